@@ -0,0 +1,361 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Hash.h"
+#include "Image.h"
+#include "MappedFile.h"
+#include "PatternSet.h"
+#include "Regions.h"
+#include "Scanner.h"
+#include "ThreadPool.h"
+
+namespace SyxLib
+{
+    /**
+     * A PE or ELF file scanned in place, without loading it.
+     *
+     * The file is mapped read-only and each section is scanned where it lies in the file; results
+     * are RVAs (offsets from the module base once loaded), the same offsets an in-process scan of
+     * the loaded module returns relative to its base. Sections are scanned over their file-backed
+     * bytes in RVA order, and sections adjacent both in memory and in the file are scanned as one,
+     * as their loaded counterparts are. Matches that would run into zero-filled memory are not
+     * reported, and writable data holds its initial contents, not what a running process stores.
+     * Code patched by base relocations (PE loaded away from its preferred base) may differ from
+     * the file where absolute addresses are embedded.
+     *
+     * Nothing is copied and a FileImage is never modified, so one instance can be scanned from
+     * many threads at once.
+     *
+     * @example
+     * SyxLib::FileImage image("build/game.dll");
+     * size_t rva = image.Find(SyxLib::Scanner(SyxLib::Pattern("48 89 5C 24 ?? 57")), SyxLib::RegionFilter::Code());
+     */
+    class FileImage
+    {
+    public:
+        FileImage() = default;
+
+        /**
+         * Opens and parses a file. Check IsOpen() for the result.
+         */
+        explicit FileImage(const std::string& path)
+        {
+            Open(path);
+        }
+
+        /**
+         * Maps a file and parses its section table.
+         *
+         * @return False if the file cannot be mapped or is not a PE or ELF image.
+         */
+        bool Open(const std::string& path)
+        {
+            m_views.clear();
+            if (!m_file.Open(path, MappedFile::READ_ONLY) || !Parse(m_file.Data(), m_file.Size()))
+            {
+                m_file.Close();
+                m_data = nullptr;
+                m_size = 0;
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Uses an image already in memory in file layout, e.g. read from an archive. The buffer
+         * must outlive the FileImage.
+         *
+         * @return False if the buffer is not a PE or ELF image.
+         */
+        bool Open(const uint8_t* data, size_t size)
+        {
+            m_file.Close();
+            m_views.clear();
+            if (!Parse(data, size))
+            {
+                m_data = nullptr;
+                m_size = 0;
+                return false;
+            }
+            return true;
+        }
+
+        bool IsOpen() const
+        {
+            return m_data != nullptr;
+        }
+
+        /** @return The raw file bytes. */
+        const uint8_t* Data() const
+        {
+            return m_data;
+        }
+
+        size_t Size() const
+        {
+            return m_size;
+        }
+
+        /**
+         * @return Sections (PE) or loadable segments (ELF), with RVAs relative to the module base.
+         */
+        const std::vector<ImageSection>& Sections() const
+        {
+            return m_sections;
+        }
+
+        /**
+         * @return Bytes the image spans once loaded, as GetModuleInfo reports in SizeOfImage.
+         */
+        size_t ImageSize() const
+        {
+            return m_imageSize;
+        }
+
+        /**
+         * Converts an RVA to the file offset holding its byte.
+         *
+         * @return False for RVAs outside the file-backed part of every section.
+         */
+        bool RvaToOffset(uint64_t rva, uint64_t& offset) const
+        {
+            for (const View& view : m_views)
+            {
+                if (rva >= view.rva && rva - view.rva < view.size)
+                {
+                    offset = view.offset + (rva - view.rva);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Converts a file offset to the RVA its byte is loaded at.
+         *
+         * @return False for offsets that are not loaded (for example debug data).
+         */
+        bool OffsetToRva(uint64_t offset, uint64_t& rva) const
+        {
+            for (const View& view : m_views)
+            {
+                if (offset >= view.offset && offset - view.offset < view.size)
+                {
+                    rva = view.rva + (offset - view.offset);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * The file-backed parts of the loaded image. Region bases are RVAs, not addresses.
+         *
+         * @param filter The sections or protections to keep.
+         * @return Regions sorted by RVA.
+         */
+        std::vector<MemoryRegion> Regions(const RegionFilter& filter = RegionFilter()) const
+        {
+            std::vector<MemoryRegion> regions;
+            for (const View& view : Select(filter))
+            {
+                regions.push_back({ static_cast<uintptr_t>(view.rva), static_cast<size_t>(view.size), view.protection, view.name });
+            }
+            return regions;
+        }
+
+        /**
+         * Finds the first match of a pattern by RVA.
+         *
+         * @param scanner The compiled pattern.
+         * @param filter The sections or protections to scan.
+         * @return RVA of the first match, or NOT_FOUND.
+         */
+        size_t Find(const Scanner& scanner, const RegionFilter& filter = RegionFilter()) const
+        {
+            for (const View& view : Select(filter))
+            {
+                const size_t found = scanner.Find(m_data + view.offset, static_cast<size_t>(view.size));
+                if (found != NOT_FOUND)
+                {
+                    return static_cast<size_t>(view.rva) + found;
+                }
+            }
+            return NOT_FOUND;
+        }
+
+        /**
+         * Resolves every signature of a compiled set with one pass per section.
+         *
+         * @return RVA of the first match of each signature, indexed like PatternSet::Add, NOT_FOUND if absent.
+         */
+        std::vector<size_t> Find(const PatternSet& set, const RegionFilter& filter = RegionFilter()) const
+        {
+            std::vector<size_t> rvas(set.Size(), NOT_FOUND);
+            for (const View& view : Select(filter))
+            {
+                const std::vector<size_t> found = set.Scan(m_data + view.offset, static_cast<size_t>(view.size));
+                for (size_t i = 0; i < rvas.size(); i++)
+                {
+                    if (rvas[i] == NOT_FOUND && found[i] != NOT_FOUND)
+                    {
+                        rvas[i] = static_cast<size_t>(view.rva) + found[i];
+                    }
+                }
+            }
+            return rvas;
+        }
+
+        /**
+         * Computes ComputeModuleKey as it would be for this file once loaded, so a SignatureCache
+         * can be filled with RVAs resolved offline and hit by the running program.
+         * Code changed by relocations at load time yields a different key, and thus a cache miss.
+         */
+        uint64_t ModuleKey() const
+        {
+            const size_t size = m_imageSize;
+            uint64_t key = Hash64(&size, sizeof(size));
+            uint64_t stamp;
+            if (ReadImageStamp(m_data, m_size, false, stamp))
+            {
+                key = Hash64(&stamp, sizeof(stamp), key);
+            }
+
+            std::vector<uint8_t> padded;
+            for (const ImageSection& section : m_sections)
+            {
+                if (!(section.protection & PROTECT_EXECUTE) || section.virtualAddress >= size)
+                {
+                    continue;
+                }
+                // Hash the loaded bytes: file data, then zeros up to the loaded size.
+                const uint64_t length = (std::min)(section.virtualSize, uint64_t(size) - section.virtualAddress);
+                const uint64_t backed = section.fileOffset < m_size ? (std::min)({ length, section.fileSize, uint64_t(m_size) - section.fileOffset }) : 0;
+                if (backed == length)
+                {
+                    key = Hash64(m_data + section.fileOffset, static_cast<size_t>(length), key);
+                    continue;
+                }
+                padded.assign(static_cast<size_t>(length), 0);
+                memcpy(padded.data(), m_data + section.fileOffset, static_cast<size_t>(backed));
+                key = Hash64(padded.data(), padded.size(), key);
+            }
+            return key;
+        }
+
+    private:
+        /** File-backed bytes of a section, or of adjacent sections merged. */
+        struct View
+        {
+            uint64_t rva;
+            uint64_t offset;
+            uint64_t size;
+            uint32_t protection;
+            std::string name;
+        };
+
+        bool Parse(const uint8_t* data, size_t size)
+        {
+            m_sections.clear();
+            m_imageSize = 0;
+            uint64_t sizeOfImage = 0;
+            const bool pe = IsPeImage(data, size);
+            if (!data || !(pe ? ParsePeSections(data, size, m_sections, &sizeOfImage) : ParseElfSegments(data, size, m_sections)) || m_sections.empty())
+            {
+                return false;
+            }
+            m_data = data;
+            m_size = size;
+
+            uint64_t end = 0;
+            for (const ImageSection& section : m_sections)
+            {
+                end = (std::max)(end, section.virtualAddress + section.virtualSize);
+                const uint64_t backed = section.fileOffset < size ? (std::min)({ section.fileSize, section.virtualSize, uint64_t(size) - section.fileOffset }) : 0;
+                if (backed)
+                {
+                    m_views.push_back({ section.virtualAddress, section.fileOffset, backed, section.protection, section.name });
+                }
+            }
+            m_imageSize = static_cast<size_t>(pe ? sizeOfImage : end);
+
+            std::sort(m_views.begin(), m_views.end(), [](const View& a, const View& b) { return a.rva < b.rva; });
+            return true;
+        }
+
+        /** Views accepted by a filter, merged where they are contiguous both in memory and in the file. */
+        std::vector<View> Select(const RegionFilter& filter) const
+        {
+            std::vector<View> views;
+            for (const View& view : m_views)
+            {
+                if (!filter.Accepts({ static_cast<uintptr_t>(view.rva), static_cast<size_t>(view.size), view.protection, view.name }))
+                {
+                    continue;
+                }
+                if (!views.empty() && views.back().rva + views.back().size == view.rva && views.back().offset + views.back().size == view.offset)
+                {
+                    View& last = views.back();
+                    last.size += view.size;
+                    last.protection &= view.protection;
+                    if (last.name != view.name)
+                    {
+                        last.name.clear();
+                    }
+                    continue;
+                }
+                views.push_back(view);
+            }
+            return views;
+        }
+
+        MappedFile m_file;
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_imageSize = 0;
+        std::vector<ImageSection> m_sections;
+        std::vector<View> m_views;
+    };
+
+    /**
+     * Resolves a set of signatures in many files at once, one file per task, for checking
+     * signatures against a library of builds.
+     *
+     * @param paths Files to scan.
+     * @param set Compiled signatures.
+     * @param filter The sections or protections to scan.
+     * @param pool Pool to run on, nullptr = ThreadPool::Default().
+     * @return Per file, the RVA of each signature (NOT_FOUND if absent); an empty list for files that
+     *         cannot be opened or are not images.
+     * @throw std::logic_error if the set was modified since the last Compile().
+     */
+    inline std::vector<std::vector<size_t>> FindInFiles(const std::vector<std::string>& paths, const PatternSet& set,
+        const RegionFilter& filter = RegionFilter(), ThreadPool* pool = nullptr)
+    {
+        if (!set.IsCompiled())
+        {
+            throw std::logic_error("FindInFiles called with a PatternSet that is not compiled.");
+        }
+        std::vector<std::vector<size_t>> results(paths.size());
+        ThreadPool& workers = pool ? *pool : ThreadPool::Default();
+        std::atomic<size_t> next{ 0 };
+        workers.Run(workers.Concurrency(), [&](unsigned)
+        {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < paths.size();)
+            {
+                FileImage image;
+                if (image.Open(paths[i]))
+                {
+                    results[i] = image.Find(set, filter);
+                }
+            }
+        });
+        return results;
+    }
+}
@@ -0,0 +1,267 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Pattern.h"
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /** The closest match of a pattern found by FindBestMatch. */
+    struct FuzzyMatch
+    {
+        /** Offset of the match, NOT_FOUND if no location is within the allowed mismatches. */
+        size_t offset = NOT_FOUND;
+        /** Significant pattern bytes that differ at offset. */
+        size_t mismatches = 0;
+    };
+
+    namespace Detail
+    {
+        /** A significant byte of a pattern, compared at a fixed position. */
+        struct FuzzyByte
+        {
+            size_t position;
+            uint8_t value;
+        };
+
+        /**
+         * Significant bytes of a pattern, rarest first: a rare byte is the likeliest to differ at a
+         * random location, so the counters of most candidates exceed the bound after a few bytes.
+         */
+        inline std::vector<FuzzyByte> FuzzyBytes(const Scanner& scanner)
+        {
+            std::vector<FuzzyByte> bytes;
+            for (size_t i = 0; i < scanner.Length(); i++)
+            {
+                if (scanner.IsSignificant(i))
+                {
+                    bytes.push_back({ i, scanner.ByteAt(i) });
+                }
+            }
+            std::stable_sort(bytes.begin(), bytes.end(), [](const FuzzyByte& a, const FuzzyByte& b)
+            {
+                return BYTE_FREQUENCY_RANK[a.value] < BYTE_FREQUENCY_RANK[b.value];
+            });
+            return bytes;
+        }
+
+        /**
+         * Keeps the best of the exact counts of one block of candidates: counts[n] belongs to
+         * candidate base + n, and counts above limit are ignored.
+         *
+         * @return True once a match with one mismatch is found: exact matches were ruled out before.
+         */
+        inline bool TakeBest(const uint8_t* counts, size_t lanes, size_t base, size_t& limit, FuzzyMatch& best)
+        {
+            for (size_t lane = 0; lane < lanes; lane++)
+            {
+                if (counts[lane] <= limit && (best.offset == NOT_FOUND || counts[lane] < best.mismatches))
+                {
+                    best.offset = base + lane;
+                    best.mismatches = counts[lane];
+                    if (best.mismatches <= 1)
+                    {
+                        return true;
+                    }
+                    limit = best.mismatches - 1;
+                }
+            }
+            return false;
+        }
+
+        /** Counts mismatches candidate by candidate, giving up on one as soon as it exceeds the bound. */
+        inline bool FuzzyScalar(const std::vector<FuzzyByte>& bytes, const uint8_t* data, size_t from, size_t count, size_t& limit, FuzzyMatch& best)
+        {
+            for (size_t i = from; i < count; i++)
+            {
+                size_t mismatches = 0;
+                for (const FuzzyByte& byte : bytes)
+                {
+                    if (data[i + byte.position] != byte.value && ++mismatches > limit)
+                    {
+                        break;
+                    }
+                }
+                const uint8_t clamped = static_cast<uint8_t>((std::min)(mismatches, limit + 1));
+                if (TakeBest(&clamped, 1, i, limit, best))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+#ifdef SYX_X86
+        // The vector kernels keep one saturating byte counter per candidate offset, 16, 32 or 64
+        // candidates per block. Each significant byte adds one to the lanes where it differs, and the
+        // block is abandoned as soon as every lane exceeds the bound.
+
+        SYX_TARGET("sse2")
+        inline bool FuzzySSE2(const std::vector<FuzzyByte>& bytes, const uint8_t* data, size_t count, size_t& limit, FuzzyMatch& best, size_t& next)
+        {
+            const __m128i one = _mm_set1_epi8(1);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m128i over = _mm_set1_epi8(static_cast<char>(limit + 1));
+                __m128i counts = _mm_setzero_si128();
+                bool alive = true;
+                for (const FuzzyByte& byte : bytes)
+                {
+                    const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + byte.position)),
+                        _mm_set1_epi8(static_cast<char>(byte.value)));
+                    counts = _mm_adds_epu8(counts, _mm_andnot_si128(equal, one));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(counts, over), over)) == 0xFFFF)
+                    {
+                        alive = false;
+                        break;
+                    }
+                }
+                alignas(16) uint8_t lanes[16];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), counts);
+                if (alive && TakeBest(lanes, 16, i, limit, best))
+                {
+                    return true;
+                }
+            }
+            next = i;
+            return false;
+        }
+
+        SYX_TARGET("avx2")
+        inline bool FuzzyAVX2(const std::vector<FuzzyByte>& bytes, const uint8_t* data, size_t count, size_t& limit, FuzzyMatch& best, size_t& next)
+        {
+            const __m256i one = _mm256_set1_epi8(1);
+            size_t i = 0;
+            for (; i + 32 <= count; i += 32)
+            {
+                const __m256i over = _mm256_set1_epi8(static_cast<char>(limit + 1));
+                __m256i counts = _mm256_setzero_si256();
+                bool alive = true;
+                for (const FuzzyByte& byte : bytes)
+                {
+                    const __m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + byte.position)),
+                        _mm256_set1_epi8(static_cast<char>(byte.value)));
+                    counts = _mm256_adds_epu8(counts, _mm256_andnot_si256(equal, one));
+                    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(counts, over), over)) == -1)
+                    {
+                        alive = false;
+                        break;
+                    }
+                }
+                alignas(32) uint8_t lanes[32];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), counts);
+                if (alive && TakeBest(lanes, 32, i, limit, best))
+                {
+                    return true;
+                }
+            }
+            next = i;
+            return false;
+        }
+
+        SYX_TARGET("avx512f,avx512bw")
+        inline bool FuzzyAVX512(const std::vector<FuzzyByte>& bytes, const uint8_t* data, size_t count, size_t& limit, FuzzyMatch& best, size_t& next)
+        {
+            const __m512i one = _mm512_set1_epi8(1);
+            size_t i = 0;
+            for (; i + 64 <= count; i += 64)
+            {
+                const __m512i over = _mm512_set1_epi8(static_cast<char>(limit + 1));
+                __m512i counts = _mm512_setzero_si512();
+                bool alive = true;
+                for (const FuzzyByte& byte : bytes)
+                {
+                    const __mmask64 differ = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(data + i + byte.position),
+                        _mm512_set1_epi8(static_cast<char>(byte.value)));
+                    counts = _mm512_mask_adds_epu8(counts, differ, counts, one);
+                    if (_mm512_cmplt_epu8_mask(counts, over) == 0)
+                    {
+                        alive = false;
+                        break;
+                    }
+                }
+                alignas(64) uint8_t lanes[64];
+                _mm512_store_si512(lanes, counts);
+                if (alive && TakeBest(lanes, 64, i, limit, best))
+                {
+                    return true;
+                }
+            }
+            next = i;
+            return false;
+        }
+#endif
+    }
+
+    /**
+     * Finds where a pattern matches with the fewest differing bytes, for recovering a signature
+     * that an update broke by changing a few of its bytes (an offset, a register, an operand).
+     *
+     * Only substitutions are counted, as a signature compares fixed positions: a location matches
+     * with n mismatches when all but n significant bytes are equal. The vector kernels count the
+     * mismatches of 16 to 64 consecutive candidate offsets at once in saturating byte counters,
+     * comparing the pattern's rarest bytes first and dropping a block as soon as every counter
+     * exceeds the bound, which tightens to one less than the best match found so far. A random
+     * location therefore costs a handful of compares. An exact match is looked for first with Find.
+     *
+     * @param scanner The pattern.
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param maxMismatches Significant bytes allowed to differ, at most 254.
+     * @param level Instruction set to use, lowered to what the CPU supports.
+     * @return The match with the fewest mismatches, the lowest offset among equals.
+     *
+     * @example
+     * SyxLib::FuzzyMatch match = SyxLib::FindBestMatch(SyxLib::Scanner(signature), base, size, 3);
+     * if (match.offset != SyxLib::NOT_FOUND && match.mismatches) log("signature drifted by %zu bytes", match.mismatches);
+     */
+    inline FuzzyMatch FindBestMatch(const Scanner& scanner, const uint8_t* data, size_t size, size_t maxMismatches, ScanLevel level = DetectScanLevel())
+    {
+        FuzzyMatch best;
+        const size_t length = scanner.Length();
+        if (!length || size < length)
+        {
+            return best;
+        }
+        const size_t exact = scanner.Find(data, size, 0, level);
+        if (exact != NOT_FOUND || !maxMismatches)
+        {
+            best.offset = exact;
+            return best;
+        }
+
+        const std::vector<Detail::FuzzyByte> bytes = Detail::FuzzyBytes(scanner);
+        const size_t count = size - length + 1;
+        size_t limit = (std::min)({ maxMismatches, bytes.size(), size_t(254) });
+        size_t next = 0;
+        if (level > DetectScanLevel())
+        {
+            level = DetectScanLevel();
+        }
+        bool done = false;
+        switch (level)
+        {
+#ifdef SYX_X86
+        case ScanLevel::AVX512:
+            done = Detail::FuzzyAVX512(bytes, data, count, limit, best, next);
+            break;
+        case ScanLevel::AVX2:
+            done = Detail::FuzzyAVX2(bytes, data, count, limit, best, next);
+            break;
+        case ScanLevel::SSE2:
+            done = Detail::FuzzySSE2(bytes, data, count, limit, best, next);
+            break;
+#endif
+        default:
+            break;
+        }
+        if (!done)
+        {
+            Detail::FuzzyScalar(bytes, data, next, count, limit, best);
+        }
+        return best;
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace SyxLib
+{
+    namespace Detail
+    {
+        static constexpr uint64_t XXH_PRIME1 = 11400714785074694791ULL;
+        static constexpr uint64_t XXH_PRIME2 = 14029467366897019727ULL;
+        static constexpr uint64_t XXH_PRIME3 = 1609587929392839161ULL;
+        static constexpr uint64_t XXH_PRIME4 = 9650029242287828579ULL;
+        static constexpr uint64_t XXH_PRIME5 = 2870177450012600261ULL;
+
+        inline uint64_t RotateLeft(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        inline uint64_t Read64(const uint8_t* p)
+        {
+            uint64_t value;
+            memcpy(&value, p, 8);
+            return value;
+        }
+
+        inline uint32_t Read32(const uint8_t* p)
+        {
+            uint32_t value;
+            memcpy(&value, p, 4);
+            return value;
+        }
+
+        inline uint64_t XxhRound(uint64_t acc, uint64_t input)
+        {
+            acc += input * XXH_PRIME2;
+            acc = RotateLeft(acc, 31);
+            return acc * XXH_PRIME1;
+        }
+
+        inline uint64_t XxhMerge(uint64_t acc, uint64_t value)
+        {
+            acc ^= XxhRound(0, value);
+            return acc * XXH_PRIME1 + XXH_PRIME4;
+        }
+    }
+
+    /**
+     * XXH64 hash of a buffer. Runs at several GB/s, fast enough to fingerprint whole code sections
+     * and 4 KB pages on every startup. The output is identical to the reference xxHash XXH64.
+     *
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param seed Seed; pass a previous hash to chain several buffers.
+     * @return 64-bit hash.
+     */
+    inline uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0)
+    {
+        using namespace Detail;
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + size;
+        uint64_t hash;
+
+        if (size >= 32)
+        {
+            uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+            uint64_t v2 = seed + XXH_PRIME2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - XXH_PRIME1;
+            const uint8_t* const limit = end - 32;
+            do
+            {
+                v1 = XxhRound(v1, Read64(p));
+                v2 = XxhRound(v2, Read64(p + 8));
+                v3 = XxhRound(v3, Read64(p + 16));
+                v4 = XxhRound(v4, Read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+            hash = XxhMerge(hash, v1);
+            hash = XxhMerge(hash, v2);
+            hash = XxhMerge(hash, v3);
+            hash = XxhMerge(hash, v4);
+        }
+        else
+        {
+            hash = seed + XXH_PRIME5;
+        }
+
+        hash += static_cast<uint64_t>(size);
+        for (; p + 8 <= end; p += 8)
+        {
+            hash ^= XxhRound(0, Read64(p));
+            hash = RotateLeft(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+        }
+        if (p + 4 <= end)
+        {
+            hash ^= static_cast<uint64_t>(Read32(p)) * XXH_PRIME1;
+            hash = RotateLeft(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+            p += 4;
+        }
+        for (; p < end; p++)
+        {
+            hash ^= (*p) * XXH_PRIME5;
+            hash = RotateLeft(hash, 11) * XXH_PRIME1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= XXH_PRIME2;
+        hash ^= hash >> 29;
+        hash *= XXH_PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
@@ -0,0 +1,264 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SYX_HOOK_STATS 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace SyxLib
+{
+    /**
+     * Call counts and latencies of one instrumented hook, merged from all threads.
+     *
+     * Latencies are in time-stamp counter ticks and cover the whole hooked call: the detour and
+     * everything it calls, including the original function.
+     */
+    struct HookStats
+    {
+        /** Histogram buckets: bucket 0 counts calls of 0 ticks, bucket i calls of [2^(i-1), 2^i) ticks. */
+        static constexpr size_t BUCKETS = 40;
+
+        /** Calls that entered the detour. */
+        uint64_t calls = 0;
+        /** Calls that returned and were timed, the sum of the histogram. */
+        uint64_t timedCalls = 0;
+        uint64_t totalTicks = 0;
+        uint64_t histogram[BUCKETS] = {};
+
+        double MeanTicks() const
+        {
+            return timedCalls ? static_cast<double>(totalTicks) / static_cast<double>(timedCalls) : 0.0;
+        }
+
+        /**
+         * @param quantile Between 0 and 1, e.g. 0.99.
+         * @return Upper bound in ticks of the bucket holding the quantile, 0 without timed calls.
+         */
+        uint64_t PercentileTicks(double quantile) const
+        {
+            const double rank = quantile * static_cast<double>(timedCalls);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++)
+            {
+                seen += histogram[i];
+                if (seen && static_cast<double>(seen) >= rank)
+                {
+                    return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+                }
+            }
+            return 0;
+        }
+    };
+
+    namespace Detail
+    {
+        /** Counter copies per hook; threads are spread over them round-robin. */
+        static constexpr size_t COUNTER_SHARDS = 16;
+
+        /** Nested instrumented calls timed per thread; deeper calls are only counted. */
+        static constexpr size_t SHADOW_DEPTH = 64;
+
+        /** One cache line group per shard so threads on different shards never share a line. */
+        struct alignas(64) CounterShard
+        {
+            std::atomic<uint64_t> calls;
+            std::atomic<uint64_t> totalTicks;
+            std::atomic<uint64_t> histogram[HookStats::BUCKETS];
+        };
+
+        /** Per-hook stub: mov r11, counters; jmp [rip + 0]; dq enter thunk. */
+        static constexpr size_t INSTRUMENT_STUB_BYTES = 24;
+
+        /** Counters of one hook, value-initialized to zero. */
+        struct HookCounters
+        {
+            CounterShard shards[COUNTER_SHARDS];
+            const void* detour;
+            uintptr_t exitThunk;
+        };
+
+        struct ShadowFrame
+        {
+            uintptr_t returnAddress;
+            HookCounters* counters;
+            uint64_t start;
+        };
+
+        /** Return addresses replaced by the exit thunk, innermost last. */
+        struct ShadowStack
+        {
+            size_t depth;
+            ShadowFrame frames[SHADOW_DEPTH];
+        };
+
+        /** Sums the shards while callers keep updating them; each counter is read once. */
+        inline void MergeCounters(const HookCounters& counters, HookStats& stats)
+        {
+            stats = HookStats();
+            for (const CounterShard& shard : counters.shards)
+            {
+                stats.calls += shard.calls.load(std::memory_order_relaxed);
+                stats.totalTicks += shard.totalTicks.load(std::memory_order_relaxed);
+                for (size_t i = 0; i < HookStats::BUCKETS; i++)
+                {
+                    const uint64_t count = shard.histogram[i].load(std::memory_order_relaxed);
+                    stats.histogram[i] += count;
+                    stats.timedCalls += count;
+                }
+            }
+        }
+
+#ifdef SYX_HOOK_STATS
+        inline ShadowStack& GetShadowStack()
+        {
+            static thread_local ShadowStack stack;
+            return stack;
+        }
+
+        inline size_t ThreadShard()
+        {
+            static std::atomic<uint32_t> next{ 0 };
+            static thread_local uint32_t shard = UINT32_MAX;
+            if (shard == UINT32_MAX)
+            {
+                shard = next.fetch_add(1, std::memory_order_relaxed) % COUNTER_SHARDS;
+            }
+            return shard;
+        }
+
+        inline size_t TickBucket(uint64_t ticks)
+        {
+            size_t bucket = 0;
+            while (ticks && bucket < HookStats::BUCKETS - 1)
+            {
+                ticks >>= 1;
+                bucket++;
+            }
+            return bucket;
+        }
+
+        /**
+         * Called by the enter thunk: counts the call and, unless the thread's shadow stack is full,
+         * saves the return address and start time and returns through the exit thunk instead.
+         *
+         * @return The detour to continue in.
+         */
+        inline uintptr_t InstrumentEnter(HookCounters* counters, uintptr_t* returnSlot)
+        {
+            counters->shards[ThreadShard()].calls.fetch_add(1, std::memory_order_relaxed);
+            ShadowStack& stack = GetShadowStack();
+            if (stack.depth < SHADOW_DEPTH)
+            {
+                stack.frames[stack.depth++] = { *returnSlot, counters, __rdtsc() };
+                *returnSlot = counters->exitThunk;
+            }
+            return reinterpret_cast<uintptr_t>(counters->detour);
+        }
+
+        /**
+         * Called by the exit thunk when the detour returns: records the latency.
+         *
+         * @return The caller's real return address.
+         */
+        inline uintptr_t InstrumentExit()
+        {
+            const uint64_t end = __rdtsc();
+            ShadowStack& stack = GetShadowStack();
+            const ShadowFrame frame = stack.frames[--stack.depth];
+            const uint64_t ticks = end - frame.start;
+            CounterShard& shard = frame.counters->shards[ThreadShard()];
+            shard.totalTicks.fetch_add(ticks, std::memory_order_relaxed);
+            shard.histogram[TickBucket(ticks)].fetch_add(1, std::memory_order_relaxed);
+            return frame.returnAddress;
+        }
+
+        /**
+         * Shared thunks, written once per HookManager.
+         *
+         * Enter (r11 = counters, [rsp] = return address): saves the argument registers of both
+         * x64 calling conventions (rdi, rsi, rdx, rcx, r8, r9, r10, rax, xmm0-7), calls
+         * InstrumentEnter with the arguments in both register sets and 32 bytes of shadow space,
+         * restores the registers and jumps to the detour.
+         *
+         * Exit (reached by the detour's ret): saves the return registers (rax, rdx, xmm0, xmm1),
+         * calls InstrumentExit and jumps to the real return address.
+         */
+        static constexpr uint8_t INSTRUMENT_THUNKS[] =
+        {
+            // enter
+            0x57, 0x56, 0x52, 0x51, 0x41, 0x50, 0x41, 0x51, 0x41, 0x52, 0x50,   // push rdi, rsi, rdx, rcx, r8, r9, r10, rax
+            0x48, 0x81, 0xEC, 0xA8, 0x00, 0x00, 0x00,                           // sub rsp, 0xA8
+            0xF3, 0x0F, 0x7F, 0x44, 0x24, 0x20,                                 // movdqu [rsp+0x20], xmm0
+            0xF3, 0x0F, 0x7F, 0x4C, 0x24, 0x30,                                 // movdqu [rsp+0x30], xmm1
+            0xF3, 0x0F, 0x7F, 0x54, 0x24, 0x40,                                 // movdqu [rsp+0x40], xmm2
+            0xF3, 0x0F, 0x7F, 0x5C, 0x24, 0x50,                                 // movdqu [rsp+0x50], xmm3
+            0xF3, 0x0F, 0x7F, 0x64, 0x24, 0x60,                                 // movdqu [rsp+0x60], xmm4
+            0xF3, 0x0F, 0x7F, 0x6C, 0x24, 0x70,                                 // movdqu [rsp+0x70], xmm5
+            0xF3, 0x0F, 0x7F, 0xB4, 0x24, 0x80, 0x00, 0x00, 0x00,               // movdqu [rsp+0x80], xmm6
+            0xF3, 0x0F, 0x7F, 0xBC, 0x24, 0x90, 0x00, 0x00, 0x00,               // movdqu [rsp+0x90], xmm7
+            0x4C, 0x89, 0xDF,                                                   // mov rdi, r11
+            0x4C, 0x89, 0xD9,                                                   // mov rcx, r11
+            0x48, 0x8D, 0xB4, 0x24, 0xE8, 0x00, 0x00, 0x00,                     // lea rsi, [rsp+0xE8] (return address)
+            0x48, 0x89, 0xF2,                                                   // mov rdx, rsi
+            0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0,                                 // mov rax, InstrumentEnter
+            0xFF, 0xD0,                                                         // call rax
+            0x49, 0x89, 0xC3,                                                   // mov r11, rax
+            0xF3, 0x0F, 0x6F, 0x44, 0x24, 0x20,                                 // movdqu xmm0, [rsp+0x20]
+            0xF3, 0x0F, 0x6F, 0x4C, 0x24, 0x30,                                 // movdqu xmm1, [rsp+0x30]
+            0xF3, 0x0F, 0x6F, 0x54, 0x24, 0x40,                                 // movdqu xmm2, [rsp+0x40]
+            0xF3, 0x0F, 0x6F, 0x5C, 0x24, 0x50,                                 // movdqu xmm3, [rsp+0x50]
+            0xF3, 0x0F, 0x6F, 0x64, 0x24, 0x60,                                 // movdqu xmm4, [rsp+0x60]
+            0xF3, 0x0F, 0x6F, 0x6C, 0x24, 0x70,                                 // movdqu xmm5, [rsp+0x70]
+            0xF3, 0x0F, 0x6F, 0xB4, 0x24, 0x80, 0x00, 0x00, 0x00,               // movdqu xmm6, [rsp+0x80]
+            0xF3, 0x0F, 0x6F, 0xBC, 0x24, 0x90, 0x00, 0x00, 0x00,               // movdqu xmm7, [rsp+0x90]
+            0x48, 0x81, 0xC4, 0xA8, 0x00, 0x00, 0x00,                           // add rsp, 0xA8
+            0x58, 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58, 0x59, 0x5A, 0x5E, 0x5F,   // pop rax, r10, r9, r8, rcx, rdx, rsi, rdi
+            0x41, 0xFF, 0xE3,                                                   // jmp r11
+            // exit
+            0x50, 0x52,                                                         // push rax, rdx
+            0x48, 0x83, 0xEC, 0x40,                                             // sub rsp, 0x40
+            0xF3, 0x0F, 0x7F, 0x44, 0x24, 0x20,                                 // movdqu [rsp+0x20], xmm0
+            0xF3, 0x0F, 0x7F, 0x4C, 0x24, 0x30,                                 // movdqu [rsp+0x30], xmm1
+            0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0,                                 // mov rax, InstrumentExit
+            0xFF, 0xD0,                                                         // call rax
+            0x49, 0x89, 0xC3,                                                   // mov r11, rax
+            0xF3, 0x0F, 0x6F, 0x44, 0x24, 0x20,                                 // movdqu xmm0, [rsp+0x20]
+            0xF3, 0x0F, 0x6F, 0x4C, 0x24, 0x30,                                 // movdqu xmm1, [rsp+0x30]
+            0x48, 0x83, 0xC4, 0x40,                                             // add rsp, 0x40
+            0x5A, 0x58,                                                         // pop rdx, rax
+            0x41, 0xFF, 0xE3                                                    // jmp r11
+        };
+        static_assert(sizeof(INSTRUMENT_THUNKS) == 0xE9, "thunk offsets below are out of date");
+        static constexpr size_t INSTRUMENT_ENTER_CALL = 0x5B;
+        static constexpr size_t INSTRUMENT_EXIT_OFFSET = 0xB3;
+        static constexpr size_t INSTRUMENT_EXIT_CALL = 0xC7;
+
+        inline void WriteInstrumentThunks(uint8_t* at)
+        {
+            const uint64_t enter = reinterpret_cast<uintptr_t>(&InstrumentEnter);
+            const uint64_t exit = reinterpret_cast<uintptr_t>(&InstrumentExit);
+            memcpy(at, INSTRUMENT_THUNKS, sizeof(INSTRUMENT_THUNKS));
+            memcpy(at + INSTRUMENT_ENTER_CALL, &enter, sizeof(enter));
+            memcpy(at + INSTRUMENT_EXIT_CALL, &exit, sizeof(exit));
+        }
+
+        inline void WriteInstrumentStub(uint8_t* at, const HookCounters* counters, const uint8_t* thunks)
+        {
+            static const uint8_t code[] = { 0x49, 0xBB, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+            const uint64_t counterAddress = reinterpret_cast<uintptr_t>(counters);
+            const uint64_t enter = reinterpret_cast<uintptr_t>(thunks);
+            memcpy(at, code, sizeof(code));
+            memcpy(at + 2, &counterAddress, sizeof(counterAddress));
+            memcpy(at + sizeof(code), &enter, sizeof(enter));
+        }
+#endif
+    }
+}
@@ -0,0 +1,1285 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "HookStats.h"
+#include "Instruction.h"
+#include "Platform.h"
+#include "Regions.h"
+
+#ifdef _WIN32
+#include <TlHelp32.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#endif
+
+namespace SyxLib
+{
+    /** Why a hook operation failed. */
+    enum class HookStatus : uint8_t
+    {
+        Ok,
+        /** Null target or detour. */
+        InvalidArgument,
+        /** The target already has a hook. */
+        AlreadyHooked,
+        /** No hook exists for the target. */
+        UnknownHook,
+        /** The prologue cannot be decoded or relocated, or is shorter than the jump. */
+        NotRelocatable,
+        /** No trampoline memory could be placed within reach of the target. */
+        NoNearMemory,
+        /** The page protection of the target could not be changed. */
+        ProtectFailed,
+        /** The other threads could not be suspended; nothing was patched. */
+        SuspendFailed,
+        /** Instrumentation needs x86-64. */
+        NotSupported,
+        /** The module does not import the function. */
+        NotFound,
+        /** A pointer slot no longer holds the pointer the hook expects. */
+        SlotChanged
+    };
+
+    /** How HookManager writes patches while other threads may run the code. */
+    enum class PatchMode : uint8_t
+    {
+        /**
+         * Patches that only replace the first instruction are written with atomic stores and no
+         * thread is stopped: the 5-byte jump when the first instruction is at least that long,
+         * otherwise a 2-byte jmp rel8 to a jmp rel32 placed in int3/nop padding right before the
+         * function. Other targets are patched with the threads suspended.
+         */
+        Atomic,
+        /**
+         * All other threads are suspended for every batch, and threads stopped inside the bytes
+         * being replaced are moved to the matching instruction in the trampoline.
+         */
+        SuspendThreads
+    };
+
+    /**
+     * @return A short description of the status.
+     */
+    inline const char* ToString(HookStatus status)
+    {
+        switch (status)
+        {
+        case HookStatus::Ok:
+            return "ok";
+        case HookStatus::InvalidArgument:
+            return "null target or detour";
+        case HookStatus::AlreadyHooked:
+            return "target is already hooked";
+        case HookStatus::UnknownHook:
+            return "target is not hooked";
+        case HookStatus::NotRelocatable:
+            return "prologue cannot be relocated";
+        case HookStatus::NoNearMemory:
+            return "no trampoline memory within reach";
+        case HookStatus::ProtectFailed:
+            return "cannot change page protection";
+        case HookStatus::SuspendFailed:
+            return "cannot suspend threads";
+        case HookStatus::NotSupported:
+            return "not supported on this architecture";
+        case HookStatus::NotFound:
+            return "import not found";
+        case HookStatus::SlotChanged:
+            return "pointer slot was changed by someone else";
+        }
+        return "unknown status";
+    }
+
+    namespace Detail
+    {
+        /** Distance a rel32 branch can safely cover, leaving room for the page and the prologue. */
+        static constexpr uintptr_t NEAR_REACH = 0x7FF00000;
+
+        /**
+         * Stores up to 8 bytes of code that lie within one aligned 8-byte word with a single
+         * atomic store, so a thread fetching them sees either the old or the new bytes.
+         */
+        inline void StoreCodeWord(uint8_t* at, const uint8_t* bytes, size_t count)
+        {
+            if (count == 4 && !(reinterpret_cast<uintptr_t>(at) & 3))
+            {
+                // A whole 32-bit pointer: store just it, so a neighbour written meanwhile is not reverted.
+                uint32_t value;
+                memcpy(&value, bytes, sizeof(value));
+#ifdef _WIN32
+                InterlockedExchange(reinterpret_cast<volatile LONG*>(at), static_cast<LONG>(value));
+#else
+                __atomic_store_n(reinterpret_cast<uint32_t*>(at), value, __ATOMIC_SEQ_CST);
+#endif
+                return;
+            }
+            const uintptr_t word = reinterpret_cast<uintptr_t>(at) & ~static_cast<uintptr_t>(7);
+            uint64_t value;
+            memcpy(&value, reinterpret_cast<const void*>(word), sizeof(value));
+            memcpy(reinterpret_cast<uint8_t*>(&value) + (reinterpret_cast<uintptr_t>(at) - word), bytes, count);
+#ifdef _WIN32
+            InterlockedExchange64(reinterpret_cast<volatile LONG64*>(word), static_cast<LONG64>(value));
+#else
+            __atomic_store_n(reinterpret_cast<uint64_t*>(word), value, __ATOMIC_SEQ_CST);
+#endif
+        }
+
+        /**
+         * Replaces up to 8 bytes of code that other threads may be executing. A patch inside one
+         * aligned 8-byte word is a single store; otherwise the first two bytes are turned into a
+         * jmp-to-self, the tail is written, and the head is stored last, so threads entering meanwhile
+         * spin instead of running half-written bytes.
+         *
+         * @return False if the first two bytes straddle an 8-byte boundary.
+         */
+        inline bool WriteCodeAtomic(uint8_t* at, const uint8_t* bytes, size_t count)
+        {
+            const size_t offset = reinterpret_cast<uintptr_t>(at) & 7;
+            if (offset + count <= 8)
+            {
+                StoreCodeWord(at, bytes, count);
+                return true;
+            }
+            if (offset > 6)
+            {
+                return false;
+            }
+            static const uint8_t spin[] = { 0xEB, 0xFE };
+            StoreCodeWord(at, spin, sizeof(spin));
+            memcpy(at + 2, bytes + 2, count - 2);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            StoreCodeWord(at, bytes, 2);
+            return true;
+        }
+
+#ifndef _WIN32
+        /** Shared between ThreadSuspender and the signal handler that parks the other threads. */
+        struct SuspendState
+        {
+            /**
+             * Generation of the current suspension in the high 32 bits, threads parked in it in the
+             * low 32. Generation 0 means none is open: a signal left pending by an earlier round
+             * (a thread that blocked it until the timeout) carries an older generation and is ignored.
+             */
+            std::atomic<uint64_t> arrived;
+            std::atomic<int> departed;
+            /** Futex word the parked threads sleep on, 1 once Resume releases them. */
+            std::atomic<int> released;
+            const std::pair<uintptr_t, uintptr_t>* moves;
+            size_t moveCount;
+            uint32_t generation;
+            /** The handler stays installed for good once a round ended with signals still pending. */
+            bool stranded;
+        };
+
+        inline SuspendState& GetSuspendState()
+        {
+            static SuspendState state;
+            return state;
+        }
+
+        /** Real-time signal used to park threads; applications must leave it unblocked and unused. */
+        inline int SuspendSignal()
+        {
+            return SIGRTMIN + 6;
+        }
+
+        inline void SuspendHandler(int, siginfo_t* info, void* context)
+        {
+            SuspendState& state = GetSuspendState();
+            const uint64_t generation = static_cast<uint32_t>(info->si_value.sival_int);
+            uint64_t seen = state.arrived.load(std::memory_order_acquire);
+            do
+            {
+                if ((seen >> 32) != generation)
+                {
+                    return;
+                }
+            } while (!state.arrived.compare_exchange_weak(seen, seen + 1, std::memory_order_acq_rel));
+            const int savedErrno = errno;
+            // Sleeping instead of spinning keeps a thousand parked threads from starving the ones
+            // still on their way in.
+            while (!state.released.load(std::memory_order_acquire))
+            {
+                syscall(SYS_futex, reinterpret_cast<int*>(&state.released), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+            }
+#if defined(__x86_64__) || defined(__i386__)
+            ucontext_t* uc = static_cast<ucontext_t*>(context);
+#ifdef __x86_64__
+            greg_t& ip = uc->uc_mcontext.gregs[REG_RIP];
+#else
+            greg_t& ip = uc->uc_mcontext.gregs[REG_EIP];
+#endif
+            for (size_t i = 0; i < state.moveCount; i++)
+            {
+                if (static_cast<uintptr_t>(ip) == state.moves[i].first)
+                {
+                    ip = static_cast<greg_t>(state.moves[i].second);
+                    break;
+                }
+            }
+#else
+            (void)context;
+#endif
+            errno = savedErrno;
+            state.departed.fetch_add(1, std::memory_order_acq_rel);
+        }
+#endif
+
+        /**
+         * Stops every other thread of the process and moves instruction pointers on resume.
+         *
+         * Windows suspends the threads with SuspendThread. Linux sends each thread a real-time
+         * signal whose handler parks it on a futex until Resume; threads are listed with getdents64
+         * so nothing allocates while other threads may hold the heap lock. Between Suspend and
+         * Resume the caller must not allocate either. After a failed Suspend the handler stays
+         * installed, since a thread that blocked the signal still has it pending.
+         */
+        class ThreadSuspender
+        {
+        public:
+            ThreadSuspender() = default;
+            ThreadSuspender(const ThreadSuspender&) = delete;
+            ThreadSuspender& operator=(const ThreadSuspender&) = delete;
+
+            ~ThreadSuspender()
+            {
+                Resume(nullptr, 0);
+            }
+
+            /**
+             * @return False if a thread could not be stopped; the others are resumed again.
+             */
+            bool Suspend()
+            {
+#ifdef _WIN32
+                HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+                if (snapshot == INVALID_HANDLE_VALUE)
+                {
+                    return false;
+                }
+                const DWORD process = GetCurrentProcessId();
+                const DWORD self = GetCurrentThreadId();
+                std::vector<DWORD> ids;
+                THREADENTRY32 entry;
+                entry.dwSize = sizeof(entry);
+                for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry))
+                {
+                    if (entry.th32OwnerProcessID == process && entry.th32ThreadID != self)
+                    {
+                        ids.push_back(entry.th32ThreadID);
+                    }
+                }
+                CloseHandle(snapshot);
+
+                m_threads.reserve(ids.size());
+                for (DWORD id : ids)
+                {
+                    HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_SET_CONTEXT, FALSE, id);
+                    if (!thread)
+                    {
+                        // The thread exited since the snapshot.
+                        continue;
+                    }
+                    if (SuspendThread(thread) == static_cast<DWORD>(-1))
+                    {
+                        CloseHandle(thread);
+                        continue;
+                    }
+                    m_threads.push_back(thread);
+                }
+                m_suspended = true;
+                return true;
+#else
+                m_lock = std::unique_lock<std::mutex>(Gate());
+                SuspendState& state = GetSuspendState();
+                state.generation = state.generation == UINT32_MAX ? 1 : state.generation + 1;
+                state.departed.store(0);
+                state.released.store(0);
+                state.moves = nullptr;
+                state.moveCount = 0;
+                state.arrived.store(static_cast<uint64_t>(state.generation) << 32, std::memory_order_release);
+
+                struct sigaction action = {};
+                action.sa_sigaction = SuspendHandler;
+                action.sa_flags = SA_SIGINFO | SA_RESTART;
+                sigemptyset(&action.sa_mask);
+                if (!state.stranded && sigaction(SuspendSignal(), &action, &m_previous) != 0)
+                {
+                    state.arrived.store(0);
+                    m_lock.unlock();
+                    return false;
+                }
+                m_suspended = true;
+
+                // The list cannot grow once threads are parked (one may hold the heap lock), so it
+                // is sized from a count taken first; running out of room fails the suspension.
+                const long self = syscall(SYS_gettid);
+                const long running = ListThreads(self, nullptr);
+                m_signaled.clear();
+                m_signaled.reserve(running < 0 ? 1024 : 2 * static_cast<size_t>(running) + 64);
+
+                // A parked thread cannot start another, so once a listing taken after every signaled
+                // thread arrived finds no new one, all threads are stopped. A thread that blocks the
+                // signal never arrives; give up rather than patch under it.
+                const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                for (;;)
+                {
+                    const long found = ListThreads(self, &m_signaled);
+                    if (found < 0)
+                    {
+                        Resume(nullptr, 0);
+                        return false;
+                    }
+                    while (static_cast<uint32_t>(state.arrived.load(std::memory_order_acquire)) < m_signaled.size())
+                    {
+                        if (std::chrono::steady_clock::now() > deadline)
+                        {
+                            Resume(nullptr, 0);
+                            return false;
+                        }
+                        sched_yield();
+                    }
+                    if (!found)
+                    {
+                        break;
+                    }
+                }
+                return true;
+#endif
+            }
+
+            /**
+             * Resumes the threads. A thread whose instruction pointer equals the first address of
+             * a move continues at the second.
+             */
+            void Resume(const std::pair<uintptr_t, uintptr_t>* moves, size_t count)
+            {
+                if (!m_suspended)
+                {
+                    return;
+                }
+                m_suspended = false;
+#ifdef _WIN32
+                for (HANDLE thread : m_threads)
+                {
+                    CONTEXT context;
+                    context.ContextFlags = CONTEXT_CONTROL;
+                    if (count && GetThreadContext(thread, &context))
+                    {
+#ifdef _WIN64
+                        DWORD64& ip = context.Rip;
+#else
+                        DWORD& ip = context.Eip;
+#endif
+                        for (size_t i = 0; i < count; i++)
+                        {
+                            if (ip == moves[i].first)
+                            {
+                                ip = moves[i].second;
+                                SetThreadContext(thread, &context);
+                                break;
+                            }
+                        }
+                    }
+                    ResumeThread(thread);
+                    CloseHandle(thread);
+                }
+                m_threads.clear();
+#else
+                SuspendState& state = GetSuspendState();
+                state.moves = moves;
+                state.moveCount = count;
+                state.released.store(1, std::memory_order_release);
+                syscall(SYS_futex, reinterpret_cast<int*>(&state.released), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+                // Close the generation: threads parked in it leave now, signals still pending (after
+                // a timeout) are ignored when they arrive.
+                const uint32_t parked = static_cast<uint32_t>(state.arrived.exchange(0, std::memory_order_acq_rel));
+                while (state.departed.load(std::memory_order_acquire) < static_cast<int>(parked))
+                {
+                    sched_yield();
+                }
+                // The previous handler, usually SIG_DFL, would terminate the process on a late signal.
+                if (parked < m_signaled.size())
+                {
+                    state.stranded = true;
+                }
+                if (!state.stranded)
+                {
+                    sigaction(SuspendSignal(), &m_previous, nullptr);
+                }
+                m_lock.unlock();
+#endif
+            }
+
+        private:
+#ifdef _WIN32
+            std::vector<HANDLE> m_threads;
+#else
+            static std::mutex& Gate()
+            {
+                static std::mutex gate;
+                return gate;
+            }
+
+            /**
+             * Lists the threads in /proc/self/task without allocating. With a list, every thread
+             * not in it yet is signaled and appended.
+             *
+             * @return Threads found (without a list) or newly signaled, -1 if the directory cannot
+             *         be read, the list is full or a thread cannot be signaled.
+             */
+            static long ListThreads(long self, std::vector<long>* signaled)
+            {
+                const int dir = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (dir < 0)
+                {
+                    return -1;
+                }
+                long found = 0;
+                alignas(8) char buffer[4096];
+                for (long read; (read = syscall(SYS_getdents64, dir, buffer, sizeof(buffer))) > 0;)
+                {
+                    for (long at = 0; at < read;)
+                    {
+                        // struct linux_dirent64: ino (8), off (8), reclen (2), type (1), name.
+                        unsigned short reclen;
+                        memcpy(&reclen, buffer + at + 16, sizeof(reclen));
+                        const char* name = buffer + at + 19;
+                        at += reclen;
+                        if (name[0] < '0' || name[0] > '9')
+                        {
+                            continue;
+                        }
+                        const long tid = strtol(name, nullptr, 10);
+                        if (tid == self)
+                        {
+                            continue;
+                        }
+                        if (!signaled)
+                        {
+                            found++;
+                            continue;
+                        }
+                        if (std::find(signaled->begin(), signaled->end(), tid) != signaled->end())
+                        {
+                            continue;
+                        }
+                        if (signaled->size() == signaled->capacity())
+                        {
+                            close(dir);
+                            return -1;
+                        }
+                        // The generation rides along so the handler can tell a stale signal apart.
+                        siginfo_t info = {};
+                        info.si_signo = SuspendSignal();
+                        info.si_code = SI_QUEUE;
+                        info.si_pid = getpid();
+                        info.si_uid = getuid();
+                        info.si_value.sival_int = static_cast<int>(GetSuspendState().generation);
+                        if (syscall(SYS_rt_tgsigqueueinfo, getpid(), tid, SuspendSignal(), &info) == 0)
+                        {
+                            signaled->push_back(tid);
+                            found++;
+                        }
+                        else if (errno != ESRCH)
+                        {
+                            // Not an exited thread: the signal queue is full, so it would keep running.
+                            close(dir);
+                            return -1;
+                        }
+                    }
+                }
+                close(dir);
+                return found;
+            }
+
+            std::unique_lock<std::mutex> m_lock;
+            std::vector<long> m_signaled;
+            struct sigaction m_previous = {};
+#endif
+            bool m_suspended = false;
+        };
+    }
+
+    /**
+     * Executable memory for trampolines, handed out in 64-byte slots from 64 KB pages.
+     *
+     * Every allocation names the code it has to reach with rel32 branches. A page within
+     * +-2 GB of that address is reused while it has room; only when none has, a new page is
+     * placed in the free range nearest to the address. Not thread-safe; HookManager serializes
+     * its calls.
+     */
+    class TrampolineArena
+    {
+    public:
+        static constexpr size_t SLOT_BYTES = 64;
+        /** The Windows allocation granularity; every page is one VirtualAlloc. */
+        static constexpr size_t PAGE_BYTES = 64 * 1024;
+
+        TrampolineArena() = default;
+        TrampolineArena(const TrampolineArena&) = delete;
+        TrampolineArena& operator=(const TrampolineArena&) = delete;
+
+        ~TrampolineArena()
+        {
+            for (Page& page : m_pages)
+            {
+                Detail::FreeCode(page.memory, PAGE_BYTES);
+            }
+        }
+
+        /**
+         * Allocates consecutive slots within rel32 reach of an address.
+         *
+         * @param near The address the memory must reach and be reachable from.
+         * @param size Bytes needed, rounded up to whole slots.
+         * @return The memory, or nullptr if no page can be placed within reach.
+         */
+        uint8_t* Allocate(uintptr_t near, size_t size)
+        {
+            const size_t slots = (size + SLOT_BYTES - 1) / SLOT_BYTES;
+            if (slots == 0 || slots > SLOTS_PER_PAGE)
+            {
+                return nullptr;
+            }
+            for (Page& page : m_pages)
+            {
+                if (page.freeSlots >= slots && InReach(page, near))
+                {
+                    if (uint8_t* memory = Take(page, slots))
+                    {
+                        return memory;
+                    }
+                }
+            }
+            if (Page* page = AddPage(near))
+            {
+                return Take(*page, slots);
+            }
+            return nullptr;
+        }
+
+        /**
+         * Returns slots to their page. Pages are kept for later hooks.
+         */
+        void Free(uint8_t* memory, size_t size)
+        {
+            const size_t slots = (size + SLOT_BYTES - 1) / SLOT_BYTES;
+            for (Page& page : m_pages)
+            {
+                if (memory >= page.memory && memory < page.memory + PAGE_BYTES)
+                {
+                    const size_t first = static_cast<size_t>(memory - page.memory) / SLOT_BYTES;
+                    for (size_t slot = first; slot < first + slots; slot++)
+                    {
+                        page.used[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+                    }
+                    page.freeSlots += slots;
+                    memset(memory, 0xCC, slots * SLOT_BYTES);
+                    return;
+                }
+            }
+        }
+
+        /**
+         * @return Number of pages allocated so far.
+         */
+        size_t PageCount() const
+        {
+            return m_pages.size();
+        }
+
+    private:
+        static constexpr size_t SLOTS_PER_PAGE = PAGE_BYTES / SLOT_BYTES;
+
+        struct Page
+        {
+            uint8_t* memory;
+            uint64_t used[SLOTS_PER_PAGE / 64];
+            size_t freeSlots;
+        };
+
+        static bool InReach(const Page& page, uintptr_t near)
+        {
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(page.memory);
+            const uintptr_t end = begin + PAGE_BYTES;
+            return (begin >= near ? end - near : near - begin) <= Detail::NEAR_REACH;
+        }
+
+        static uint8_t* Take(Page& page, size_t slots)
+        {
+            size_t run = 0;
+            for (size_t slot = 0; slot < SLOTS_PER_PAGE; slot++)
+            {
+                if (page.used[slot / 64] & (uint64_t(1) << (slot % 64)))
+                {
+                    run = 0;
+                    continue;
+                }
+                if (++run == slots)
+                {
+                    const size_t first = slot + 1 - slots;
+                    for (size_t s = first; s <= slot; s++)
+                    {
+                        page.used[s / 64] |= uint64_t(1) << (s % 64);
+                    }
+                    page.freeSlots -= slots;
+                    return page.memory + first * SLOT_BYTES;
+                }
+            }
+            return nullptr;
+        }
+
+        Page* AddPage(uintptr_t near)
+        {
+            // In 32-bit processes every address is within rel32 reach.
+            const uintptr_t reach = sizeof(void*) == 8 ? Detail::NEAR_REACH - PAGE_BYTES : UINTPTR_MAX;
+            const uintptr_t floor = PAGE_BYTES;
+            const uintptr_t lo = near > floor + reach ? near - reach : floor;
+            const uintptr_t hi = UINTPTR_MAX - near > reach ? near + reach : UINTPTR_MAX - PAGE_BYTES;
+
+            // The best spot in each free range is the page closest to the target.
+            std::vector<uintptr_t> candidates;
+            for (const auto& range : Detail::FreeRanges(lo, hi))
+            {
+                const uintptr_t first = (range.first + PAGE_BYTES - 1) & ~static_cast<uintptr_t>(PAGE_BYTES - 1);
+                if (range.second < PAGE_BYTES || first > range.second - PAGE_BYTES)
+                {
+                    continue;
+                }
+                const uintptr_t last = (range.second - PAGE_BYTES) & ~static_cast<uintptr_t>(PAGE_BYTES - 1);
+                const uintptr_t aligned = near & ~static_cast<uintptr_t>(PAGE_BYTES - 1);
+                candidates.push_back((std::min)((std::max)(aligned, first), last));
+            }
+            std::sort(candidates.begin(), candidates.end(), [near](uintptr_t a, uintptr_t b)
+            {
+                return (a > near ? a - near : near - a) < (b > near ? b - near : near - b);
+            });
+
+            for (uintptr_t candidate : candidates)
+            {
+                if (uint8_t* memory = Detail::AllocateCodeAt(candidate, PAGE_BYTES))
+                {
+                    Page page = { memory, {}, SLOTS_PER_PAGE };
+                    memset(memory, 0xCC, PAGE_BYTES);
+                    m_pages.push_back(page);
+                    return &m_pages.back();
+                }
+            }
+            return nullptr;
+        }
+
+        std::vector<Page> m_pages;
+    };
+
+    /**
+     * Registry of inline hooks sharing a TrampolineArena.
+     *
+     * Creating a hook prepares everything without touching the target: the prologue is measured
+     * with FindPatchLength, relocated into a trampoline slot next to the target, and followed by a
+     * jump back. The target is then patched with a 5-byte jmp rel32; in 64-bit processes it lands
+     * on an absolute jump to the detour stored in the same slot. Enable and Disable only swap those
+     * bytes, so hooks can be toggled cheaply and while the process runs (see PatchMode).
+     * Enabling or disabling a batch changes the protection of each affected code page once.
+     *
+     * Removing a hook retires its trampoline instead of freeing it: a thread still inside the
+     * detour may call the original function afterwards. Reclaim returns retired slots to the arena
+     * once that can no longer happen.
+     *
+     * @example
+     * SyxLib::HookManager& hooks = SyxLib::HookManager::Instance();
+     * hooks.Create(target, &MyDetour, reinterpret_cast<const void**>(&original));
+     * hooks.EnableAll();
+     */
+    class HookManager
+    {
+    public:
+        /** Bytes written over the target: jmp rel32. */
+        static constexpr size_t PATCH_BYTES = 5;
+
+        /** x64 relay at the start of each slot: jmp [rip + 2], two int3 and the aligned detour address. */
+        static constexpr size_t RELAY_BYTES = 16;
+
+        HookManager() = default;
+        HookManager(const HookManager&) = delete;
+        HookManager& operator=(const HookManager&) = delete;
+
+        ~HookManager()
+        {
+            DisableAll();
+        }
+
+        /**
+         * Selects how patches are written, PatchMode::Atomic by default.
+         */
+        void SetPatchMode(PatchMode mode)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_mode = mode;
+        }
+
+        /**
+         * Prepares a hook. The target is not modified until Enable.
+         *
+         * @param target The function to hook.
+         * @param detour The function to run instead.
+         * @param original Optional, receives the trampoline that runs the original function.
+         * @param minLength Minimum number of bytes to move, rounded up to whole instructions.
+         */
+        HookStatus Create(void* target, const void* detour, const void** original = nullptr, size_t minLength = 0)
+        {
+            if (!target || !detour)
+            {
+                return HookStatus::InvalidArgument;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const uintptr_t address = reinterpret_cast<uintptr_t>(target);
+            if (m_hooks.count(address))
+            {
+                return HookStatus::AlreadyHooked;
+            }
+
+            const bool x64 = sizeof(void*) == 8;
+            const uint8_t* code = static_cast<const uint8_t*>(target);
+            const size_t readable = ReadableCode(address, 64);
+            const size_t first = FindPatchLength(code, readable, 1, x64);
+            if (!first)
+            {
+                return HookStatus::NotRelocatable;
+            }
+
+            // Hot-patch through the padding when the jump would otherwise cover several instructions.
+            Hook hook = {};
+            hook.patchSize = PATCH_BYTES;
+            if (first >= 2 && first < PATCH_BYTES && minLength <= first && HasPadding(address))
+            {
+                hook.padding = address - PATCH_BYTES;
+                hook.patchSize = 2;
+            }
+            const size_t length = hook.padding ? first : FindPatchLength(code, readable, (std::max)(minLength, PATCH_BYTES), x64);
+            if (!length)
+            {
+                return HookStatus::NotRelocatable;
+            }
+            hook.atomic = (address & 7) != 7 && (hook.padding || first >= PATCH_BYTES);
+
+            // Slot layout: [x64 relay: jmp [rip + 2]; int3 int3; dq detour] [relocated prologue] [jmp rel32 back].
+            const size_t relay = x64 ? RELAY_BYTES : 0;
+            std::vector<uint8_t> moved;
+            uint8_t* slot = nullptr;
+            size_t slotBytes = 0;
+            for (size_t attempt = 0; attempt < 2; attempt++)
+            {
+                // The relocated size depends on where the code goes; a first guess is refined once.
+                const size_t guess = attempt == 0 ? relay + length * 4 + PATCH_BYTES : relay + moved.size() + PATCH_BYTES;
+                if (slot)
+                {
+                    m_arena.Free(slot, slotBytes);
+                }
+                slotBytes = guess;
+                slot = m_arena.Allocate(address, slotBytes);
+                if (!slot)
+                {
+                    return HookStatus::NoNearMemory;
+                }
+                if (!RelocateInstructions(code, length, address, reinterpret_cast<uintptr_t>(slot + relay), x64, moved, &hook.boundaries))
+                {
+                    m_arena.Free(slot, slotBytes);
+                    return HookStatus::NotRelocatable;
+                }
+                if (relay + moved.size() + PATCH_BYTES <= slotBytes)
+                {
+                    break;
+                }
+            }
+            if (relay + moved.size() + PATCH_BYTES > slotBytes)
+            {
+                m_arena.Free(slot, slotBytes);
+                return HookStatus::NotRelocatable;
+            }
+
+            hook.target = address;
+            hook.detour = detour;
+            hook.slot = slot;
+            hook.slotBytes = slotBytes;
+            hook.trampoline = slot + relay;
+            memcpy(hook.original, code, PATCH_BYTES);
+
+            uintptr_t jumpTarget = reinterpret_cast<uintptr_t>(detour);
+            if (x64)
+            {
+                // The pointer is 8-byte aligned so Instrument can swap it with one atomic store.
+                static const uint8_t jump[] = { 0xFF, 0x25, 0x02, 0x00, 0x00, 0x00, 0xCC, 0xCC };
+                const uint64_t absolute = reinterpret_cast<uintptr_t>(detour);
+                memcpy(slot, jump, sizeof(jump));
+                memcpy(slot + sizeof(jump), &absolute, sizeof(absolute));
+                jumpTarget = reinterpret_cast<uintptr_t>(slot);
+            }
+            memcpy(hook.trampoline, moved.data(), moved.size());
+            WriteJump(hook.trampoline + moved.size(), reinterpret_cast<uintptr_t>(hook.trampoline + moved.size()), address + length);
+            if (hook.padding)
+            {
+                // jmp short -7 lands on the jmp rel32 in the padding.
+                WriteJump(hook.paddingJump, hook.padding, jumpTarget);
+                hook.patch[0] = 0xEB;
+                hook.patch[1] = static_cast<uint8_t>(-static_cast<int>(PATCH_BYTES + 2));
+            }
+            else
+            {
+                WriteJump(hook.patch, address, jumpTarget);
+            }
+
+            if (original)
+            {
+                *original = hook.trampoline;
+            }
+            m_hooks.emplace(address, static_cast<Hook&&>(hook));
+            return HookStatus::Ok;
+        }
+
+        /** Patches the target of a hook. */
+        HookStatus Enable(void* target)
+        {
+            return Enable(std::vector<void*>{ target });
+        }
+
+        /** Restores the original code of a hook's target. The hook can be enabled again. */
+        HookStatus Disable(void* target)
+        {
+            return Disable(std::vector<void*>{ target });
+        }
+
+        /**
+         * Patches several targets, changing the protection of each affected page once.
+         *
+         * @return UnknownHook if a target has no hook (the others are still enabled), or the first failure.
+         */
+        HookStatus Enable(const std::vector<void*>& targets)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            std::vector<Hook*> hooks = Select(targets, unknown);
+            return Apply(hooks, true, unknown);
+        }
+
+        /**
+         * Restores several targets, changing the protection of each affected page once.
+         */
+        HookStatus Disable(const std::vector<void*>& targets)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            std::vector<Hook*> hooks = Select(targets, unknown);
+            return Apply(hooks, false, unknown);
+        }
+
+        HookStatus EnableAll()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            return Apply(Select({}, unknown), true);
+        }
+
+        HookStatus DisableAll()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            return Apply(Select({}, unknown), false);
+        }
+
+        /**
+         * Disables a hook and forgets it. Its trampoline stays valid until Reclaim; a jump placed
+         * in the padding before the target is left in place.
+         */
+        HookStatus Remove(void* target)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(target));
+            if (it == m_hooks.end())
+            {
+                return HookStatus::UnknownHook;
+            }
+            const HookStatus status = Apply({ &it->second }, false);
+            if (status != HookStatus::Ok)
+            {
+                return status;
+            }
+            m_retired.push_back({ it->second.slot, it->second.slotBytes });
+            if (it->second.counters)
+            {
+                m_retired.push_back({ it->second.stub, Detail::INSTRUMENT_STUB_BYTES });
+                m_retiredCounters.push_back(static_cast<std::unique_ptr<Detail::HookCounters>&&>(it->second.counters));
+            }
+            m_hooks.erase(it);
+            return HookStatus::Ok;
+        }
+
+        /**
+         * Returns the trampolines of removed hooks to the arena. Call it only when no thread can
+         * still be running a removed detour or trampoline.
+         *
+         * @return Number of trampolines released.
+         */
+        size_t Reclaim()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& retired : m_retired)
+            {
+                m_arena.Free(retired.first, retired.second);
+            }
+            const size_t count = m_retired.size();
+            m_retired.clear();
+            m_retiredCounters.clear();
+            return count;
+        }
+
+        /**
+         * Routes a hook's calls through counters and a latency timer, or straight to the detour
+         * again. Instrumented calls run a stub and two shared thunks that count each call in a
+         * per-thread shard and time it with RDTSC, by returning from the detour through an exit
+         * thunk. Hooks that are not instrumented run exactly as before. Switching is one atomic
+         * store, safe while the hook runs; the counters are kept when instrumentation is turned off.
+         *
+         * A C++ exception or longjmp must not leave an instrumented detour: the stack then holds a
+         * return address into the exit thunk, which has no unwind information.
+         *
+         * @return NotSupported outside x86-64, NoNearMemory if the stub cannot be allocated.
+         */
+        HookStatus Instrument(void* target, bool instrument = true)
+        {
+#ifdef SYX_HOOK_STATS
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(target));
+            if (it == m_hooks.end())
+            {
+                return HookStatus::UnknownHook;
+            }
+            Hook& hook = it->second;
+            if (instrument && !hook.counters)
+            {
+                if (!m_thunks)
+                {
+                    m_thunks = m_arena.Allocate(hook.target, sizeof(Detail::INSTRUMENT_THUNKS));
+                    if (!m_thunks)
+                    {
+                        return HookStatus::NoNearMemory;
+                    }
+                    Detail::WriteInstrumentThunks(m_thunks);
+                }
+                hook.stub = m_arena.Allocate(hook.target, Detail::INSTRUMENT_STUB_BYTES);
+                if (!hook.stub)
+                {
+                    return HookStatus::NoNearMemory;
+                }
+                hook.counters.reset(new Detail::HookCounters());
+                hook.counters->detour = hook.detour;
+                hook.counters->exitThunk = reinterpret_cast<uintptr_t>(m_thunks + Detail::INSTRUMENT_EXIT_OFFSET);
+                Detail::WriteInstrumentStub(hook.stub, hook.counters.get(), m_thunks);
+            }
+            if (hook.counters)
+            {
+                const uint64_t relayTarget = reinterpret_cast<uintptr_t>(instrument ? hook.stub : hook.detour);
+                Detail::StoreCodeWord(hook.slot + RELAY_BYTES - 8, reinterpret_cast<const uint8_t*>(&relayTarget), 8);
+            }
+            return HookStatus::Ok;
+#else
+            (void)target;
+            (void)instrument;
+            return HookStatus::NotSupported;
+#endif
+        }
+
+        /**
+         * Merges the counters of an instrumented hook. Callers are not stopped, so counts of calls
+         * in flight may be off by those calls.
+         *
+         * @return False if the target has no hook or was never instrumented.
+         */
+        bool Stats(void* target, HookStats& stats) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(target));
+            if (it == m_hooks.end() || !it->second.counters)
+            {
+                return false;
+            }
+            Detail::MergeCounters(*it->second.counters, stats);
+            return true;
+        }
+
+        /**
+         * @return The trampoline that runs the original function, nullptr if the target has no hook.
+         */
+        const void* Original(void* target) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(target));
+            return it == m_hooks.end() ? nullptr : it->second.trampoline;
+        }
+
+        bool IsEnabled(void* target) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(target));
+            return it != m_hooks.end() && it->second.enabled;
+        }
+
+        /**
+         * @return Number of hooks, enabled or not.
+         */
+        size_t Count() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_hooks.size();
+        }
+
+        /**
+         * @return The trampoline memory shared by the hooks.
+         */
+        const TrampolineArena& Arena() const
+        {
+            return m_arena;
+        }
+
+        /**
+         * @return The process-wide manager used by Syx::DetourFunc64 and Syx::DetourFunc32.
+         */
+        static HookManager& Instance()
+        {
+            static HookManager manager;
+            return manager;
+        }
+
+    private:
+        struct Hook
+        {
+            uintptr_t target;
+            const void* detour;
+            uint8_t* slot;
+            size_t slotBytes;
+            uint8_t* trampoline;
+            /** Offsets of the moved instructions in the target and in the trampoline. */
+            std::vector<std::pair<size_t, size_t>> boundaries;
+            /** Hot-patch: address of the jmp rel32 written into the padding, 0 if none. */
+            uintptr_t padding;
+            uint8_t paddingJump[PATCH_BYTES];
+            /** Bytes written at the target: 5, or 2 when hot-patching. */
+            size_t patchSize;
+            /** The bytes the patch replaces. */
+            uint8_t original[PATCH_BYTES];
+            /** jmp rel32 to the relay or the detour, or jmp rel8 to the padding. */
+            uint8_t patch[PATCH_BYTES];
+            /** The patch only replaces the first instruction and can be stored atomically. */
+            bool atomic;
+            bool enabled;
+            /** Instrumentation, created by the first Instrument call. */
+            std::unique_ptr<Detail::HookCounters> counters;
+            uint8_t* stub;
+        };
+
+        /**
+         * @return How many of the size bytes at address are readable without a gap, so a short
+         *         function at the end of a mapping is not decoded into the unmapped page after it.
+         */
+        static size_t ReadableCode(uintptr_t address, size_t size)
+        {
+            size_t readable = 0;
+            for (const MemoryRegion& region : QueryRegions(address, address + size))
+            {
+                if (region.base != address + readable || !(region.protection & PROTECT_READ))
+                {
+                    break;
+                }
+                readable += region.size;
+            }
+            return readable;
+        }
+
+        /**
+         * @return True if the PATCH_BYTES before an address are int3 or nop padding on the same page.
+         */
+        static bool HasPadding(uintptr_t address)
+        {
+            if ((address & (Detail::SystemPageSize() - 1)) < PATCH_BYTES)
+            {
+                return false;
+            }
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(address - PATCH_BYTES);
+            return std::all_of(bytes, bytes + PATCH_BYTES, [](uint8_t b) { return b == 0xCC || b == 0x90; });
+        }
+
+        static void WriteJump(uint8_t* at, uintptr_t from, uintptr_t to)
+        {
+            const int32_t rel = static_cast<int32_t>(to - (from + PATCH_BYTES));
+            at[0] = 0xE9;
+            memcpy(at + 1, &rel, sizeof(rel));
+        }
+
+        /** The hooks of a list of targets, every hook for an empty list. */
+        std::vector<Hook*> Select(const std::vector<void*>& targets, bool& unknown)
+        {
+            std::vector<Hook*> hooks;
+            unknown = false;
+            if (targets.empty())
+            {
+                for (auto& entry : m_hooks)
+                {
+                    hooks.push_back(&entry.second);
+                }
+                return hooks;
+            }
+            for (void* target : targets)
+            {
+                auto it = m_hooks.find(reinterpret_cast<uintptr_t>(target));
+                if (it == m_hooks.end())
+                {
+                    unknown = true;
+                    continue;
+                }
+                hooks.push_back(&it->second);
+            }
+            return hooks;
+        }
+
+        /**
+         * Writes the patch or the original bytes of every hook whose state changes. The pages
+         * touched are grouped so that each one is unprotected and restored exactly once. When
+         * threads are suspended, everything the writes need is allocated beforehand.
+         */
+        HookStatus Apply(std::vector<Hook*> hooks, bool enable, bool unknown = false)
+        {
+            hooks.erase(std::remove_if(hooks.begin(), hooks.end(), [enable](const Hook* hook) { return hook->enabled == enable; }), hooks.end());
+            std::sort(hooks.begin(), hooks.end(), [](const Hook* a, const Hook* b) { return a->target < b->target; });
+
+            struct Page
+            {
+                uintptr_t base;
+                uint32_t saved;
+            };
+            const uintptr_t pageSize = Detail::SystemPageSize();
+            HookStatus status = unknown ? HookStatus::UnknownHook : HookStatus::Ok;
+
+            // Unprotect every page once; a group is a run of hooks whose pages touch or overlap,
+            // since a patch may straddle two pages. Hooks of a group that failed are dropped.
+            std::vector<Page> pages;
+            std::vector<Hook*> writable;
+            auto patchBegin = [](const Hook* hook) { return hook->padding ? hook->padding : hook->target; };
+            auto patchEnd = [](const Hook* hook) { return hook->target + hook->patchSize; };
+            for (size_t first = 0; first < hooks.size();)
+            {
+                const uintptr_t begin = patchBegin(hooks[first]) & ~(pageSize - 1);
+                uintptr_t end = (patchEnd(hooks[first]) + pageSize - 1) & ~(pageSize - 1);
+                size_t last = first + 1;
+                while (last < hooks.size() && (patchBegin(hooks[last]) & ~(pageSize - 1)) < end)
+                {
+                    end = (std::max)(end, (patchEnd(hooks[last]) + pageSize - 1) & ~(pageSize - 1));
+                    last++;
+                }
+                const size_t groupStart = pages.size();
+                bool unprotected = true;
+                for (uintptr_t page = begin; page < end; page += pageSize)
+                {
+                    Page entry = { page, 0 };
+                    if (!Detail::UnprotectCode(page, pageSize, entry.saved))
+                    {
+                        unprotected = false;
+                        break;
+                    }
+                    pages.push_back(entry);
+                }
+                if (unprotected)
+                {
+                    writable.insert(writable.end(), hooks.begin() + first, hooks.begin() + last);
+                }
+                else
+                {
+                    for (size_t page = groupStart; page < pages.size(); page++)
+                    {
+                        Detail::RestoreProtection(pages[page].base, pageSize, pages[page].saved);
+                    }
+                    pages.resize(groupStart);
+                    if (status == HookStatus::Ok)
+                    {
+                        status = HookStatus::ProtectFailed;
+                    }
+                }
+                first = last;
+            }
+
+            // A thread stopped inside the bytes being replaced by a jump continues in the trampoline.
+            bool suspend = m_mode == PatchMode::SuspendThreads;
+            std::vector<std::pair<uintptr_t, uintptr_t>> moves;
+            for (const Hook* hook : writable)
+            {
+                suspend = suspend || !hook->atomic;
+                for (const auto& boundary : hook->boundaries)
+                {
+                    if (enable && boundary.first > 0 && boundary.first < hook->patchSize)
+                    {
+                        moves.push_back({ hook->target + boundary.first, reinterpret_cast<uintptr_t>(hook->trampoline) + boundary.second });
+                    }
+                }
+            }
+
+            Detail::ThreadSuspender suspender;
+            if (!writable.empty() && suspend && !suspender.Suspend())
+            {
+                writable.clear();
+                status = HookStatus::SuspendFailed;
+            }
+            for (Hook* hook : writable)
+            {
+                uint8_t* at = reinterpret_cast<uint8_t*>(hook->target);
+                const uint8_t* bytes = enable ? hook->patch : hook->original;
+                if (enable && hook->padding)
+                {
+                    // Nothing runs the padding, so the long jump needs no care.
+                    memcpy(reinterpret_cast<void*>(hook->padding), hook->paddingJump, PATCH_BYTES);
+                }
+                if (suspend)
+                {
+                    memcpy(at, bytes, hook->patchSize);
+                }
+                else
+                {
+                    Detail::WriteCodeAtomic(at, bytes, hook->patchSize);
+                }
+                hook->enabled = enable;
+            }
+            suspender.Resume(moves.data(), moves.size());
+
+            for (const Page& page : pages)
+            {
+                Detail::RestoreProtection(page.base, pageSize, page.saved);
+            }
+            return status;
+        }
+
+        mutable std::mutex m_mutex;
+        std::map<uintptr_t, Hook> m_hooks;
+        std::vector<std::pair<uint8_t*, size_t>> m_retired;
+        std::vector<std::unique_ptr<Detail::HookCounters>> m_retiredCounters;
+        TrampolineArena m_arena;
+        /** Enter and exit thunks shared by instrumented hooks. */
+        uint8_t* m_thunks = nullptr;
+        PatchMode m_mode = PatchMode::Atomic;
+    };
+}
@@ -0,0 +1,689 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Hash.h"
+
+/**
+ * Platform-neutral PE and ELF header parsing. The parsers only read the bytes they are given and
+ * bounds-check every access, so they work the same on a module loaded in memory and on a file image.
+ */
+
+namespace SyxLib
+{
+    /** Protection flags shared by image sections and memory regions. */
+    enum MemoryProtection : uint32_t
+    {
+        PROTECT_NONE = 0,
+        PROTECT_READ = 1,
+        PROTECT_WRITE = 2,
+        PROTECT_EXECUTE = 4
+    };
+
+    /**
+     * A section (PE) or loadable segment (ELF) of an executable image.
+     */
+    struct ImageSection
+    {
+        /** Section name (".text", ".rdata", ...). ELF segments are named "LOAD0", "LOAD1", ... */
+        std::string name;
+        /** Offset of the section from the image base once loaded (RVA). */
+        uint64_t virtualAddress;
+        /** Size of the section once loaded. */
+        uint64_t virtualSize;
+        /** Offset of the section data in the file. */
+        uint64_t fileOffset;
+        /** Size of the section data in the file. */
+        uint64_t fileSize;
+        /** Combination of MemoryProtection flags. */
+        uint32_t protection;
+    };
+
+    /**
+     * A pointer the loader fills with the address of an imported function: an entry of a PE import
+     * address table or of an ELF global offset table.
+     */
+    struct ImportSlot
+    {
+        /** Offset of the slot from the module base (RVA). */
+        uint64_t slot;
+        /** Imported function, "#n" for a PE import by ordinal n. */
+        std::string function;
+        /** DLL a PE import comes from. Empty for ELF, whose symbols are not bound to a library. */
+        std::string library;
+    };
+
+    namespace Detail
+    {
+        template <typename T>
+        inline bool LoadAt(const uint8_t* data, size_t size, uint64_t offset, T& value)
+        {
+            if (offset > size || size - offset < sizeof(T))
+            {
+                return false;
+            }
+            memcpy(&value, data + offset, sizeof(T));
+            return true;
+        }
+
+        /** Reads a NUL-terminated string that ends inside the buffer. */
+        inline bool LoadString(const uint8_t* data, size_t size, uint64_t offset, std::string& value)
+        {
+            if (offset >= size)
+            {
+                return false;
+            }
+            const void* end = memchr(data + offset, 0, static_cast<size_t>(size - offset));
+            if (!end)
+            {
+                return false;
+            }
+            value.assign(reinterpret_cast<const char*>(data + offset), static_cast<const uint8_t*>(end) - (data + offset));
+            return true;
+        }
+
+        /** Reads a 4-byte or 8-byte little-endian word. */
+        inline bool LoadWord(const uint8_t* data, size_t size, uint64_t offset, bool is64, uint64_t& value)
+        {
+            if (is64)
+            {
+                return LoadAt(data, size, offset, value);
+            }
+            uint32_t value32;
+            if (!LoadAt(data, size, offset, value32))
+            {
+                return false;
+            }
+            value = value32;
+            return true;
+        }
+
+        static constexpr uint16_t PE_DOS_MAGIC = 0x5A4D;
+        static constexpr uint32_t PE_NT_SIGNATURE = 0x00004550;
+        static constexpr uint16_t PE_OPTIONAL_MAGIC32 = 0x10B;
+        static constexpr uint16_t PE_OPTIONAL_MAGIC64 = 0x20B;
+        static constexpr uint32_t PE_SCN_MEM_EXECUTE = 0x20000000;
+        static constexpr uint32_t PE_SCN_MEM_READ = 0x40000000;
+        static constexpr uint32_t PE_SCN_MEM_WRITE = 0x80000000;
+        static constexpr uint32_t PE_DIRECTORY_IMPORT = 1;
+
+        static constexpr uint32_t ELF_MAGIC = 0x464C457F;
+        static constexpr uint32_t ELF_PT_LOAD = 1;
+        static constexpr uint32_t ELF_PT_DYNAMIC = 2;
+        static constexpr uint32_t ELF_PT_NOTE = 4;
+        static constexpr uint32_t ELF_NT_GNU_BUILD_ID = 3;
+        static constexpr uint32_t ELF_PF_X = 1;
+        static constexpr uint32_t ELF_PF_W = 2;
+        static constexpr uint32_t ELF_PF_R = 4;
+        static constexpr uint64_t ELF_DT_PLTRELSZ = 2;
+        static constexpr uint64_t ELF_DT_STRTAB = 5;
+        static constexpr uint64_t ELF_DT_SYMTAB = 6;
+        static constexpr uint64_t ELF_DT_RELA = 7;
+        static constexpr uint64_t ELF_DT_RELASZ = 8;
+        static constexpr uint64_t ELF_DT_REL = 17;
+        static constexpr uint64_t ELF_DT_RELSZ = 18;
+        static constexpr uint64_t ELF_DT_PLTREL = 20;
+        static constexpr uint64_t ELF_DT_JMPREL = 23;
+
+        struct ElfProgramHeader
+        {
+            uint32_t type;
+            uint32_t flags;
+            uint64_t offset;
+            uint64_t vaddr;
+            uint64_t filesz;
+            uint64_t memsz;
+        };
+
+        /**
+         * Calls visit(const ElfProgramHeader&) for every program header of a 32-bit or 64-bit
+         * little-endian ELF image.
+         *
+         * @return False if the headers are malformed, truncated or not little-endian.
+         */
+        template <typename Visitor>
+        inline bool ForEachElfProgramHeader(const uint8_t* data, size_t size, Visitor&& visit)
+        {
+            uint32_t magic;
+            if (!LoadAt(data, size, 0, magic) || magic != ELF_MAGIC || size < 64 || data[5] != 1)
+            {
+                return false;
+            }
+            const bool is64 = data[4] == 2;
+
+            uint64_t phoff = 0;
+            uint16_t phentsize, phnum;
+            if (is64)
+            {
+                LoadAt(data, size, 32, phoff);
+                LoadAt(data, size, 54, phentsize);
+                LoadAt(data, size, 56, phnum);
+            }
+            else
+            {
+                uint32_t phoff32;
+                LoadAt(data, size, 28, phoff32);
+                LoadAt(data, size, 42, phentsize);
+                LoadAt(data, size, 44, phnum);
+                phoff = phoff32;
+            }
+
+            for (uint16_t i = 0; i < phnum; i++)
+            {
+                const uint64_t entry = phoff + uint64_t(i) * phentsize;
+                ElfProgramHeader header;
+                bool ok;
+                if (is64)
+                {
+                    ok = LoadAt(data, size, entry, header.type) && LoadAt(data, size, entry + 4, header.flags) &&
+                        LoadAt(data, size, entry + 8, header.offset) && LoadAt(data, size, entry + 16, header.vaddr) &&
+                        LoadAt(data, size, entry + 32, header.filesz) && LoadAt(data, size, entry + 40, header.memsz);
+                }
+                else
+                {
+                    uint32_t offset32, vaddr32, filesz32, memsz32;
+                    ok = LoadAt(data, size, entry, header.type) && LoadAt(data, size, entry + 4, offset32) &&
+                        LoadAt(data, size, entry + 8, vaddr32) && LoadAt(data, size, entry + 16, filesz32) &&
+                        LoadAt(data, size, entry + 20, memsz32) && LoadAt(data, size, entry + 24, header.flags);
+                    header.offset = offset32;
+                    header.vaddr = vaddr32;
+                    header.filesz = filesz32;
+                    header.memsz = memsz32;
+                }
+                if (!ok)
+                {
+                    return false;
+                }
+                visit(static_cast<const ElfProgramHeader&>(header));
+            }
+            return true;
+        }
+    }
+
+    /**
+     * @return True if the buffer starts with a PE (MZ) header.
+     */
+    inline bool IsPeImage(const uint8_t* data, size_t size)
+    {
+        uint16_t magic;
+        return Detail::LoadAt(data, size, 0, magic) && magic == Detail::PE_DOS_MAGIC;
+    }
+
+    /**
+     * @return True if the buffer starts with an ELF header.
+     */
+    inline bool IsElfImage(const uint8_t* data, size_t size)
+    {
+        uint32_t magic;
+        return Detail::LoadAt(data, size, 0, magic) && magic == Detail::ELF_MAGIC;
+    }
+
+    /**
+     * Parses the section table of a PE image.
+     *
+     * @param data Start of the image (DOS header).
+     * @param size Number of readable bytes at data.
+     * @param sections Receives the sections in table order.
+     * @param sizeOfImage Optional, receives SizeOfImage from the optional header.
+     * @return False if the headers are malformed or truncated.
+     */
+    inline bool ParsePeSections(const uint8_t* data, size_t size, std::vector<ImageSection>& sections, uint64_t* sizeOfImage = nullptr)
+    {
+        uint16_t dosMagic;
+        uint32_t ntOffset, signature;
+        if (!Detail::LoadAt(data, size, 0, dosMagic) || dosMagic != Detail::PE_DOS_MAGIC ||
+            !Detail::LoadAt(data, size, 0x3C, ntOffset) ||
+            !Detail::LoadAt(data, size, ntOffset, signature) || signature != Detail::PE_NT_SIGNATURE)
+        {
+            return false;
+        }
+
+        uint16_t sectionCount, optionalSize, optionalMagic;
+        uint32_t imageSize;
+        const uint64_t fileHeader = uint64_t(ntOffset) + 4;
+        const uint64_t optionalHeader = fileHeader + 20;
+        if (!Detail::LoadAt(data, size, fileHeader + 2, sectionCount) ||
+            !Detail::LoadAt(data, size, fileHeader + 16, optionalSize) ||
+            !Detail::LoadAt(data, size, optionalHeader, optionalMagic) ||
+            (optionalMagic != Detail::PE_OPTIONAL_MAGIC32 && optionalMagic != Detail::PE_OPTIONAL_MAGIC64) ||
+            !Detail::LoadAt(data, size, optionalHeader + 56, imageSize))
+        {
+            return false;
+        }
+        if (sizeOfImage)
+        {
+            *sizeOfImage = imageSize;
+        }
+
+        sections.clear();
+        const uint64_t table = optionalHeader + optionalSize;
+        for (uint16_t i = 0; i < sectionCount; i++)
+        {
+            const uint64_t entry = table + uint64_t(i) * 40;
+            char name[9] = {};
+            uint32_t virtualSize, virtualAddress, rawSize, rawOffset, characteristics;
+            if (!Detail::LoadAt(data, size, entry + 8, virtualSize) ||
+                !Detail::LoadAt(data, size, entry + 12, virtualAddress) ||
+                !Detail::LoadAt(data, size, entry + 16, rawSize) ||
+                !Detail::LoadAt(data, size, entry + 20, rawOffset) ||
+                !Detail::LoadAt(data, size, entry + 36, characteristics))
+            {
+                return false;
+            }
+            memcpy(name, data + entry, 8);
+
+            ImageSection section;
+            section.name = name;
+            section.virtualAddress = virtualAddress;
+            section.virtualSize = virtualSize ? virtualSize : rawSize;
+            section.fileOffset = rawOffset;
+            section.fileSize = rawSize;
+            section.protection = ((characteristics & Detail::PE_SCN_MEM_READ) ? PROTECT_READ : PROTECT_NONE) |
+                ((characteristics & Detail::PE_SCN_MEM_WRITE) ? PROTECT_WRITE : PROTECT_NONE) |
+                ((characteristics & Detail::PE_SCN_MEM_EXECUTE) ? PROTECT_EXECUTE : PROTECT_NONE);
+            sections.push_back(section);
+        }
+        return true;
+    }
+
+    /**
+     * Parses the PT_LOAD program headers of a 32-bit or 64-bit little-endian ELF image.
+     *
+     * virtualAddress is reported relative to the address the ELF header is loaded at, which makes
+     * it directly comparable to a PE RVA: module base + virtualAddress is the runtime address.
+     *
+     * @param data Start of the image (ELF header).
+     * @param size Number of readable bytes at data.
+     * @param segments Receives the loadable segments in program header order.
+     * @return False if the headers are malformed, truncated or not little-endian.
+     */
+    inline bool ParseElfSegments(const uint8_t* data, size_t size, std::vector<ImageSection>& segments)
+    {
+        segments.clear();
+        uint64_t loadBase = UINT64_MAX;
+        const bool parsed = Detail::ForEachElfProgramHeader(data, size, [&](const Detail::ElfProgramHeader& header)
+        {
+            if (header.type != Detail::ELF_PT_LOAD)
+            {
+                return;
+            }
+
+            // The segment mapping file offset 0 determines where the ELF header lands.
+            if (header.vaddr - header.offset < loadBase)
+            {
+                loadBase = header.vaddr - header.offset;
+            }
+
+            ImageSection segment;
+            segment.name = "LOAD" + std::to_string(segments.size());
+            segment.virtualAddress = header.vaddr;
+            segment.virtualSize = header.memsz;
+            segment.fileOffset = header.offset;
+            segment.fileSize = header.filesz;
+            segment.protection = ((header.flags & Detail::ELF_PF_R) ? PROTECT_READ : PROTECT_NONE) |
+                ((header.flags & Detail::ELF_PF_W) ? PROTECT_WRITE : PROTECT_NONE) |
+                ((header.flags & Detail::ELF_PF_X) ? PROTECT_EXECUTE : PROTECT_NONE);
+            segments.push_back(segment);
+        });
+        if (!parsed)
+        {
+            return false;
+        }
+
+        for (ImageSection& segment : segments)
+        {
+            segment.virtualAddress -= loadBase;
+        }
+        return true;
+    }
+
+    /**
+     * Parses the sections of a PE image or the loadable segments of an ELF image.
+     *
+     * @param data Start of the image.
+     * @param size Number of readable bytes at data.
+     * @param sections Receives the sections.
+     * @return False if the image is neither PE nor ELF or its headers are malformed.
+     */
+    inline bool ParseImageSections(const uint8_t* data, size_t size, std::vector<ImageSection>& sections)
+    {
+        if (IsPeImage(data, size))
+        {
+            return ParsePeSections(data, size, sections);
+        }
+        return ParseElfSegments(data, size, sections);
+    }
+
+    /**
+     * Reads the build stamp of an image: the PE TimeDateStamp, or a hash of the ELF GNU build-id note.
+     * Together with the image size it identifies a build without hashing any code.
+     *
+     * @param data Start of the image.
+     * @param size Number of readable bytes at data.
+     * @param mapped True if the image is laid out as loaded (notes are found by RVA), false for a file image.
+     * @param stamp Receives the stamp.
+     * @return False if the image is malformed or has no stamp (an ELF without a build-id).
+     */
+    inline bool ReadImageStamp(const uint8_t* data, size_t size, bool mapped, uint64_t& stamp)
+    {
+        if (IsPeImage(data, size))
+        {
+            uint32_t ntOffset, signature, timeDateStamp;
+            if (!Detail::LoadAt(data, size, 0x3C, ntOffset) ||
+                !Detail::LoadAt(data, size, ntOffset, signature) || signature != Detail::PE_NT_SIGNATURE ||
+                !Detail::LoadAt(data, size, uint64_t(ntOffset) + 8, timeDateStamp))
+            {
+                return false;
+            }
+            stamp = timeDateStamp;
+            return true;
+        }
+
+        std::vector<Detail::ElfProgramHeader> notes;
+        uint64_t loadBase = UINT64_MAX;
+        const bool parsed = Detail::ForEachElfProgramHeader(data, size, [&](const Detail::ElfProgramHeader& header)
+        {
+            if (header.type == Detail::ELF_PT_LOAD)
+            {
+                loadBase = (std::min)(loadBase, header.vaddr - header.offset);
+            }
+            else if (header.type == Detail::ELF_PT_NOTE)
+            {
+                notes.push_back(header);
+            }
+        });
+        if (!parsed)
+        {
+            return false;
+        }
+
+        for (const Detail::ElfProgramHeader& header : notes)
+        {
+            // Each note is namesz, descsz, type, then name and descriptor padded to 4 bytes.
+            uint64_t note = mapped ? header.vaddr - loadBase : header.offset;
+            const uint64_t end = note + header.filesz;
+            while (note + 12 <= end)
+            {
+                uint32_t nameSize, descSize, type;
+                if (!Detail::LoadAt(data, size, note, nameSize) || !Detail::LoadAt(data, size, note + 4, descSize) ||
+                    !Detail::LoadAt(data, size, note + 8, type))
+                {
+                    break;
+                }
+                const uint64_t name = note + 12;
+                const uint64_t desc = name + ((uint64_t(nameSize) + 3) & ~uint64_t(3));
+                const uint64_t next = desc + ((uint64_t(descSize) + 3) & ~uint64_t(3));
+                if (next > end || desc + descSize > size)
+                {
+                    break;
+                }
+                if (type == Detail::ELF_NT_GNU_BUILD_ID && nameSize == 4 && memcmp(data + name, "GNU", 4) == 0)
+                {
+                    stamp = Hash64(data + desc, descSize);
+                    return true;
+                }
+                note = next;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Lists the import address table entries of a PE image laid out as loaded. Entries of
+     * descriptors without a lookup table have no name once bound and are reported with an empty one.
+     * Delay-load imports are not included.
+     *
+     * @param data Start of the loaded image (module base).
+     * @param size Number of readable bytes at data, usually SizeOfImage.
+     * @param slots Receives the slots in table order.
+     * @return False if the headers or the import directory are malformed or truncated.
+     */
+    inline bool ParsePeImports(const uint8_t* data, size_t size, std::vector<ImportSlot>& slots)
+    {
+        slots.clear();
+        uint32_t ntOffset, signature, directoryCount, importRva;
+        uint16_t optionalMagic;
+        if (!Detail::LoadAt(data, size, 0x3C, ntOffset) ||
+            !Detail::LoadAt(data, size, ntOffset, signature) || signature != Detail::PE_NT_SIGNATURE)
+        {
+            return false;
+        }
+        const uint64_t optionalHeader = uint64_t(ntOffset) + 24;
+        if (!Detail::LoadAt(data, size, optionalHeader, optionalMagic) ||
+            (optionalMagic != Detail::PE_OPTIONAL_MAGIC32 && optionalMagic != Detail::PE_OPTIONAL_MAGIC64))
+        {
+            return false;
+        }
+        const bool is64 = optionalMagic == Detail::PE_OPTIONAL_MAGIC64;
+        const uint64_t directories = optionalHeader + (is64 ? 112 : 96);
+        if (!Detail::LoadAt(data, size, directories - 4, directoryCount))
+        {
+            return false;
+        }
+        if (directoryCount <= Detail::PE_DIRECTORY_IMPORT || !Detail::LoadAt(data, size, directories + 8 * Detail::PE_DIRECTORY_IMPORT, importRva) || !importRva)
+        {
+            return true;
+        }
+
+        // Import descriptors: lookup table, time stamp, forwarder chain, DLL name, address table.
+        const uint64_t thunkSize = is64 ? 8 : 4;
+        const uint64_t ordinalFlag = uint64_t(1) << (is64 ? 63 : 31);
+        for (uint64_t descriptor = importRva;; descriptor += 20)
+        {
+            uint32_t lookup, name, table;
+            if (!Detail::LoadAt(data, size, descriptor, lookup) || !Detail::LoadAt(data, size, descriptor + 12, name) ||
+                !Detail::LoadAt(data, size, descriptor + 16, table))
+            {
+                return false;
+            }
+            if (!name && !table)
+            {
+                return true;
+            }
+            std::string library;
+            if (!Detail::LoadString(data, size, name, library))
+            {
+                return false;
+            }
+            for (uint64_t i = 0;; i++)
+            {
+                uint64_t bound, entry;
+                if (!Detail::LoadWord(data, size, table + i * thunkSize, is64, bound) ||
+                    (lookup && !Detail::LoadWord(data, size, lookup + i * thunkSize, is64, entry)))
+                {
+                    return false;
+                }
+                if (!(lookup ? entry : bound))
+                {
+                    break;
+                }
+                ImportSlot slot;
+                slot.slot = table + i * thunkSize;
+                slot.library = library;
+                if (lookup && (entry & ordinalFlag))
+                {
+                    slot.function = "#" + std::to_string(entry & 0xFFFF);
+                }
+                else if (lookup && !Detail::LoadString(data, size, (entry & 0x7FFFFFFF) + 2, slot.function))
+                {
+                    return false;
+                }
+                slots.push_back(slot);
+            }
+        }
+    }
+
+    /**
+     * Lists the global offset table entries of a loaded ELF module that its jump slot and GLOB_DAT
+     * relocations bind to functions and data of other objects, once per slot. Supports x86, x86-64,
+     * ARM and AArch64.
+     *
+     * The dynamic section may hold addresses the loader already relocated, so data must be where
+     * the module is loaded, not a copy.
+     *
+     * @param data Start of the loaded module (ELF header).
+     * @param size Number of bytes the module spans.
+     * @param slots Receives the slots sorted by RVA.
+     * @return False if the headers are malformed or the machine is not supported. A module without
+     *         a dynamic section has no slots.
+     */
+    inline bool ParseElfImports(const uint8_t* data, size_t size, std::vector<ImportSlot>& slots)
+    {
+        slots.clear();
+        uint64_t loadBase = UINT64_MAX, dynamic = UINT64_MAX, dynamicSize = 0;
+        const bool parsed = Detail::ForEachElfProgramHeader(data, size, [&](const Detail::ElfProgramHeader& header)
+        {
+            if (header.type == Detail::ELF_PT_LOAD)
+            {
+                loadBase = (std::min)(loadBase, header.vaddr - header.offset);
+            }
+            else if (header.type == Detail::ELF_PT_DYNAMIC)
+            {
+                dynamic = header.vaddr;
+                dynamicSize = header.memsz;
+            }
+        });
+        uint16_t machine;
+        if (!parsed || loadBase == UINT64_MAX || !Detail::LoadAt(data, size, 18, machine))
+        {
+            return false;
+        }
+        if (dynamic == UINT64_MAX)
+        {
+            return true;
+        }
+
+        uint32_t jumpSlot, globalData;
+        switch (machine)
+        {
+        case 3:  // x86
+        case 62: // x86-64
+            jumpSlot = 7;
+            globalData = 6;
+            break;
+        case 40: // ARM
+            jumpSlot = 22;
+            globalData = 21;
+            break;
+        case 183: // AArch64
+            jumpSlot = 1026;
+            globalData = 1025;
+            break;
+        default:
+            return false;
+        }
+
+        // Pointers in the dynamic section are link-time addresses unless the loader relocated them in place.
+        const uint64_t runtimeBase = reinterpret_cast<uintptr_t>(data);
+        const auto toRva = [&](uint64_t pointer) { return pointer - runtimeBase < size ? pointer - runtimeBase : pointer - loadBase; };
+        const bool is64 = data[4] == 2;
+        const uint64_t word = is64 ? 8 : 4;
+        uint64_t strtab = 0, symtab = 0, rela = 0, relaSize = 0, rel = 0, relSize = 0, jmprel = 0, pltSize = 0, pltType = 0;
+        for (uint64_t entry = dynamic - loadBase; entry + 2 * word <= dynamic - loadBase + dynamicSize; entry += 2 * word)
+        {
+            uint64_t tag, value;
+            if (!Detail::LoadWord(data, size, entry, is64, tag) || !Detail::LoadWord(data, size, entry + word, is64, value))
+            {
+                return false;
+            }
+            if (!tag)
+            {
+                break;
+            }
+            switch (tag)
+            {
+            case Detail::ELF_DT_STRTAB:
+                strtab = toRva(value);
+                break;
+            case Detail::ELF_DT_SYMTAB:
+                symtab = toRva(value);
+                break;
+            case Detail::ELF_DT_RELA:
+                rela = toRva(value);
+                break;
+            case Detail::ELF_DT_RELASZ:
+                relaSize = value;
+                break;
+            case Detail::ELF_DT_REL:
+                rel = toRva(value);
+                break;
+            case Detail::ELF_DT_RELSZ:
+                relSize = value;
+                break;
+            case Detail::ELF_DT_JMPREL:
+                jmprel = toRva(value);
+                break;
+            case Detail::ELF_DT_PLTRELSZ:
+                pltSize = value;
+                break;
+            case Detail::ELF_DT_PLTREL:
+                pltType = value;
+                break;
+            }
+        }
+        if (!strtab || !symtab)
+        {
+            return true;
+        }
+
+        // Elf_Rel is offset and info; Elf_Rela adds an addend. Elf_Sym starts with the name offset.
+        const struct
+        {
+            uint64_t table;
+            uint64_t size;
+            bool addend;
+        } tables[] = { { rela, relaSize, true }, { rel, relSize, false }, { jmprel, pltSize, pltType == Detail::ELF_DT_RELA } };
+        for (const auto& table : tables)
+        {
+            const uint64_t entrySize = table.addend ? 3 * word : 2 * word;
+            for (uint64_t entry = table.table; table.table && entry + entrySize <= table.table + table.size; entry += entrySize)
+            {
+                uint64_t offset, info;
+                if (!Detail::LoadWord(data, size, entry, is64, offset) || !Detail::LoadWord(data, size, entry + word, is64, info))
+                {
+                    return false;
+                }
+                const uint64_t type = is64 ? info & 0xFFFFFFFF : info & 0xFF;
+                const uint64_t symbol = is64 ? info >> 32 : info >> 8;
+                if ((type != jumpSlot && type != globalData) || !symbol)
+                {
+                    continue;
+                }
+                uint32_t name;
+                ImportSlot slot;
+                slot.slot = offset - loadBase;
+                if (!Detail::LoadAt(data, size, symtab + symbol * (is64 ? 24 : 16), name) ||
+                    !Detail::LoadString(data, size, strtab + name, slot.function))
+                {
+                    return false;
+                }
+                slots.push_back(slot);
+            }
+        }
+
+        // Some linkers let the DT_RELA range cover the jump slots as well.
+        std::sort(slots.begin(), slots.end(), [](const ImportSlot& a, const ImportSlot& b) { return a.slot < b.slot; });
+        slots.erase(std::unique(slots.begin(), slots.end(), [](const ImportSlot& a, const ImportSlot& b) { return a.slot == b.slot; }), slots.end());
+        return true;
+    }
+
+    /**
+     * Lists the import slots of a loaded PE or ELF module.
+     *
+     * @param data Start of the loaded module.
+     * @param size Number of bytes the module spans.
+     * @param slots Receives the slots.
+     * @return False if the image is neither PE nor ELF or its import tables are malformed.
+     */
+    inline bool ParseImports(const uint8_t* data, size_t size, std::vector<ImportSlot>& slots)
+    {
+        if (IsPeImage(data, size))
+        {
+            return ParsePeImports(data, size, slots);
+        }
+        return ParseElfImports(data, size, slots);
+    }
+}
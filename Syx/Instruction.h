@@ -0,0 +1,818 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace SyxLib
+{
+    /**
+     * What an instruction does to the control flow, as far as copying it elsewhere is concerned.
+     */
+    enum class InstructionKind : uint8_t
+    {
+        /** Falls through to the next instruction. */
+        Other,
+        /** call rel32. */
+        Call,
+        /** jmp rel8 / rel32. */
+        Jump,
+        /** jcc rel8 / rel32; Instruction::condition holds the condition code. */
+        ConditionalJump,
+        /** loop, loope, loopne, jecxz / jrcxz (rel8 only). */
+        Loop,
+        /** ret, indirect jmp and other instructions that never fall through. */
+        Exit
+    };
+
+    /**
+     * A decoded x86 or x64 instruction: its length and the fields a relocation has to patch.
+     */
+    struct Instruction
+    {
+        /** Length in bytes, 1 to 15. */
+        uint8_t length = 0;
+        InstructionKind kind = InstructionKind::Other;
+        /** Offset of the branch displacement or of the RIP-relative disp32, 0 if there is none. */
+        uint8_t relativeOffset = 0;
+        /** Size of the branch displacement (1, 2 or 4) or 4 for a RIP-relative operand, 0 if none. */
+        uint8_t relativeSize = 0;
+        /** The disp32 at relativeOffset addresses memory relative to the next instruction. */
+        bool ripRelative = false;
+        /** Condition code (0-15) of a ConditionalJump, the Loop opcode (0xE0-0xE3) of a Loop. */
+        uint8_t condition = 0;
+        /** Offset of an absolute address: a displacement without base register, or a mov moffs. 0 if none. */
+        uint8_t absoluteOffset = 0;
+        /** Size of the absolute address (2, 4 or 8), 0 if none. */
+        uint8_t absoluteSize = 0;
+        /** Offset of the immediate operands, 0 if there are none. */
+        uint8_t immediateOffset = 0;
+        /** Total size of the immediate operands (enter has two), 0 if none. */
+        uint8_t immediateSize = 0;
+
+        /**
+         * @return The displacement stored at relativeOffset, sign-extended.
+         */
+        int64_t Displacement(const uint8_t* code) const
+        {
+            switch (relativeSize)
+            {
+            case 1:
+                return static_cast<int8_t>(code[relativeOffset]);
+            case 2:
+            {
+                int16_t value;
+                memcpy(&value, code + relativeOffset, sizeof(value));
+                return value;
+            }
+            case 4:
+            {
+                int32_t value;
+                memcpy(&value, code + relativeOffset, sizeof(value));
+                return value;
+            }
+            default:
+                return 0;
+            }
+        }
+
+        /**
+         * @param code The instruction bytes.
+         * @param address Address the instruction executes at.
+         * @return The branch target or the RIP-relative address, 0 if there is none.
+         */
+        uintptr_t Target(const uint8_t* code, uintptr_t address) const
+        {
+            return relativeSize ? address + length + static_cast<uintptr_t>(Displacement(code)) : 0;
+        }
+    };
+
+    namespace Detail
+    {
+        enum : uint8_t
+        {
+            OP_MODRM = 1,
+            OP_IMM8 = 2,
+            /** imm16 with an operand-size prefix, imm32 otherwise. */
+            OP_IMMZ = 4,
+            OP_IMM16 = 8,
+            OP_REL8 = 16,
+            OP_REL32 = 32,
+            /** Address-sized memory offset (mov moffs). */
+            OP_MOFFS = 64,
+            /** Not encodable in 64-bit mode. */
+            OP_NO64 = 128
+        };
+
+        /** Operand layout of the one-byte opcodes. Prefixes, escapes and the odd ones are handled in code. */
+        inline uint8_t OneByteFlags(uint8_t op)
+        {
+            if (op < 0x40)
+            {
+                switch (op & 7)
+                {
+                case 4:
+                    return OP_IMM8;
+                case 5:
+                    return OP_IMMZ;
+                case 6:
+                case 7:
+                    // push/pop segment, daa, das, aaa, aas; the rest of the column are prefixes.
+                    return OP_NO64;
+                default:
+                    return OP_MODRM;
+                }
+            }
+            if (op < 0x60)
+            {
+                return 0;
+            }
+            if (op >= 0x70 && op <= 0x7F)
+            {
+                return OP_REL8;
+            }
+            if (op >= 0x84 && op <= 0x8F)
+            {
+                return OP_MODRM;
+            }
+            if (op >= 0x91 && op <= 0x9F)
+            {
+                return op == 0x9A ? OP_NO64 | OP_IMMZ | OP_IMM16 : 0;
+            }
+            if (op >= 0xB0 && op <= 0xB7)
+            {
+                return OP_IMM8;
+            }
+            if (op >= 0xB8 && op <= 0xBF)
+            {
+                return OP_IMMZ;
+            }
+            if (op >= 0xD8 && op <= 0xDF)
+            {
+                return OP_MODRM;
+            }
+            switch (op)
+            {
+            case 0x60: case 0x61: return OP_NO64;
+            case 0x62: return OP_MODRM | OP_NO64;
+            case 0x63: return OP_MODRM;
+            case 0x68: return OP_IMMZ;
+            case 0x69: return OP_MODRM | OP_IMMZ;
+            case 0x6A: return OP_IMM8;
+            case 0x6B: return OP_MODRM | OP_IMM8;
+            case 0x80: return OP_MODRM | OP_IMM8;
+            case 0x81: return OP_MODRM | OP_IMMZ;
+            case 0x82: return OP_MODRM | OP_IMM8 | OP_NO64;
+            case 0x83: return OP_MODRM | OP_IMM8;
+            case 0xA0: case 0xA1: case 0xA2: case 0xA3: return OP_MOFFS;
+            case 0xA8: return OP_IMM8;
+            case 0xA9: return OP_IMMZ;
+            case 0xC0: case 0xC1: return OP_MODRM | OP_IMM8;
+            case 0xC2: return OP_IMM16;
+            case 0xC4: case 0xC5: return OP_MODRM | OP_NO64;
+            case 0xC6: return OP_MODRM | OP_IMM8;
+            case 0xC7: return OP_MODRM | OP_IMMZ;
+            case 0xC8: return OP_IMM16 | OP_IMM8;
+            case 0xCA: return OP_IMM16;
+            case 0xCD: return OP_IMM8;
+            case 0xCE: return OP_NO64;
+            case 0xD0: case 0xD1: case 0xD2: case 0xD3: return OP_MODRM;
+            case 0xD4: case 0xD5: return OP_IMM8 | OP_NO64;
+            case 0xE0: case 0xE1: case 0xE2: case 0xE3: return OP_REL8;
+            case 0xE4: case 0xE5: case 0xE6: case 0xE7: return OP_IMM8;
+            case 0xE8: case 0xE9: return OP_REL32;
+            case 0xEA: return OP_NO64 | OP_IMMZ | OP_IMM16;
+            case 0xEB: return OP_REL8;
+            case 0xF6: case 0xF7: case 0xFE: case 0xFF: return OP_MODRM;
+            default: return 0;
+            }
+        }
+
+        /** Operand layout of the 0F xx opcodes. */
+        inline uint8_t TwoByteFlags(uint8_t op)
+        {
+            if (op >= 0x80 && op <= 0x8F)
+            {
+                return OP_REL32;
+            }
+            if ((op >= 0x70 && op <= 0x73) || op == 0xA4 || op == 0xAC || op == 0xBA || op == 0xC2 || (op >= 0xC4 && op <= 0xC6))
+            {
+                return OP_MODRM | OP_IMM8;
+            }
+            if ((op >= 0x04 && op <= 0x0C) || op == 0x0E || (op >= 0x30 && op <= 0x37) || op == 0x77 ||
+                op == 0xA0 || op == 0xA1 || op == 0xA2 || op == 0xA8 || op == 0xA9 || op == 0xAA || (op >= 0xC8 && op <= 0xCF))
+            {
+                return 0;
+            }
+            return OP_MODRM;
+        }
+
+        /**
+         * Length of the ModRM byte and everything it implies (SIB, displacement). Sets the displacement
+         * position for RIP-relative operands and, with its size, for addresses without a base register.
+         */
+        inline size_t ModRMLength(const uint8_t* p, size_t left, bool x64, bool addr16, bool& ripRelative, size_t& dispOffset, size_t& absoluteSize)
+        {
+            if (left < 1)
+            {
+                return 0;
+            }
+            const uint8_t modrm = p[0];
+            const uint8_t mod = modrm >> 6, rm = modrm & 7;
+            if (mod == 3)
+            {
+                return 1;
+            }
+            if (addr16)
+            {
+                if (mod == 0 && rm == 6)
+                {
+                    dispOffset = 1;
+                    absoluteSize = 2;
+                }
+                return 1 + (mod == 1 ? 1 : mod == 2 || (mod == 0 && rm == 6) ? 2 : 0);
+            }
+            size_t length = 1;
+            if (rm == 4)
+            {
+                if (left < 2)
+                {
+                    return 0;
+                }
+                length = 2;
+                if (mod == 0 && (p[1] & 7) == 5)
+                {
+                    dispOffset = 2;
+                    absoluteSize = 4;
+                    return length + 4;
+                }
+            }
+            else if (mod == 0 && rm == 5)
+            {
+                ripRelative = x64;
+                dispOffset = 1;
+                absoluteSize = x64 ? 0 : 4;
+                return length + 4;
+            }
+            return length + (mod == 1 ? 1 : mod == 2 ? 4 : 0);
+        }
+    }
+
+    /**
+     * Decodes the length and branch fields of one instruction. Covers the general-purpose, x87,
+     * SSE, VEX, EVEX and XOP encodings; instructions reading past size or longer than 15 bytes fail.
+     *
+     * @param code The instruction bytes.
+     * @param size Bytes available at code.
+     * @param x64 Decode in 64-bit mode.
+     * @param out Receives the instruction.
+     * @return False if the bytes are not a valid instruction.
+     */
+    inline bool DecodeInstruction(const uint8_t* code, size_t size, bool x64, Instruction& out)
+    {
+        using namespace Detail;
+        out = Instruction();
+        const size_t limit = size < 15 ? size : 15;
+        size_t i = 0;
+        bool operand16 = false, address16 = false, rexW = false;
+
+        // Legacy prefixes and, in 64-bit mode, REX. A REX only counts right before the opcode.
+        for (; i < limit; i++)
+        {
+            const uint8_t b = code[i];
+            if (x64 && (b & 0xF0) == 0x40)
+            {
+                rexW = (b & 8) != 0;
+                continue;
+            }
+            if (b == 0x66)
+            {
+                operand16 = true;
+            }
+            else if (b == 0x67)
+            {
+                address16 = true;
+            }
+            else if (b != 0xF0 && b != 0xF2 && b != 0xF3 && b != 0x2E && b != 0x36 && b != 0x3E && b != 0x26 && b != 0x64 && b != 0x65)
+            {
+                break;
+            }
+            rexW = false;
+        }
+        if (i >= limit)
+        {
+            return false;
+        }
+        // In 64-bit mode the address-size prefix selects 32-bit addressing, which decodes like 64-bit.
+        const bool addr16 = address16 && !x64;
+        const size_t immZ = operand16 ? 2 : 4;
+
+        uint8_t flags = 0;
+        size_t extra = 0;
+        bool moffs = false;
+        const uint8_t op = code[i++];
+        if (op == 0x0F)
+        {
+            if (i >= limit)
+            {
+                return false;
+            }
+            const uint8_t op2 = code[i++];
+            if (op2 == 0x38 || op2 == 0x3A)
+            {
+                if (i >= limit)
+                {
+                    return false;
+                }
+                i++;
+                flags = OP_MODRM | (op2 == 0x3A ? OP_IMM8 : 0);
+            }
+            else if (op2 == 0x0F)
+            {
+                // 3DNow!: ModRM, then the real opcode as an imm8.
+                flags = OP_MODRM | OP_IMM8;
+            }
+            else if (op2 >= 0x20 && op2 <= 0x27)
+            {
+                // mov to/from control, debug and test registers ignores the mod field: always a register.
+                if (i >= limit)
+                {
+                    return false;
+                }
+                i++;
+            }
+            else
+            {
+                flags = TwoByteFlags(op2);
+                if (op2 >= 0x80 && op2 <= 0x8F)
+                {
+                    out.kind = InstructionKind::ConditionalJump;
+                    out.condition = op2 & 0x0F;
+                }
+                else if (op2 == 0x07 || op2 == 0x0B || op2 == 0x35)
+                {
+                    // sysret, ud2, sysexit
+                    out.kind = InstructionKind::Exit;
+                }
+            }
+        }
+        else if (i < limit && (((op == 0xC4 || op == 0xC5 || op == 0x62) && (x64 || (code[i] & 0xC0) == 0xC0)) ||
+            (op == 0x8F && (code[i] & 0x1F) >= 8)))
+        {
+            // VEX (C4/C5), EVEX (62) and XOP (8F, told from pop r/m by its map field). Outside
+            // 64-bit mode C4/C5/62 are only prefixes when the next byte would be an invalid
+            // memory ModRM of les/lds/bound.
+            size_t map;
+            if (op == 0xC5)
+            {
+                map = 1;
+                i += 1;
+            }
+            else if (op == 0x62)
+            {
+                if (i + 3 > limit)
+                {
+                    return false;
+                }
+                map = code[i] & 7;
+                i += 3;
+            }
+            else
+            {
+                if (i + 2 > limit)
+                {
+                    return false;
+                }
+                map = code[i] & 0x1F;
+                i += 2;
+            }
+            if (i >= limit)
+            {
+                return false;
+            }
+            const uint8_t vop = code[i++];
+            flags = OP_MODRM;
+            if (op == 0x8F)
+            {
+                extra = map == 8 ? 1 : map == 0x0A ? 4 : 0;
+            }
+            else if (map == 3)
+            {
+                flags |= OP_IMM8;
+            }
+            else if (map == 1)
+            {
+                if (vop == 0x77 && op != 0x62)
+                {
+                    flags = 0;
+                }
+                else if ((vop >= 0x70 && vop <= 0x73) || vop == 0xC2 || (vop >= 0xC4 && vop <= 0xC6))
+                {
+                    flags |= OP_IMM8;
+                }
+            }
+        }
+        else
+        {
+            flags = OneByteFlags(op);
+            if (x64 && (flags & OP_NO64))
+            {
+                return false;
+            }
+            if (op >= 0x70 && op <= 0x7F)
+            {
+                out.kind = InstructionKind::ConditionalJump;
+                out.condition = op & 0x0F;
+            }
+            else if (op >= 0xE0 && op <= 0xE3)
+            {
+                out.kind = InstructionKind::Loop;
+                out.condition = op;
+            }
+            else if (op == 0xE8)
+            {
+                out.kind = InstructionKind::Call;
+            }
+            else if (op == 0xE9 || op == 0xEB)
+            {
+                out.kind = InstructionKind::Jump;
+            }
+            else if (op == 0xC2 || op == 0xC3 || op == 0xCA || op == 0xCB || op == 0xCF || op == 0xEA)
+            {
+                out.kind = InstructionKind::Exit;
+            }
+            else if (op >= 0xB8 && op <= 0xBF && rexW)
+            {
+                flags = 0;
+                extra = 8;
+            }
+            else if (op == 0xF6 || op == 0xF7)
+            {
+                // test r/m, imm is the only group 3 member with an immediate.
+                if (i < limit && ((code[i] >> 3) & 7) < 2)
+                {
+                    flags |= op == 0xF6 ? OP_IMM8 : OP_IMMZ;
+                }
+            }
+            else if (op == 0xFF && i < limit)
+            {
+                const uint8_t reg = (code[i] >> 3) & 7;
+                if (reg == 4 || reg == 5)
+                {
+                    out.kind = InstructionKind::Exit;
+                }
+            }
+            if (flags & OP_MOFFS)
+            {
+                extra = x64 ? (address16 ? 4 : 8) : (address16 ? 2 : 4);
+                moffs = true;
+            }
+        }
+
+        if (flags & OP_REL32)
+        {
+            // Outside 64-bit mode the operand-size prefix shortens branches to rel16.
+            out.relativeSize = !x64 && operand16 ? 2 : 4;
+        }
+        if (flags & OP_REL8)
+        {
+            out.relativeSize = 1;
+        }
+
+        if (flags & OP_MODRM)
+        {
+            bool rip = false;
+            size_t dispOffset = 0, absoluteSize = 0;
+            const size_t length = ModRMLength(code + i, limit - i, x64, addr16, rip, dispOffset, absoluteSize);
+            if (!length)
+            {
+                return false;
+            }
+            if (rip)
+            {
+                out.ripRelative = true;
+                out.relativeSize = 4;
+                out.relativeOffset = static_cast<uint8_t>(i + dispOffset);
+            }
+            else if (absoluteSize)
+            {
+                out.absoluteOffset = static_cast<uint8_t>(i + dispOffset);
+                out.absoluteSize = static_cast<uint8_t>(absoluteSize);
+            }
+            i += length;
+        }
+        if (out.relativeSize && !out.ripRelative)
+        {
+            out.relativeOffset = static_cast<uint8_t>(i);
+            i += out.relativeSize;
+        }
+        if (moffs)
+        {
+            out.absoluteOffset = static_cast<uint8_t>(i);
+            out.absoluteSize = static_cast<uint8_t>(extra);
+            i += extra;
+            extra = 0;
+        }
+        const size_t immediate = i;
+        i += extra;
+        if (flags & OP_IMM16)
+        {
+            i += 2;
+        }
+        if (flags & OP_IMMZ)
+        {
+            i += immZ;
+        }
+        if (flags & OP_IMM8)
+        {
+            i += 1;
+        }
+        if (i > limit)
+        {
+            return false;
+        }
+        if (i > immediate)
+        {
+            out.immediateOffset = static_cast<uint8_t>(immediate);
+            out.immediateSize = static_cast<uint8_t>(i - immediate);
+        }
+        out.length = static_cast<uint8_t>(i);
+        return true;
+    }
+
+    /**
+     * Finds how many bytes of whole instructions have to be moved to overwrite at least minLength
+     * bytes at the start of a function.
+     *
+     * Fails if an instruction cannot be decoded, or if the function returns or jumps away before
+     * minLength bytes unless only int3/nop padding follows.
+     *
+     * @param code Start of the function.
+     * @param size Bytes readable at code.
+     * @param minLength Bytes the hook writes.
+     * @param x64 Decode in 64-bit mode.
+     * @return The length, at least minLength, or 0 on failure.
+     */
+    inline size_t FindPatchLength(const uint8_t* code, size_t size, size_t minLength, bool x64)
+    {
+        size_t length = 0;
+        while (length < minLength)
+        {
+            Instruction instruction;
+            if (!DecodeInstruction(code + length, size - length, x64, instruction))
+            {
+                return 0;
+            }
+            length += instruction.length;
+            if (length < minLength && (instruction.kind == InstructionKind::Exit || instruction.kind == InstructionKind::Jump))
+            {
+                for (size_t pad = length; pad < minLength; pad++)
+                {
+                    if (pad >= size || (code[pad] != 0xCC && code[pad] != 0x90))
+                    {
+                        return 0;
+                    }
+                }
+                return minLength;
+            }
+        }
+        return length;
+    }
+
+    namespace Detail
+    {
+        inline bool FitsRel32(int64_t value)
+        {
+            return value >= INT32_MIN && value <= INT32_MAX;
+        }
+
+        inline void PutRel32(std::vector<uint8_t>& out, int64_t value)
+        {
+            const int32_t rel = static_cast<int32_t>(value);
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&rel);
+            out.insert(out.end(), bytes, bytes + 4);
+        }
+
+        /** jmp [rip + 0] followed by the 64-bit target. */
+        inline void PutAbsoluteJump(std::vector<uint8_t>& out, uint64_t target)
+        {
+            static const uint8_t jump[] = { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+            out.insert(out.end(), jump, jump + sizeof(jump));
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&target);
+            out.insert(out.end(), bytes, bytes + 8);
+        }
+    }
+
+    /**
+     * Copies whole instructions to another address and fixes everything that is relative to the
+     * instruction pointer, so the copy behaves like the original:
+     * - call/jmp/jcc rel32 are re-aimed; rel8 jmp/jcc are widened to rel32.
+     * - loop/jecxz become the rel8 instruction over a short jmp, followed by a jmp rel32.
+     * - In 64-bit mode, branches that no longer reach their target within +-2 GB become absolute
+     *   jumps through an inline pointer (calls push the address after the pointer).
+     * - RIP-relative operands get a new disp32.
+     * - Branches into the copied range are aimed at the copy.
+     *
+     * @param code The instructions to copy; length must end on an instruction boundary, see FindPatchLength.
+     * @param length Number of bytes to copy.
+     * @param source Address the instructions execute at now.
+     * @param destination Address the copy will execute at.
+     * @param x64 Decode in 64-bit mode.
+     * @param out Receives the relocated code.
+     * @param boundaries Optional, receives the offset of each instruction in code and in out.
+     * @return False if an instruction cannot be decoded, a rel16 branch or a branch into the middle
+     *         of a copied instruction is met, or a RIP-relative operand is out of reach.
+     */
+    inline bool RelocateInstructions(const uint8_t* code, size_t length, uintptr_t source, uintptr_t destination,
+        bool x64, std::vector<uint8_t>& out, std::vector<std::pair<size_t, size_t>>* boundaries = nullptr)
+    {
+        using namespace Detail;
+        struct Item
+        {
+            Instruction instruction;
+            size_t from;
+            size_t to;
+            /** Far form (64-bit absolute jump) chosen. */
+            bool far;
+        };
+        std::vector<Item> items;
+
+        // First pass: decode and size every instruction. A copy only grows, and the size of each
+        // one only depends on the ones before it, so a single forward pass places them all.
+        size_t at = 0, placed = 0;
+        while (at < length)
+        {
+            Item item = { Instruction(), at, placed, false };
+            if (!DecodeInstruction(code + at, length - at, x64, item.instruction))
+            {
+                return false;
+            }
+            const Instruction& instruction = item.instruction;
+            size_t size = instruction.length;
+            if (instruction.relativeSize == 2)
+            {
+                return false;
+            }
+            if (instruction.relativeSize && !instruction.ripRelative && instruction.kind != InstructionKind::Other)
+            {
+                const uintptr_t target = instruction.Target(code + at, source + at);
+                const bool inside = target >= source && target < source + length;
+                switch (instruction.kind)
+                {
+                case InstructionKind::Call:
+                case InstructionKind::Jump:
+                    size = 5;
+                    break;
+                case InstructionKind::ConditionalJump:
+                    size = 6;
+                    break;
+                case InstructionKind::Loop:
+                    size = instruction.length + 2 + 5;
+                    break;
+                default:
+                    break;
+                }
+                if (x64 && !inside)
+                {
+                    // Estimated end of the near form; far forms are used when it cannot reach.
+                    item.far = !FitsRel32(static_cast<int64_t>(target - (destination + placed + size)));
+                    if (item.far)
+                    {
+                        size = instruction.kind == InstructionKind::Call ? 8 + 8 :
+                            instruction.kind == InstructionKind::Jump ? 14 :
+                            instruction.kind == InstructionKind::ConditionalJump ? 2 + 14 : instruction.length + 2 + 14;
+                    }
+                }
+            }
+            at += instruction.length;
+            placed += size;
+            items.push_back(item);
+        }
+
+        auto mapInside = [&](uintptr_t target, uintptr_t& mapped)
+        {
+            for (const Item& item : items)
+            {
+                if (source + item.from == target)
+                {
+                    mapped = destination + item.to;
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        // Second pass: emit.
+        out.clear();
+        out.reserve(placed);
+        for (const Item& item : items)
+        {
+            const Instruction& instruction = item.instruction;
+            const uint8_t* bytes = code + item.from;
+            const uintptr_t here = destination + out.size();
+
+            if (instruction.ripRelative)
+            {
+                const uintptr_t target = instruction.Target(bytes, source + item.from);
+                const int64_t disp = static_cast<int64_t>(target - (here + instruction.length));
+                if (!FitsRel32(disp))
+                {
+                    return false;
+                }
+                const size_t start = out.size();
+                out.insert(out.end(), bytes, bytes + instruction.length);
+                const int32_t rel = static_cast<int32_t>(disp);
+                memcpy(out.data() + start + instruction.relativeOffset, &rel, sizeof(rel));
+                continue;
+            }
+            if (!instruction.relativeSize || instruction.kind == InstructionKind::Other)
+            {
+                out.insert(out.end(), bytes, bytes + instruction.length);
+                continue;
+            }
+
+            uintptr_t target = instruction.Target(bytes, source + item.from);
+            if (target >= source && target < source + length && !mapInside(target, target))
+            {
+                return false;
+            }
+
+            switch (instruction.kind)
+            {
+            case InstructionKind::Call:
+                if (item.far)
+                {
+                    // call [rip + 2]; jmp +8; dq target
+                    static const uint8_t call[] = { 0xFF, 0x15, 0x02, 0x00, 0x00, 0x00, 0xEB, 0x08 };
+                    out.insert(out.end(), call, call + sizeof(call));
+                    const uint64_t absolute = target;
+                    const uint8_t* pointer = reinterpret_cast<const uint8_t*>(&absolute);
+                    out.insert(out.end(), pointer, pointer + 8);
+                }
+                else
+                {
+                    out.push_back(0xE8);
+                    PutRel32(out, static_cast<int64_t>(target - (here + 5)));
+                }
+                break;
+            case InstructionKind::Jump:
+                if (item.far)
+                {
+                    PutAbsoluteJump(out, target);
+                }
+                else
+                {
+                    out.push_back(0xE9);
+                    PutRel32(out, static_cast<int64_t>(target - (here + 5)));
+                }
+                break;
+            case InstructionKind::ConditionalJump:
+                if (item.far)
+                {
+                    // Inverted condition skips the absolute jump.
+                    out.push_back(static_cast<uint8_t>(0x70 | (instruction.condition ^ 1)));
+                    out.push_back(14);
+                    PutAbsoluteJump(out, target);
+                }
+                else
+                {
+                    out.push_back(0x0F);
+                    out.push_back(static_cast<uint8_t>(0x80 | instruction.condition));
+                    PutRel32(out, static_cast<int64_t>(target - (here + 6)));
+                }
+                break;
+            case InstructionKind::Loop:
+            {
+                // loop +2 (taken: to the long jump); jmp short over it; long jump to the target.
+                // Keep any address-size prefix, it selects cx/ecx/rcx.
+                out.insert(out.end(), bytes, bytes + instruction.relativeOffset);
+                out.push_back(2);
+                out.push_back(0xEB);
+                out.push_back(static_cast<uint8_t>(item.far ? 14 : 5));
+                if (item.far)
+                {
+                    PutAbsoluteJump(out, target);
+                }
+                else
+                {
+                    out.push_back(0xE9);
+                    PutRel32(out, static_cast<int64_t>(target - (destination + out.size() + 4)));
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        if (boundaries)
+        {
+            boundaries->clear();
+            for (const Item& item : items)
+            {
+                boundaries->push_back({ item.from, item.to });
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,361 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SyxLib
+{
+    /**
+     * A file mapped into memory. On Windows this is CreateFileMapping/MapViewOfFile, elsewhere mmap.
+     * Writable mappings are shared, so stores through Data() reach the file without explicit writes.
+     *
+     * @example
+     * SyxLib::MappedFile file;
+     * if (file.Open("signatures.cache", SyxLib::MappedFile::READ_WRITE, 4096))
+     *     file.Data()[0] = 1;
+     */
+    class MappedFile
+    {
+    public:
+        enum Mode
+        {
+            /** Map an existing file read-only. */
+            READ_ONLY,
+            /** Map a file read-write, creating it if it does not exist. */
+            READ_WRITE,
+            /**
+             * Like READ_WRITE, but other processes may open the file for writing too (Windows
+             * refuses them otherwise); writers coordinate with Lock.
+             */
+            READ_WRITE_SHARED
+        };
+
+        MappedFile() = default;
+
+        ~MappedFile()
+        {
+            Close();
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+        {
+            *this = static_cast<MappedFile&&>(other);
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Close();
+                m_file = other.m_file;
+                m_data = other.m_data;
+                m_size = other.m_size;
+                m_mode = other.m_mode;
+                other.m_file = INVALID_FILE;
+                other.m_data = nullptr;
+                other.m_size = 0;
+            }
+            return *this;
+        }
+
+        /**
+         * Opens and maps a file.
+         *
+         * @param path Path of the file.
+         * @param mode READ_ONLY, READ_WRITE or READ_WRITE_SHARED.
+         * @param minimumSize For a writable mode, the file is grown to at least this many bytes.
+         * @return False if the file cannot be opened or mapped.
+         */
+        bool Open(const std::string& path, Mode mode, size_t minimumSize = 0)
+        {
+            Close();
+            m_mode = mode;
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), IsWritable() ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                FILE_SHARE_READ | (mode != READ_WRITE ? FILE_SHARE_WRITE : 0), NULL,
+                IsWritable() ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (m_file == INVALID_FILE)
+            {
+                return false;
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_file, &size))
+            {
+                Close();
+                return false;
+            }
+            m_size = static_cast<size_t>(size.QuadPart);
+#else
+            m_file = open(path.c_str(), IsWritable() ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+            if (m_file == INVALID_FILE)
+            {
+                return false;
+            }
+            struct stat info;
+            if (fstat(m_file, &info) != 0)
+            {
+                Close();
+                return false;
+            }
+            m_size = static_cast<size_t>(info.st_size);
+#endif
+            if (IsWritable() && m_size < minimumSize)
+            {
+                return Resize(minimumSize);
+            }
+            if (!Map())
+            {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Changes the size of a writable file and remaps it. Data() may move. Other processes that
+         * map a shared file fault on pages past its end, so shared files should only grow.
+         *
+         * @param size New size in bytes.
+         * @return False if the file cannot be resized or remapped; the file is closed in that case.
+         */
+        bool Resize(size_t size)
+        {
+            if (m_file == INVALID_FILE || !IsWritable())
+            {
+                return false;
+            }
+            Unmap();
+#ifdef _WIN32
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(size);
+            const bool resized = SetFilePointerEx(m_file, position, NULL, FILE_BEGIN) && SetEndOfFile(m_file);
+#else
+            const bool resized = ftruncate(m_file, static_cast<off_t>(size)) == 0;
+#endif
+            if (!resized)
+            {
+                Close();
+                return false;
+            }
+            m_size = size;
+            if (!Map())
+            {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Maps the file again if another process changed its size. The handle, and a lock held
+         * on it, are kept.
+         *
+         * @return False if the file cannot be remapped; the file is closed in that case.
+         */
+        bool Refresh()
+        {
+            if (m_file == INVALID_FILE)
+            {
+                return false;
+            }
+#ifdef _WIN32
+            LARGE_INTEGER info;
+            if (!GetFileSizeEx(m_file, &info))
+            {
+                return false;
+            }
+            const size_t size = static_cast<size_t>(info.QuadPart);
+#else
+            struct stat info;
+            if (fstat(m_file, &info) != 0)
+            {
+                return false;
+            }
+            const size_t size = static_cast<size_t>(info.st_size);
+#endif
+            if (size == m_size)
+            {
+                return true;
+            }
+            Unmap();
+            m_size = size;
+            if (!Map())
+            {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Takes an advisory lock shared with every process that opens the same file, waiting until
+         * it is free. Mapped reads and writes are not blocked by it.
+         *
+         * @param exclusive False for a shared lock, which only excludes exclusive holders.
+         */
+        bool Lock(bool exclusive = true) const
+        {
+            if (m_file == INVALID_FILE)
+            {
+                return false;
+            }
+#ifdef _WIN32
+            // Windows byte-range locks are mandatory, so the locked byte lies far past any data.
+            OVERLAPPED overlapped = {};
+            overlapped.OffsetHigh = MAXDWORD;
+            return LockFileEx(m_file, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &overlapped) != 0;
+#else
+            int result;
+            while ((result = flock(m_file, exclusive ? LOCK_EX : LOCK_SH)) != 0 && errno == EINTR)
+            {
+            }
+            return result == 0;
+#endif
+        }
+
+        void Unlock() const
+        {
+            if (m_file == INVALID_FILE)
+            {
+                return;
+            }
+#ifdef _WIN32
+            OVERLAPPED overlapped = {};
+            overlapped.OffsetHigh = MAXDWORD;
+            UnlockFileEx(m_file, 0, 1, 0, &overlapped);
+#else
+            flock(m_file, LOCK_UN);
+#endif
+        }
+
+        /**
+         * Asks the OS to write dirty pages back to the file. Not needed for correctness across
+         * processes, only for durability against a system crash.
+         */
+        bool Flush()
+        {
+            if (!m_data)
+            {
+                return false;
+            }
+#ifdef _WIN32
+            return FlushViewOfFile(m_data, m_size) != 0;
+#else
+            return msync(m_data, m_size, MS_SYNC) == 0;
+#endif
+        }
+
+        /** Unmaps and closes the file. */
+        void Close()
+        {
+            Unmap();
+            if (m_file != INVALID_FILE)
+            {
+#ifdef _WIN32
+                CloseHandle(m_file);
+#else
+                close(m_file);
+#endif
+                m_file = INVALID_FILE;
+            }
+            m_size = 0;
+        }
+
+        bool IsOpen() const
+        {
+            return m_file != INVALID_FILE;
+        }
+
+        /**
+         * @return Start of the mapping, nullptr for a closed or empty file.
+         */
+        uint8_t* Data()
+        {
+            return m_data;
+        }
+
+        const uint8_t* Data() const
+        {
+            return m_data;
+        }
+
+        size_t Size() const
+        {
+            return m_size;
+        }
+
+    private:
+#ifdef _WIN32
+        using FileHandle = HANDLE;
+        static inline const FileHandle INVALID_FILE = INVALID_HANDLE_VALUE;
+#else
+        using FileHandle = int;
+        static constexpr FileHandle INVALID_FILE = -1;
+#endif
+
+        bool IsWritable() const
+        {
+            return m_mode != READ_ONLY;
+        }
+
+        bool Map()
+        {
+            // Empty files cannot be mapped; they are valid and simply have no data.
+            if (m_size == 0)
+            {
+                return true;
+            }
+#ifdef _WIN32
+            HANDLE mapping = CreateFileMappingA(m_file, NULL, IsWritable() ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+            if (!mapping)
+            {
+                return false;
+            }
+            m_data = static_cast<uint8_t*>(MapViewOfFile(mapping, IsWritable() ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, m_size));
+            // The view keeps the mapping object alive.
+            CloseHandle(mapping);
+            return m_data != nullptr;
+#else
+            void* data = mmap(nullptr, m_size, IsWritable() ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_file, 0);
+            if (data == MAP_FAILED)
+            {
+                return false;
+            }
+            m_data = static_cast<uint8_t*>(data);
+            return true;
+#endif
+        }
+
+        void Unmap()
+        {
+            if (m_data)
+            {
+#ifdef _WIN32
+                UnmapViewOfFile(m_data);
+#else
+                munmap(m_data, m_size);
+#endif
+                m_data = nullptr;
+            }
+        }
+
+        FileHandle m_file = INVALID_FILE;
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        Mode m_mode = READ_ONLY;
+    };
+}
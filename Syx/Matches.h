@@ -0,0 +1,250 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    namespace Detail
+    {
+        /**
+         * Calls a match callback. Callbacks returning bool stop the scan by returning false,
+         * callbacks returning anything else never stop it.
+         *
+         * @return False if the scan should stop.
+         */
+        template <typename Callback, typename Value>
+        inline bool InvokeMatchCallback(Callback& callback, Value value)
+        {
+            if constexpr (std::is_same<decltype(callback(value)), bool>::value)
+            {
+                return callback(value);
+            }
+            else
+            {
+                callback(value);
+                return true;
+            }
+        }
+    }
+
+    /**
+     * A lazy range over every match of a pattern in a buffer, in address order. Overlapping
+     * matches are all reported. Each step resumes the scan one byte after the previous hit, so
+     * iterating costs the same as a single scan of the buffer and the compiled pattern is reused.
+     *
+     * Matches are reported as origin + offset: with the default origin of 0 they are offsets into
+     * the buffer, with origin set to the buffer's address they are absolute addresses. A range over
+     * several spans reports absolute addresses and never matches across the gap between two spans.
+     *
+     * @example
+     * for (uintptr_t hit : SyxLib::MatchRange(SyxLib::Scanner(pattern), data, size))
+     *     printf("%zx\n", hit);
+     */
+    class MatchRange
+    {
+    public:
+        class Iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = uintptr_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const uintptr_t*;
+            using reference = uintptr_t;
+
+            Iterator() = default;
+
+            uintptr_t operator*() const
+            {
+                return m_range->m_pieces[m_piece].origin + m_offset;
+            }
+
+            Iterator& operator++()
+            {
+                m_count++;
+                if (m_count < m_range->m_limit)
+                {
+                    Seek(m_offset + 1);
+                }
+                else
+                {
+                    m_offset = NOT_FOUND;
+                }
+                return *this;
+            }
+
+            Iterator operator++(int)
+            {
+                Iterator previous = *this;
+                ++*this;
+                return previous;
+            }
+
+            bool operator==(const Iterator& other) const
+            {
+                return m_offset == other.m_offset && (m_offset == NOT_FOUND || m_piece == other.m_piece);
+            }
+
+            bool operator!=(const Iterator& other) const
+            {
+                return !(*this == other);
+            }
+
+        private:
+            friend class MatchRange;
+
+            explicit Iterator(const MatchRange* range)
+                : m_range(range)
+            {
+            }
+
+            /** Moves to the first match at or after an offset of the current piece, or in a later piece. */
+            void Seek(size_t from)
+            {
+                for (; m_piece < m_range->m_pieces.size(); m_piece++, from = 0)
+                {
+                    const Piece& piece = m_range->m_pieces[m_piece];
+                    m_offset = m_range->m_scanner.Find(piece.data, piece.size, from);
+                    if (m_offset != NOT_FOUND)
+                    {
+                        return;
+                    }
+                }
+                m_offset = NOT_FOUND;
+            }
+
+            const MatchRange* m_range = nullptr;
+            size_t m_piece = 0;
+            size_t m_offset = NOT_FOUND;
+            size_t m_count = 0;
+        };
+
+        /**
+         * @param scanner The compiled pattern. The range keeps its own copy.
+         * @param data Start of the buffer.
+         * @param size Size of the buffer in bytes.
+         * @param limit Maximum number of matches to report.
+         * @param origin Value added to every reported offset.
+         */
+        MatchRange(Scanner scanner, const uint8_t* data, size_t size, size_t limit = SIZE_MAX, uintptr_t origin = 0)
+            : m_scanner(static_cast<Scanner&&>(scanner)), m_pieces{ { data, size, origin } }, m_limit(limit)
+        {
+        }
+
+        /**
+         * @param scanner The compiled pattern. The range keeps its own copy.
+         * @param spans Readable spans sorted by address; matches are reported as addresses.
+         * @param limit Maximum number of matches to report.
+         */
+        MatchRange(Scanner scanner, const std::vector<ByteSpan>& spans, size_t limit = SIZE_MAX)
+            : m_scanner(static_cast<Scanner&&>(scanner)), m_limit(limit)
+        {
+            for (const ByteSpan& span : spans)
+            {
+                m_pieces.push_back({ span.data, span.size, reinterpret_cast<uintptr_t>(span.data) });
+            }
+        }
+
+        Iterator begin() const
+        {
+            Iterator it(this);
+            if (m_limit)
+            {
+                it.Seek(0);
+            }
+            return it;
+        }
+
+        Iterator end() const
+        {
+            return Iterator();
+        }
+
+        /**
+         * @return True if the pattern does not occur at all.
+         */
+        bool Empty() const
+        {
+            return begin() == end();
+        }
+
+        /**
+         * Counts the matches, stopping at the limit. Use a limit of 2 to check that a signature is unique.
+         *
+         * @return Number of matches, at most the limit.
+         */
+        size_t Count() const
+        {
+            size_t count = 0;
+            for (Iterator it = begin(); it != end(); ++it)
+            {
+                count++;
+            }
+            return count;
+        }
+
+        /**
+         * @return Every reported match.
+         */
+        std::vector<uintptr_t> ToVector() const
+        {
+            return std::vector<uintptr_t>(begin(), end());
+        }
+
+    private:
+        struct Piece
+        {
+            const uint8_t* data;
+            size_t size;
+            /** Value reported for a match at the start of the piece. */
+            uintptr_t origin;
+        };
+
+        Scanner m_scanner;
+        std::vector<Piece> m_pieces;
+        size_t m_limit;
+    };
+
+    /**
+     * Calls a function for every match of a pattern in a buffer, in address order.
+     *
+     * @param scanner The compiled pattern.
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param callback Called with the offset of each match. If it returns bool, returning false stops the scan.
+     * @param limit Maximum number of matches to report.
+     * @return Number of matches reported.
+     */
+    template <typename Callback>
+    inline size_t ForEachMatch(const Scanner& scanner, const uint8_t* data, size_t size, Callback&& callback, size_t limit = SIZE_MAX)
+    {
+        size_t count = 0;
+        for (size_t offset = scanner.Find(data, size); offset != NOT_FOUND && count < limit; offset = scanner.Find(data, size, offset + 1))
+        {
+            count++;
+            if (!Detail::InvokeMatchCallback(callback, offset))
+            {
+                break;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Counts the matches of a pattern in a buffer, stopping at a limit.
+     *
+     * @param scanner The compiled pattern.
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param limit Maximum number of matches to count; 2 is enough to tell whether a signature is unique.
+     * @return Number of matches, at most limit.
+     */
+    inline size_t CountMatches(const Scanner& scanner, const uint8_t* data, size_t size, size_t limit = SIZE_MAX)
+    {
+        return ForEachMatch(scanner, data, size, [](size_t) {}, limit);
+    }
+}
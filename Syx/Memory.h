@@ -0,0 +1,467 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Regions.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <climits>
+#include <sys/uio.h>
+#endif
+
+namespace SyxLib
+{
+    /**
+     * One piece of a scattered read: size bytes at address are copied to buffer.
+     */
+    struct ReadRequest
+    {
+        uintptr_t address;
+        void* buffer;
+        size_t size;
+        /** Set by ReadScatter to the length of the readable prefix that was copied. */
+        size_t transferred;
+    };
+
+    /**
+     * One piece of a scattered write: size bytes from buffer are copied to address.
+     */
+    struct WriteRequest
+    {
+        uintptr_t address;
+        const void* buffer;
+        size_t size;
+        /** Set by WriteScatter to the number of bytes written. */
+        size_t transferred;
+    };
+
+    /**
+     * Reads and writes the memory of some address space: the current process or another one.
+     *
+     * Scans (MemoryScan.h) and pointer walks (ResolvePointerChain) are written against this
+     * interface, so the same code runs in-process and out of process. Backends move data in
+     * blocks; callers should read large ranges or batch many small reads with ReadScatter
+     * instead of issuing one call per value.
+     */
+    class MemoryAccessor
+    {
+    public:
+        virtual ~MemoryAccessor() = default;
+
+        /**
+         * Copies memory out of the address space.
+         *
+         * @param address Source address.
+         * @param buffer Destination buffer.
+         * @param size Number of bytes to copy.
+         * @return Length of the readable prefix that was copied; less than size if an unreadable page was hit.
+         */
+        virtual size_t ReadBytes(uintptr_t address, void* buffer, size_t size) const = 0;
+
+        /**
+         * Copies memory into the address space. Page protection is not changed.
+         *
+         * @return Number of bytes written.
+         */
+        virtual size_t WriteBytes(uintptr_t address, const void* buffer, size_t size) const = 0;
+
+        /**
+         * Performs several reads, using as few system calls as the backend allows.
+         * Each request's transferred field receives its readable prefix length.
+         */
+        virtual void ReadScatter(ReadRequest* requests, size_t count) const
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                requests[i].transferred = ReadBytes(requests[i].address, requests[i].buffer, requests[i].size);
+            }
+        }
+
+        /**
+         * Performs several writes, using as few system calls as the backend allows.
+         * Each request's transferred field receives the number of bytes written.
+         */
+        virtual void WriteScatter(WriteRequest* requests, size_t count) const
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                requests[i].transferred = WriteBytes(requests[i].address, requests[i].buffer, requests[i].size);
+            }
+        }
+
+        /**
+         * Enumerates the committed regions of the address space that overlap a range.
+         *
+         * @return Regions sorted by base address.
+         */
+        virtual std::vector<MemoryRegion> QueryRegions(uintptr_t begin = 0, uintptr_t end = UINTPTR_MAX) const = 0;
+
+        /**
+         * @return Size of a pointer in the address space: 4 for a 32-bit target, 8 for a 64-bit one.
+         */
+        virtual size_t PointerSize() const
+        {
+            return sizeof(void*);
+        }
+
+        /**
+         * Returns a pointer through which [address, address + size) can be read directly, or
+         * nullptr if the memory must be copied with ReadBytes. Lets generic scans skip the copy
+         * for the current process.
+         */
+        virtual const uint8_t* Direct(uintptr_t address, size_t size) const
+        {
+            (void)address;
+            (void)size;
+            return nullptr;
+        }
+
+        /**
+         * Reads a value.
+         *
+         * @return False if the value could not be read completely.
+         */
+        template <typename T>
+        bool Read(uintptr_t address, T& value) const
+        {
+            return ReadBytes(address, &value, sizeof(T)) == sizeof(T);
+        }
+
+        /**
+         * Writes a value.
+         *
+         * @return False if the value could not be written completely.
+         */
+        template <typename T>
+        bool Write(uintptr_t address, const T& value) const
+        {
+            return WriteBytes(address, &value, sizeof(T)) == sizeof(T);
+        }
+
+        /**
+         * Reads a pointer of the address space's pointer size.
+         *
+         * @return False if the pointer could not be read.
+         */
+        bool ReadPointer(uintptr_t address, uintptr_t& value) const
+        {
+            if (PointerSize() == 4)
+            {
+                uint32_t pointer;
+                if (!Read(address, pointer))
+                {
+                    return false;
+                }
+                value = pointer;
+                return true;
+            }
+            uint64_t pointer;
+            if (!Read(address, pointer))
+            {
+                return false;
+            }
+            value = static_cast<uintptr_t>(pointer);
+            return true;
+        }
+    };
+
+    /**
+     * The current process. Reads and writes are plain memory copies with no checks, exactly like
+     * dereferencing the addresses directly.
+     */
+    class LocalMemory final : public MemoryAccessor
+    {
+    public:
+        size_t ReadBytes(uintptr_t address, void* buffer, size_t size) const override
+        {
+            memcpy(buffer, reinterpret_cast<const void*>(address), size);
+            return size;
+        }
+
+        size_t WriteBytes(uintptr_t address, const void* buffer, size_t size) const override
+        {
+            memcpy(reinterpret_cast<void*>(address), buffer, size);
+            return size;
+        }
+
+        std::vector<MemoryRegion> QueryRegions(uintptr_t begin = 0, uintptr_t end = UINTPTR_MAX) const override
+        {
+            return SyxLib::QueryRegions(begin, end);
+        }
+
+        const uint8_t* Direct(uintptr_t address, size_t) const override
+        {
+            return reinterpret_cast<const uint8_t*>(address);
+        }
+
+        /**
+         * @return A shared instance; LocalMemory has no state.
+         */
+        static const LocalMemory& Instance()
+        {
+            static const LocalMemory memory;
+            return memory;
+        }
+    };
+
+    /**
+     * Another process, accessed with ReadProcessMemory/WriteProcessMemory on Windows and
+     * process_vm_readv/process_vm_writev on Linux. On Linux ReadScatter moves up to IOV_MAX
+     * pieces per system call.
+     *
+     * Attaching needs the same rights as a debugger: PROCESS_VM_READ/WRITE on Windows, ptrace
+     * access (same user and a permissive ptrace_scope, or CAP_SYS_PTRACE) on Linux.
+     *
+     * @example
+     * SyxLib::ProcessMemory game(pid);
+     * int health;
+     * if (game.IsOpen() && game.Read(0x7FF6A0001234, health)) ...
+     */
+    class ProcessMemory final : public MemoryAccessor
+    {
+    public:
+        /**
+         * Attaches to a process. Check IsOpen() for the result.
+         *
+         * @param pid Process id.
+         */
+        explicit ProcessMemory(uint32_t pid)
+            : m_pid(pid)
+        {
+#ifdef _WIN32
+            m_process = OpenProcess(PROCESS_VM_READ | PROCESS_VM_WRITE | PROCESS_VM_OPERATION | PROCESS_QUERY_INFORMATION, FALSE, pid);
+            BOOL wow64 = FALSE;
+            if (m_process && IsWow64Process(m_process, &wow64) && wow64)
+            {
+                m_pointerSize = 4;
+            }
+#elif defined(__linux__)
+            // The ELF class of the main executable tells the target's pointer size.
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%u/exe", pid);
+            if (FILE* file = fopen(path, "rb"))
+            {
+                uint8_t ident[5] = {};
+                if (fread(ident, 1, sizeof(ident), file) == sizeof(ident) && ident[4] == 1)
+                {
+                    m_pointerSize = 4;
+                }
+                fclose(file);
+                m_open = true;
+            }
+#endif
+        }
+
+        ~ProcessMemory() override
+        {
+#ifdef _WIN32
+            if (m_process)
+            {
+                CloseHandle(m_process);
+            }
+#endif
+        }
+
+        ProcessMemory(const ProcessMemory&) = delete;
+        ProcessMemory& operator=(const ProcessMemory&) = delete;
+
+        /**
+         * @return True if the process could be opened.
+         */
+        bool IsOpen() const
+        {
+#ifdef _WIN32
+            return m_process != NULL;
+#else
+            return m_open;
+#endif
+        }
+
+        uint32_t Pid() const
+        {
+            return m_pid;
+        }
+
+        size_t ReadBytes(uintptr_t address, void* buffer, size_t size) const override
+        {
+#ifdef _WIN32
+            SIZE_T read = 0;
+            if (ReadProcessMemory(m_process, reinterpret_cast<LPCVOID>(address), buffer, size, &read) || read)
+            {
+                return read;
+            }
+            // A read crossing into an unreadable page can fail as a whole; recover the readable prefix.
+            size_t done = 0;
+            while (done < size)
+            {
+                const size_t chunk = (std::min)(size - done, PAGE_BYTES - ((address + done) & (PAGE_BYTES - 1)));
+                if (!ReadProcessMemory(m_process, reinterpret_cast<LPCVOID>(address + done), static_cast<uint8_t*>(buffer) + done, chunk, &read) || read != chunk)
+                {
+                    return done + read;
+                }
+                done += chunk;
+            }
+            return done;
+#elif defined(__linux__)
+            iovec local = { buffer, size };
+            iovec remote = { reinterpret_cast<void*>(address), size };
+            const ssize_t read = process_vm_readv(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0);
+            return read > 0 ? static_cast<size_t>(read) : 0;
+#else
+            (void)address;
+            (void)buffer;
+            (void)size;
+            return 0;
+#endif
+        }
+
+        size_t WriteBytes(uintptr_t address, const void* buffer, size_t size) const override
+        {
+#ifdef _WIN32
+            SIZE_T written = 0;
+            WriteProcessMemory(m_process, reinterpret_cast<LPVOID>(address), buffer, size, &written);
+            return written;
+#elif defined(__linux__)
+            iovec local = { const_cast<void*>(buffer), size };
+            iovec remote = { reinterpret_cast<void*>(address), size };
+            const ssize_t written = process_vm_writev(static_cast<pid_t>(m_pid), &local, 1, &remote, 1, 0);
+            return written > 0 ? static_cast<size_t>(written) : 0;
+#else
+            (void)address;
+            (void)buffer;
+            (void)size;
+            return 0;
+#endif
+        }
+
+#ifdef __linux__
+        void ReadScatter(ReadRequest* requests, size_t count) const override
+        {
+            // process_vm_readv stops at the first fault; resume after the faulting piece.
+            size_t first = 0;
+            while (first < count)
+            {
+                const size_t batch = (std::min)(count - first, static_cast<size_t>(IOV_MAX));
+                std::vector<iovec> local(batch), remote(batch);
+                for (size_t i = 0; i < batch; i++)
+                {
+                    local[i] = { requests[first + i].buffer, requests[first + i].size };
+                    remote[i] = { reinterpret_cast<void*>(requests[first + i].address), requests[first + i].size };
+                }
+                const ssize_t result = process_vm_readv(static_cast<pid_t>(m_pid), local.data(), batch, remote.data(), batch, 0);
+                size_t remaining = result > 0 ? static_cast<size_t>(result) : 0;
+
+                size_t i = 0;
+                for (; i < batch && remaining >= requests[first + i].size; i++)
+                {
+                    requests[first + i].transferred = requests[first + i].size;
+                    remaining -= requests[first + i].size;
+                }
+                if (i < batch)
+                {
+                    // Partial piece: its prefix came through the batch, the tail is retried alone.
+                    ReadRequest& faulted = requests[first + i];
+                    faulted.transferred = remaining + ReadBytes(faulted.address + remaining,
+                        static_cast<uint8_t*>(faulted.buffer) + remaining, faulted.size - remaining);
+                    i++;
+                }
+                first += i;
+            }
+        }
+
+        void WriteScatter(WriteRequest* requests, size_t count) const override
+        {
+            // process_vm_writev stops at the first fault, like process_vm_readv.
+            size_t first = 0;
+            while (first < count)
+            {
+                const size_t batch = (std::min)(count - first, static_cast<size_t>(IOV_MAX));
+                std::vector<iovec> local(batch), remote(batch);
+                for (size_t i = 0; i < batch; i++)
+                {
+                    local[i] = { const_cast<void*>(requests[first + i].buffer), requests[first + i].size };
+                    remote[i] = { reinterpret_cast<void*>(requests[first + i].address), requests[first + i].size };
+                }
+                const ssize_t result = process_vm_writev(static_cast<pid_t>(m_pid), local.data(), batch, remote.data(), batch, 0);
+                size_t remaining = result > 0 ? static_cast<size_t>(result) : 0;
+
+                size_t i = 0;
+                for (; i < batch && remaining >= requests[first + i].size; i++)
+                {
+                    requests[first + i].transferred = requests[first + i].size;
+                    remaining -= requests[first + i].size;
+                }
+                if (i < batch)
+                {
+                    WriteRequest& faulted = requests[first + i];
+                    faulted.transferred = remaining + WriteBytes(faulted.address + remaining,
+                        static_cast<const uint8_t*>(faulted.buffer) + remaining, faulted.size - remaining);
+                    i++;
+                }
+                first += i;
+            }
+        }
+#endif
+
+        std::vector<MemoryRegion> QueryRegions(uintptr_t begin = 0, uintptr_t end = UINTPTR_MAX) const override
+        {
+#ifdef _WIN32
+            return Detail::QueryProcessRegions(m_process, begin, end);
+#else
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%u/maps", m_pid);
+            return Detail::QueryMapsFile(path, begin, end);
+#endif
+        }
+
+        size_t PointerSize() const override
+        {
+            return m_pointerSize;
+        }
+
+    private:
+#ifdef _WIN32
+        static constexpr size_t PAGE_BYTES = 4096;
+        HANDLE m_process = NULL;
+#else
+        bool m_open = false;
+#endif
+        uint32_t m_pid;
+        size_t m_pointerSize = sizeof(void*);
+    };
+
+    /**
+     * Follows a multi-level pointer the way Syx::WritePTR does: starting at base, each step reads
+     * the pointer at the current address and adds the next offset.
+     *
+     * @param memory The address space to read.
+     * @param base Address of the first pointer.
+     * @param offsets Offsets added after each dereference.
+     * @param address Receives the final address.
+     * @return False if a null pointer is read or a pointer cannot be read.
+     */
+    inline bool ResolvePointerChain(const MemoryAccessor& memory, uintptr_t base, const std::vector<uintptr_t>& offsets, uintptr_t& address)
+    {
+        uintptr_t current = base;
+        for (uintptr_t offset : offsets)
+        {
+            uintptr_t pointer;
+            if (!current || !memory.ReadPointer(current, pointer) || !pointer)
+            {
+                return false;
+            }
+            current = pointer + offset;
+        }
+        if (!current)
+        {
+            return false;
+        }
+        address = current;
+        return true;
+    }
+}
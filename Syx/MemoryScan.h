@@ -0,0 +1,216 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Matches.h"
+#include "Memory.h"
+#include "Regions.h"
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /** Bytes a generic scan reads per block when the memory has to be copied. */
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+    namespace Detail
+    {
+        /**
+         * Visits the readable bytes of a list of regions of any address space, in address order.
+         *
+         * Memory the accessor exposes directly is visited in place, one call per region. Other
+         * memory is copied in blocks of blockSize bytes, each extended by overlap bytes of the next
+         * block so items up to overlap + 1 bytes long are never cut; blocks of small regions are
+         * batched into a single ReadScatter. Pages that turn out to be unreadable are skipped, the
+         * readable bytes around them are visited separately.
+         *
+         * @param memory The address space.
+         * @param regions Regions sorted by base address.
+         * @param overlap Bytes shared by consecutive blocks of a region.
+         * @param blockSize Bytes per copied block.
+         * @param visit Called with (address, data, size) for each block; returning false stops.
+         * @return False if visit stopped the walk.
+         */
+        template <typename Visit>
+        inline bool ForEachBlock(const MemoryAccessor& memory, const std::vector<MemoryRegion>& regions, size_t overlap,
+            size_t blockSize, Visit&& visit)
+        {
+            static constexpr uintptr_t PAGE_BYTES = 4096;
+            struct Piece
+            {
+                uintptr_t address;
+                size_t size;
+                size_t offset;
+            };
+            const size_t pieceMax = blockSize + overlap;
+            std::vector<uint8_t> buffer;
+            std::vector<Piece> pieces;
+            std::vector<ReadRequest> requests;
+            size_t used = 0;
+            bool stop = false;
+
+            auto flush = [&]()
+            {
+                requests.resize(pieces.size());
+                for (size_t i = 0; i < pieces.size(); i++)
+                {
+                    requests[i] = { pieces[i].address, buffer.data() + pieces[i].offset, pieces[i].size, 0 };
+                }
+                memory.ReadScatter(requests.data(), requests.size());
+
+                for (size_t i = 0; i < pieces.size() && !stop; i++)
+                {
+                    const Piece& piece = pieces[i];
+                    uint8_t* data = buffer.data() + piece.offset;
+                    size_t segment = 0;
+                    size_t available = requests[i].transferred;
+                    for (;;)
+                    {
+                        if (available > overlap && !visit(piece.address + segment, static_cast<const uint8_t*>(data + segment), available))
+                        {
+                            stop = true;
+                        }
+                        if (stop || segment + available >= piece.size)
+                        {
+                            break;
+                        }
+                        // Skip the page that faulted and read the rest of the piece.
+                        const uintptr_t next = ((piece.address + segment + available) & ~(PAGE_BYTES - 1)) + PAGE_BYTES;
+                        if (next >= piece.address + piece.size)
+                        {
+                            break;
+                        }
+                        segment = next - piece.address;
+                        available = memory.ReadBytes(next, data + segment, piece.size - segment);
+                    }
+                }
+                pieces.clear();
+                used = 0;
+            };
+
+            for (const MemoryRegion& region : regions)
+            {
+                if (stop)
+                {
+                    break;
+                }
+                if (region.size <= overlap)
+                {
+                    continue;
+                }
+                if (const uint8_t* direct = memory.Direct(region.base, region.size))
+                {
+                    flush();
+                    if (!stop && !visit(region.base, direct, region.size))
+                    {
+                        stop = true;
+                    }
+                    continue;
+                }
+
+                if (buffer.empty())
+                {
+                    buffer.resize(2 * pieceMax);
+                }
+                for (uintptr_t start = region.base;; start += blockSize)
+                {
+                    const size_t left = region.base + region.size - start;
+                    const size_t size = (std::min)(left, pieceMax);
+                    if (used + size > buffer.size())
+                    {
+                        flush();
+                        if (stop)
+                        {
+                            break;
+                        }
+                    }
+                    pieces.push_back({ start, size, used });
+                    used += size;
+                    if (left <= pieceMax)
+                    {
+                        break;
+                    }
+                }
+            }
+            if (!stop)
+            {
+                flush();
+            }
+            return !stop;
+        }
+    }
+
+    /**
+     * Calls a function for every match of a pattern in a list of regions of any address space,
+     * in address order.
+     *
+     * Memory the accessor exposes directly (the current process) is scanned in place. Other
+     * memory is copied in blocks of blockSize bytes, overlapped by the pattern length so matches
+     * across block boundaries are found; blocks of small regions are batched into a single
+     * ReadScatter. Pages that turn out to be unreadable are skipped.
+     *
+     * @param memory The address space.
+     * @param scanner The compiled pattern.
+     * @param regions Regions sorted by base address, typically the output of FilterRegions.
+     * @param callback Called with the address of each match. If it returns bool, returning false stops the scan.
+     * @param limit Maximum number of matches to report.
+     * @param blockSize Bytes per copied block.
+     * @return Number of matches reported.
+     */
+    template <typename Callback>
+    inline size_t ForEachMatch(const MemoryAccessor& memory, const Scanner& scanner, const std::vector<MemoryRegion>& regions,
+        Callback&& callback, size_t limit = SIZE_MAX, size_t blockSize = DEFAULT_BLOCK_SIZE)
+    {
+        const size_t length = scanner.Length();
+        if (length == 0 || limit == 0 || blockSize == 0)
+        {
+            return 0;
+        }
+
+        size_t count = 0;
+        bool stop = false;
+        Detail::ForEachBlock(memory, regions, length - 1, blockSize, [&](uintptr_t address, const uint8_t* data, size_t size)
+        {
+            SyxLib::ForEachMatch(scanner, data, size, [&](size_t offset)
+            {
+                count++;
+                stop = !Detail::InvokeMatchCallback(callback, address + offset) || count >= limit;
+                return !stop;
+            });
+            return !stop;
+        });
+        return count;
+    }
+
+    /**
+     * Finds the lowest match of a pattern across a list of regions of any address space.
+     *
+     * @param memory The address space.
+     * @param scanner The compiled pattern.
+     * @param regions Regions sorted by base address.
+     * @return The address of the first match, or 0 if not found.
+     */
+    inline uintptr_t FindInRegions(const MemoryAccessor& memory, const Scanner& scanner, const std::vector<MemoryRegion>& regions)
+    {
+        uintptr_t found = 0;
+        ForEachMatch(memory, scanner, regions, [&](uintptr_t address) { found = address; }, 1);
+        return found;
+    }
+
+    /**
+     * Finds the lowest match of a pattern in an address range of any address space. Only the
+     * committed regions the filter accepts are read, so holes in the range cost nothing.
+     *
+     * @param memory The address space.
+     * @param scanner The compiled pattern.
+     * @param begin Start of the range.
+     * @param size Size of the range.
+     * @param filter Regions to scan, readable memory by default.
+     * @return The address of the first match, or 0 if not found.
+     */
+    inline uintptr_t FindPattern(const MemoryAccessor& memory, const Scanner& scanner, uintptr_t begin, size_t size,
+        const RegionFilter& filter = {})
+    {
+        const uintptr_t end = size > UINTPTR_MAX - begin ? UINTPTR_MAX : begin + size;
+        return FindInRegions(memory, scanner, FilterRegions(memory.QueryRegions(begin, end), filter));
+    }
+}
@@ -0,0 +1,686 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "Memory.h"
+#include "PointerChain.h"
+
+namespace SyxLib
+{
+    /** Largest value, in bytes, a MemoryWatch entry can freeze or watch. */
+    constexpr size_t WATCH_VALUE_BYTES = 16;
+
+    /**
+     * A change of a watched value, reported by MemoryWatch::Poll.
+     */
+    struct WatchEvent
+    {
+        /** Id returned by MemoryWatch::Watch. */
+        uint32_t id;
+        /** Address the value was read from. */
+        uintptr_t address;
+        uint32_t size;
+        uint8_t previous[WATCH_VALUE_BYTES];
+        uint8_t current[WATCH_VALUE_BYTES];
+
+        template <typename T>
+        T Previous() const
+        {
+            static_assert(sizeof(T) <= WATCH_VALUE_BYTES, "Value is larger than WATCH_VALUE_BYTES.");
+            T value;
+            memcpy(&value, previous, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        T Current() const
+        {
+            static_assert(sizeof(T) <= WATCH_VALUE_BYTES, "Value is larger than WATCH_VALUE_BYTES.");
+            T value;
+            memcpy(&value, current, sizeof(T));
+            return value;
+        }
+    };
+
+    /**
+     * Tuning for MemoryWatch.
+     */
+    struct WatchOptions
+    {
+        /** Length of one timer wheel tick. Periods are rounded up to whole ticks. */
+        std::chrono::microseconds resolution{ 1000 };
+        /** Capacity of the change queue, rounded up to a power of two. Changes are dropped while it is full. */
+        size_t queueCapacity = 4096;
+    };
+
+    namespace Detail
+    {
+        /**
+         * Bounded lock-free queue for one producer thread and one consumer thread.
+         */
+        template <typename T>
+        class SpscQueue
+        {
+        public:
+            explicit SpscQueue(size_t capacity)
+            {
+                size_t size = 1;
+                while (size < capacity)
+                {
+                    size <<= 1;
+                }
+                m_items.resize(size);
+                m_mask = size - 1;
+            }
+
+            /**
+             * @return False if the queue is full.
+             */
+            bool TryPush(const T& item)
+            {
+                const size_t tail = m_tail.load(std::memory_order_relaxed);
+                if (tail - m_head.load(std::memory_order_acquire) == m_items.size())
+                {
+                    return false;
+                }
+                m_items[tail & m_mask] = item;
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @return False if the queue is empty.
+             */
+            bool TryPop(T& item)
+            {
+                const size_t head = m_head.load(std::memory_order_relaxed);
+                if (head == m_tail.load(std::memory_order_acquire))
+                {
+                    return false;
+                }
+                item = m_items[head & m_mask];
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            std::vector<T> m_items;
+            size_t m_mask = 0;
+            alignas(64) std::atomic<size_t> m_head{ 0 };
+            alignas(64) std::atomic<size_t> m_tail{ 0 };
+        };
+    }
+
+    /**
+     * Keeps values frozen and reports changes of watched values, serviced by one scheduler thread.
+     *
+     * Entries are registered with an address or a PointerChain, a value type and a period. A hashed
+     * timer wheel (one slot per tick) finds the entries due each tick without looking at the others,
+     * and everything due at once is serviced as one batch: chains are resolved from their cache
+     * (walked again only after Refresh() or a failed access), entries are sorted by address so
+     * values on the same page are handled together, frozen values go out in one WriteScatter and
+     * watched values come in with one ReadScatter. Changes of watched values are pushed to a
+     * lock-free single-producer, single-consumer queue read with Poll().
+     *
+     * Registration and removal may be called from any thread; they are queued and applied by the
+     * scheduler at its next tick. Poll() must only be called from one thread at a time.
+     *
+     * @example
+     * SyxLib::MemoryWatch watch;
+     * watch.Freeze(SyxLib::PointerChain(moduleBase + 0x1234, { 0x10, 0x4C }, 1), 100, std::chrono::milliseconds(10));
+     * uint32_t ammo = watch.Watch<int>(ammoAddress, std::chrono::milliseconds(50));
+     * watch.Start();
+     * SyxLib::WatchEvent event;
+     * while (watch.Poll(event)) ...
+     */
+    class MemoryWatch
+    {
+    public:
+        /** Never returned for a valid entry. */
+        static constexpr uint32_t INVALID_ID = 0;
+
+        /**
+         * @param memory The address space to access; must outlive the MemoryWatch.
+         * @param options Tick length and queue capacity.
+         */
+        explicit MemoryWatch(const MemoryAccessor& memory = LocalMemory::Instance(), const WatchOptions& options = WatchOptions())
+            : m_memory(memory), m_resolution((std::max)(options.resolution, std::chrono::microseconds(1))), m_events(options.queueCapacity),
+              m_start(std::chrono::steady_clock::now()), m_wheel(WHEEL_SLOTS)
+        {
+        }
+
+        ~MemoryWatch()
+        {
+            Stop();
+        }
+
+        MemoryWatch(const MemoryWatch&) = delete;
+        MemoryWatch& operator=(const MemoryWatch&) = delete;
+
+        /**
+         * Writes a value to an address every period.
+         *
+         * @return Id of the entry.
+         */
+        template <typename T>
+        uint32_t Freeze(uintptr_t address, const T& value, std::chrono::microseconds period)
+        {
+            return Add<T>(true, address, nullptr, &value, period);
+        }
+
+        /**
+         * Writes a value to the end of a chain every period.
+         *
+         * @return Id of the entry.
+         */
+        template <typename T>
+        uint32_t Freeze(const PointerChain& chain, const T& value, std::chrono::microseconds period)
+        {
+            return Add<T>(true, 0, &chain, &value, period);
+        }
+
+        /**
+         * Reads a value every period and reports each change to Poll(). The first read sets the
+         * baseline and is not reported.
+         *
+         * @return Id of the entry.
+         */
+        template <typename T>
+        uint32_t Watch(uintptr_t address, std::chrono::microseconds period)
+        {
+            return Add<T>(false, address, nullptr, nullptr, period);
+        }
+
+        /**
+         * Reads the value at the end of a chain every period and reports each change to Poll().
+         *
+         * @return Id of the entry.
+         */
+        template <typename T>
+        uint32_t Watch(const PointerChain& chain, std::chrono::microseconds period)
+        {
+            return Add<T>(false, 0, &chain, nullptr, period);
+        }
+
+        /**
+         * Changes the value a frozen entry writes.
+         *
+         * @return False if id is not a frozen entry of this type's size.
+         */
+        template <typename T>
+        bool SetValue(uint32_t id, const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Frozen values must be trivially copyable.");
+            static_assert(sizeof(T) <= WATCH_VALUE_BYTES, "Value is larger than WATCH_VALUE_BYTES.");
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto live = m_live.find(id);
+            if (live == m_live.end() || !live->second.freeze || live->second.size != sizeof(T))
+            {
+                return false;
+            }
+            Command command;
+            command.kind = Command::SET;
+            command.entry.id = id;
+            memcpy(command.entry.value, &value, sizeof(T));
+            PushCommand(static_cast<Command&&>(command));
+            return true;
+        }
+
+        /**
+         * Stops servicing an entry.
+         *
+         * @return False if id is unknown.
+         */
+        bool Remove(uint32_t id)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_live.erase(id))
+            {
+                return false;
+            }
+            Command command;
+            command.kind = Command::REMOVE;
+            command.entry.id = id;
+            PushCommand(static_cast<Command&&>(command));
+            return true;
+        }
+
+        /**
+         * @return Number of registered entries.
+         */
+        size_t Count() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_live.size();
+        }
+
+        /**
+         * Makes every chain walk again at its next service, after objects may have moved.
+         */
+        void Refresh()
+        {
+            m_generation.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Starts the scheduler thread.
+         *
+         * @return False if it is already running.
+         */
+        bool Start()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_thread.joinable())
+            {
+                return false;
+            }
+            m_stop = false;
+            m_thread = std::thread([this] { Run(); });
+            return true;
+        }
+
+        /**
+         * Stops the scheduler thread and waits for it. Entries stay registered.
+         */
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            if (m_thread.joinable() && m_thread.get_id() != std::this_thread::get_id())
+            {
+                m_thread.join();
+            }
+        }
+
+        bool IsRunning() const
+        {
+            return m_thread.joinable();
+        }
+
+        /**
+         * Services every entry due by now on the calling thread, for callers that drive the
+         * watch from their own loop instead of Start().
+         */
+        void Tick()
+        {
+            std::lock_guard<std::mutex> lock(m_serviceMutex);
+            Service(CurrentTick());
+        }
+
+        /**
+         * Takes the oldest change notification.
+         *
+         * @return False if there is none.
+         */
+        bool Poll(WatchEvent& event)
+        {
+            return m_events.TryPop(event);
+        }
+
+        /**
+         * @return Number of change notifications dropped because the queue was full.
+         */
+        uint64_t Dropped() const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr size_t WHEEL_SLOTS = 512;
+        static constexpr uint64_t NEVER = UINT64_MAX;
+
+        /** Everything a service touches, kept small; the chain of an entry lives in m_chains. */
+        struct Entry
+        {
+            uint64_t due = 0;
+            uint64_t period = 1;
+            /** Fixed address, or the last address the chain resolved to. */
+            uintptr_t address = 0;
+            /** INVALID_ID for a free slot of m_entries. */
+            uint32_t id = INVALID_ID;
+            uint8_t size = 0;
+            bool freeze = false;
+            bool hasChain = false;
+            /** Removed while still linked in the wheel; freed when its slot is next visited. */
+            bool removed = false;
+            /** A watched entry holds a baseline value. */
+            bool seen = false;
+            /** Value to write (freeze) or last value read (watch). */
+            uint8_t value[WATCH_VALUE_BYTES] = {};
+        };
+
+        struct Command
+        {
+            enum Kind
+            {
+                ADD,
+                REMOVE,
+                SET
+            };
+            Kind kind = ADD;
+            Entry entry;
+            PointerChain chain;
+        };
+
+        /** Registered entry as seen by the registering threads. */
+        struct LiveEntry
+        {
+            uint32_t size;
+            bool freeze;
+        };
+
+        template <typename T>
+        uint32_t Add(bool freeze, uintptr_t address, const PointerChain* chain, const T* value, std::chrono::microseconds period)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Watched values must be trivially copyable.");
+            static_assert(sizeof(T) <= WATCH_VALUE_BYTES, "Value is larger than WATCH_VALUE_BYTES.");
+            Command command;
+            Entry& entry = command.entry;
+            entry.size = static_cast<uint8_t>(sizeof(T));
+            entry.freeze = freeze;
+            entry.hasChain = chain != nullptr;
+            entry.period = (std::max)(static_cast<uint64_t>((period.count() + m_resolution.count() - 1) / m_resolution.count()), uint64_t(1));
+            entry.address = address;
+            if (chain)
+            {
+                command.chain = *chain;
+            }
+            if (value)
+            {
+                memcpy(entry.value, value, sizeof(T));
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            entry.id = m_nextId++;
+            m_live[entry.id] = { entry.size, freeze };
+            const uint32_t id = entry.id;
+            PushCommand(static_cast<Command&&>(command));
+            return id;
+        }
+
+        /** Queues a command for the scheduler. m_mutex must be held. */
+        void PushCommand(Command&& command)
+        {
+            m_commands.push_back(static_cast<Command&&>(command));
+            m_hasCommands.store(true, std::memory_order_release);
+            m_wake.notify_one();
+        }
+
+        uint64_t CurrentTick() const
+        {
+            return static_cast<uint64_t>((std::chrono::steady_clock::now() - m_start) / m_resolution);
+        }
+
+        void Schedule(uint32_t index, uint64_t due)
+        {
+            m_entries[index].due = due;
+            m_wheel[due & (WHEEL_SLOTS - 1)].push_back(index);
+        }
+
+        void ApplyCommands(uint64_t now)
+        {
+            if (!m_hasCommands.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending.swap(m_commands);
+                m_hasCommands.store(false, std::memory_order_relaxed);
+            }
+
+            for (Command& command : m_pending)
+            {
+                if (command.kind == Command::ADD)
+                {
+                    uint32_t index;
+                    if (m_free.empty())
+                    {
+                        index = static_cast<uint32_t>(m_entries.size());
+                        m_entries.emplace_back();
+                        m_chains.emplace_back();
+                    }
+                    else
+                    {
+                        index = m_free.back();
+                        m_free.pop_back();
+                    }
+                    m_entries[index] = command.entry;
+                    m_chains[index] = static_cast<PointerChain&&>(command.chain);
+                    m_index[m_entries[index].id] = index;
+                    // New entries are serviced at the next slot the sweep visits.
+                    Schedule(index, (std::max)(now, m_next));
+                    continue;
+                }
+
+                auto found = m_index.find(command.entry.id);
+                if (found == m_index.end())
+                {
+                    continue;
+                }
+                Entry& entry = m_entries[found->second];
+                if (command.kind == Command::SET)
+                {
+                    memcpy(entry.value, command.entry.value, entry.size);
+                }
+                else
+                {
+                    entry.removed = true;
+                    m_index.erase(found);
+                }
+            }
+            m_pending.clear();
+        }
+
+        /** Services the entries due at or before tick now. m_serviceMutex must be held. */
+        void Service(uint64_t now)
+        {
+            ApplyCommands(now);
+
+            // Visit each slot the clock passed since the last service; after a full turn every slot has been seen.
+            m_batch.clear();
+            for (uint64_t tick = m_next; tick <= now && tick - m_next < WHEEL_SLOTS; tick++)
+            {
+                std::vector<uint32_t>& slot = m_wheel[tick & (WHEEL_SLOTS - 1)];
+                size_t kept = 0;
+                for (uint32_t index : slot)
+                {
+                    Entry& entry = m_entries[index];
+                    if (entry.removed)
+                    {
+                        entry = Entry();
+                        m_chains[index] = PointerChain();
+                        m_free.push_back(index);
+                    }
+                    else if (entry.due <= now)
+                    {
+                        m_batch.push_back(index);
+                    }
+                    else
+                    {
+                        slot[kept++] = index;
+                    }
+                }
+                slot.resize(kept);
+            }
+            m_next = (std::max)(m_next, now + 1);
+            if (m_batch.empty())
+            {
+                return;
+            }
+
+            // Order the batch by address so entries on one page are accessed together.
+            // Batches rescheduled together come back in order, so the sort is usually skipped.
+            const uint64_t generation = m_generation.load(std::memory_order_relaxed);
+            bool sorted = true;
+            uintptr_t previous = 0;
+            for (uint32_t index : m_batch)
+            {
+                Entry& entry = m_entries[index];
+                if (entry.hasChain && !m_chains[index].Resolve(m_memory, entry.address, generation))
+                {
+                    entry.address = 0;
+                }
+                sorted = sorted && entry.address >= previous;
+                previous = entry.address;
+            }
+            if (!sorted)
+            {
+                std::sort(m_batch.begin(), m_batch.end(), [this](uint32_t a, uint32_t b) { return m_entries[a].address < m_entries[b].address; });
+            }
+
+            m_writes.clear();
+            m_reads.clear();
+            m_readBuffer.resize(m_batch.size() * WATCH_VALUE_BYTES);
+            for (size_t i = 0; i < m_batch.size(); i++)
+            {
+                const Entry& entry = m_entries[m_batch[i]];
+                if (!entry.address)
+                {
+                    continue;
+                }
+                if (entry.freeze)
+                {
+                    m_writes.push_back({ entry.address, entry.value, entry.size, 0 });
+                }
+                else
+                {
+                    m_reads.push_back({ entry.address, &m_readBuffer[i * WATCH_VALUE_BYTES], entry.size, 0 });
+                }
+            }
+            if (!m_writes.empty())
+            {
+                m_memory.WriteScatter(m_writes.data(), m_writes.size());
+            }
+            if (!m_reads.empty())
+            {
+                m_memory.ReadScatter(m_reads.data(), m_reads.size());
+            }
+
+            size_t write = 0;
+            size_t read = 0;
+            for (size_t i = 0; i < m_batch.size(); i++)
+            {
+                Entry& entry = m_entries[m_batch[i]];
+                if (entry.address)
+                {
+                    const bool ok = entry.freeze ? m_writes[write++].transferred == entry.size : m_reads[read++].transferred == entry.size;
+                    if (!ok)
+                    {
+                        m_chains[m_batch[i]].Invalidate();
+                    }
+                    else if (!entry.freeze)
+                    {
+                        Compare(entry, &m_readBuffer[i * WATCH_VALUE_BYTES]);
+                    }
+                }
+                // Keep the cadence, but never schedule into the past after a stall.
+                Schedule(m_batch[i], (std::max)(entry.due + entry.period, now + 1));
+            }
+        }
+
+        void Compare(Entry& entry, const uint8_t* current)
+        {
+            if (entry.seen && memcmp(entry.value, current, entry.size) != 0)
+            {
+                WatchEvent event = {};
+                event.id = entry.id;
+                event.address = entry.address;
+                event.size = entry.size;
+                memcpy(event.previous, entry.value, entry.size);
+                memcpy(event.current, current, entry.size);
+                if (!m_events.TryPush(event))
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            memcpy(entry.value, current, entry.size);
+            entry.seen = true;
+        }
+
+        /** @return First tick after now whose wheel slot holds an entry, NEVER if the wheel is empty. */
+        uint64_t NextDue(uint64_t now) const
+        {
+            for (uint64_t tick = now + 1; tick <= now + WHEEL_SLOTS; tick++)
+            {
+                if (!m_wheel[tick & (WHEEL_SLOTS - 1)].empty())
+                {
+                    return tick;
+                }
+            }
+            return NEVER;
+        }
+
+        void Run()
+        {
+            for (;;)
+            {
+                uint64_t next;
+                {
+                    std::lock_guard<std::mutex> lock(m_serviceMutex);
+                    const uint64_t now = CurrentTick();
+                    Service(now);
+                    next = NextDue(now);
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                auto woken = [this] { return m_stop || !m_commands.empty(); };
+                if (next == NEVER)
+                {
+                    m_wake.wait(lock, woken);
+                }
+                else
+                {
+                    m_wake.wait_until(lock, m_start + m_resolution * next, woken);
+                }
+                if (m_stop)
+                {
+                    return;
+                }
+            }
+        }
+
+        const MemoryAccessor& m_memory;
+        const std::chrono::microseconds m_resolution;
+        Detail::SpscQueue<WatchEvent> m_events;
+        std::atomic<uint64_t> m_dropped{ 0 };
+        std::atomic<uint64_t> m_generation{ 1 };
+        const std::chrono::steady_clock::time_point m_start;
+
+        // Shared with the registering threads, guarded by m_mutex.
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::vector<Command> m_commands;
+        std::atomic<bool> m_hasCommands{ false };
+        std::unordered_map<uint32_t, LiveEntry> m_live;
+        uint32_t m_nextId = 1;
+        bool m_stop = false;
+        std::thread m_thread;
+
+        // Scheduler state, guarded by m_serviceMutex.
+        std::mutex m_serviceMutex;
+        std::vector<Entry> m_entries;
+        std::vector<PointerChain> m_chains;
+        std::vector<uint32_t> m_free;
+        std::unordered_map<uint32_t, uint32_t> m_index;
+        std::vector<std::vector<uint32_t>> m_wheel;
+        uint64_t m_next = 0;
+        std::vector<Command> m_pending;
+        std::vector<uint32_t> m_batch;
+        std::vector<WriteRequest> m_writes;
+        std::vector<ReadRequest> m_reads;
+        std::vector<uint8_t> m_readBuffer;
+    };
+}
@@ -0,0 +1,582 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Hash.h"
+#include "Image.h"
+#include "MappedFile.h"
+#include "Scanner.h"
+#include "SignatureCache.h"
+
+namespace SyxLib
+{
+    /** A run of changed bytes, page granular. */
+    struct ChangedRange
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    /**
+     * The pages that differ between two builds of a module, as sorted, merged ranges of image
+     * offsets (RVAs for loaded modules, file offsets for files). A page present on only one side
+     * counts as changed.
+     */
+    struct SnapshotDiff
+    {
+        std::vector<ChangedRange> changed;
+        /** Module keys (see ComputeModuleKey) of the older and the newer build. */
+        uint64_t previousKey = 0;
+        uint64_t currentKey = 0;
+        /** Pages compared, counting pages present on either side once. */
+        size_t pages = 0;
+        size_t changedPages = 0;
+
+        bool Empty() const
+        {
+            return changed.empty();
+        }
+
+        /**
+         * @return True if [offset, offset + size) overlaps a changed range.
+         */
+        bool Intersects(uint64_t offset, uint64_t size) const
+        {
+            auto it = std::upper_bound(changed.begin(), changed.end(), offset, [](uint64_t value, const ChangedRange& range)
+            {
+                return value < range.offset;
+            });
+            if (it != changed.begin() && std::prev(it)->offset + std::prev(it)->size > offset)
+            {
+                return true;
+            }
+            return it != changed.end() && it->offset < offset + size;
+        }
+    };
+
+    namespace Detail
+    {
+        /**
+         * Offsets of the pages covered by the sections of an image, or by the whole buffer if it is
+         * not one. Writable sections of a loaded module are left out: they change while it runs.
+         */
+        inline std::vector<uint64_t> ImagePages(const uint8_t* image, size_t size, bool mapped, size_t pageBytes)
+        {
+            std::vector<uint64_t> pages;
+            std::vector<ImageSection> sections;
+            if (!ParseImageSections(image, size, sections) || sections.empty())
+            {
+                sections.assign(1, ImageSection{ "DATA", 0, size, 0, size, 0 });
+            }
+            for (const ImageSection& section : sections)
+            {
+                if (mapped && (section.protection & PROTECT_WRITE))
+                {
+                    continue;
+                }
+                const uint64_t begin = mapped ? section.virtualAddress : section.fileOffset;
+                const uint64_t end = (std::min)(begin + (mapped ? section.virtualSize : section.fileSize), uint64_t(size));
+                for (uint64_t page = begin - begin % pageBytes; page < end; page += pageBytes)
+                {
+                    pages.push_back(page);
+                }
+            }
+            std::sort(pages.begin(), pages.end());
+            pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+            return pages;
+        }
+
+        /** ComputeModuleKey, plus the content for buffers that are not images and have no code sections to hash. */
+        inline uint64_t SnapshotKey(const uint8_t* image, size_t size, bool mapped)
+        {
+            const uint64_t key = ComputeModuleKey(image, size, mapped);
+            std::vector<ImageSection> sections;
+            return ParseImageSections(image, size, sections) ? key : Hash64(image, size, key);
+        }
+
+        inline void AddChangedPage(SnapshotDiff& diff, uint64_t offset, uint64_t size)
+        {
+            diff.changedPages++;
+            if (!diff.changed.empty() && diff.changed.back().offset + diff.changed.back().size == offset)
+            {
+                diff.changed.back().size += size;
+                return;
+            }
+            diff.changed.push_back({ offset, size });
+        }
+    }
+
+    /**
+     * A copy of a module's sections in a memory-mapped file, with an XXH64 hash of every 4 KB page.
+     *
+     * Comparing the page hashes of a snapshot with a newer build (a live module or another
+     * snapshot) yields the pages an update changed, so cached signature results outside them can
+     * be reused instead of rescanning the whole module; see RevalidateMatch and FindRevalidated.
+     * Loaded modules are captured in their mapped layout without their writable sections, which
+     * hold no stable signatures; files on disk are captured whole, in their file layout.
+     *
+     * File layout: header, section table, one (offset, hash) entry per page sorted by offset, then
+     * the page contents at 4 KB alignment.
+     *
+     * @example
+     * SyxLib::ModuleSnapshot snapshot;
+     * SyxLib::SnapshotDiff diff;
+     * if (snapshot.Open("game.snap") && SyxLib::DiffSnapshot(snapshot, base, size, diff))
+     *     printf("%zu of %zu pages changed\n", diff.changedPages, diff.pages);
+     * snapshot.Capture("game.snap", base, size);
+     */
+    class ModuleSnapshot
+    {
+    public:
+        static constexpr size_t PAGE_BYTES = 4096;
+
+        ModuleSnapshot() = default;
+
+        /**
+         * Writes a snapshot of an image and opens it.
+         *
+         * @param path File to write; an existing file is replaced. It must not be open in another
+         *             ModuleSnapshot, whose mapping would change underneath it.
+         * @param image Start of the image.
+         * @param size SizeOfImage for a loaded module, the file size for a file.
+         * @param mapped True for a module laid out as loaded, false for a file image.
+         * @return False if the file cannot be written.
+         */
+        bool Capture(const std::string& path, const uint8_t* image, size_t size, bool mapped = true)
+        {
+            m_file.Close();
+            const std::vector<uint64_t> pages = Detail::ImagePages(image, size, mapped, PAGE_BYTES);
+            std::vector<ImageSection> sections;
+            ParseImageSections(image, size, sections);
+
+            const size_t dataStart = DataStart(sections.size(), pages.size());
+            if (!m_file.Open(path, MappedFile::READ_WRITE) || !m_file.Resize(dataStart + pages.size() * PAGE_BYTES))
+            {
+                return false;
+            }
+            memset(m_file.Data(), 0, dataStart);
+
+            Header* header = GetHeader();
+            header->magic = MAGIC;
+            header->version = VERSION;
+            header->mapped = mapped ? 1 : 0;
+            header->sectionCount = static_cast<uint32_t>(sections.size());
+            header->imageSize = size;
+            header->pageCount = pages.size();
+            header->moduleKey = Detail::SnapshotKey(image, size, mapped);
+
+            Section* table = GetSections();
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                const ImageSection& section = sections[i];
+                memcpy(table[i].name, section.name.c_str(), (std::min)(section.name.size(), sizeof(table[i].name) - 1));
+                table[i].virtualAddress = section.virtualAddress;
+                table[i].virtualSize = section.virtualSize;
+                table[i].fileOffset = section.fileOffset;
+                table[i].fileSize = section.fileSize;
+                table[i].protection = section.protection;
+            }
+
+            Page* entries = GetPages();
+            uint8_t* data = m_file.Data() + dataStart;
+            for (size_t i = 0; i < pages.size(); i++)
+            {
+                const size_t length = static_cast<size_t>((std::min)(uint64_t(PAGE_BYTES), size - pages[i]));
+                memcpy(data + i * PAGE_BYTES, image + pages[i], length);
+                memset(data + i * PAGE_BYTES + length, 0, PAGE_BYTES - length);
+                entries[i].offset = pages[i];
+                entries[i].hash = Hash64(image + pages[i], length);
+            }
+            return true;
+        }
+
+        /**
+         * Writes a snapshot of a file on disk, laid out as in the file.
+         */
+        bool CaptureFile(const std::string& path, const std::string& file)
+        {
+            MappedFile source;
+            if (!source.Open(file, MappedFile::READ_ONLY))
+            {
+                return false;
+            }
+            static const uint8_t empty = 0;
+            return Capture(path, source.Data() ? source.Data() : &empty, source.Size(), false);
+        }
+
+        /**
+         * Opens a snapshot read-only.
+         *
+         * @return False if the file is missing or not a valid snapshot.
+         */
+        bool Open(const std::string& path)
+        {
+            if (!m_file.Open(path, MappedFile::READ_ONLY))
+            {
+                return false;
+            }
+            if (!IsValid())
+            {
+                m_file.Close();
+                return false;
+            }
+            return true;
+        }
+
+        bool IsOpen() const
+        {
+            return m_file.IsOpen() && m_file.Data();
+        }
+
+        /**
+         * @return Key of the captured build, comparable with ComputeModuleKey and SignatureCache::ModuleKey.
+         */
+        uint64_t ModuleKey() const
+        {
+            return IsOpen() ? GetHeader()->moduleKey : 0;
+        }
+
+        uint64_t ImageSize() const
+        {
+            return IsOpen() ? GetHeader()->imageSize : 0;
+        }
+
+        /**
+         * @return True if offsets are RVAs of a loaded module, false if they are file offsets.
+         */
+        bool IsMapped() const
+        {
+            return IsOpen() && GetHeader()->mapped;
+        }
+
+        std::vector<ImageSection> Sections() const
+        {
+            std::vector<ImageSection> sections;
+            for (size_t i = 0; IsOpen() && i < GetHeader()->sectionCount; i++)
+            {
+                const Section& section = GetSections()[i];
+                sections.push_back({ std::string(section.name, strnlen(section.name, sizeof(section.name))), section.virtualAddress,
+                    section.virtualSize, section.fileOffset, section.fileSize, section.protection });
+            }
+            return sections;
+        }
+
+        size_t PageCount() const
+        {
+            return IsOpen() ? static_cast<size_t>(GetHeader()->pageCount) : 0;
+        }
+
+        /**
+         * @return Image offset of a page, in ascending order of index.
+         */
+        uint64_t PageOffset(size_t index) const
+        {
+            return GetPages()[index].offset;
+        }
+
+        uint64_t PageHash(size_t index) const
+        {
+            return GetPages()[index].hash;
+        }
+
+        /**
+         * @return The captured bytes of a page; a page past the end of the image is zero-filled.
+         */
+        const uint8_t* PageData(size_t index) const
+        {
+            return m_file.Data() + DataStart(GetHeader()->sectionCount, PageCount()) + index * PAGE_BYTES;
+        }
+
+    private:
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t mapped;
+            uint32_t sectionCount;
+            uint64_t imageSize;
+            uint64_t pageCount;
+            uint64_t moduleKey;
+            uint64_t reserved[3];
+        };
+
+        struct Section
+        {
+            char name[16];
+            uint64_t virtualAddress;
+            uint64_t virtualSize;
+            uint64_t fileOffset;
+            uint64_t fileSize;
+            uint32_t protection;
+            uint32_t reserved;
+        };
+
+        struct Page
+        {
+            uint64_t offset;
+            uint64_t hash;
+        };
+
+        static constexpr uint32_t MAGIC = 0x53585953; // "SYXS"
+        static constexpr uint32_t VERSION = 1;
+
+        static size_t DataStart(size_t sectionCount, size_t pageCount)
+        {
+            const size_t tables = sizeof(Header) + sectionCount * sizeof(Section) + pageCount * sizeof(Page);
+            return (tables + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+        }
+
+        Header* GetHeader()
+        {
+            return reinterpret_cast<Header*>(m_file.Data());
+        }
+
+        const Header* GetHeader() const
+        {
+            return reinterpret_cast<const Header*>(m_file.Data());
+        }
+
+        Section* GetSections()
+        {
+            return reinterpret_cast<Section*>(m_file.Data() + sizeof(Header));
+        }
+
+        const Section* GetSections() const
+        {
+            return reinterpret_cast<const Section*>(m_file.Data() + sizeof(Header));
+        }
+
+        Page* GetPages()
+        {
+            return reinterpret_cast<Page*>(GetSections() + GetHeader()->sectionCount);
+        }
+
+        const Page* GetPages() const
+        {
+            return reinterpret_cast<const Page*>(GetSections() + GetHeader()->sectionCount);
+        }
+
+        bool IsValid() const
+        {
+            if (m_file.Size() < sizeof(Header))
+            {
+                return false;
+            }
+            const Header* header = GetHeader();
+            if (header->magic != MAGIC || header->version != VERSION || header->sectionCount > 4096 ||
+                header->pageCount > m_file.Size() / PAGE_BYTES)
+            {
+                return false;
+            }
+            const size_t pageCount = static_cast<size_t>(header->pageCount);
+            if (m_file.Size() != DataStart(header->sectionCount, pageCount) + pageCount * PAGE_BYTES)
+            {
+                return false;
+            }
+            const Page* pages = GetPages();
+            for (size_t i = 1; i < pageCount; i++)
+            {
+                if (pages[i].offset <= pages[i - 1].offset)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        MappedFile m_file;
+    };
+
+    /**
+     * Compares two snapshots of the same module page by page.
+     *
+     * @return False if a snapshot is not open or the two use different layouts (mapped and file).
+     */
+    inline bool DiffSnapshots(const ModuleSnapshot& previous, const ModuleSnapshot& current, SnapshotDiff& diff)
+    {
+        diff = SnapshotDiff();
+        if (!previous.IsOpen() || !current.IsOpen() || previous.IsMapped() != current.IsMapped())
+        {
+            return false;
+        }
+        diff.previousKey = previous.ModuleKey();
+        diff.currentKey = current.ModuleKey();
+        const size_t count = previous.PageCount();
+        const size_t currentCount = current.PageCount();
+        size_t i = 0, j = 0;
+        while (i < count || j < currentCount)
+        {
+            const uint64_t a = i < count ? previous.PageOffset(i) : UINT64_MAX;
+            const uint64_t b = j < currentCount ? current.PageOffset(j) : UINT64_MAX;
+            diff.pages++;
+            if (a == b)
+            {
+                if (previous.PageHash(i) != current.PageHash(j))
+                {
+                    Detail::AddChangedPage(diff, a, ModuleSnapshot::PAGE_BYTES);
+                }
+                i++;
+                j++;
+            }
+            else
+            {
+                Detail::AddChangedPage(diff, (std::min)(a, b), ModuleSnapshot::PAGE_BYTES);
+                (a < b ? i : j)++;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Compares a snapshot with the current contents of an image, hashing only the image's pages.
+     *
+     * @param previous The older snapshot.
+     * @param image Start of the image, laid out like the snapshot (loaded module or file).
+     * @param size SizeOfImage or file size.
+     * @return False if the snapshot is not open.
+     */
+    inline bool DiffSnapshot(const ModuleSnapshot& previous, const uint8_t* image, size_t size, SnapshotDiff& diff)
+    {
+        diff = SnapshotDiff();
+        if (!previous.IsOpen())
+        {
+            return false;
+        }
+        const bool mapped = previous.IsMapped();
+        const std::vector<uint64_t> pages = Detail::ImagePages(image, size, mapped, ModuleSnapshot::PAGE_BYTES);
+        diff.previousKey = previous.ModuleKey();
+        diff.currentKey = Detail::SnapshotKey(image, size, mapped);
+        const size_t count = previous.PageCount();
+        size_t i = 0, j = 0;
+        while (i < count || j < pages.size())
+        {
+            const uint64_t a = i < count ? previous.PageOffset(i) : UINT64_MAX;
+            const uint64_t b = j < pages.size() ? pages[j] : UINT64_MAX;
+            diff.pages++;
+            if (a == b)
+            {
+                const size_t length = static_cast<size_t>((std::min)(uint64_t(ModuleSnapshot::PAGE_BYTES), size - b));
+                if (previous.PageHash(i) != Hash64(image + b, length))
+                {
+                    Detail::AddChangedPage(diff, a, ModuleSnapshot::PAGE_BYTES);
+                }
+                i++;
+                j++;
+            }
+            else
+            {
+                Detail::AddChangedPage(diff, (std::min)(a, b), ModuleSnapshot::PAGE_BYTES);
+                (a < b ? i : j)++;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * The RevalidateMatch below for an image with unmapped gaps: only its readable spans are read.
+     *
+     * @param scanner The compiled pattern.
+     * @param base Start of the newer build; offsets are relative to it.
+     * @param spans Readable spans of the newer build sorted by address, see FindInSpans.
+     * @param previous First match in the older build, or NOT_FOUND if it had none.
+     * @param diff Changed pages between the builds.
+     * @return Offset of the first match in the newer build, or NOT_FOUND.
+     */
+    inline size_t RevalidateMatch(const Scanner& scanner, const uint8_t* base, const std::vector<ByteSpan>& spans, size_t previous, const SnapshotDiff& diff)
+    {
+        const size_t length = scanner.Length();
+        if (length == 0)
+        {
+            return NOT_FOUND;
+        }
+        const uint64_t reach = length - 1;
+        for (const ChangedRange& range : diff.changed)
+        {
+            const uint64_t begin = range.offset > reach ? range.offset - reach : 0;
+            if (previous != NOT_FOUND && begin >= previous)
+            {
+                break;
+            }
+            const uint64_t end = (std::min)(range.offset + range.size + reach, uint64_t(SIZE_MAX));
+            const size_t found = FindInSpans(scanner, base, spans, static_cast<size_t>(begin), static_cast<size_t>(end));
+            if (found != NOT_FOUND && (previous == NOT_FOUND || found < previous))
+            {
+                return found;
+            }
+        }
+        if (previous == NOT_FOUND)
+        {
+            return NOT_FOUND;
+        }
+        if (MatchesInSpans(scanner, base, spans, previous))
+        {
+            return previous;
+        }
+        return FindInSpans(scanner, base, spans, previous);
+    }
+
+    /**
+     * Finds the first match of a pattern in a newer build from its first match in the older one,
+     * scanning only around the changed pages.
+     *
+     * A new match can only start where its bytes overlap a changed range, so each range is scanned
+     * together with the pattern length on either side. The earliest such match before the old hit
+     * wins; otherwise the old hit stands if it still matches, and only if it was overwritten is the
+     * rest of the data scanned from there.
+     *
+     * @param scanner The compiled pattern.
+     * @param data Start of the newer build, laid out like the diff's offsets.
+     * @param size Size of the newer build.
+     * @param previous First match in the older build, or NOT_FOUND if it had none.
+     * @param diff Changed pages between the builds.
+     * @return Offset of the first match in the newer build, or NOT_FOUND.
+     */
+    inline size_t RevalidateMatch(const Scanner& scanner, const uint8_t* data, size_t size, size_t previous, const SnapshotDiff& diff)
+    {
+        return RevalidateMatch(scanner, data, std::vector<ByteSpan>{ { data, size } }, previous, diff);
+    }
+
+    /**
+     * The FindRevalidated below for an image with unmapped gaps: only its readable spans are read.
+     *
+     * @param cache The persistent cache.
+     * @param scanner The compiled pattern.
+     * @param base Start of the newer build; offsets are relative to it.
+     * @param spans Readable spans of the newer build sorted by address, see FindInSpans.
+     * @param diff Diff from the older build's snapshot, providing both module keys.
+     * @return Offset of the first match, or NOT_FOUND.
+     */
+    inline size_t FindRevalidated(SignatureCache& cache, const Scanner& scanner, const uint8_t* base, const std::vector<ByteSpan>& spans, const SnapshotDiff& diff)
+    {
+        const uint64_t patternKey = ComputePatternKey(scanner);
+        size_t offset;
+        if (cache.Lookup(diff.currentKey, patternKey, offset) || !cache.Lookup(diff.previousKey, patternKey, offset))
+        {
+            return cache.Find(diff.currentKey, scanner, base, spans);
+        }
+        offset = RevalidateMatch(scanner, base, spans, offset, diff);
+        cache.Store(diff.currentKey, patternKey, offset);
+        return offset;
+    }
+
+    /**
+     * SignatureCache::Find for a module that was updated since the cache was filled: a result
+     * cached for the older build is carried over with RevalidateMatch and stored for the newer one,
+     * so only signatures near changed pages cost a (partial) scan.
+     *
+     * @param cache The persistent cache.
+     * @param scanner The compiled pattern.
+     * @param data Start of the newer build.
+     * @param size Size of the newer build.
+     * @param diff Diff from the older build's snapshot, providing both module keys.
+     * @return Offset of the first match, or NOT_FOUND.
+     */
+    inline size_t FindRevalidated(SignatureCache& cache, const Scanner& scanner, const uint8_t* data, size_t size, const SnapshotDiff& diff)
+    {
+        return FindRevalidated(cache, scanner, data, std::vector<ByteSpan>{ { data, size } }, diff);
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Scanner.h"
+#include "ThreadPool.h"
+
+namespace SyxLib
+{
+    /**
+     * Tuning knobs for ParallelFind.
+     */
+    struct ParallelScanOptions
+    {
+        /** Number of workers, 0 = every thread of the pool. */
+        unsigned threadCount = 0;
+        /** Candidate offsets per chunk. The default keeps a chunk inside a typical L2 cache. */
+        size_t chunkSize = 256 * 1024;
+        /** Pool to run on, nullptr = ThreadPool::Default(). */
+        ThreadPool* pool = nullptr;
+    };
+
+    namespace Detail
+    {
+        /**
+         * Per-worker deque of chunk indices [front, back) packed into one atomic word.
+         * The owner pops from the front (lowest addresses first), thieves split off the back half.
+         */
+        struct alignas(64) ChunkDeque
+        {
+            std::atomic<uint64_t> range{ 0 };
+
+            static uint64_t Pack(uint32_t front, uint32_t back)
+            {
+                return (static_cast<uint64_t>(back) << 32) | front;
+            }
+
+            void Assign(uint32_t front, uint32_t back)
+            {
+                range.store(Pack(front, back));
+            }
+
+            void Clear()
+            {
+                range.store(0);
+            }
+
+            bool PopFront(uint32_t& chunk)
+            {
+                uint64_t current = range.load();
+                for (;;)
+                {
+                    const uint32_t front = static_cast<uint32_t>(current), back = static_cast<uint32_t>(current >> 32);
+                    if (front >= back)
+                    {
+                        return false;
+                    }
+                    if (range.compare_exchange_weak(current, Pack(front + 1, back)))
+                    {
+                        chunk = front;
+                        return true;
+                    }
+                }
+            }
+
+            // Moves the back half of this deque into an empty thief deque. Chunks at or past limit are not worth stealing.
+            bool StealInto(ChunkDeque& thief, uint32_t limit)
+            {
+                uint64_t current = range.load();
+                for (;;)
+                {
+                    const uint32_t front = static_cast<uint32_t>(current), back = static_cast<uint32_t>(current >> 32);
+                    if (front >= back || front >= limit)
+                    {
+                        return false;
+                    }
+                    const uint32_t split = back - (back - front + 1) / 2;
+                    if (range.compare_exchange_weak(current, Pack(front, split)))
+                    {
+                        thief.Assign(split, back);
+                        return true;
+                    }
+                }
+            }
+        };
+    }
+
+    /**
+     * Finds the first match of a pattern using several threads.
+     *
+     * The candidate offsets are split into chunks that overlap by Length() - 1 bytes so no match
+     * straddling a chunk border is lost. Chunks are dealt out to per-worker deques in address
+     * order and idle workers steal from the others. Once a match is found, chunks above it are
+     * cancelled, while chunks below it still finish, so the result is always the lowest match,
+     * exactly as Scanner::Find would return.
+     *
+     * @param scanner The compiled pattern.
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param options Thread count, chunk size and pool.
+     * @return Offset of the first match, or NOT_FOUND.
+     */
+    inline size_t ParallelFind(const Scanner& scanner, const uint8_t* data, size_t size, const ParallelScanOptions& options = {})
+    {
+        const size_t length = scanner.Length();
+        if (size < length)
+        {
+            return NOT_FOUND;
+        }
+        const size_t count = size - length + 1;
+        const size_t chunkSize = (std::max)(options.chunkSize, count / UINT32_MAX + 1);
+        const size_t chunks = (count + chunkSize - 1) / chunkSize;
+
+        ThreadPool& pool = options.pool ? *options.pool : ThreadPool::Default();
+        unsigned workers = options.threadCount ? options.threadCount : pool.Concurrency();
+        workers = static_cast<unsigned>((std::min<size_t>)({ workers, pool.Concurrency(), chunks }));
+        if (workers <= 1)
+        {
+            return scanner.Find(data, size);
+        }
+
+        std::vector<Detail::ChunkDeque> deques(workers);
+        for (unsigned w = 0; w < workers; w++)
+        {
+            deques[w].Assign(static_cast<uint32_t>(chunks * w / workers), static_cast<uint32_t>(chunks * (w + 1) / workers));
+        }
+
+        std::atomic<size_t> best{ NOT_FOUND };
+        pool.Run(workers, [&](unsigned self)
+        {
+            for (;;)
+            {
+                uint32_t chunk;
+                if (!deques[self].PopFront(chunk))
+                {
+                    // Never steal chunks that start at or above the best match so far.
+                    const size_t bestChunk = (std::min<size_t>)(best.load() / chunkSize, chunks);
+                    bool stolen = false;
+                    for (unsigned i = 1; i < workers && !stolen; i++)
+                    {
+                        stolen = deques[(self + i) % workers].StealInto(deques[self], static_cast<uint32_t>(bestChunk));
+                    }
+                    if (!stolen)
+                    {
+                        return;
+                    }
+                    continue;
+                }
+
+                const size_t start = chunk * chunkSize;
+                if (start >= best.load())
+                {
+                    // Everything left in this deque is higher still.
+                    deques[self].Clear();
+                    continue;
+                }
+
+                const size_t end = (std::min)(start + chunkSize, count);
+                const size_t hit = scanner.Find(data, end + length - 1, start);
+                if (hit != NOT_FOUND)
+                {
+                    size_t current = best.load();
+                    while (hit < current && !best.compare_exchange_weak(current, hit))
+                    {
+                    }
+                }
+            }
+        });
+        return best.load();
+    }
+}
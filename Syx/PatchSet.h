@@ -0,0 +1,429 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+#include "Hooks.h"
+#include "Platform.h"
+#include "Regions.h"
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /** Why a PatchSet could not be applied or reverted. */
+    enum class PatchStatus : uint8_t
+    {
+        Ok,
+        /** The set is empty, or already in the requested state. */
+        InvalidArgument,
+        /** Two patches write the same byte. */
+        Overlap,
+        /** A patch lies in unmapped or no-access memory. */
+        Unreadable,
+        /** The bytes in memory are not the expected originals (Apply) or the patch bytes (Revert). */
+        Mismatch,
+        /** The page protection could not be changed. */
+        ProtectFailed,
+        /** The other threads could not be suspended. */
+        SuspendFailed
+    };
+
+    /**
+     * @return A short description of the status.
+     */
+    inline const char* ToString(PatchStatus status)
+    {
+        switch (status)
+        {
+        case PatchStatus::Ok:
+            return "ok";
+        case PatchStatus::InvalidArgument:
+            return "empty set or already in that state";
+        case PatchStatus::Overlap:
+            return "patches overlap";
+        case PatchStatus::Unreadable:
+            return "patch in unmapped memory";
+        case PatchStatus::Mismatch:
+            return "memory does not hold the expected bytes";
+        case PatchStatus::ProtectFailed:
+            return "cannot change page protection";
+        case PatchStatus::SuspendFailed:
+            return "cannot suspend threads";
+        }
+        return "unknown status";
+    }
+
+    /**
+     * Byte patches (NOPs, flipped jumps, changed constants) applied and reverted as one transaction.
+     *
+     * Apply() checks every patch before touching anything: the bytes must be mapped, must not
+     * overlap another patch, and must equal the expected originals when they were given (otherwise
+     * the current bytes are saved as the originals). The pages under the patches are then made
+     * writable with one protection change per run of adjacent pages, the bytes are written, and the
+     * protection is restored, so 400 patches on 10 pages cost 20 system calls, not 800. If a check
+     * or a protection change fails, nothing is written. Revert() restores the saved originals the
+     * same way, after checking that every patch is still in place.
+     *
+     * Patch bytes and saved originals live in one pooled buffer. A PatchSet is not thread-safe;
+     * build and apply it from one thread.
+     *
+     * With PatchMode::Atomic, patches that lie within one aligned 8-byte word are written with an
+     * atomic store while other threads run; if any patch is longer, all threads are suspended while
+     * the set is written. A thread suspended inside a longer patch resumes at the same address, so
+     * patches that change instruction boundaries must not be running.
+     *
+     * @example
+     * SyxLib::PatchSet patches;
+     * patches.Add(base + 0x1234, { 0xEB }, { 0x74 });                 // je -> jmp
+     * patches.AddNop(base + 0x5678, 5, { 0xE8, 0x10, 0x20, 0x00, 0x00 });
+     * if (patches.Apply() != SyxLib::PatchStatus::Ok) ...
+     */
+    class PatchSet
+    {
+    public:
+        explicit PatchSet(PatchMode mode = PatchMode::Atomic)
+            : m_mode(mode)
+        {
+        }
+
+        /**
+         * Adds a patch.
+         *
+         * @param address First byte to replace.
+         * @param bytes New bytes.
+         * @param size Number of bytes.
+         * @param expected Bytes that must be in memory when the set is applied, nullptr to accept any.
+         * @return Index of the patch, NOT_FOUND if size is 0 or the set is applied.
+         */
+        size_t Add(uintptr_t address, const uint8_t* bytes, size_t size, const uint8_t* expected = nullptr)
+        {
+            if (!bytes || !Reserve(address, size, expected))
+            {
+                return NOT_FOUND;
+            }
+            memcpy(&m_bytes[m_patches.back().offset], bytes, size);
+            return m_patches.size() - 1;
+        }
+
+        /**
+         * Adds a patch given as a byte list; expected must be empty or as long as bytes.
+         */
+        size_t Add(uintptr_t address, std::initializer_list<uint8_t> bytes, std::initializer_list<uint8_t> expected = {})
+        {
+            if (expected.size() && expected.size() != bytes.size())
+            {
+                return NOT_FOUND;
+            }
+            return Add(address, bytes.begin(), bytes.size(), expected.size() ? expected.begin() : nullptr);
+        }
+
+        /**
+         * Adds a patch that fills size bytes with NOP (0x90).
+         */
+        size_t AddNop(uintptr_t address, size_t size, const uint8_t* expected = nullptr)
+        {
+            if (!Reserve(address, size, expected))
+            {
+                return NOT_FOUND;
+            }
+            memset(&m_bytes[m_patches.back().offset], 0x90, size);
+            return m_patches.size() - 1;
+        }
+
+        size_t AddNop(uintptr_t address, size_t size, std::initializer_list<uint8_t> expected)
+        {
+            if (expected.size() && expected.size() != size)
+            {
+                return NOT_FOUND;
+            }
+            return AddNop(address, size, expected.size() ? expected.begin() : nullptr);
+        }
+
+        size_t Count() const
+        {
+            return m_patches.size();
+        }
+
+        bool IsApplied() const
+        {
+            return m_applied;
+        }
+
+        /**
+         * @return The bytes a patch replaced; valid after Apply(), or from Add() when expected bytes were given.
+         */
+        const uint8_t* Original(size_t index) const
+        {
+            return index < m_patches.size() ? &m_bytes[m_patches[index].offset + m_patches[index].size] : nullptr;
+        }
+
+        /**
+         * @return Index of the patch the last failed Apply(), Revert() or Validate() stopped at, NOT_FOUND if none.
+         */
+        size_t FailedPatch() const
+        {
+            return m_failed;
+        }
+
+        /**
+         * Runs the checks of Apply() without writing.
+         */
+        PatchStatus Validate()
+        {
+            std::vector<MemoryRegion> regions;
+            return Check(true, regions);
+        }
+
+        /**
+         * Writes every patch, or none.
+         */
+        PatchStatus Apply()
+        {
+            return Commit(true);
+        }
+
+        /**
+         * Restores every original, or none.
+         */
+        PatchStatus Revert()
+        {
+            return Commit(false);
+        }
+
+    private:
+        struct Patch
+        {
+            uintptr_t address;
+            size_t size;
+            /** Patch bytes at m_bytes[offset], originals right after them. */
+            size_t offset;
+            bool verify;
+        };
+
+        /** A run of pages with one protection, made writable together. */
+        struct Range
+        {
+            uintptr_t base;
+            size_t size;
+            uint32_t protection;
+            uint32_t saved;
+        };
+
+        /** Appends a patch with room for its bytes and originals in the pool. */
+        bool Reserve(uintptr_t address, size_t size, const uint8_t* expected)
+        {
+            if (!address || !size || m_applied)
+            {
+                return false;
+            }
+            const size_t offset = m_bytes.size();
+            m_bytes.resize(offset + size * 2);
+            if (expected)
+            {
+                memcpy(&m_bytes[offset + size], expected, size);
+            }
+            m_patches.push_back({ address, size, offset, expected != nullptr });
+            m_sorted = false;
+            return true;
+        }
+
+        const uint8_t* Bytes(const Patch& patch) const
+        {
+            return &m_bytes[patch.offset];
+        }
+
+        const uint8_t* Originals(const Patch& patch) const
+        {
+            return &m_bytes[patch.offset + patch.size];
+        }
+
+        /** Sorts the patches by address once per change of the set and rejects overlaps. */
+        bool Sort()
+        {
+            if (!m_sorted)
+            {
+                m_order.resize(m_patches.size());
+                for (size_t i = 0; i < m_order.size(); i++)
+                {
+                    m_order[i] = i;
+                }
+                std::sort(m_order.begin(), m_order.end(), [this](size_t a, size_t b) { return m_patches[a].address < m_patches[b].address; });
+                m_sorted = true;
+            }
+            for (size_t i = 1; i < m_order.size(); i++)
+            {
+                const Patch& previous = m_patches[m_order[i - 1]];
+                if (previous.address + previous.size > m_patches[m_order[i]].address)
+                {
+                    m_failed = m_order[i];
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Checks that every patch is mapped and holds the bytes it is about to replace.
+         *
+         * @param regions Receives the regions under the patches, sorted by address.
+         */
+        PatchStatus Check(bool apply, std::vector<MemoryRegion>& regions)
+        {
+            m_failed = NOT_FOUND;
+            if (m_patches.empty() || apply == m_applied)
+            {
+                return PatchStatus::InvalidArgument;
+            }
+            if (!Sort())
+            {
+                return PatchStatus::Overlap;
+            }
+
+            const uintptr_t pageSize = Detail::SystemPageSize();
+            const Patch& last = m_patches[m_order.back()];
+            regions = QueryRegions(m_patches[m_order.front()].address & ~(pageSize - 1), last.address + last.size);
+            size_t region = 0;
+            for (size_t index : m_order)
+            {
+                const Patch& patch = m_patches[index];
+                // Every byte must lie in readable regions that follow each other without a gap.
+                for (uintptr_t cursor = patch.address; cursor < patch.address + patch.size;)
+                {
+                    while (region < regions.size() && regions[region].base + regions[region].size <= cursor)
+                    {
+                        region++;
+                    }
+                    if (region == regions.size() || regions[region].base > cursor || !(regions[region].protection & PROTECT_READ))
+                    {
+                        m_failed = index;
+                        return PatchStatus::Unreadable;
+                    }
+                    cursor = regions[region].base + regions[region].size;
+                }
+
+                const uint8_t* current = reinterpret_cast<const uint8_t*>(patch.address);
+                const uint8_t* wanted = apply ? (patch.verify ? Originals(patch) : nullptr) : Bytes(patch);
+                if (wanted && memcmp(current, wanted, patch.size) != 0)
+                {
+                    m_failed = index;
+                    return PatchStatus::Mismatch;
+                }
+            }
+            return PatchStatus::Ok;
+        }
+
+        PatchStatus Commit(bool apply)
+        {
+            std::vector<MemoryRegion> regions;
+            const PatchStatus status = Check(apply, regions);
+            if (status != PatchStatus::Ok)
+            {
+                return status;
+            }
+
+            // Pages under the patches, merged into runs that stay inside one region.
+            const uintptr_t pageSize = Detail::SystemPageSize();
+            std::vector<Range> ranges;
+            size_t region = 0;
+            for (size_t index : m_order)
+            {
+                const Patch& patch = m_patches[index];
+                uintptr_t page = patch.address & ~(pageSize - 1);
+                const uintptr_t end = (patch.address + patch.size + pageSize - 1) & ~(pageSize - 1);
+                for (; page < end; page += pageSize)
+                {
+                    if (!ranges.empty() && page < ranges.back().base + ranges.back().size)
+                    {
+                        continue;
+                    }
+                    // Regions are whole pages, so the region holding the page's patch bytes holds the page.
+                    while (regions[region].base + regions[region].size <= page)
+                    {
+                        region++;
+                    }
+                    const uint32_t protection = regions[region].protection;
+                    if (!ranges.empty() && ranges.back().base + ranges.back().size == page && ranges.back().base >= regions[region].base)
+                    {
+                        ranges.back().size += pageSize;
+                    }
+                    else
+                    {
+                        ranges.push_back({ page, pageSize, protection, 0 });
+                    }
+                }
+            }
+
+            size_t unprotected = 0;
+            for (; unprotected < ranges.size(); unprotected++)
+            {
+                Range& range = ranges[unprotected];
+                if (!(range.protection & PROTECT_WRITE) && !Detail::UnprotectCode(range.base, range.size, range.protection, range.saved))
+                {
+                    break;
+                }
+            }
+            if (unprotected < ranges.size())
+            {
+                Restore(ranges, unprotected);
+                return PatchStatus::ProtectFailed;
+            }
+
+            bool suspend = m_mode == PatchMode::SuspendThreads;
+            for (const Patch& patch : m_patches)
+            {
+                suspend = suspend || (patch.address & 7) + patch.size > 8;
+            }
+            Detail::ThreadSuspender suspender;
+            if (suspend && !suspender.Suspend())
+            {
+                Restore(ranges, ranges.size());
+                return PatchStatus::SuspendFailed;
+            }
+            for (const Patch& patch : m_patches)
+            {
+                uint8_t* at = reinterpret_cast<uint8_t*>(patch.address);
+                if (apply)
+                {
+                    memcpy(&m_bytes[patch.offset + patch.size], at, patch.size);
+                }
+                const uint8_t* bytes = apply ? Bytes(patch) : Originals(patch);
+                if (suspend)
+                {
+                    memcpy(at, bytes, patch.size);
+                }
+                else
+                {
+                    Detail::StoreCodeWord(at, bytes, patch.size);
+                }
+            }
+            suspender.Resume(nullptr, 0);
+
+            Restore(ranges, ranges.size());
+            m_applied = apply;
+            return PatchStatus::Ok;
+        }
+
+        /** Restores the protection of the first count ranges. */
+        static void Restore(const std::vector<Range>& ranges, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!(ranges[i].protection & PROTECT_WRITE))
+                {
+                    Detail::RestoreProtection(ranges[i].base, ranges[i].size, ranges[i].saved);
+                }
+            }
+        }
+
+        std::vector<Patch> m_patches;
+        /** Pool holding the patch bytes and originals of every patch. */
+        std::vector<uint8_t> m_bytes;
+        std::vector<size_t> m_order;
+        size_t m_failed = NOT_FOUND;
+        PatchMode m_mode;
+        bool m_sorted = false;
+        bool m_applied = false;
+    };
+}
@@ -0,0 +1,257 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__cpp_consteval)
+#define SYX_CONSTEVAL consteval
+#else
+#define SYX_CONSTEVAL constexpr
+#endif
+
+namespace SyxLib
+{
+    namespace Detail
+    {
+        /**
+         * Frequency rank of every byte value in x86/x64 machine code (0 = rarest, 255 = most common).
+         * Measured over the .text sections of a few large compiler-generated binaries; used to pick
+         * the pattern bytes least likely to produce false candidates.
+         */
+        static constexpr uint8_t BYTE_FREQUENCY_RANK[256] =
+        {
+            255, 248, 230, 213, 232, 218, 170, 174, 241, 136, 113, 105, 157, 154, 106, 251,
+            234, 177,  94,  71, 150, 137,  84,  69, 222,  91,  49,  42,  85,  75,  46, 231,
+            224,  79,  28,  47, 249, 124,  13,  14, 204, 186,  32, 115,  88,  78, 147,  44,
+            205, 228,  15,  33, 104, 140,  30,  23, 184, 226,  54, 134, 183, 201,  43,  97,
+            229, 242, 120, 187, 240, 220, 121, 153, 254, 236,  66,  77, 245, 215,  50,  65,
+            209,  52,  57, 176, 212, 198, 126, 123, 160,  37,  34, 191, 192, 206, 128, 109,
+            167,   2,  22, 111, 119,  39, 235,  27, 158, 139,  80,  63, 141,  64, 112, 148,
+            199,  36,  82, 130, 233, 223, 129, 100, 155,  48,  45, 135, 203, 145,  96, 165,
+            219, 169,  67, 243, 244, 246,  92, 114, 166, 252,  17, 250,  86, 238,  51,  61,
+            194,  12,  29,  35, 116,  98,  18,   9,  89, 101,   0,  11,  60,  25,   3,   8,
+            173,  10,   4,  26,  40,  21,  19,   1,  99,  24,  41,  31,  68,  16,   5,  62,
+            110,   6,   7,  20,  87,  58, 175, 195, 196, 146, 197,  74, 149, 132, 216, 211,
+            239, 208, 172, 221, 193, 185, 214, 227, 151, 161, 163,  56,  72, 102,  93,  73,
+            182, 108, 188, 125,  81,  76, 117,  83, 142,  53,  90, 131,  38,  59, 127, 200,
+            190, 107, 138,  55, 122,  70, 143, 164, 247, 237, 144, 189, 168, 162, 159, 202,
+            171, 103, 133, 152,  95, 118, 217, 179, 210, 156, 178, 181, 180, 207, 225, 253,
+        };
+
+        /** The two rarest significant positions of a pattern (equal when only one exists). */
+        struct AnchorChoice
+        {
+            size_t first = 0;
+            size_t second = 0;
+            size_t significant = 0;
+        };
+
+        constexpr AnchorChoice ChooseAnchors(const uint8_t* bytes, const uint8_t* mask, size_t length)
+        {
+            AnchorChoice choice;
+            bool haveFirst = false, haveSecond = false;
+            for (size_t i = 0; i < length; i++)
+            {
+                if (!mask[i])
+                {
+                    continue;
+                }
+                choice.significant++;
+                const uint8_t rank = BYTE_FREQUENCY_RANK[bytes[i]];
+                if (!haveFirst || rank < BYTE_FREQUENCY_RANK[bytes[choice.first]])
+                {
+                    choice.second = choice.first;
+                    haveSecond = haveFirst;
+                    choice.first = i;
+                    haveFirst = true;
+                }
+                else if (!haveSecond || rank < BYTE_FREQUENCY_RANK[bytes[choice.second]])
+                {
+                    choice.second = i;
+                    haveSecond = true;
+                }
+            }
+            if (!haveSecond)
+            {
+                choice.second = choice.first;
+            }
+            return choice;
+        }
+
+        /**
+         * Builds a Boyer-Moore-Horspool shift table that honours wildcards: the shift for a byte is
+         * the distance from its last occurrence (or the last wildcard) before the final position
+         * to the end of the pattern. Shifts are capped at 255.
+         */
+        constexpr void BuildSkipTable(const uint8_t* bytes, const uint8_t* mask, size_t length, uint8_t (&skip)[256])
+        {
+            size_t lastWildcard = 0;
+            bool haveWildcard = false;
+            for (size_t i = 0; i + 1 < length; i++)
+            {
+                if (!mask[i])
+                {
+                    lastWildcard = i;
+                    haveWildcard = true;
+                }
+            }
+
+            const size_t defaultShift = haveWildcard ? length - 1 - lastWildcard : (length ? length : 1);
+            for (size_t c = 0; c < 256; c++)
+            {
+                skip[c] = static_cast<uint8_t>(defaultShift < 255 ? defaultShift : 255);
+            }
+            for (size_t i = 0; i + 1 < length; i++)
+            {
+                const size_t shift = length - 1 - i;
+                if (mask[i] && shift < skip[bytes[i]])
+                {
+                    skip[bytes[i]] = static_cast<uint8_t>(shift);
+                }
+            }
+        }
+
+        constexpr int HexValue(char c)
+        {
+            return c >= '0' && c <= '9' ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                : -1;
+        }
+    }
+
+    /**
+     * A signature parsed from an IDA-style string such as "48 8B ?? E8 ?? ?? ?? ??".
+     *
+     * Tokens are two hex digits or a wildcard ("?" or "??") separated by whitespace. Parsing also
+     * precomputes the anchor positions and the skip table used by Scanner, so building a Scanner
+     * from a Pattern does no work beyond copying. The constructor is constexpr: a Pattern declared
+     * constexpr is parsed by the compiler and a malformed signature is a compile error. At run time
+     * the same constructor throws std::invalid_argument.
+     *
+     * @example
+     * constexpr SyxLib::Pattern tick("48 89 5C 24 08 57 48 83 EC ??");
+     * uintptr_t addr = Syx::FindPatternA(L"game.dll", tick);
+     */
+    class Pattern
+    {
+    public:
+        /** Longest signature a Pattern can hold. */
+        static constexpr size_t MAX_LENGTH = 128;
+
+        /**
+         * Parses an IDA-style signature.
+         *
+         * @param signature The signature string.
+         * @throw std::invalid_argument if the string is empty, malformed or longer than MAX_LENGTH bytes.
+         */
+        constexpr Pattern(const char* signature)
+        {
+            size_t i = 0;
+            while (signature[i])
+            {
+                if (signature[i] == ' ' || signature[i] == '\t')
+                {
+                    i++;
+                    continue;
+                }
+                if (m_length == MAX_LENGTH)
+                {
+                    throw std::invalid_argument("Signature is longer than Pattern::MAX_LENGTH bytes.");
+                }
+
+                if (signature[i] == '?')
+                {
+                    i += signature[i + 1] == '?' ? 2 : 1;
+                }
+                else
+                {
+                    const int high = Detail::HexValue(signature[i]);
+                    const int low = high < 0 ? -1 : Detail::HexValue(signature[i + 1]);
+                    if (low < 0)
+                    {
+                        throw std::invalid_argument("Signature contains a token that is not a hex byte or wildcard.");
+                    }
+                    m_bytes[m_length] = static_cast<uint8_t>(high * 16 + low);
+                    m_mask[m_length] = 0xFF;
+                    i += 2;
+                }
+                if (signature[i] && signature[i] != ' ' && signature[i] != '\t')
+                {
+                    throw std::invalid_argument("Signature tokens must be separated by whitespace.");
+                }
+                m_length++;
+            }
+            if (m_length == 0)
+            {
+                throw std::invalid_argument("Signature is empty.");
+            }
+
+            m_anchors = Detail::ChooseAnchors(m_bytes, m_mask, m_length);
+            Detail::BuildSkipTable(m_bytes, m_mask, m_length, m_skip);
+        }
+
+        /**
+         * @return Length of the pattern in bytes.
+         */
+        constexpr size_t Length() const
+        {
+            return m_length;
+        }
+
+        /**
+         * @return Pattern bytes, wildcards are 0.
+         */
+        constexpr const uint8_t* Bytes() const
+        {
+            return m_bytes;
+        }
+
+        /**
+         * @return One mask byte per pattern byte, 0xFF = must match, 0 = wildcard.
+         */
+        constexpr const uint8_t* Mask() const
+        {
+            return m_mask;
+        }
+
+        /**
+         * @return The precomputed anchor positions.
+         */
+        constexpr const Detail::AnchorChoice& Anchors() const
+        {
+            return m_anchors;
+        }
+
+        /**
+         * @return The precomputed Horspool skip table.
+         */
+        constexpr const uint8_t (&SkipTable() const)[256]
+        {
+            return m_skip;
+        }
+
+    private:
+        uint8_t m_bytes[MAX_LENGTH] = {};
+        uint8_t m_mask[MAX_LENGTH] = {};
+        uint8_t m_skip[256] = {};
+        size_t m_length = 0;
+        Detail::AnchorChoice m_anchors;
+    };
+
+    inline namespace Literals
+    {
+        /**
+         * Parses an IDA-style signature literal. With C++20 this is consteval, so a malformed
+         * literal never compiles, wherever it is used.
+         *
+         * @example
+         * using namespace SyxLib::Literals;
+         * auto call = "E8 ?? ?? ?? ?? 48 85 C0"_sig;
+         */
+        SYX_CONSTEVAL Pattern operator""_sig(const char* signature, size_t)
+        {
+            return Pattern(signature);
+        }
+    }
+}
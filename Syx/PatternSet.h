@@ -0,0 +1,272 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /**
+     * A set of named signatures resolved together in a single pass over memory.
+     *
+     * Every signature is anchored on its rarest pair of adjacent significant bytes (or its rarest
+     * single byte when no such pair exists). Compile() builds a 64 KB filter over the anchor
+     * pairs plus a bucket table from anchor value to signatures, so the scan costs one filter
+     * lookup per byte regardless of how many signatures are in the set, and a full comparison
+     * only where an anchor occurs.
+     */
+    class PatternSet
+    {
+    public:
+        /**
+         * Adds a signature to the set. Compile() must be called again before the next Scan().
+         *
+         * @param name Name of the signature, used for diagnostics.
+         * @param pattern Pointer to the pattern bytes.
+         * @param mask Mask string, 'x' = byte must match, any other character = wildcard.
+         * @return Index of the signature in the results returned by Scan().
+         */
+        size_t Add(const std::string& name, const uint8_t* pattern, const char* mask)
+        {
+            m_names.push_back(name);
+            m_scanners.emplace_back(pattern, mask);
+            m_compiled = false;
+            return m_names.size() - 1;
+        }
+
+        /**
+         * Adds a signature given as a char string, as passed to Syx::FindPatternA.
+         */
+        size_t Add(const std::string& name, const char* pattern, const char* mask)
+        {
+            return Add(name, reinterpret_cast<const uint8_t*>(pattern), mask);
+        }
+
+        /**
+         * Adds a parsed signature to the set.
+         */
+        size_t Add(const std::string& name, const Pattern& pattern)
+        {
+            m_names.push_back(name);
+            m_scanners.emplace_back(pattern);
+            m_compiled = false;
+            return m_names.size() - 1;
+        }
+
+        /**
+         * @return True if Compile() was called since the set was last modified.
+         */
+        bool IsCompiled() const
+        {
+            return m_compiled;
+        }
+
+        /**
+         * @return Number of signatures in the set.
+         */
+        size_t Size() const
+        {
+            return m_names.size();
+        }
+
+        /**
+         * @param index Index returned by Add().
+         * @return Name of the signature.
+         */
+        const std::string& Name(size_t index) const
+        {
+            return m_names[index];
+        }
+
+        /**
+         * Builds the anchor filter and bucket tables for every signature added so far.
+         */
+        void Compile()
+        {
+            m_pairFilter.assign(65536, 0);
+            m_pairStart.assign(65536 + 1, 0);
+            m_byteStart.assign(256 + 1, 0);
+            m_pairEntries.clear();
+            m_byteEntries.clear();
+            m_unanchored.clear();
+            memset(m_byteFilter, 0, sizeof(m_byteFilter));
+
+            std::vector<Entry> pairs, bytes;
+            std::vector<uint32_t> pairKeys, byteKeys;
+            for (size_t index = 0; index < m_scanners.size(); index++)
+            {
+                const Scanner& scanner = m_scanners[index];
+                size_t bestPair = NOT_FOUND, bestByte = NOT_FOUND;
+                unsigned bestPairRank = ~0u, bestByteRank = ~0u;
+                for (size_t i = 0; i < scanner.Length(); i++)
+                {
+                    if (!scanner.IsSignificant(i))
+                    {
+                        continue;
+                    }
+                    const unsigned rank = Detail::BYTE_FREQUENCY_RANK[scanner.ByteAt(i)];
+                    if (rank < bestByteRank)
+                    {
+                        bestByteRank = rank;
+                        bestByte = i;
+                    }
+                    if (i + 1 < scanner.Length() && scanner.IsSignificant(i + 1))
+                    {
+                        const unsigned pairRank = rank + Detail::BYTE_FREQUENCY_RANK[scanner.ByteAt(i + 1)];
+                        if (pairRank < bestPairRank)
+                        {
+                            bestPairRank = pairRank;
+                            bestPair = i;
+                        }
+                    }
+                }
+
+                const uint32_t id = static_cast<uint32_t>(index);
+                if (bestPair != NOT_FOUND)
+                {
+                    pairs.push_back({ id, static_cast<uint32_t>(bestPair) });
+                    pairKeys.push_back(scanner.ByteAt(bestPair) | (scanner.ByteAt(bestPair + 1) << 8));
+                }
+                else if (bestByte != NOT_FOUND)
+                {
+                    bytes.push_back({ id, static_cast<uint32_t>(bestByte) });
+                    byteKeys.push_back(scanner.ByteAt(bestByte));
+                }
+                else
+                {
+                    m_unanchored.push_back(id);
+                }
+            }
+
+            BuildBuckets(pairs, pairKeys, m_pairStart, m_pairEntries);
+            BuildBuckets(bytes, byteKeys, m_byteStart, m_byteEntries);
+            for (uint32_t key : pairKeys)
+            {
+                m_pairFilter[key] = 1;
+            }
+            for (uint32_t key : byteKeys)
+            {
+                m_byteFilter[key] = true;
+            }
+            m_compiled = true;
+        }
+
+        /**
+         * Resolves every signature in one pass over a buffer.
+         *
+         * @param data Start of the buffer.
+         * @param size Size of the buffer in bytes.
+         * @return Offset of the first match of each signature, indexed like Add(), NOT_FOUND if absent.
+         * @throw std::logic_error if the set was modified since the last Compile().
+         */
+        std::vector<size_t> Scan(const uint8_t* data, size_t size) const
+        {
+            if (!m_compiled)
+            {
+                throw std::logic_error("PatternSet::Scan called before Compile.");
+            }
+
+            std::vector<size_t> results(m_scanners.size(), NOT_FOUND);
+            size_t remaining = m_scanners.size();
+            for (uint32_t index : m_unanchored)
+            {
+                if (m_scanners[index].Length() <= size)
+                {
+                    results[index] = 0;
+                    remaining--;
+                }
+            }
+
+            // Single-byte anchors are rare (signatures without two adjacent significant bytes), so
+            // they get their own loop and the common pair loop stays a single table probe per byte.
+            if (!m_byteEntries.empty())
+            {
+                for (size_t i = 0; i < size && remaining; i++)
+                {
+                    if (m_byteFilter[data[i]])
+                    {
+                        remaining -= Verify(data, size, i, m_byteEntries, m_byteStart[data[i]], m_byteStart[data[i] + 1], results);
+                    }
+                }
+            }
+            if (!m_pairEntries.empty())
+            {
+                const uint8_t* filter = m_pairFilter.data();
+                for (size_t i = 0; i + 1 < size && remaining; i++)
+                {
+                    const uint32_t key = data[i] | (data[i + 1] << 8);
+                    if (filter[key])
+                    {
+                        remaining -= Verify(data, size, i, m_pairEntries, m_pairStart[key], m_pairStart[key + 1], results);
+                    }
+                }
+            }
+            return results;
+        }
+
+    private:
+        struct Entry
+        {
+            uint32_t index;
+            uint32_t anchor;
+        };
+
+        // Lays out entries grouped by key (CSR style): bucket k is entries[start[k] .. start[k + 1]).
+        static void BuildBuckets(const std::vector<Entry>& source, const std::vector<uint32_t>& keys,
+            std::vector<uint32_t>& start, std::vector<Entry>& entries)
+        {
+            for (uint32_t key : keys)
+            {
+                start[key + 1]++;
+            }
+            for (size_t k = 1; k < start.size(); k++)
+            {
+                start[k] += start[k - 1];
+            }
+            entries.resize(source.size());
+            std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+            for (size_t i = 0; i < source.size(); i++)
+            {
+                entries[fill[keys[i]]++] = source[i];
+            }
+        }
+
+        // Checks each signature of a bucket whose anchor sits at position; returns how many got resolved.
+        size_t Verify(const uint8_t* data, size_t size, size_t position, const std::vector<Entry>& entries,
+            uint32_t first, uint32_t last, std::vector<size_t>& results) const
+        {
+            size_t resolved = 0;
+            for (uint32_t e = first; e < last; e++)
+            {
+                const Entry& entry = entries[e];
+                if (results[entry.index] != NOT_FOUND || position < entry.anchor)
+                {
+                    continue;
+                }
+                const size_t start = position - entry.anchor;
+                const Scanner& scanner = m_scanners[entry.index];
+                if (start + scanner.Length() <= size && scanner.MatchesAt(data + start))
+                {
+                    // Each signature has a single anchor offset, so the first hit is also the lowest address.
+                    results[entry.index] = start;
+                    resolved++;
+                }
+            }
+            return resolved;
+        }
+
+        std::vector<std::string> m_names;
+        std::vector<Scanner> m_scanners;
+        std::vector<uint8_t> m_pairFilter;
+        std::vector<uint32_t> m_pairStart;
+        std::vector<Entry> m_pairEntries;
+        bool m_byteFilter[256] = {};
+        std::vector<uint32_t> m_byteStart;
+        std::vector<Entry> m_byteEntries;
+        std::vector<uint32_t> m_unanchored;
+        bool m_compiled = false;
+    };
+}
@@ -0,0 +1,287 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Regions.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Platform backend: the few operating system calls the rest of SyxLib needs. Windows uses
+ * GetModuleInformation, VirtualAlloc and VirtualProtect; Linux and other ELF systems use
+ * dl_iterate_phdr, /proc/self/maps (through QueryRegions), mmap and mprotect. Everything else
+ * in SyxLib is platform-neutral and builds on these.
+ */
+
+namespace SyxLib
+{
+#ifdef _WIN32
+    using ModuleInfo = MODULEINFO;
+#else
+    /** Mirrors MODULEINFO so code written against Syx::GetModuleInfo builds unchanged. */
+    struct ModuleInfo
+    {
+        void* lpBaseOfDll;
+        size_t SizeOfImage;
+        void* EntryPoint;
+    };
+
+    namespace Detail
+    {
+        struct ModuleQuery
+        {
+            const char* name;
+            ModuleInfo info;
+        };
+
+        /**
+         * Matches a loaded object by full path or file name; the first object is the program. The
+         * reported range runs from the first PT_LOAD segment to the end of the last one, so it can
+         * hold unmapped gaps between segments: scan it through QueryModuleRegions, not as one buffer.
+         */
+        inline int MatchModule(dl_phdr_info* object, size_t, void* data)
+        {
+            ModuleQuery& query = *static_cast<ModuleQuery*>(data);
+            const char* path = object->dlpi_name ? object->dlpi_name : "";
+            if (query.name)
+            {
+                const char* slash = strrchr(path, '/');
+                const char* file = slash ? slash + 1 : path;
+                if (strcmp(path, query.name) != 0 && strcmp(file, query.name) != 0)
+                {
+                    return 0;
+                }
+            }
+
+            uintptr_t begin = UINTPTR_MAX, end = 0;
+            for (int i = 0; i < object->dlpi_phnum; i++)
+            {
+                const ElfW(Phdr)& header = object->dlpi_phdr[i];
+                if (header.p_type == PT_LOAD)
+                {
+                    begin = (std::min)(begin, static_cast<uintptr_t>(object->dlpi_addr + header.p_vaddr));
+                    end = (std::max)(end, static_cast<uintptr_t>(object->dlpi_addr + header.p_vaddr + header.p_memsz));
+                }
+            }
+            if (begin >= end)
+            {
+                return 0;
+            }
+            const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+            begin &= ~(page - 1);
+            query.info.lpBaseOfDll = reinterpret_cast<void*>(begin);
+            query.info.SizeOfImage = end - begin;
+            return 1;
+        }
+    }
+#endif
+
+    /**
+     * Finds a module loaded in the current process.
+     *
+     * @param name Module name (a file name or, on Linux, a full path); nullptr for the program itself.
+     * @return The module's base and size, all zero if it is not loaded.
+     */
+    inline ModuleInfo FindModule(const char* name)
+    {
+        ModuleInfo info = {};
+#ifdef _WIN32
+        HMODULE module = GetModuleHandleA(name);
+        if (module)
+        {
+            GetModuleInformation(GetCurrentProcess(), module, &info, sizeof(info));
+        }
+#else
+        Detail::ModuleQuery query = { name, {} };
+        dl_iterate_phdr(Detail::MatchModule, &query);
+        info = query.info;
+#endif
+        return info;
+    }
+
+    inline ModuleInfo FindModule(const wchar_t* name)
+    {
+#ifdef _WIN32
+        ModuleInfo info = {};
+        HMODULE module = GetModuleHandleW(name);
+        if (module)
+        {
+            GetModuleInformation(GetCurrentProcess(), module, &info, sizeof(info));
+        }
+        return info;
+#else
+        if (!name)
+        {
+            return FindModule(static_cast<const char*>(nullptr));
+        }
+        // Module names are file names; anything outside ASCII cannot match a narrow path anyway.
+        std::string narrow;
+        for (; *name; name++)
+        {
+            narrow += *name < 0x80 ? static_cast<char>(*name) : '?';
+        }
+        return FindModule(narrow.c_str());
+#endif
+    }
+
+    /**
+     * @return The id of the current process, as taken by ProcessMemory.
+     */
+    inline uint32_t CurrentProcessId()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+    namespace Detail
+    {
+        inline size_t SystemPageSize()
+        {
+#ifdef _WIN32
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return info.dwPageSize;
+#else
+            return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        }
+
+        /** Unallocated address ranges in [begin, end), in address order. */
+        inline std::vector<std::pair<uintptr_t, uintptr_t>> FreeRanges(uintptr_t begin, uintptr_t end)
+        {
+            std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+#ifdef _WIN32
+            MEMORY_BASIC_INFORMATION mbi;
+            uintptr_t address = begin;
+            while (address < end && VirtualQuery(reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)))
+            {
+                const uintptr_t regionBase = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+                const uintptr_t next = regionBase + mbi.RegionSize;
+                if (next <= address)
+                {
+                    break;
+                }
+                if (mbi.State == MEM_FREE)
+                {
+                    ranges.push_back({ (std::max)(begin, regionBase), (std::min)(end, next) });
+                }
+                address = next;
+            }
+#else
+            // Reserved and guard mappings are listed too, so every gap between regions is free.
+            uintptr_t cursor = begin;
+            for (const MemoryRegion& region : QueryRegions(begin, end))
+            {
+                if (region.base > cursor)
+                {
+                    ranges.push_back({ cursor, region.base });
+                }
+                cursor = (std::max)(cursor, region.base + region.size);
+            }
+            if (cursor < end)
+            {
+                ranges.push_back({ cursor, end });
+            }
+#endif
+            return ranges;
+        }
+
+        /** Allocates read/write/execute memory exactly at an address, nullptr if it is taken. */
+        inline uint8_t* AllocateCodeAt(uintptr_t address, size_t size)
+        {
+#ifdef _WIN32
+            return reinterpret_cast<uint8_t*>(VirtualAlloc(reinterpret_cast<LPVOID>(address), size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+#else
+            void* memory = mmap(reinterpret_cast<void*>(address), size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+            {
+                return nullptr;
+            }
+            if (reinterpret_cast<uintptr_t>(memory) != address)
+            {
+                munmap(memory, size);
+                return nullptr;
+            }
+            return static_cast<uint8_t*>(memory);
+#endif
+        }
+
+        inline void FreeCode(uint8_t* memory, size_t size)
+        {
+#ifdef _WIN32
+            (void)size;
+            VirtualFree(memory, 0, MEM_RELEASE);
+#else
+            munmap(memory, size);
+#endif
+        }
+
+        /**
+         * Makes pages of code writable when their current protection is already known, which
+         * saves the region query on Linux.
+         *
+         * @param current MemoryProtection flags of every page in the range.
+         * @param saved Receives what RestoreProtection needs to undo the change.
+         */
+        inline bool UnprotectCode(uintptr_t page, size_t size, uint32_t current, uint32_t& saved)
+        {
+#ifdef _WIN32
+            (void)current;
+            DWORD old = 0;
+            if (!VirtualProtect(reinterpret_cast<LPVOID>(page), size, PAGE_EXECUTE_READWRITE, &old))
+            {
+                return false;
+            }
+            saved = old;
+            return true;
+#else
+            // Data pages such as a GOT stay non-executable.
+            saved = current;
+            return mprotect(reinterpret_cast<void*>(page), size, PROT_READ | PROT_WRITE | ((current & PROTECT_EXECUTE) ? PROT_EXEC : 0)) == 0;
+#endif
+        }
+
+        /**
+         * Makes pages of code writable.
+         *
+         * @param saved Receives what RestoreProtection needs to undo the change.
+         */
+        inline bool UnprotectCode(uintptr_t page, size_t size, uint32_t& saved)
+        {
+#ifdef _WIN32
+            return UnprotectCode(page, size, 0, saved);
+#else
+            const std::vector<MemoryRegion> regions = QueryRegions(page, page + size);
+            return UnprotectCode(page, size, regions.empty() ? PROTECT_READ | PROTECT_EXECUTE : regions.front().protection, saved);
+#endif
+        }
+
+        inline void RestoreProtection(uintptr_t page, size_t size, uint32_t saved)
+        {
+#ifdef _WIN32
+            DWORD old = 0;
+            VirtualProtect(reinterpret_cast<LPVOID>(page), size, saved, &old);
+            FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<LPCVOID>(page), size);
+#else
+            const int protection = ((saved & PROTECT_READ) ? PROT_READ : 0) | ((saved & PROTECT_WRITE) ? PROT_WRITE : 0) |
+                ((saved & PROTECT_EXECUTE) ? PROT_EXEC : 0);
+            mprotect(reinterpret_cast<void*>(page), size, protection);
+            __builtin___clear_cache(reinterpret_cast<char*>(page), reinterpret_cast<char*>(page + size));
+#endif
+        }
+    }
+}
@@ -0,0 +1,341 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "Memory.h"
+
+namespace SyxLib
+{
+    /**
+     * A multi-level pointer compiled once from a base address and a list of offsets, following the
+     * same rules as Syx::WritePTR: starting at the base, each level reads the pointer at the current
+     * address and adds the next offset. A null pointer anywhere on the path fails the chain.
+     *
+     * The chain remembers the address of every node it walked. Two mechanisms let later calls skip
+     * the walk:
+     * - Generation: pass the same nonzero generation to Resolve/Read/Write and the final address is
+     *   reused without any dereference. Bump the generation whenever objects may have moved (level
+     *   load, respawn, ...). Generation 0 always walks.
+     * - Stable prefix: the first stablePrefix dereferences (typically static module globals) are
+     *   reused across generations until Invalidate() or a failed walk.
+     *
+     * Nothing throws; failures are reported as false and drop the cache.
+     *
+     * @example
+     * SyxLib::PointerChain health(moduleBase + 0x1234, { 0x10, 0x28, 0x4C }, 1);
+     * int value;
+     * if (health.Read(value, frame)) ...
+     */
+    class PointerChain
+    {
+    public:
+        PointerChain() = default;
+
+        /**
+         * @param base Address of the first pointer.
+         * @param offsets Offsets added after each dereference.
+         * @param stablePrefix Number of leading dereferences whose results are reused across generations.
+         */
+        PointerChain(uintptr_t base, std::vector<uintptr_t> offsets, size_t stablePrefix = 0)
+            : m_offsets(static_cast<std::vector<uintptr_t>&&>(offsets)), m_stablePrefix(stablePrefix)
+        {
+            m_nodes.resize(m_offsets.size() + 1);
+            m_nodes[0] = base;
+        }
+
+        uintptr_t Base() const
+        {
+            return m_nodes.empty() ? 0 : m_nodes[0];
+        }
+
+        const std::vector<uintptr_t>& Offsets() const
+        {
+            return m_offsets;
+        }
+
+        /**
+         * @return Number of dereferences.
+         */
+        size_t Depth() const
+        {
+            return m_offsets.size();
+        }
+
+        /**
+         * @return True if the final address is cached for this generation.
+         */
+        bool IsCached(uint64_t generation) const
+        {
+            return generation != 0 && generation == m_generation && m_validDepth == Depth();
+        }
+
+        /**
+         * @return The last resolved address, 0 if the chain has not been resolved.
+         */
+        uintptr_t CachedAddress() const
+        {
+            return m_validDepth == Depth() && !m_nodes.empty() ? m_nodes.back() : 0;
+        }
+
+        /** Drops every cached node, including the stable prefix. */
+        void Invalidate()
+        {
+            m_validDepth = 0;
+            m_generation = 0;
+        }
+
+        /**
+         * Resolves the final address.
+         *
+         * @param memory The address space to read.
+         * @param address Receives the final address.
+         * @param generation Cache generation, 0 to always walk past the stable prefix.
+         * @return False if a null or unreadable pointer is met.
+         */
+        bool Resolve(const MemoryAccessor& memory, uintptr_t& address, uint64_t generation = 0)
+        {
+            if (m_nodes.empty())
+            {
+                return false;
+            }
+            if (!IsCached(generation))
+            {
+                uintptr_t current = m_nodes[StartLevel()];
+                for (size_t level = StartLevel(); level < Depth(); level++)
+                {
+                    uintptr_t pointer;
+                    if (!current || !memory.ReadPointer(current, pointer) || !pointer)
+                    {
+                        Invalidate();
+                        return false;
+                    }
+                    current = pointer + m_offsets[level];
+                    m_nodes[level + 1] = current;
+                }
+                if (!Complete(generation))
+                {
+                    return false;
+                }
+            }
+            address = m_nodes.back();
+            return true;
+        }
+
+        /**
+         * Resolves the chain in the current process.
+         */
+        bool Resolve(uintptr_t& address, uint64_t generation = 0)
+        {
+            return Resolve(LocalMemory::Instance(), address, generation);
+        }
+
+        /**
+         * Reads the value at the end of the chain.
+         *
+         * @return False if the chain cannot be resolved or the value cannot be read.
+         */
+        template <typename T>
+        bool Read(const MemoryAccessor& memory, T& value, uint64_t generation = 0)
+        {
+            uintptr_t address;
+            if (!Resolve(memory, address, generation) || !memory.Read(address, value))
+            {
+                Invalidate();
+                return false;
+            }
+            return true;
+        }
+
+        template <typename T, typename = typename std::enable_if<!std::is_base_of<MemoryAccessor, T>::value>::type>
+        bool Read(T& value, uint64_t generation = 0)
+        {
+            return Read(LocalMemory::Instance(), value, generation);
+        }
+
+        /**
+         * Writes the value at the end of the chain.
+         *
+         * @return False if the chain cannot be resolved or the value cannot be written.
+         */
+        template <typename T>
+        bool Write(const MemoryAccessor& memory, const T& value, uint64_t generation = 0)
+        {
+            uintptr_t address;
+            if (!Resolve(memory, address, generation) || !memory.Write(address, value))
+            {
+                Invalidate();
+                return false;
+            }
+            return true;
+        }
+
+        template <typename T, typename = typename std::enable_if<!std::is_base_of<MemoryAccessor, T>::value>::type>
+        bool Write(const T& value, uint64_t generation = 0)
+        {
+            return Write(LocalMemory::Instance(), value, generation);
+        }
+
+    private:
+        friend size_t ResolveChains(const MemoryAccessor& memory, PointerChain* chains, size_t count, uint64_t generation);
+
+        /** First level that has to be walked again. */
+        size_t StartLevel() const
+        {
+            return (std::min)(m_validDepth, m_stablePrefix);
+        }
+
+        bool Complete(uint64_t generation)
+        {
+            if (!m_nodes.back())
+            {
+                Invalidate();
+                return false;
+            }
+            m_validDepth = Depth();
+            m_generation = generation;
+            return true;
+        }
+
+        std::vector<uintptr_t> m_offsets;
+        /** m_nodes[0] is the base, m_nodes[i + 1] the address after the i-th dereference. */
+        std::vector<uintptr_t> m_nodes;
+        size_t m_validDepth = 0;
+        size_t m_stablePrefix = 0;
+        uint64_t m_generation = 0;
+    };
+
+    /**
+     * Resolves many chains together, one level at a time. Each level costs one ReadScatter of the
+     * distinct addresses still to be dereferenced, so chains sharing a prefix read it once and a
+     * remote backend needs a handful of system calls for thousands of chains.
+     *
+     * @param memory The address space to read.
+     * @param chains The chains; already cached ones are not walked again.
+     * @param count Number of chains.
+     * @param generation Cache generation, see PointerChain.
+     * @return Number of chains that resolved. CachedAddress() is 0 for the others.
+     */
+    inline size_t ResolveChains(const MemoryAccessor& memory, PointerChain* chains, size_t count, uint64_t generation = 0)
+    {
+        struct Walk
+        {
+            PointerChain* chain;
+            size_t level;
+        };
+        std::vector<Walk> active;
+        size_t resolved = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            PointerChain& chain = chains[i];
+            if (chain.m_nodes.empty())
+            {
+                continue;
+            }
+            if (chain.IsCached(generation))
+            {
+                resolved++;
+            }
+            else if (chain.StartLevel() == chain.Depth())
+            {
+                resolved += chain.Complete(generation) ? 1 : 0;
+            }
+            else
+            {
+                active.push_back({ &chain, chain.StartLevel() });
+            }
+        }
+
+        const size_t pointerSize = memory.PointerSize();
+        std::vector<uintptr_t> addresses;
+        std::vector<uint64_t> values;
+        std::vector<ReadRequest> requests;
+        while (!active.empty())
+        {
+            addresses.clear();
+            for (const Walk& walk : active)
+            {
+                addresses.push_back(walk.chain->m_nodes[walk.level]);
+            }
+            std::sort(addresses.begin(), addresses.end());
+            addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+            values.assign(addresses.size(), 0);
+            requests.resize(addresses.size());
+            for (size_t i = 0; i < addresses.size(); i++)
+            {
+                requests[i] = { addresses[i], &values[i], addresses[i] ? pointerSize : 0, 0 };
+            }
+            memory.ReadScatter(requests.data(), requests.size());
+
+            size_t kept = 0;
+            for (Walk walk : active)
+            {
+                PointerChain& chain = *walk.chain;
+                const uintptr_t current = chain.m_nodes[walk.level];
+                const size_t slot = std::lower_bound(addresses.begin(), addresses.end(), current) - addresses.begin();
+                if (!current || requests[slot].transferred != pointerSize || !values[slot])
+                {
+                    chain.Invalidate();
+                    continue;
+                }
+                chain.m_nodes[walk.level + 1] = static_cast<uintptr_t>(values[slot]) + chain.m_offsets[walk.level];
+                if (++walk.level == chain.Depth())
+                {
+                    resolved += chain.Complete(generation) ? 1 : 0;
+                    continue;
+                }
+                active[kept++] = walk;
+            }
+            active.resize(kept);
+        }
+        return resolved;
+    }
+
+    /**
+     * Resolves many chains and reads the value at the end of each, with one scattered read for the values.
+     *
+     * @param memory The address space to read.
+     * @param chains The chains.
+     * @param count Number of chains.
+     * @param values Receives one value per chain; entries of failed chains are left unchanged.
+     * @param valid Optional, receives whether each value was read.
+     * @param generation Cache generation, see PointerChain.
+     * @return Number of values read.
+     */
+    template <typename T>
+    inline size_t ReadChains(const MemoryAccessor& memory, PointerChain* chains, size_t count, T* values, bool* valid = nullptr, uint64_t generation = 0)
+    {
+        ResolveChains(memory, chains, count, generation);
+
+        std::vector<T> buffer(count);
+        std::vector<ReadRequest> requests(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uintptr_t address = chains[i].CachedAddress();
+            requests[i] = { address, &buffer[i], address ? sizeof(T) : 0, 0 };
+        }
+        memory.ReadScatter(requests.data(), requests.size());
+
+        size_t read = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const bool ok = requests[i].address && requests[i].transferred == sizeof(T);
+            if (ok)
+            {
+                values[i] = buffer[i];
+                read++;
+            }
+            else
+            {
+                chains[i].Invalidate();
+            }
+            if (valid)
+            {
+                valid[i] = ok;
+            }
+        }
+        return read;
+    }
+}
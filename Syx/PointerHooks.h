@@ -0,0 +1,389 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "Hooks.h"
+#include "Image.h"
+#include "PatchSet.h"
+#include "Platform.h"
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+namespace SyxLib
+{
+    /**
+     * Registry of hooks that replace a function pointer instead of patching code: a slot of a
+     * virtual function table, an entry of a PE import address table, or an ELF GOT entry.
+     *
+     * Nothing is relocated and no trampoline is needed: callers already jump through the slot, so
+     * a hooked call costs exactly the indirect call it made before, and the replacement reaches the
+     * original function through the pointer the slot held. Enabling or disabling a hook is one
+     * atomic pointer store, safe while other threads make the call; a batch is verified first and
+     * changes the protection of each affected page once (see PatchSet).
+     *
+     * Only calls made through the slot are redirected. A vtable slot is shared by every object of
+     * the class, calls the compiler devirtualized are not affected, and an import hook only covers
+     * the module whose table is patched. On Linux, a slot still pointing at its PLT stub (lazy
+     * binding) gets the resolved function as original, which Disable stores in place of the stub.
+     * A thread resolving that same import while the hook is enabled may overwrite it, so link with
+     * -z now or call the function once first.
+     *
+     * @example
+     * SyxLib::PointerHooks hooks;
+     * hooks.CreateImport(nullptr, "connect", &MyConnect, reinterpret_cast<const void**>(&original));
+     * hooks.CreateVirtual(renderer, 8, &MyPresent, reinterpret_cast<const void**>(&originalPresent));
+     * hooks.EnableAll();
+     */
+    class PointerHooks
+    {
+    public:
+        PointerHooks() = default;
+        PointerHooks(const PointerHooks&) = delete;
+        PointerHooks& operator=(const PointerHooks&) = delete;
+
+        ~PointerHooks()
+        {
+            DisableAll();
+        }
+
+        /**
+         * Prepares a hook on a function pointer. The slot is not modified until Enable.
+         *
+         * @param slot The pointer callers load the function from.
+         * @param replacement The function to store in the slot.
+         * @param original Optional, receives the pointer the slot holds now.
+         */
+        HookStatus Create(void** slot, const void* replacement, const void** original = nullptr)
+        {
+            if (!slot || !replacement)
+            {
+                return HookStatus::InvalidArgument;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_hooks.count(reinterpret_cast<uintptr_t>(slot)))
+            {
+                return HookStatus::AlreadyHooked;
+            }
+            const void* current = Load(slot);
+            m_hooks.emplace(reinterpret_cast<uintptr_t>(slot), Hook{ slot, replacement, current, current, false });
+            if (original)
+            {
+                *original = current;
+            }
+            return HookStatus::Ok;
+        }
+
+        /**
+         * Prepares a hook on a virtual function of the object's class.
+         *
+         * @param object An object whose vtable pointer is its first member.
+         * @param index Position of the function in the vtable.
+         */
+        HookStatus CreateVirtual(void* object, size_t index, const void* replacement, const void** original = nullptr)
+        {
+            if (!object)
+            {
+                return HookStatus::InvalidArgument;
+            }
+            void** table = *static_cast<void***>(object);
+            return Create(table ? table + index : nullptr, replacement, original);
+        }
+
+        /**
+         * Prepares a hook on every slot through which a module calls an imported function.
+         *
+         * @param module The importing module as FindModule takes it, nullptr for the main program.
+         * @param function Name of the imported function, "#n" for a PE import by ordinal n.
+         * @param replacement The function to store in the slots.
+         * @param original Optional, receives the imported function.
+         * @param library Optional, the DLL the import comes from (case-insensitive). Ignored on ELF.
+         * @param slots Optional, receives the hooked slots to enable or disable them one by one.
+         * @return NotFound if the module does not import the function, AlreadyHooked if one of its
+         *         slots is hooked (no hook is created then).
+         */
+        HookStatus CreateImport(const char* module, const char* function, const void* replacement, const void** original = nullptr,
+            const char* library = nullptr, std::vector<void**>* slots = nullptr)
+        {
+            if (!function || !replacement)
+            {
+                return HookStatus::InvalidArgument;
+            }
+            const ModuleInfo info = FindModule(module);
+            const uint8_t* base = static_cast<const uint8_t*>(info.lpBaseOfDll);
+            std::vector<ImportSlot> imports;
+            if (!base || !ParseImports(base, info.SizeOfImage, imports))
+            {
+                return HookStatus::NotFound;
+            }
+
+            std::vector<void**> found;
+            for (const ImportSlot& import : imports)
+            {
+                if (import.function == function && (!library || import.library.empty() || SameName(import.library.c_str(), library)))
+                {
+                    found.push_back(reinterpret_cast<void**>(const_cast<uint8_t*>(base) + import.slot));
+                }
+            }
+            if (found.empty())
+            {
+                return HookStatus::NotFound;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const void* resolved = nullptr;
+            for (void** slot : found)
+            {
+                if (m_hooks.count(reinterpret_cast<uintptr_t>(slot)))
+                {
+                    return HookStatus::AlreadyHooked;
+                }
+                const void* current = Load(slot);
+                const uintptr_t address = reinterpret_cast<uintptr_t>(current);
+                if (address - reinterpret_cast<uintptr_t>(base) >= info.SizeOfImage)
+                {
+                    resolved = current;
+                }
+            }
+#ifndef _WIN32
+            // Every slot still points at a PLT stub: look the function up as the lazy binder would.
+            if (!resolved)
+            {
+                resolved = dlsym(RTLD_DEFAULT, function);
+                if (!resolved)
+                {
+                    return HookStatus::NotFound;
+                }
+            }
+#endif
+            for (void** slot : found)
+            {
+                const void* current = Load(slot);
+                m_hooks.emplace(reinterpret_cast<uintptr_t>(slot), Hook{ slot, replacement, resolved ? resolved : current, current, false });
+            }
+            if (original)
+            {
+                *original = resolved ? resolved : Load(found.front());
+            }
+            if (slots)
+            {
+                slots->insert(slots->end(), found.begin(), found.end());
+            }
+            return HookStatus::Ok;
+        }
+
+        /** Stores the replacement in a hooked slot. */
+        HookStatus Enable(void** slot)
+        {
+            return Enable(std::vector<void**>{ slot });
+        }
+
+        /** Restores the original function in a hooked slot. The hook can be enabled again. */
+        HookStatus Disable(void** slot)
+        {
+            return Disable(std::vector<void**>{ slot });
+        }
+
+        /**
+         * Enables several hooks as one transaction: if any slot was changed by someone else or
+         * cannot be made writable, none is written.
+         *
+         * @return UnknownHook if a slot has no hook (the others are still enabled), or the first failure.
+         */
+        HookStatus Enable(const std::vector<void**>& slots)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            std::vector<Hook*> hooks = Select(slots, unknown);
+            return Apply(hooks, true, unknown);
+        }
+
+        /**
+         * Disables several hooks as one transaction.
+         */
+        HookStatus Disable(const std::vector<void**>& slots)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            std::vector<Hook*> hooks = Select(slots, unknown);
+            return Apply(hooks, false, unknown);
+        }
+
+        HookStatus EnableAll()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            return Apply(Select({}, unknown), true);
+        }
+
+        HookStatus DisableAll()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool unknown;
+            return Apply(Select({}, unknown), false);
+        }
+
+        /**
+         * Disables a hook and forgets it.
+         */
+        HookStatus Remove(void** slot)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(slot));
+            if (it == m_hooks.end())
+            {
+                return HookStatus::UnknownHook;
+            }
+            const HookStatus status = Apply({ &it->second }, false);
+            if (status != HookStatus::Ok)
+            {
+                return status;
+            }
+            m_hooks.erase(it);
+            return HookStatus::Ok;
+        }
+
+        /**
+         * @return The function the replacement should call, nullptr if the slot has no hook.
+         */
+        const void* Original(void** slot) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(slot));
+            return it == m_hooks.end() ? nullptr : it->second.original;
+        }
+
+        bool IsEnabled(void** slot) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hooks.find(reinterpret_cast<uintptr_t>(slot));
+            return it != m_hooks.end() && it->second.enabled;
+        }
+
+        /**
+         * @return Number of hooks, enabled or not.
+         */
+        size_t Count() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_hooks.size();
+        }
+
+    private:
+        struct Hook
+        {
+            void** slot;
+            const void* replacement;
+            /** The function the slot leads to, resolved if it held a PLT stub; written back by Disable. */
+            const void* original;
+            /** The pointer the slot held when the hook was created. */
+            const void* saved;
+            bool enabled;
+        };
+
+        static const void* Load(void** slot)
+        {
+#ifdef _WIN32
+            return *static_cast<void* volatile*>(slot);
+#else
+            return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+#endif
+        }
+
+        /** Compares DLL names case-insensitively. */
+        static bool SameName(const char* a, const char* b)
+        {
+            for (; *a && *b; a++, b++)
+            {
+                const char x = (*a >= 'A' && *a <= 'Z') ? static_cast<char>(*a - 'A' + 'a') : *a;
+                const char y = (*b >= 'A' && *b <= 'Z') ? static_cast<char>(*b - 'A' + 'a') : *b;
+                if (x != y)
+                {
+                    return false;
+                }
+            }
+            return *a == *b;
+        }
+
+        /** Hooks for the given slots, or all hooks if none are given. */
+        std::vector<Hook*> Select(const std::vector<void**>& slots, bool& unknown)
+        {
+            unknown = false;
+            std::vector<Hook*> hooks;
+            if (slots.empty())
+            {
+                for (auto& entry : m_hooks)
+                {
+                    hooks.push_back(&entry.second);
+                }
+                return hooks;
+            }
+            for (void** slot : slots)
+            {
+                auto it = m_hooks.find(reinterpret_cast<uintptr_t>(slot));
+                if (it == m_hooks.end())
+                {
+                    unknown = true;
+                    continue;
+                }
+                hooks.push_back(&it->second);
+            }
+            return hooks;
+        }
+
+        /** Writes the replacement (enable) or the original (disable) into the slots of a batch. */
+        HookStatus Apply(const std::vector<Hook*>& hooks, bool enable, bool unknown = false)
+        {
+            PatchSet patches;
+            std::vector<Hook*> changed;
+            for (Hook* hook : hooks)
+            {
+                if (hook->enabled == enable)
+                {
+                    continue;
+                }
+                // A lazily bound slot may have been resolved since the hook was created.
+                const void* current = Load(hook->slot);
+                const bool expected = enable ? current == hook->saved || current == hook->original : current == hook->replacement;
+                if (!expected)
+                {
+                    return HookStatus::SlotChanged;
+                }
+                const void* value = enable ? hook->replacement : hook->original;
+                patches.Add(reinterpret_cast<uintptr_t>(hook->slot), reinterpret_cast<const uint8_t*>(&value), sizeof(value),
+                    reinterpret_cast<const uint8_t*>(&current));
+                changed.push_back(hook);
+            }
+            if (changed.empty())
+            {
+                return unknown ? HookStatus::UnknownHook : HookStatus::Ok;
+            }
+
+            switch (patches.Apply())
+            {
+            case PatchStatus::Ok:
+                break;
+            case PatchStatus::Mismatch:
+                return HookStatus::SlotChanged;
+            case PatchStatus::ProtectFailed:
+                return HookStatus::ProtectFailed;
+            case PatchStatus::SuspendFailed:
+                return HookStatus::SuspendFailed;
+            default:
+                return HookStatus::InvalidArgument;
+            }
+            for (Hook* hook : changed)
+            {
+                hook->enabled = enable;
+            }
+            return unknown ? HookStatus::UnknownHook : HookStatus::Ok;
+        }
+
+        std::map<uintptr_t, Hook> m_hooks;
+        mutable std::mutex m_mutex;
+    };
+}
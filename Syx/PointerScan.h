@@ -0,0 +1,495 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "Memory.h"
+#include "MemoryScan.h"
+#include "PointerChain.h"
+#include "Regions.h"
+#include "ThreadPool.h"
+
+namespace SyxLib
+{
+    /**
+     * A static base and the offsets leading from it to a target, in the form Syx::WritePTR,
+     * Syx::ReadPTR and PointerChain take: read the pointer at base, add offsets[0], read the
+     * pointer there, add offsets[1], and so on.
+     */
+    struct PointerPath
+    {
+        uintptr_t base;
+        std::vector<uintptr_t> offsets;
+
+        bool operator==(const PointerPath& other) const
+        {
+            return base == other.base && offsets == other.offsets;
+        }
+
+        bool operator<(const PointerPath& other) const
+        {
+            return base != other.base ? base < other.base : offsets < other.offsets;
+        }
+    };
+
+    /**
+     * Tuning knobs for the pointer scan.
+     */
+    struct PointerScanOptions
+    {
+        /** Maximum number of dereferences in a path. */
+        size_t maxDepth = 4;
+        /** Maximum offset added after a dereference, the size of the largest object to look into. */
+        size_t maxOffset = 0x1000;
+        /** Stop after this many paths. */
+        size_t maxResults = 100000;
+        /** Only follow pointers stored at multiples of the pointer size. */
+        bool aligned = true;
+        /** Number of workers building the index, 0 = every thread of the pool. */
+        unsigned threadCount = 0;
+        /** Pool to build the index on, nullptr = ThreadPool::Default(). */
+        ThreadPool* pool = nullptr;
+    };
+
+    /**
+     * Reverse index of the pointers stored in a set of regions: for every location holding a value
+     * that points into one of the regions, the pair (value, location), sorted by value. The values
+     * and locations are kept in two flat arrays, so the binary searches of a pointer scan only
+     * touch the value array.
+     *
+     * The regions are split into 1 MB chunks that the workers of a pool read and index in parallel;
+     * the per-worker lists are sorted independently and merged.
+     */
+    class PointerMap
+    {
+    public:
+        PointerMap() = default;
+
+        /**
+         * Indexes the pointers stored in a list of regions.
+         *
+         * @param memory The address space to read.
+         * @param regions Regions to index, sorted by base address; writable memory is where pointers live.
+         * @param options Alignment, thread count and pool.
+         */
+        PointerMap(const MemoryAccessor& memory, const std::vector<MemoryRegion>& regions, const PointerScanOptions& options = {})
+            : m_regions(regions)
+        {
+            static constexpr size_t CHUNK_BYTES = 1024 * 1024;
+            const size_t pointerSize = memory.PointerSize();
+            const size_t step = options.aligned ? pointerSize : 1;
+
+            struct Chunk
+            {
+                uintptr_t base;
+                size_t size;
+            };
+            std::vector<Chunk> chunks;
+            for (const MemoryRegion& region : m_regions)
+            {
+                for (size_t offset = 0; offset < region.size; offset += CHUNK_BYTES)
+                {
+                    chunks.push_back({ region.base + offset, (std::min)(CHUNK_BYTES, region.size - offset) });
+                }
+            }
+            if (chunks.empty())
+            {
+                return;
+            }
+
+            ThreadPool& pool = options.pool ? *options.pool : ThreadPool::Default();
+            unsigned workers = options.threadCount ? options.threadCount : pool.Concurrency();
+            workers = static_cast<unsigned>((std::min<size_t>)({ workers, pool.Concurrency(), chunks.size() }));
+
+            // Entries are appended to fixed-size blocks that are not moved or freed until every
+            // chunk has been read: freeing a large buffer unmaps it, and the region list of the
+            // current process would then name memory that is gone.
+            static constexpr size_t BLOCK_ENTRIES = 64 * 1024;
+            size_t total = 0;
+            for (const Chunk& chunk : chunks)
+            {
+                total += chunk.size / step + 1;
+            }
+            std::vector<std::vector<std::unique_ptr<Entry[]>>> blocks(workers);
+            std::vector<size_t> filled(workers, BLOCK_ENTRIES);
+            for (auto& list : blocks)
+            {
+                list.reserve(total / BLOCK_ENTRIES + chunks.size() + 1);
+            }
+
+            std::atomic<size_t> next{ 0 };
+            auto task = [&](unsigned self)
+            {
+                std::vector<std::unique_ptr<Entry[]>>& list = blocks[self];
+                size_t& used = filled[self];
+                std::vector<MemoryRegion> piece(1);
+                for (size_t i; (i = next.fetch_add(1)) < chunks.size();)
+                {
+                    // A chunk is read pointerSize - 1 bytes past its end, so pointers straddling
+                    // two chunks are seen once, by the chunk they start in.
+                    const Chunk& chunk = chunks[i];
+                    const uintptr_t chunkEnd = chunk.base + chunk.size;
+                    piece[0].base = chunk.base;
+                    piece[0].size = chunk.size + (std::min<size_t>)(pointerSize - 1, RegionEnd(chunk.base) - chunkEnd);
+                    Detail::ForEachBlock(memory, piece, pointerSize - 1, DEFAULT_BLOCK_SIZE,
+                        [&](uintptr_t address, const uint8_t* data, size_t size)
+                        {
+                            size_t offset = static_cast<size_t>(((address + step - 1) & ~static_cast<uintptr_t>(step - 1)) - address);
+                            for (; offset + pointerSize <= size && address + offset < chunkEnd; offset += step)
+                            {
+                                const uintptr_t value = LoadPointer(data + offset, pointerSize);
+                                if (Contains(value))
+                                {
+                                    if (used == BLOCK_ENTRIES)
+                                    {
+                                        list.emplace_back(new Entry[BLOCK_ENTRIES]);
+                                        used = 0;
+                                    }
+                                    list.back()[used++] = { value, address + offset };
+                                }
+                            }
+                            return true;
+                        });
+                }
+            };
+            if (workers <= 1)
+            {
+                task(0);
+            }
+            else
+            {
+                pool.Run(workers, task);
+            }
+
+            std::vector<std::vector<Entry>> lists(workers);
+            auto gather = [&](unsigned self)
+            {
+                std::vector<Entry>& list = lists[self];
+                for (size_t b = 0; b < blocks[self].size(); b++)
+                {
+                    const Entry* block = blocks[self][b].get();
+                    list.insert(list.end(), block, block + (b + 1 == blocks[self].size() ? filled[self] : BLOCK_ENTRIES));
+                }
+                std::vector<std::unique_ptr<Entry[]>>().swap(blocks[self]);
+                std::sort(list.begin(), list.end());
+            };
+            if (workers <= 1)
+            {
+                gather(0);
+            }
+            else
+            {
+                pool.Run(workers, gather);
+            }
+
+            // Merge the sorted lists pairwise, then split them into the two flat arrays.
+            for (size_t width = 1; width < lists.size(); width *= 2)
+            {
+                for (size_t i = 0; i + width < lists.size(); i += 2 * width)
+                {
+                    std::vector<Entry> merged(lists[i].size() + lists[i + width].size());
+                    std::merge(lists[i].begin(), lists[i].end(), lists[i + width].begin(), lists[i + width].end(), merged.begin());
+                    lists[i] = static_cast<std::vector<Entry>&&>(merged);
+                    std::vector<Entry>().swap(lists[i + width]);
+                }
+            }
+            const std::vector<Entry>& entries = lists[0];
+            m_values.resize(entries.size());
+            m_locations.resize(entries.size());
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                m_values[i] = entries[i].value;
+                m_locations[i] = entries[i].location;
+            }
+        }
+
+        /**
+         * @return Number of indexed pointers.
+         */
+        size_t Size() const
+        {
+            return m_values.size();
+        }
+
+        /**
+         * @return The indexed regions.
+         */
+        const std::vector<MemoryRegion>& Regions() const
+        {
+            return m_regions;
+        }
+
+        /**
+         * Calls a function for every location holding a pointer in [lo, hi], in ascending value order.
+         *
+         * @param callback Called with (location, value).
+         */
+        template <typename Callback>
+        void ForEachReference(uintptr_t lo, uintptr_t hi, Callback&& callback) const
+        {
+            size_t i = std::lower_bound(m_values.begin(), m_values.end(), lo) - m_values.begin();
+            for (; i < m_values.size() && m_values[i] <= hi; i++)
+            {
+                callback(m_locations[i], m_values[i]);
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            uintptr_t value;
+            uintptr_t location;
+
+            bool operator<(const Entry& other) const
+            {
+                return value != other.value ? value < other.value : location < other.location;
+            }
+        };
+
+        static uintptr_t LoadPointer(const uint8_t* data, size_t pointerSize)
+        {
+            if (pointerSize == 4)
+            {
+                uint32_t pointer;
+                memcpy(&pointer, data, sizeof(pointer));
+                return pointer;
+            }
+            uint64_t pointer;
+            memcpy(&pointer, data, sizeof(pointer));
+            return static_cast<uintptr_t>(pointer);
+        }
+
+        /** Index of the last region starting at or below an address, or SIZE_MAX. */
+        size_t RegionIndex(uintptr_t address) const
+        {
+            auto it = std::upper_bound(m_regions.begin(), m_regions.end(), address,
+                [](uintptr_t value, const MemoryRegion& region) { return value < region.base; });
+            return it == m_regions.begin() ? SIZE_MAX : static_cast<size_t>(it - m_regions.begin()) - 1;
+        }
+
+        bool Contains(uintptr_t address) const
+        {
+            const size_t index = RegionIndex(address);
+            return index != SIZE_MAX && address - m_regions[index].base < m_regions[index].size;
+        }
+
+        /** End of the region holding an address. */
+        uintptr_t RegionEnd(uintptr_t address) const
+        {
+            const MemoryRegion& region = m_regions[RegionIndex(address)];
+            return region.base + region.size;
+        }
+
+        std::vector<MemoryRegion> m_regions;
+        /** Pointer values in ascending order. */
+        std::vector<uintptr_t> m_values;
+        /** m_locations[i] holds m_values[i]. */
+        std::vector<uintptr_t> m_locations;
+    };
+
+    /**
+     * Finds the paths from static memory to a target address.
+     *
+     * The search runs backwards from the target, one level per dereference. Level 0 is the target;
+     * level k + 1 holds every indexed location whose pointer lands at most maxOffset bytes below a
+     * level k address. Each level is deduplicated and sorted, so shared subpaths are expanded once
+     * and the search stays bounded by maxDepth times the index size. Every level k location inside
+     * a static region is the base of paths of depth k, which are then enumerated forwards through
+     * the levels until maxResults is reached. Shorter paths come first.
+     *
+     * @param map Index of the pointers in the memory to search; it must include the static regions.
+     * @param target The address the paths must reach.
+     * @param staticRegions Regions whose addresses are stable across runs, typically a module's writable sections.
+     * @param options Depth, offset and result limits.
+     * @return The paths found, in (depth, base, offsets) order.
+     */
+    inline std::vector<PointerPath> FindPointerPaths(const PointerMap& map, uintptr_t target,
+        const std::vector<MemoryRegion>& staticRegions, const PointerScanOptions& options = {})
+    {
+        std::vector<PointerPath> paths;
+        if (!target || options.maxResults == 0)
+        {
+            return paths;
+        }
+
+        auto isStatic = [&](uintptr_t address)
+        {
+            auto it = std::upper_bound(staticRegions.begin(), staticRegions.end(), address,
+                [](uintptr_t value, const MemoryRegion& region) { return value < region.base; });
+            return it != staticRegions.begin() && address - (it - 1)->base < (it - 1)->size;
+        };
+        // levels[k]: sorted, distinct addresses k dereferences away from the target, with the
+        // pointer each one holds (unused for level 0).
+        struct Node
+        {
+            uintptr_t address;
+            uintptr_t value;
+
+            bool operator<(const Node& other) const
+            {
+                return address < other.address;
+            }
+        };
+        std::vector<std::vector<Node>> levels(1, std::vector<Node>{ { target, 0 } });
+        std::vector<uintptr_t> offsets;
+
+        // Enumerates the paths from a level k location down to the target.
+        auto emit = [&](size_t level, const Node& base)
+        {
+            offsets.resize(level);
+            struct Frame
+            {
+                size_t level;
+                uintptr_t value;
+                size_t next;
+            };
+            std::vector<Frame> stack{ { level, base.value, 0 } };
+            while (!stack.empty() && paths.size() < options.maxResults)
+            {
+                Frame& frame = stack.back();
+                const std::vector<Node>& below = levels[frame.level - 1];
+                if (frame.next == 0)
+                {
+                    frame.next = std::lower_bound(below.begin(), below.end(), Node{ frame.value, 0 }) - below.begin() + 1;
+                }
+                const size_t index = frame.next - 1;
+                if (index >= below.size() || below[index].address - frame.value > options.maxOffset)
+                {
+                    stack.pop_back();
+                    continue;
+                }
+                frame.next++;
+                const Node& child = below[index];
+                offsets[level - frame.level] = child.address - frame.value;
+                if (frame.level == 1)
+                {
+                    paths.push_back({ base.address, offsets });
+                }
+                else
+                {
+                    stack.push_back({ frame.level - 1, child.value, 0 });
+                }
+            }
+        };
+
+        for (size_t level = 1; level <= options.maxDepth && paths.size() < options.maxResults; level++)
+        {
+            const std::vector<Node>& below = levels[level - 1];
+            std::vector<Node> nodes;
+            // The windows [address - maxOffset, address] of consecutive nodes overlap; each index
+            // entry is visited once by sweeping the merged windows.
+            for (size_t i = 0; i < below.size();)
+            {
+                const uintptr_t lo = below[i].address > options.maxOffset ? below[i].address - options.maxOffset : 0;
+                uintptr_t hi = below[i].address;
+                while (++i < below.size() && (below[i].address <= options.maxOffset || below[i].address - options.maxOffset <= hi + 1))
+                {
+                    hi = below[i].address;
+                }
+                map.ForEachReference(lo, hi, [&](uintptr_t location, uintptr_t value) { nodes.push_back({ location, value }); });
+            }
+            if (nodes.empty())
+            {
+                break;
+            }
+            std::sort(nodes.begin(), nodes.end());
+            nodes.erase(std::unique(nodes.begin(), nodes.end(),
+                [](const Node& a, const Node& b) { return a.address == b.address; }), nodes.end());
+            levels.push_back(static_cast<std::vector<Node>&&>(nodes));
+
+            for (const Node& node : levels.back())
+            {
+                if (paths.size() >= options.maxResults)
+                {
+                    break;
+                }
+                if (isStatic(node.address))
+                {
+                    emit(level, node);
+                }
+            }
+        }
+        return paths;
+    }
+
+    /**
+     * Scans an address space for paths from static memory to a target. Indexes the pointers stored
+     * in its writable memory, then runs FindPointerPaths.
+     *
+     * @param memory The address space.
+     * @param target The address the paths must reach.
+     * @param staticRegions Regions whose addresses are stable across runs, typically a module's writable sections.
+     * @param options Depth, offset, result and thread limits.
+     * @return The paths found, shortest first.
+     */
+    inline std::vector<PointerPath> FindPointerPaths(const MemoryAccessor& memory, uintptr_t target,
+        const std::vector<MemoryRegion>& staticRegions, const PointerScanOptions& options = {})
+    {
+        const PointerMap map(memory, FilterRegions(memory.QueryRegions(), RegionFilter::Writable()), options);
+        return FindPointerPaths(map, target, staticRegions, options);
+    }
+
+    /**
+     * Keeps the paths that still lead to a target, for example after the object moved or the
+     * process was restarted. All paths are resolved together with ResolveChains.
+     *
+     * @param memory The address space.
+     * @param paths Paths from an earlier scan.
+     * @param target Where the paths must lead now.
+     * @param baseDelta Added to every base first, the distance the module moved since the earlier scan.
+     * @return The surviving paths, rebased, in their original order.
+     */
+    inline std::vector<PointerPath> FilterPointerPaths(const MemoryAccessor& memory, const std::vector<PointerPath>& paths,
+        uintptr_t target, intptr_t baseDelta = 0)
+    {
+        std::vector<PointerChain> chains;
+        chains.reserve(paths.size());
+        for (const PointerPath& path : paths)
+        {
+            chains.emplace_back(path.base + baseDelta, path.offsets);
+        }
+        ResolveChains(memory, chains.data(), chains.size());
+
+        std::vector<PointerPath> kept;
+        for (size_t i = 0; i < chains.size(); i++)
+        {
+            if (chains[i].CachedAddress() == target)
+            {
+                kept.push_back({ chains[i].Base(), paths[i].offsets });
+            }
+        }
+        return kept;
+    }
+
+    /**
+     * Keeps the paths found by two scans, for example before and after a restart.
+     *
+     * @param previous Paths of the earlier scan.
+     * @param current Paths of the later scan.
+     * @param baseDelta Added to the bases of previous, the distance the module moved between the scans.
+     * @return The paths of current that previous also found, in current's order.
+     */
+    inline std::vector<PointerPath> IntersectPointerPaths(const std::vector<PointerPath>& previous,
+        const std::vector<PointerPath>& current, intptr_t baseDelta = 0)
+    {
+        std::vector<PointerPath> sorted(previous);
+        for (PointerPath& path : sorted)
+        {
+            path.base += baseDelta;
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<PointerPath> kept;
+        for (const PointerPath& path : current)
+        {
+            if (std::binary_search(sorted.begin(), sorted.end(), path))
+            {
+                kept.push_back(path);
+            }
+        }
+        return kept;
+    }
+}
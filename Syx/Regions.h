@@ -0,0 +1,396 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "Scanner.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace SyxLib
+{
+    /**
+     * A range of committed memory with uniform protection.
+     */
+    struct MemoryRegion
+    {
+        uintptr_t base;
+        size_t size;
+        /** Combination of MemoryProtection flags, PROTECT_NONE for guard and no-access pages. */
+        uint32_t protection;
+        /** Image section name, or the mapped file path when the region comes from the OS map. */
+        std::string name;
+    };
+
+    /**
+     * Selects the regions a scan should visit.
+     */
+    struct RegionFilter
+    {
+        /** Every one of these MemoryProtection flags must be present. */
+        uint32_t requiredProtection = PROTECT_READ;
+        /** None of these MemoryProtection flags may be present. */
+        uint32_t excludedProtection = PROTECT_NONE;
+        /** If set, only regions with exactly this name are kept (for example ".text"). */
+        std::string name;
+
+        /** Readable memory, the default. */
+        static RegionFilter Readable()
+        {
+            return RegionFilter();
+        }
+
+        /** Readable and executable memory (r-x and rwx), where code signatures live. */
+        static RegionFilter Code()
+        {
+            RegionFilter filter;
+            filter.requiredProtection = PROTECT_READ | PROTECT_EXECUTE;
+            return filter;
+        }
+
+        /** Readable and writable memory, where heap, stack and global data live. */
+        static RegionFilter Writable()
+        {
+            RegionFilter filter;
+            filter.requiredProtection = PROTECT_READ | PROTECT_WRITE;
+            return filter;
+        }
+
+        /** Readable memory of one named image section. */
+        static RegionFilter Section(const std::string& sectionName)
+        {
+            RegionFilter filter;
+            filter.name = sectionName;
+            return filter;
+        }
+
+        bool Accepts(const MemoryRegion& region) const
+        {
+            return (region.protection & requiredProtection) == requiredProtection &&
+                !(region.protection & excludedProtection) &&
+                (name.empty() || region.name == name);
+        }
+    };
+
+    /**
+     * Keeps the regions a filter accepts and merges neighbours that touch, so patterns
+     * spanning a protection boundary inside the accepted set are still found.
+     *
+     * @param regions Regions sorted by base address.
+     * @param filter The filter to apply.
+     * @return Accepted regions, sorted and coalesced.
+     */
+    inline std::vector<MemoryRegion> FilterRegions(const std::vector<MemoryRegion>& regions, const RegionFilter& filter)
+    {
+        std::vector<MemoryRegion> result;
+        for (const MemoryRegion& region : regions)
+        {
+            if (!filter.Accepts(region) || region.size == 0)
+            {
+                continue;
+            }
+            if (!result.empty() && result.back().base + result.back().size == region.base)
+            {
+                MemoryRegion& last = result.back();
+                last.size += region.size;
+                last.protection &= region.protection;
+                if (last.name != region.name)
+                {
+                    last.name.clear();
+                }
+                continue;
+            }
+            result.push_back(region);
+        }
+        return result;
+    }
+
+    /**
+     * Splits image sections along the boundaries of the OS regions they overlap. Each piece keeps
+     * the section name but takes the current OS protection, which may differ from the section
+     * characteristics after VirtualProtect/mprotect. Parts of sections not covered by any OS
+     * region are dropped.
+     *
+     * @param sections Sections of the image, in address order.
+     * @param imageBase Address the image is loaded at.
+     * @param osRegions Regions reported by the OS, sorted by base address.
+     * @return Section pieces sorted by address.
+     */
+    inline std::vector<MemoryRegion> IntersectSections(const std::vector<ImageSection>& sections, uintptr_t imageBase,
+        const std::vector<MemoryRegion>& osRegions)
+    {
+        std::vector<MemoryRegion> result;
+        for (const ImageSection& section : sections)
+        {
+            const uintptr_t begin = imageBase + static_cast<uintptr_t>(section.virtualAddress);
+            const uintptr_t end = begin + static_cast<uintptr_t>(section.virtualSize);
+            auto it = std::upper_bound(osRegions.begin(), osRegions.end(), begin,
+                [](uintptr_t address, const MemoryRegion& region) { return address < region.base; });
+            if (it != osRegions.begin())
+            {
+                --it;
+            }
+            for (; it != osRegions.end() && it->base < end; ++it)
+            {
+                const uintptr_t from = (std::max)(begin, it->base);
+                const uintptr_t to = (std::min)(end, it->base + it->size);
+                if (from < to)
+                {
+                    result.push_back({ from, to - from, it->protection, section.name });
+                }
+            }
+        }
+        std::sort(result.begin(), result.end(),
+            [](const MemoryRegion& a, const MemoryRegion& b) { return a.base < b.base; });
+        return result;
+    }
+
+    /**
+     * Parses the text of a /proc/<pid>/maps file.
+     *
+     * @param text Contents of the maps file.
+     * @return One region per line, in file (address) order.
+     */
+    inline std::vector<MemoryRegion> ParseProcMaps(const std::string& text)
+    {
+        std::vector<MemoryRegion> regions;
+        size_t line = 0;
+        while (line < text.size())
+        {
+            size_t next = text.find('\n', line);
+            if (next == std::string::npos)
+            {
+                next = text.size();
+            }
+
+            // start-end perms offset dev inode [path]
+            const char* p = text.c_str() + line;
+            char* cursor;
+            const unsigned long long start = strtoull(p, &cursor, 16);
+            if (*cursor == '-')
+            {
+                const unsigned long long end = strtoull(cursor + 1, &cursor, 16);
+                while (*cursor == ' ')
+                {
+                    cursor++;
+                }
+                MemoryRegion region{ static_cast<uintptr_t>(start), static_cast<size_t>(end - start), PROTECT_NONE, std::string() };
+                if (cursor[0] == 'r')
+                {
+                    region.protection |= PROTECT_READ;
+                }
+                if (cursor[0] && cursor[1] == 'w')
+                {
+                    region.protection |= PROTECT_WRITE;
+                }
+                if (cursor[0] && cursor[1] && cursor[2] == 'x')
+                {
+                    region.protection |= PROTECT_EXECUTE;
+                }
+
+                // The path is the sixth field and may contain spaces.
+                const char* field = cursor;
+                const char* lineEnd = text.c_str() + next;
+                for (int i = 0; i < 4 && field < lineEnd; i++)
+                {
+                    while (field < lineEnd && *field != ' ')
+                    {
+                        field++;
+                    }
+                    while (field < lineEnd && *field == ' ')
+                    {
+                        field++;
+                    }
+                }
+                if (field < lineEnd)
+                {
+                    region.name.assign(field, lineEnd);
+                }
+                regions.push_back(region);
+            }
+            line = next + 1;
+        }
+        return regions;
+    }
+
+    namespace Detail
+    {
+#ifdef _WIN32
+        inline uint32_t ProtectionFromWin32(DWORD protect)
+        {
+            uint32_t protection = PROTECT_NONE;
+            if (!(protect & (PAGE_GUARD | PAGE_NOACCESS)))
+            {
+                const DWORD access = protect & 0xFF;
+                if (access & (PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY))
+                {
+                    protection |= PROTECT_READ;
+                }
+                if (access & (PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY))
+                {
+                    protection |= PROTECT_WRITE;
+                }
+                if (access & (PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY))
+                {
+                    protection |= PROTECT_EXECUTE;
+                }
+            }
+            return protection;
+        }
+
+        /** Walks VirtualQueryEx over [begin, end) of a process. */
+        inline std::vector<MemoryRegion> QueryProcessRegions(HANDLE process, uintptr_t begin, uintptr_t end)
+        {
+            std::vector<MemoryRegion> regions;
+            MEMORY_BASIC_INFORMATION mbi;
+            uintptr_t address = begin;
+            while (address < end && VirtualQueryEx(process, reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)))
+            {
+                const uintptr_t regionBase = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+                const uintptr_t next = regionBase + mbi.RegionSize;
+                if (next <= address)
+                {
+                    break;
+                }
+                address = next;
+                if (mbi.State != MEM_COMMIT)
+                {
+                    continue;
+                }
+
+                const uintptr_t from = (std::max)(begin, regionBase);
+                const uintptr_t to = (std::min)(end, next);
+                regions.push_back({ from, to - from, ProtectionFromWin32(mbi.Protect), std::string() });
+            }
+            return regions;
+        }
+#else
+        /** Reads a maps file such as /proc/self/maps and clips its regions to [begin, end). */
+        inline std::vector<MemoryRegion> QueryMapsFile(const char* path, uintptr_t begin, uintptr_t end)
+        {
+            std::string text;
+            if (FILE* file = fopen(path, "r"))
+            {
+                char buffer[4096];
+                size_t read;
+                while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                {
+                    text.append(buffer, read);
+                }
+                fclose(file);
+            }
+
+            std::vector<MemoryRegion> regions;
+            for (MemoryRegion& region : ParseProcMaps(text))
+            {
+                const uintptr_t from = (std::max)(begin, region.base);
+                const uintptr_t to = (std::min)(end, region.base + region.size);
+                if (from < to)
+                {
+                    region.size = to - from;
+                    region.base = from;
+                    regions.push_back(region);
+                }
+            }
+            return regions;
+        }
+#endif
+    }
+
+    /**
+     * Enumerates the committed memory regions of the current process that overlap a range.
+     * Windows walks VirtualQuery, Linux parses /proc/self/maps. Regions are clipped to the range.
+     *
+     * @param begin Start of the range.
+     * @param end End of the range (exclusive).
+     * @return Regions sorted by base address. Guard and no-access pages have PROTECT_NONE.
+     */
+    inline std::vector<MemoryRegion> QueryRegions(uintptr_t begin = 0, uintptr_t end = UINTPTR_MAX)
+    {
+#ifdef _WIN32
+        return Detail::QueryProcessRegions(GetCurrentProcess(), begin, end);
+#else
+        return Detail::QueryMapsFile("/proc/self/maps", begin, end);
+#endif
+    }
+
+    namespace Detail
+    {
+        /**
+         * @return Bytes readable from address to the end of the region that holds it, 0 if the
+         *         address is not readable.
+         */
+        inline size_t ReadableBytesAt(uintptr_t address)
+        {
+#ifdef _WIN32
+            MEMORY_BASIC_INFORMATION mbi;
+            if (!VirtualQuery(reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT ||
+                !(ProtectionFromWin32(mbi.Protect) & PROTECT_READ))
+            {
+                return 0;
+            }
+            return reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize - address;
+#else
+            const std::vector<MemoryRegion> regions = QueryRegions(address, UINTPTR_MAX);
+            if (regions.empty() || regions.front().base != address || !(regions.front().protection & PROTECT_READ))
+            {
+                return 0;
+            }
+            return regions.front().size;
+#endif
+        }
+    }
+
+    /**
+     * Enumerates the sections of a module loaded in the current process with their current protection.
+     * The section table comes from the module's PE or ELF headers, the protection from QueryRegions.
+     *
+     * @param moduleBase Address the module's PE or ELF header is loaded at.
+     * @return Section pieces sorted by address, empty if the headers cannot be parsed.
+     */
+    inline std::vector<MemoryRegion> QueryModuleRegions(uintptr_t moduleBase)
+    {
+        // The headers and the tables they point to lie in the first mapping of the module; offsets
+        // in a corrupt header that lead past it are rejected instead of dereferenced.
+        const uint8_t* image = reinterpret_cast<const uint8_t*>(moduleBase);
+        const size_t readable = moduleBase ? Detail::ReadableBytesAt(moduleBase) : 0;
+        std::vector<ImageSection> sections;
+        if (!readable || !ParseImageSections(image, readable, sections) || sections.empty())
+        {
+            return {};
+        }
+
+        uintptr_t imageEnd = moduleBase;
+        for (const ImageSection& section : sections)
+        {
+            imageEnd = (std::max)(imageEnd, moduleBase + static_cast<uintptr_t>(section.virtualAddress + section.virtualSize));
+        }
+        return IntersectSections(sections, moduleBase, QueryRegions(moduleBase, imageEnd));
+    }
+
+    /**
+     * Finds the lowest match of a pattern across a list of regions.
+     *
+     * @param scanner The compiled pattern.
+     * @param regions Readable regions sorted by base address, typically the output of FilterRegions.
+     * @return The address of the first match, or 0 if not found.
+     */
+    inline uintptr_t FindInRegions(const Scanner& scanner, const std::vector<MemoryRegion>& regions)
+    {
+        for (const MemoryRegion& region : regions)
+        {
+            const size_t offset = scanner.Find(reinterpret_cast<const uint8_t*>(region.base), region.size);
+            if (offset != NOT_FOUND)
+            {
+                return region.base + offset;
+            }
+        }
+        return 0;
+    }
+}
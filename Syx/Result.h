@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+
+namespace SyxLib
+{
+    /** Why a checked memory access failed. */
+    enum class MemoryError : uint8_t
+    {
+        None,
+        /** A pointer on the path was null. */
+        NullPointer,
+        /** The address is not committed memory. */
+        Unmapped,
+        /** The memory exists but does not allow the access (no-access, guard or read-only pages). */
+        ProtectionDenied
+    };
+
+    /**
+     * @return A short description of the error.
+     */
+    inline const char* ToString(MemoryError error)
+    {
+        switch (error)
+        {
+        case MemoryError::None:
+            return "no error";
+        case MemoryError::NullPointer:
+            return "null pointer";
+        case MemoryError::Unmapped:
+            return "address is not mapped";
+        case MemoryError::ProtectionDenied:
+            return "page protection denies the access";
+        }
+        return "unknown error";
+    }
+
+    /**
+     * The value of a checked memory access or the reason it failed, in the spirit of std::expected.
+     * Constructing and testing a Result never throws and never allocates.
+     *
+     * @example
+     * if (auto health = memory.TryRead<int>(address))
+     *     printf("%d\n", *health);
+     * else
+     *     printf("%s\n", SyxLib::ToString(health.Error()));
+     */
+    template <typename T>
+    class Result
+    {
+    public:
+        Result(const T& value)
+            : m_value(value), m_error(MemoryError::None)
+        {
+        }
+
+        Result(MemoryError error)
+            : m_value(), m_error(error)
+        {
+        }
+
+        bool HasValue() const
+        {
+            return m_error == MemoryError::None;
+        }
+
+        explicit operator bool() const
+        {
+            return HasValue();
+        }
+
+        MemoryError Error() const
+        {
+            return m_error;
+        }
+
+        /**
+         * @return The value.
+         * @throw std::logic_error if the result holds an error. Test the result first on hot paths.
+         */
+        const T& Value() const
+        {
+            if (!HasValue())
+            {
+                throw std::logic_error(ToString(m_error));
+            }
+            return m_value;
+        }
+
+        /**
+         * @return The value, or fallback if the result holds an error.
+         */
+        T ValueOr(const T& fallback) const
+        {
+            return HasValue() ? m_value : fallback;
+        }
+
+        /** Unchecked access; the result must hold a value. */
+        const T& operator*() const
+        {
+            return m_value;
+        }
+
+        const T* operator->() const
+        {
+            return &m_value;
+        }
+
+    private:
+        T m_value;
+        MemoryError m_error;
+    };
+
+    /**
+     * The outcome of a checked memory access that produces no value, such as a write.
+     */
+    template <>
+    class Result<void>
+    {
+    public:
+        Result()
+            : m_error(MemoryError::None)
+        {
+        }
+
+        Result(MemoryError error)
+            : m_error(error)
+        {
+        }
+
+        bool HasValue() const
+        {
+            return m_error == MemoryError::None;
+        }
+
+        explicit operator bool() const
+        {
+            return HasValue();
+        }
+
+        MemoryError Error() const
+        {
+            return m_error;
+        }
+
+    private:
+        MemoryError m_error;
+    };
+}
@@ -0,0 +1,304 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+#include "Memory.h"
+#include "Result.h"
+
+namespace SyxLib
+{
+    /**
+     * A cached, sorted map of the committed regions of an address space, used to validate
+     * addresses with a binary search instead of touching them.
+     *
+     * The map is refreshed lazily: when it is older than the maximum age, and when a lookup misses
+     * (the memory may have been allocated or reprotected since the last refresh). Refreshes after a
+     * miss are rate-limited, so a loop probing a bad pointer does not rebuild the map every time.
+     * Memory freed after the last refresh still looks valid until the next refresh; call
+     * Invalidate() after unmapping memory you know about.
+     *
+     * Lookups take a shared lock and may run on any number of threads.
+     */
+    class RegionMap
+    {
+    public:
+        /**
+         * @param source The address space whose regions are mapped.
+         * @param maxAge Age after which the map is rebuilt on the next lookup.
+         * @param missCooldown Minimum time between two refreshes triggered by misses.
+         */
+        explicit RegionMap(const MemoryAccessor& source = LocalMemory::Instance(),
+            std::chrono::milliseconds maxAge = std::chrono::milliseconds(1000),
+            std::chrono::milliseconds missCooldown = std::chrono::milliseconds(50))
+            : m_source(source), m_maxAge(maxAge), m_missCooldown(missCooldown)
+        {
+        }
+
+        RegionMap(const RegionMap&) = delete;
+        RegionMap& operator=(const RegionMap&) = delete;
+
+        /**
+         * Returns how many bytes starting at address allow an access.
+         *
+         * @param address Start of the access.
+         * @param size Size of the access.
+         * @param required MemoryProtection flags the access needs.
+         * @param error Optional, receives why the access stops short of size.
+         * @return Length of the accessible prefix, size if the whole access is allowed.
+         */
+        size_t Accessible(uintptr_t address, size_t size, uint32_t required, MemoryError* error = nullptr)
+        {
+            const Clock::time_point now = Clock::now();
+            if (now - Clock::time_point(Clock::duration(m_refreshed.load(std::memory_order_relaxed))) > m_maxAge)
+            {
+                Refresh();
+            }
+
+            MemoryError reason;
+            size_t accessible = Lookup(address, size, required, reason);
+            if (accessible < size &&
+                now - Clock::time_point(Clock::duration(m_refreshed.load(std::memory_order_relaxed))) > m_missCooldown)
+            {
+                Refresh();
+                accessible = Lookup(address, size, required, reason);
+            }
+            if (error)
+            {
+                *error = accessible < size ? reason : MemoryError::None;
+            }
+            return accessible;
+        }
+
+        /**
+         * Checks a whole access.
+         *
+         * @return MemoryError::None if every byte of [address, address + size) allows the access.
+         */
+        MemoryError Check(uintptr_t address, size_t size, uint32_t required)
+        {
+            MemoryError error;
+            Accessible(address, size, required, &error);
+            return error;
+        }
+
+        /** Rebuilds the map now. */
+        void Refresh()
+        {
+            std::vector<Range> ranges;
+            for (const MemoryRegion& region : m_source.QueryRegions())
+            {
+                const uintptr_t end = region.base + region.size;
+                if (!ranges.empty() && ranges.back().end == region.base && ranges.back().protection == region.protection)
+                {
+                    ranges.back().end = end;
+                }
+                else
+                {
+                    ranges.push_back({ region.base, end, region.protection });
+                }
+            }
+
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_ranges.swap(ranges);
+            m_refreshed.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        }
+
+        /** Forces a refresh on the next lookup. */
+        void Invalidate()
+        {
+            m_refreshed.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Range
+        {
+            uintptr_t begin;
+            uintptr_t end;
+            uint32_t protection;
+        };
+
+        size_t Lookup(uintptr_t address, size_t size, uint32_t required, MemoryError& error) const
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            const uintptr_t end = size > UINTPTR_MAX - address ? UINTPTR_MAX : address + size;
+            uintptr_t cursor = address;
+            auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), address,
+                [](uintptr_t value, const Range& range) { return value < range.begin; });
+            if (it != m_ranges.begin())
+            {
+                --it;
+            }
+
+            // An access may span several adjacent ranges with different protection.
+            while (cursor < end)
+            {
+                if (it == m_ranges.end() || cursor < it->begin || cursor >= it->end)
+                {
+                    error = MemoryError::Unmapped;
+                    return cursor - address;
+                }
+                if ((it->protection & required) != required)
+                {
+                    error = MemoryError::ProtectionDenied;
+                    return cursor - address;
+                }
+                cursor = it->end;
+                ++it;
+            }
+            error = MemoryError::None;
+            return size;
+        }
+
+        const MemoryAccessor& m_source;
+        const Clock::duration m_maxAge;
+        const Clock::duration m_missCooldown;
+        mutable std::shared_mutex m_mutex;
+        std::vector<Range> m_ranges;
+        std::atomic<Clock::rep> m_refreshed{ 0 };
+    };
+
+    /**
+     * The current process, with every access checked against a RegionMap first. Reads of unmapped
+     * or no-access memory and writes to read-only memory are rejected instead of faulting, so no
+     * exception handling or signal handler is involved.
+     *
+     * As a MemoryAccessor it can drive scans and PointerChains safely. The Try* functions return
+     * Results that say why an access was rejected.
+     *
+     * @example
+     * SyxLib::SafeMemory& memory = SyxLib::SafeMemory::Instance();
+     * SyxLib::Result<float> speed = memory.TryRead<float>(address);
+     * if (speed && memory.TryWrite(address, *speed * 2.0f)) ...
+     */
+    class SafeMemory final : public MemoryAccessor
+    {
+    public:
+        SafeMemory() = default;
+
+        /**
+         * Reads a value.
+         *
+         * @return The value, or why the read was rejected.
+         */
+        template <typename T>
+        Result<T> TryRead(uintptr_t address)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "TryRead needs a trivially copyable type.");
+            if (!address)
+            {
+                return MemoryError::NullPointer;
+            }
+            MemoryError error;
+            if (m_map.Accessible(address, sizeof(T), PROTECT_READ, &error) != sizeof(T))
+            {
+                return error;
+            }
+            T value;
+            memcpy(&value, reinterpret_cast<const void*>(address), sizeof(T));
+            return value;
+        }
+
+        /**
+         * Writes a value. Page protection is not changed.
+         *
+         * @return Why the write was rejected, if it was.
+         */
+        template <typename T>
+        Result<void> TryWrite(uintptr_t address, const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "TryWrite needs a trivially copyable type.");
+            if (!address)
+            {
+                return MemoryError::NullPointer;
+            }
+            MemoryError error;
+            if (m_map.Accessible(address, sizeof(T), PROTECT_READ | PROTECT_WRITE, &error) != sizeof(T))
+            {
+                return error;
+            }
+            memcpy(reinterpret_cast<void*>(address), &value, sizeof(T));
+            return Result<void>();
+        }
+
+        /**
+         * Follows a multi-level pointer like Syx::WritePTR, checking every dereference.
+         *
+         * @return The final address, or why the walk stopped.
+         */
+        Result<uintptr_t> TryResolve(uintptr_t base, const std::vector<uintptr_t>& offsets)
+        {
+            uintptr_t current = base;
+            for (uintptr_t offset : offsets)
+            {
+                const Result<uintptr_t> pointer = TryRead<uintptr_t>(current);
+                if (!pointer)
+                {
+                    return pointer.Error();
+                }
+                if (!*pointer)
+                {
+                    return MemoryError::NullPointer;
+                }
+                current = *pointer + offset;
+            }
+            if (!current)
+            {
+                return MemoryError::NullPointer;
+            }
+            return current;
+        }
+
+        size_t ReadBytes(uintptr_t address, void* buffer, size_t size) const override
+        {
+            const size_t accessible = m_map.Accessible(address, size, PROTECT_READ);
+            memcpy(buffer, reinterpret_cast<const void*>(address), accessible);
+            return accessible;
+        }
+
+        size_t WriteBytes(uintptr_t address, const void* buffer, size_t size) const override
+        {
+            const size_t accessible = m_map.Accessible(address, size, PROTECT_READ | PROTECT_WRITE);
+            memcpy(reinterpret_cast<void*>(address), buffer, accessible);
+            return accessible;
+        }
+
+        std::vector<MemoryRegion> QueryRegions(uintptr_t begin = 0, uintptr_t end = UINTPTR_MAX) const override
+        {
+            return SyxLib::QueryRegions(begin, end);
+        }
+
+        const uint8_t* Direct(uintptr_t address, size_t size) const override
+        {
+            return m_map.Accessible(address, size, PROTECT_READ) == size ? reinterpret_cast<const uint8_t*>(address) : nullptr;
+        }
+
+        /**
+         * @return The region map used for the checks.
+         */
+        RegionMap& Map() const
+        {
+            return m_map;
+        }
+
+        /**
+         * @return A process-wide instance.
+         */
+        static SafeMemory& Instance()
+        {
+            static SafeMemory memory;
+            return memory;
+        }
+
+    private:
+        mutable RegionMap m_map;
+    };
+}
@@ -0,0 +1,538 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Pattern.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SYX_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SYX_TARGET(features) __attribute__((target(features)))
+#else
+#define SYX_TARGET(features)
+#endif
+
+/**
+ * Platform-neutral pattern scan engine used by Syx::FindPattern and Syx::FindPatternA.
+ *
+ * Everything in this header works on a plain (const uint8_t*, size_t) span and does not
+ * depend on the Windows API, so it can be built, benchmarked and tested on any platform.
+ */
+
+namespace SyxLib
+{
+    /** Returned by the scan functions when no match exists. */
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    /**
+     * Instruction set used by a scan. Levels are ordered, a CPU supporting a level supports
+     * every level below it.
+     */
+    enum class ScanLevel
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512
+    };
+
+    /**
+     * A contiguous, readable range of bytes.
+     */
+    struct ByteSpan
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    namespace Detail
+    {
+        inline unsigned CountTrailingZeros(uint64_t value)
+        {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, value);
+            return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+            unsigned long index;
+            if (_BitScanForward(&index, static_cast<unsigned long>(value)))
+            {
+                return static_cast<unsigned>(index);
+            }
+            _BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+            return static_cast<unsigned>(index) + 32;
+#else
+            return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+        }
+
+#ifdef SYX_X86
+        inline void CpuId(unsigned regs[4], unsigned leaf, unsigned subleaf)
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; i++)
+            {
+                regs[i] = static_cast<unsigned>(info[i]);
+            }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        inline uint64_t ReadXCR0()
+        {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+        }
+#endif
+
+        inline ScanLevel QueryScanLevel()
+        {
+#ifdef SYX_X86
+            unsigned regs[4];
+            CpuId(regs, 0, 0);
+            const unsigned maxLeaf = regs[0];
+
+            CpuId(regs, 1, 0);
+            if (!(regs[3] & (1u << 26)))
+            {
+                return ScanLevel::Scalar;
+            }
+
+            // AVX state must be enabled by the OS (OSXSAVE + XCR0), not just reported by the CPU.
+            const bool osxsave = (regs[2] & (1u << 27)) != 0;
+            const bool avx = (regs[2] & (1u << 28)) != 0;
+            if (!osxsave || !avx || maxLeaf < 7)
+            {
+                return ScanLevel::SSE2;
+            }
+
+            const uint64_t xcr0 = ReadXCR0();
+            if ((xcr0 & 0x6) != 0x6)
+            {
+                return ScanLevel::SSE2;
+            }
+
+            CpuId(regs, 7, 0);
+            const bool avx2 = (regs[1] & (1u << 5)) != 0;
+            const bool avx512f = (regs[1] & (1u << 16)) != 0;
+            const bool avx512bw = (regs[1] & (1u << 30)) != 0;
+            if (avx512f && avx512bw && (xcr0 & 0xE6) == 0xE6)
+            {
+                return ScanLevel::AVX512;
+            }
+            return avx2 ? ScanLevel::AVX2 : ScanLevel::SSE2;
+#else
+            return ScanLevel::Scalar;
+#endif
+        }
+    }
+
+    /**
+     * Returns the best scan level supported by the CPU and OS. Detected once and cached.
+     */
+    inline ScanLevel DetectScanLevel()
+    {
+        static const ScanLevel level = Detail::QueryScanLevel();
+        return level;
+    }
+
+    /**
+     * A pattern/mask pair compiled for scanning.
+     *
+     * Compilation selects the two rarest significant bytes of the pattern as anchors. The vector
+     * kernels compare both anchors for 32 or 64 candidate offsets per iteration and only run the
+     * full masked comparison on candidates where both anchors hit. A Scanner can be built from a
+     * pattern/mask pair at run time or from a Pattern whose tables were computed at compile time.
+     */
+    class Scanner
+    {
+    public:
+        Scanner() = default;
+
+        /**
+         * Compiles a pattern using a code-style mask.
+         *
+         * @param pattern Pointer to the pattern bytes.
+         * @param mask Mask string, 'x' = byte must match, any other character = wildcard.
+         */
+        Scanner(const uint8_t* pattern, const char* mask)
+            : Scanner(pattern, mask, strlen(mask))
+        {
+        }
+
+        /**
+         * Compiles a pattern using a code-style mask of known length.
+         *
+         * @param pattern Pointer to the pattern bytes.
+         * @param mask Mask characters, 'x' = byte must match, any other character = wildcard.
+         * @param length Number of pattern bytes and mask characters.
+         */
+        Scanner(const uint8_t* pattern, const char* mask, size_t length)
+            : m_bytes((length + 7) & ~size_t(7), 0), m_mask((length + 7) & ~size_t(7), 0), m_length(length)
+        {
+            for (size_t i = 0; i < length; i++)
+            {
+                if (mask[i] == 'x')
+                {
+                    m_bytes[i] = pattern[i];
+                    m_mask[i] = 0xFF;
+                }
+            }
+            SelectAnchors();
+        }
+
+        /**
+         * Builds a scanner from a parsed signature. Anchors and skip table are copied, not recomputed.
+         *
+         * @param pattern The parsed signature.
+         */
+        Scanner(const Pattern& pattern)
+            : m_bytes(pattern.Bytes(), pattern.Bytes() + pattern.Length()), m_mask(pattern.Mask(), pattern.Mask() + pattern.Length()),
+            m_length(pattern.Length())
+        {
+            m_bytes.resize((m_length + 7) & ~size_t(7), 0);
+            m_mask.resize((m_length + 7) & ~size_t(7), 0);
+            ApplyAnchors(pattern.Anchors());
+            memcpy(m_skip, pattern.SkipTable(), sizeof(m_skip));
+        }
+
+        /**
+         * @return Length of the pattern in bytes.
+         */
+        size_t Length() const
+        {
+            return m_length;
+        }
+
+        /**
+         * @param index Position inside the pattern.
+         * @return True if the byte at index must match, false if it is a wildcard.
+         */
+        bool IsSignificant(size_t index) const
+        {
+            return m_mask[index] != 0;
+        }
+
+        /**
+         * @param index Position inside the pattern.
+         * @return Pattern byte at index (0 for wildcards).
+         */
+        uint8_t ByteAt(size_t index) const
+        {
+            return m_bytes[index];
+        }
+
+        /**
+         * Checks the full pattern against the bytes at a given location.
+         *
+         * @param pData Pointer to at least Length() readable bytes.
+         * @return True if every significant byte matches.
+         */
+        bool MatchesAt(const uint8_t* pData) const
+        {
+            const size_t words = m_length / 8;
+            for (size_t w = 0; w < words; w++)
+            {
+                uint64_t data, bytes, mask;
+                memcpy(&data, pData + w * 8, 8);
+                memcpy(&bytes, &m_bytes[w * 8], 8);
+                memcpy(&mask, &m_mask[w * 8], 8);
+                if ((data ^ bytes) & mask)
+                {
+                    return false;
+                }
+            }
+            for (size_t i = words * 8; i < m_length; i++)
+            {
+                if ((pData[i] ^ m_bytes[i]) & m_mask[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Finds the first match that lies completely inside a buffer, using the best
+         * instruction set available.
+         *
+         * @param data Start of the buffer.
+         * @param size Size of the buffer in bytes.
+         * @param from Offset of the first candidate to test.
+         * @return Offset of the first match at or after from, or NOT_FOUND.
+         */
+        size_t Find(const uint8_t* data, size_t size, size_t from = 0) const
+        {
+            return Find(data, size, from, DetectScanLevel());
+        }
+
+        /**
+         * Finds the first match using a specific instruction set. Levels the CPU does not
+         * support are lowered to the best supported one.
+         *
+         * @param data Start of the buffer.
+         * @param size Size of the buffer in bytes.
+         * @param from Offset of the first candidate to test.
+         * @param level Instruction set to use.
+         * @return Offset of the first match at or after from, or NOT_FOUND.
+         */
+        size_t Find(const uint8_t* data, size_t size, size_t from, ScanLevel level) const
+        {
+            if (size < m_length || from > size - m_length)
+            {
+                return NOT_FOUND;
+            }
+            const size_t count = size - m_length + 1;
+            if (m_significant == 0)
+            {
+                return from;
+            }
+
+            if (level > DetectScanLevel())
+            {
+                level = DetectScanLevel();
+            }
+            switch (level)
+            {
+#ifdef SYX_X86
+            case ScanLevel::AVX512:
+                return FindAVX512(data, count, from);
+            case ScanLevel::AVX2:
+                return FindAVX2(data, count, from);
+            case ScanLevel::SSE2:
+                return FindSSE2(data, count, from);
+#endif
+            default:
+                return FindScalar(data, count, from);
+            }
+        }
+
+    private:
+        void SelectAnchors()
+        {
+            ApplyAnchors(Detail::ChooseAnchors(m_bytes.data(), m_mask.data(), m_length));
+            Detail::BuildSkipTable(m_bytes.data(), m_mask.data(), m_length, m_skip);
+        }
+
+        void ApplyAnchors(const Detail::AnchorChoice& anchors)
+        {
+            m_significant = anchors.significant;
+            m_anchor[0] = anchors.first;
+            m_anchor[1] = anchors.second;
+            m_anchorByte[0] = m_significant ? m_bytes[m_anchor[0]] : 0;
+            m_anchorByte[1] = m_significant ? m_bytes[m_anchor[1]] : 0;
+        }
+
+        // Tests every candidate bit of a hit mask in address order. Bit n is candidate base + n.
+        size_t VerifyCandidates(const uint8_t* data, size_t base, uint64_t bits) const
+        {
+            while (bits)
+            {
+                const size_t candidate = base + Detail::CountTrailingZeros(bits);
+                if (MatchesAt(data + candidate))
+                {
+                    return candidate;
+                }
+                bits &= bits - 1;
+            }
+            return NOT_FOUND;
+        }
+
+        size_t FindScalar(const uint8_t* data, size_t count, size_t from) const
+        {
+            // memchr on the rarest anchor is already vectorized by the C runtime. After a failed
+            // candidate the Horspool shift of the byte under the last pattern position is applied.
+            const size_t a0 = m_anchor[0], a1 = m_anchor[1];
+            size_t i = from;
+            while (i < count)
+            {
+                const void* hit = memchr(data + i + a0, m_anchorByte[0], count - i);
+                if (!hit)
+                {
+                    break;
+                }
+                i = static_cast<size_t>(static_cast<const uint8_t*>(hit) - data) - a0;
+                if (data[i + a1] == m_anchorByte[1] && MatchesAt(data + i))
+                {
+                    return i;
+                }
+                i += m_skip[data[i + m_length - 1]];
+            }
+            return NOT_FOUND;
+        }
+
+#ifdef SYX_X86
+        SYX_TARGET("sse2")
+        size_t FindSSE2(const uint8_t* data, size_t count, size_t from) const
+        {
+            const uint8_t* p0 = data + m_anchor[0];
+            const uint8_t* p1 = data + m_anchor[1];
+            const __m128i b0 = _mm_set1_epi8(static_cast<char>(m_anchorByte[0]));
+            const __m128i b1 = _mm_set1_epi8(static_cast<char>(m_anchorByte[1]));
+
+            size_t i = from;
+            for (; i + 32 <= count; i += 32)
+            {
+                const __m128i lo = _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + i)), b0),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + i)), b1));
+                const __m128i hi = _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + i + 16)), b0),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + i + 16)), b1));
+                const uint64_t bits = static_cast<uint32_t>(_mm_movemask_epi8(lo)) |
+                    (static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hi))) << 16);
+                if (bits)
+                {
+                    const size_t found = VerifyCandidates(data, i, bits);
+                    if (found != NOT_FOUND)
+                    {
+                        return found;
+                    }
+                }
+            }
+            return FindScalar(data, count, i);
+        }
+
+        SYX_TARGET("avx2")
+        size_t FindAVX2(const uint8_t* data, size_t count, size_t from) const
+        {
+            const uint8_t* p0 = data + m_anchor[0];
+            const uint8_t* p1 = data + m_anchor[1];
+            const __m256i b0 = _mm256_set1_epi8(static_cast<char>(m_anchorByte[0]));
+            const __m256i b1 = _mm256_set1_epi8(static_cast<char>(m_anchorByte[1]));
+
+            size_t i = from;
+            for (; i + 32 <= count; i += 32)
+            {
+                const __m256i hits = _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p0 + i)), b0),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + i)), b1));
+                const uint64_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+                if (bits)
+                {
+                    const size_t found = VerifyCandidates(data, i, bits);
+                    if (found != NOT_FOUND)
+                    {
+                        return found;
+                    }
+                }
+            }
+            return FindScalar(data, count, i);
+        }
+
+        SYX_TARGET("avx512f,avx512bw")
+        size_t FindAVX512(const uint8_t* data, size_t count, size_t from) const
+        {
+            const uint8_t* p0 = data + m_anchor[0];
+            const uint8_t* p1 = data + m_anchor[1];
+            const __m512i b0 = _mm512_set1_epi8(static_cast<char>(m_anchorByte[0]));
+            const __m512i b1 = _mm512_set1_epi8(static_cast<char>(m_anchorByte[1]));
+
+            size_t i = from;
+            for (; i + 64 <= count; i += 64)
+            {
+                const __mmask64 first = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p0 + i), b0);
+                const uint64_t bits = _mm512_mask_cmpeq_epi8_mask(first, _mm512_loadu_si512(p1 + i), b1);
+                if (bits)
+                {
+                    const size_t found = VerifyCandidates(data, i, bits);
+                    if (found != NOT_FOUND)
+                    {
+                        return found;
+                    }
+                }
+            }
+            return FindScalar(data, count, i);
+        }
+#endif
+
+        std::vector<uint8_t> m_bytes;
+        std::vector<uint8_t> m_mask;
+        size_t m_length = 0;
+        size_t m_significant = 0;
+        size_t m_anchor[2] = {};
+        uint8_t m_anchorByte[2] = {};
+        uint8_t m_skip[256] = {};
+    };
+
+    /**
+     * Finds the first occurrence of a pattern in a buffer.
+     *
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param pattern Pointer to the pattern bytes.
+     * @param mask Mask string, 'x' = byte must match, any other character = wildcard.
+     * @return Offset of the first match, or NOT_FOUND.
+     */
+    inline size_t FindPattern(const uint8_t* data, size_t size, const uint8_t* pattern, const char* mask)
+    {
+        return Scanner(pattern, mask).Find(data, size);
+    }
+
+    /**
+     * Finds the first match that lies completely inside one of several spans of an image, for
+     * images whose readable parts are separated by unmapped gaps.
+     *
+     * @param scanner The compiled pattern.
+     * @param base Start of the image; offsets are relative to it.
+     * @param spans Readable spans sorted by address, none below base.
+     * @param from Offset of the first candidate to test.
+     * @param to Offset the match must end at or before.
+     * @return Offset of the first match, or NOT_FOUND.
+     */
+    inline size_t FindInSpans(const Scanner& scanner, const uint8_t* base, const std::vector<ByteSpan>& spans, size_t from = 0, size_t to = SIZE_MAX)
+    {
+        for (const ByteSpan& span : spans)
+        {
+            const size_t begin = static_cast<size_t>(span.data - base);
+            if (begin >= to)
+            {
+                break;
+            }
+            if (begin + span.size <= from)
+            {
+                continue;
+            }
+            const size_t found = scanner.Find(span.data, (std::min)(span.size, to - begin), from > begin ? from - begin : 0);
+            if (found != NOT_FOUND)
+            {
+                return begin + found;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    /**
+     * @return True if a pattern matches at an offset of an image and the match lies inside one span.
+     */
+    inline bool MatchesInSpans(const Scanner& scanner, const uint8_t* base, const std::vector<ByteSpan>& spans, size_t offset)
+    {
+        for (const ByteSpan& span : spans)
+        {
+            const size_t begin = static_cast<size_t>(span.data - base);
+            if (offset >= begin && offset - begin < span.size)
+            {
+                return span.size - (offset - begin) >= scanner.Length() && scanner.MatchesAt(base + offset);
+            }
+        }
+        return false;
+    }
+}
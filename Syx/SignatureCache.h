@@ -0,0 +1,451 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Hash.h"
+#include "Image.h"
+#include "MappedFile.h"
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /**
+     * Computes a key identifying one build of a module: its size, its build stamp (PE TimeDateStamp
+     * or ELF build-id) and a hash of its executable sections. Any patch to the code changes the key,
+     * so cached offsets are never applied to a different build.
+     *
+     * @param image Start of the image.
+     * @param size Size of the image (SizeOfImage for a loaded module, the file size for a file).
+     * @param mapped True for a module laid out as loaded, false for a file image.
+     * @return The module key.
+     */
+    inline uint64_t ComputeModuleKey(const uint8_t* image, size_t size, bool mapped = true)
+    {
+        uint64_t key = Hash64(&size, sizeof(size));
+        uint64_t stamp;
+        if (ReadImageStamp(image, size, mapped, stamp))
+        {
+            key = Hash64(&stamp, sizeof(stamp), key);
+        }
+
+        std::vector<ImageSection> sections;
+        if (ParseImageSections(image, size, sections))
+        {
+            for (const ImageSection& section : sections)
+            {
+                if (!(section.protection & PROTECT_EXECUTE))
+                {
+                    continue;
+                }
+                const uint64_t begin = mapped ? section.virtualAddress : section.fileOffset;
+                const uint64_t length = mapped ? section.virtualSize : section.fileSize;
+                if (begin < size)
+                {
+                    key = Hash64(image + begin, static_cast<size_t>((std::min)(length, uint64_t(size) - begin)), key);
+                }
+            }
+        }
+        return key;
+    }
+
+    /**
+     * @return A key identifying a compiled pattern by its length, bytes and wildcards.
+     */
+    inline uint64_t ComputePatternKey(const Scanner& scanner)
+    {
+        std::vector<uint8_t> buffer(scanner.Length() * 2);
+        for (size_t i = 0; i < scanner.Length(); i++)
+        {
+            buffer[i * 2] = scanner.ByteAt(i);
+            buffer[i * 2 + 1] = scanner.IsSignificant(i) ? 0xFF : 0;
+        }
+        return Hash64(buffer.data(), buffer.size(), scanner.Length());
+    }
+
+    /**
+     * A persistent map from (module build, pattern) to the offset the pattern was found at.
+     *
+     * The cache lives in a memory-mapped file holding an open-addressing hash table, so opening
+     * it costs one mapping and a lookup touches a single cache line. Find() verifies a cached
+     * offset with one masked compare before returning it and falls back to a full scan when the
+     * entry is missing or stale. Patterns known to be absent from a build are cached too.
+     *
+     * Entries of older builds are never returned (their module key differs) and are simply left
+     * behind; call Clear() to drop them.
+     *
+     * Several processes may share a cache file. Open, Store and Clear hold an exclusive file lock
+     * and first remap the file if another process grew it; Lookup holds a shared one, so it never
+     * sees a half-written entry. The file never shrinks, so a mapping made earlier stays valid. A
+     * lookup bounds every probe by the table that fits its own mapping; a table grown elsewhere
+     * reads as a miss until the next Store remaps it.
+     *
+     * @example
+     * SyxLib::SignatureCache cache("game.sigcache");
+     * uintptr_t tick = Syx::FindPatternCached(cache, L"game.dll", SyxLib::Pattern("48 89 5C 24 ?? 57"));
+     */
+    class SignatureCache
+    {
+    public:
+        SignatureCache() = default;
+
+        /**
+         * Opens or creates a cache file. Check IsOpen() for the result.
+         */
+        explicit SignatureCache(const std::string& path)
+        {
+            Open(path);
+        }
+
+        /**
+         * Opens a cache file, creating it if needed. A file with an unknown format or version is
+         * reinitialized empty.
+         *
+         * @param path Path of the cache file.
+         * @return False if the file cannot be created or mapped.
+         */
+        bool Open(const std::string& path)
+        {
+            m_moduleKeys.clear();
+            if (!m_file.Open(path, MappedFile::READ_WRITE_SHARED))
+            {
+                return false;
+            }
+            // Another process may be creating or rebuilding the same file right now.
+            FileLock lock(m_file);
+            return lock.locked && Refresh();
+        }
+
+        bool IsOpen() const
+        {
+            return m_file.IsOpen() && m_file.Data();
+        }
+
+        /**
+         * @return Number of cached entries.
+         */
+        size_t Count() const
+        {
+            return IsOpen() ? static_cast<size_t>(GetHeader()->count) : 0;
+        }
+
+        /**
+         * Looks up a cached result.
+         *
+         * @param moduleKey Key of the module build, see ComputeModuleKey.
+         * @param patternKey Key of the pattern, see ComputePatternKey.
+         * @param offset Receives the cached offset, NOT_FOUND if the pattern is known to be absent.
+         * @return True if the cache holds an entry.
+         */
+        bool Lookup(uint64_t moduleKey, uint64_t patternKey, size_t& offset) const
+        {
+            if (!IsOpen())
+            {
+                return false;
+            }
+            // Writers in other processes hold the exclusive lock while they rebuild or insert.
+            FileLock lock(m_file, false);
+            if (!lock.locked)
+            {
+                return false;
+            }
+            const uint64_t capacity = GetHeader()->capacity;
+            if (!Fits(capacity))
+            {
+                return false;
+            }
+            const Entry* entries = GetEntries();
+            const uint64_t mask = capacity - 1;
+            uint64_t slot = SlotOf(moduleKey, patternKey) & mask;
+            for (uint64_t probe = 0; probe < capacity && entries[slot].value != EMPTY; probe++, slot = (slot + 1) & mask)
+            {
+                if (entries[slot].moduleKey == moduleKey && entries[slot].patternKey == patternKey)
+                {
+                    offset = entries[slot].value == ABSENT ? NOT_FOUND : static_cast<size_t>(entries[slot].value - 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Adds or replaces a cached result, growing the file when the table gets too full.
+         *
+         * @param moduleKey Key of the module build.
+         * @param patternKey Key of the pattern.
+         * @param offset Offset of the match, or NOT_FOUND to record that the pattern is absent.
+         * @return False if the cache is not open or could not grow.
+         */
+        bool Store(uint64_t moduleKey, uint64_t patternKey, size_t offset)
+        {
+            if (!IsOpen())
+            {
+                return false;
+            }
+            FileLock lock(m_file);
+            if (!lock.locked || !Refresh())
+            {
+                return false;
+            }
+            const Entry entry = { moduleKey, patternKey, offset == NOT_FOUND ? ABSENT : uint64_t(offset) + 1 };
+            if ((GetHeader()->count + 1) * 4 > GetHeader()->capacity * 3 && !Grow())
+            {
+                return false;
+            }
+            // A table without a free slot has a wrong count (a corrupt file): rebuilding recounts it.
+            return Insert(entry) || (Grow() && Insert(entry));
+        }
+
+        /**
+         * Resolves a pattern in a module, using the cache when it holds a verified result.
+         *
+         * @param moduleKey Key of the module build, identifying the data being scanned.
+         * @param scanner The compiled pattern.
+         * @param data Start of the scanned range.
+         * @param size Size of the scanned range.
+         * @return Offset of the first match, or NOT_FOUND.
+         */
+        size_t Find(uint64_t moduleKey, const Scanner& scanner, const uint8_t* data, size_t size)
+        {
+            return Find(moduleKey, scanner, data, std::vector<ByteSpan>{ { data, size } });
+        }
+
+        /**
+         * Find for an image with unmapped gaps: only its readable spans are verified and scanned.
+         *
+         * @param moduleKey Key of the module build.
+         * @param scanner The compiled pattern.
+         * @param base Start of the image; offsets are relative to it.
+         * @param spans Readable spans of the image sorted by address, see FindInSpans.
+         * @return Offset of the first match, or NOT_FOUND.
+         */
+        size_t Find(uint64_t moduleKey, const Scanner& scanner, const uint8_t* base, const std::vector<ByteSpan>& spans)
+        {
+            const uint64_t patternKey = ComputePatternKey(scanner);
+            size_t offset;
+            if (Lookup(moduleKey, patternKey, offset))
+            {
+                if (offset == NOT_FOUND)
+                {
+                    return NOT_FOUND;
+                }
+                if (MatchesInSpans(scanner, base, spans, offset))
+                {
+                    return offset;
+                }
+            }
+
+            offset = FindInSpans(scanner, base, spans);
+            Store(moduleKey, patternKey, offset);
+            return offset;
+        }
+
+        /**
+         * Key of a module loaded in the current process, computed once per cache and module.
+         *
+         * @param base Address the module is loaded at.
+         * @param size SizeOfImage of the module.
+         * @return The module key.
+         */
+        uint64_t ModuleKey(const uint8_t* base, size_t size)
+        {
+            auto it = m_moduleKeys.find(base);
+            if (it != m_moduleKeys.end() && it->second.first == size)
+            {
+                return it->second.second;
+            }
+            const uint64_t key = ComputeModuleKey(base, size);
+            m_moduleKeys[base] = { size, key };
+            return key;
+        }
+
+        /** Removes every entry. The file keeps its size, as other processes may map all of it. */
+        bool Clear()
+        {
+            if (!m_file.IsOpen())
+            {
+                return false;
+            }
+            FileLock lock(m_file);
+            return lock.locked && m_file.Refresh() && Rebuild(INITIAL_CAPACITY, {});
+        }
+
+        /** Writes the cache back to disk now instead of whenever the OS decides to. */
+        bool Flush()
+        {
+            return m_file.Flush();
+        }
+
+    private:
+        /** Holds the file lock for a scope. */
+        struct FileLock
+        {
+            explicit FileLock(const MappedFile& file, bool exclusive = true)
+                : file(file), locked(file.Lock(exclusive))
+            {
+            }
+
+            ~FileLock()
+            {
+                if (locked)
+                {
+                    file.Unlock();
+                }
+            }
+
+            FileLock(const FileLock&) = delete;
+            FileLock& operator=(const FileLock&) = delete;
+
+            const MappedFile& file;
+            const bool locked;
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t capacity;
+            uint64_t count;
+            uint64_t reserved[5];
+        };
+
+        struct Entry
+        {
+            uint64_t moduleKey;
+            uint64_t patternKey;
+            /** EMPTY, ABSENT, or the offset + 1. */
+            uint64_t value;
+        };
+
+        static constexpr uint32_t MAGIC = 0x43585953; // "SYXC"
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint64_t INITIAL_CAPACITY = 256;
+        static constexpr uint64_t EMPTY = 0;
+        static constexpr uint64_t ABSENT = UINT64_MAX;
+
+        static uint64_t SlotOf(uint64_t moduleKey, uint64_t patternKey)
+        {
+            return moduleKey ^ (patternKey * Detail::XXH_PRIME1);
+        }
+
+        Header* GetHeader()
+        {
+            return reinterpret_cast<Header*>(m_file.Data());
+        }
+
+        const Header* GetHeader() const
+        {
+            return reinterpret_cast<const Header*>(m_file.Data());
+        }
+
+        Entry* GetEntries()
+        {
+            return reinterpret_cast<Entry*>(m_file.Data() + sizeof(Header));
+        }
+
+        const Entry* GetEntries() const
+        {
+            return reinterpret_cast<const Entry*>(m_file.Data() + sizeof(Header));
+        }
+
+        /** @return True if a table of this capacity lies inside the mapping. */
+        bool Fits(uint64_t capacity) const
+        {
+            return m_file.Size() >= sizeof(Header) && capacity >= INITIAL_CAPACITY && (capacity & (capacity - 1)) == 0 &&
+                capacity <= (m_file.Size() - sizeof(Header)) / sizeof(Entry);
+        }
+
+        bool IsValid() const
+        {
+            if (m_file.Size() < sizeof(Header))
+            {
+                return false;
+            }
+            const Header* header = GetHeader();
+            return header->magic == MAGIC && header->version == VERSION && Fits(header->capacity) && header->count < header->capacity;
+        }
+
+        /** Remaps the file if another process grew it, and reinitializes it if it is not a valid cache. Needs the lock. */
+        bool Refresh()
+        {
+            return m_file.Refresh() && (IsValid() || Rebuild(INITIAL_CAPACITY, {}));
+        }
+
+        /** Moves the entries into a table of twice the capacity. Needs the lock. */
+        bool Grow()
+        {
+            std::vector<Entry> entries;
+            entries.reserve(static_cast<size_t>(GetHeader()->count));
+            for (uint64_t i = 0; i < GetHeader()->capacity; i++)
+            {
+                if (GetEntries()[i].value != EMPTY)
+                {
+                    entries.push_back(GetEntries()[i]);
+                }
+            }
+            return Rebuild(GetHeader()->capacity * 2, entries);
+        }
+
+        /**
+         * Reinitializes the table with at least the given capacity. The file is never shrunk: the
+         * table takes all of it, since other processes may still map every byte.
+         */
+        bool Rebuild(uint64_t capacity, const std::vector<Entry>& entries)
+        {
+            while (capacity * 2 <= (m_file.Size() > sizeof(Header) ? (m_file.Size() - sizeof(Header)) / sizeof(Entry) : 0))
+            {
+                capacity *= 2;
+            }
+            const size_t size = static_cast<size_t>(sizeof(Header) + capacity * sizeof(Entry));
+            if (size > m_file.Size() && !m_file.Resize(size))
+            {
+                return false;
+            }
+            memset(m_file.Data(), 0, m_file.Size());
+            Header* header = GetHeader();
+            header->magic = MAGIC;
+            header->version = VERSION;
+            header->capacity = capacity;
+            for (const Entry& entry : entries)
+            {
+                Insert(entry);
+            }
+            return true;
+        }
+
+        /**
+         * Adds or updates an entry. Needs the lock.
+         *
+         * @return False if no slot is free.
+         */
+        bool Insert(const Entry& entry)
+        {
+            Entry* entries = GetEntries();
+            const uint64_t capacity = GetHeader()->capacity;
+            const uint64_t mask = capacity - 1;
+            uint64_t slot = SlotOf(entry.moduleKey, entry.patternKey) & mask;
+            for (uint64_t probe = 0; probe < capacity; probe++, slot = (slot + 1) & mask)
+            {
+                if (entries[slot].value == EMPTY)
+                {
+                    entries[slot].moduleKey = entry.moduleKey;
+                    entries[slot].patternKey = entry.patternKey;
+                    entries[slot].value = entry.value;
+                    GetHeader()->count++;
+                    return true;
+                }
+                if (entries[slot].moduleKey == entry.moduleKey && entries[slot].patternKey == entry.patternKey)
+                {
+                    entries[slot].value = entry.value;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        MappedFile m_file;
+        std::unordered_map<const uint8_t*, std::pair<size_t, uint64_t>> m_moduleKeys;
+    };
+}
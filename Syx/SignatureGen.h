@@ -0,0 +1,237 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "FuzzyScan.h"
+#include "Instruction.h"
+#include "Matches.h"
+#include "Pattern.h"
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /** How GenerateSignature builds a signature. */
+    struct SignatureOptions
+    {
+        /** Longest signature to try, in bytes; at most Pattern::MAX_LENGTH. */
+        size_t maxLength = 64;
+        /**
+         * Bytes that may change before the signature stops finding its target: every other location
+         * differs in more than margin significant bytes, so FindBestMatch with maxMismatches = margin
+         * still returns the target after up to margin of its bytes change. 0 = merely unique.
+         */
+        size_t margin = 0;
+        /** Decode the code as x64 instead of x86. */
+        bool x64 = sizeof(void*) == 8;
+        /**
+         * Addresses that immediates are recognized as pointers in, usually the range the module
+         * is loaded at. Both 0 = the range the scanned spans cover.
+         */
+        uintptr_t imageBase = 0;
+        size_t imageSize = 0;
+    };
+
+    namespace Detail
+    {
+        /** Marks the bytes of an operand as wildcards. */
+        inline void WildcardOperand(std::string& mask, size_t start, size_t offset, size_t size)
+        {
+            mask.replace(start + offset, size, size, '?');
+        }
+
+        /** @return True if a pointer-sized or 32-bit immediate holds an address inside [base, base + size). */
+        inline bool IsImageAddress(const uint8_t* code, const Instruction& instruction, uintptr_t base, size_t size)
+        {
+            uint64_t value = 0;
+            if (instruction.immediateSize == 4)
+            {
+                uint32_t value32;
+                memcpy(&value32, code + instruction.immediateOffset, sizeof(value32));
+                value = value32;
+            }
+            else if (instruction.immediateSize == 8)
+            {
+                memcpy(&value, code + instruction.immediateOffset, sizeof(value));
+            }
+            else
+            {
+                return false;
+            }
+            return value >= base && value - base < size;
+        }
+
+        /**
+         * @return True if no location but target matches with margin mismatches or fewer.
+         */
+        inline bool IsDistinct(const Scanner& scanner, const std::vector<ByteSpan>& spans, const uint8_t* target, size_t margin)
+        {
+            const size_t length = scanner.Length();
+            for (const ByteSpan& span : spans)
+            {
+                if (target < span.data || target >= span.data + span.size)
+                {
+                    if (FindBestMatch(scanner, span.data, span.size, margin).offset != NOT_FOUND)
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                // Candidates before the target, then after it.
+                const size_t before = static_cast<size_t>(target - span.data) + length - 1;
+                const size_t after = static_cast<size_t>(span.data + span.size - target) - 1;
+                if (FindBestMatch(scanner, span.data, (std::min)(before, span.size), margin).offset != NOT_FOUND ||
+                    FindBestMatch(scanner, target + 1, after, margin).offset != NOT_FOUND)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /** Counts the matches of a pattern in every span, stopping at limit. */
+        inline size_t CountSpanMatches(const Scanner& scanner, const std::vector<ByteSpan>& spans, size_t limit)
+        {
+            size_t count = 0;
+            for (const ByteSpan& span : spans)
+            {
+                count += CountMatches(scanner, span.data, span.size, limit - count);
+                if (count >= limit)
+                {
+                    break;
+                }
+            }
+            return count;
+        }
+
+        inline std::string FormatSignature(const std::vector<uint8_t>& bytes, const std::string& mask, size_t length)
+        {
+            static const char digits[] = "0123456789ABCDEF";
+            std::string text;
+            for (size_t i = 0; i < length; i++)
+            {
+                if (i)
+                {
+                    text += ' ';
+                }
+                if (mask[i] == 'x')
+                {
+                    text += digits[bytes[i] >> 4];
+                    text += digits[bytes[i] & 15];
+                }
+                else
+                {
+                    text += "??";
+                }
+            }
+            return text;
+        }
+    }
+
+    /**
+     * Builds the shortest signature starting at an address that matches only there.
+     *
+     * Whole instructions are added one at a time, with the operands that change when the code is
+     * relinked or relocated turned into wildcards: rel32 branch targets, RIP-relative
+     * displacements, absolute addresses in memory operands, and immediates that point into the
+     * image. After each instruction the candidate is checked with a find-all scan that stops at
+     * the second match. Once it is unique, the shortest unique prefix inside the last instruction
+     * is found by bisection, since a prefix matches everywhere a longer one does. Bytes that do not
+     * decode are taken literally, one at a time. With a margin, uniqueness is checked with
+     * FindBestMatch instead, so the signature keeps finding its target after small changes.
+     *
+     * @param spans Everything the signature must be unique in, e.g. the readable regions of a module.
+     * @param target Start of the signature; must lie inside one of the spans.
+     * @param options Length limit, decoding mode and image range.
+     * @return An IDA-style signature Pattern accepts, empty if none up to maxLength bytes is unique.
+     */
+    inline std::string GenerateSignature(const std::vector<ByteSpan>& spans, const uint8_t* target, const SignatureOptions& options = {})
+    {
+        const ByteSpan* home = nullptr;
+        uintptr_t low = UINTPTR_MAX, high = 0;
+        for (const ByteSpan& span : spans)
+        {
+            const uintptr_t start = reinterpret_cast<uintptr_t>(span.data);
+            low = (std::min)(low, start);
+            high = (std::max)(high, start + span.size);
+            if (target >= span.data && target < span.data + span.size)
+            {
+                home = &span;
+            }
+        }
+        if (!home)
+        {
+            return std::string();
+        }
+        const uintptr_t imageBase = options.imageBase || options.imageSize ? options.imageBase : low;
+        const size_t imageSize = options.imageBase || options.imageSize ? options.imageSize : high - low;
+        const size_t maxLength = (std::min)({ options.maxLength, Pattern::MAX_LENGTH, static_cast<size_t>(home->data + home->size - target) });
+
+        std::vector<uint8_t> bytes;
+        std::string mask;
+        const auto unique = [&](size_t length)
+        {
+            const Scanner scanner(bytes.data(), mask.c_str(), length);
+            return options.margin ? Detail::IsDistinct(scanner, spans, target, options.margin) : Detail::CountSpanMatches(scanner, spans, 2) == 1;
+        };
+
+        size_t checked = 0;
+        while (bytes.size() < maxLength)
+        {
+            const size_t start = bytes.size();
+            const uint8_t* code = target + start;
+            Instruction instruction;
+            if (!DecodeInstruction(code, maxLength - start, options.x64, instruction))
+            {
+                instruction = Instruction();
+                instruction.length = 1;
+            }
+            bytes.insert(bytes.end(), code, code + instruction.length);
+            mask.append(instruction.length, 'x');
+            if (instruction.relativeSize >= 2)
+            {
+                Detail::WildcardOperand(mask, start, instruction.relativeOffset, instruction.relativeSize);
+            }
+            if (instruction.absoluteSize)
+            {
+                Detail::WildcardOperand(mask, start, instruction.absoluteOffset, instruction.absoluteSize);
+            }
+            if (Detail::IsImageAddress(code, instruction, imageBase, imageSize))
+            {
+                Detail::WildcardOperand(mask, start, instruction.immediateOffset, instruction.immediateSize);
+            }
+            if (unique(bytes.size()))
+            {
+                // Bisect between the last length known not to be unique and this one.
+                size_t longest = checked, shortest = bytes.size();
+                while (shortest - longest > 1)
+                {
+                    const size_t middle = longest + (shortest - longest) / 2;
+                    (unique(middle) ? shortest : longest) = middle;
+                }
+                return Detail::FormatSignature(bytes, mask, shortest);
+            }
+            checked = bytes.size();
+        }
+        return std::string();
+    }
+
+    /**
+     * Builds the shortest unique signature for an offset of a buffer, such as a module image.
+     *
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     * @param offset Start of the signature in the buffer.
+     * @return An IDA-style signature, empty if none up to maxLength bytes is unique in the buffer.
+     */
+    inline std::string GenerateSignature(const uint8_t* data, size_t size, size_t offset, const SignatureOptions& options = {})
+    {
+        if (offset >= size)
+        {
+            return std::string();
+        }
+        return GenerateSignature(std::vector<ByteSpan>{ { data, size } }, data + offset, options);
+    }
+}
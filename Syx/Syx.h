@@ -1,12 +1,35 @@
+#include <cstdint>
+#include <cstdio>
 #include <stdexcept>
 #include <vector>
 #include <string>
 #include <sstream>
-#include <Psapi.h>
-#include <Windows.h>
+#include "Platform.h"
+#include "Hooks.h"
+#include "Instruction.h"
+#include "Scanner.h"
+#include "PatternSet.h"
+#include "ParallelScan.h"
+#include "Matches.h"
+#include "Memory.h"
+#include "MemoryScan.h"
+#include "PointerChain.h"
+#include "PointerScan.h"
+#include "Result.h"
+#include "SafeMemory.h"
+#include "ValueScan.h"
+#include "Regions.h"
+#include "SignatureCache.h"
+#include "ModuleSnapshot.h"
+#include "FileImage.h"
+#include "MemoryWatch.h"
+#include "PatchSet.h"
+#include "PointerHooks.h"
+#include "FuzzyScan.h"
+#include "SignatureGen.h"
 
 /**
- * SyxLib is a C++ class that provides functions for memory operations and pattern searching in a Windows environment.
+ * SyxLib is a C++ class that provides functions for memory operations and pattern searching on Windows and Linux.
  * It simplifies common memory-related tasks such as reading and writing memory, searching for patterns in memory,
  * and retrieving module base addresses.
  *
@@ -25,7 +48,7 @@ public:
      * @param szMask Pointer to the mask string.
      * @return True if the data matches the mask, false otherwise.
      */
-    static bool DataCompare(const BYTE* pData, const BYTE* bMask, const char* szMask)
+    static bool DataCompare(const uint8_t* pData, const uint8_t* bMask, const char* szMask)
     {
         for (; *szMask; ++szMask, ++pData, ++bMask)
         {
@@ -34,27 +57,23 @@ public:
                 return false;
             }
         }
-        return (*szMask) == NULL;
+        return (*szMask) == '\0';
     }
 
     /**
      * Retrieves information about a module by its name.
      *
      * @param szModule The name of the module.
-     * @return MODULEINFO structure containing information about the module.
+     * @return The module base and size (MODULEINFO on Windows), zeroed if the module is not loaded.
      */
-    static MODULEINFO GetModuleInfo(const wchar_t* szModule)
+    static SyxLib::ModuleInfo GetModuleInfo(const wchar_t* szModule)
     {
-        MODULEINFO modinfo{ 0 };
-        HMODULE hModule = GetModuleHandle(szModule);
-        if (hModule == 0)
-            return modinfo;
-        GetModuleInformation(GetCurrentProcess(), hModule, &modinfo, sizeof(MODULEINFO));
-        return modinfo;
+        return SyxLib::FindModule(szModule);
     }
 
     /**
      * Searches for a pattern in a specified memory region.
+     * Only matches that lie completely inside the region are reported.
      *
      * @param dwAddress Starting address of the memory region.
      * @param dwLen Length of the memory region to search.
@@ -62,48 +81,343 @@ public:
      * @param szMask Pointer to the mask string.
      * @return The address where the pattern was found, or 0 if not found.
      */
-    static uintptr_t FindPattern(uintptr_t dwAddress, uintptr_t dwLen, BYTE* bMask, char* szMask)
+    static uintptr_t FindPattern(uintptr_t dwAddress, uintptr_t dwLen, uint8_t* bMask, char* szMask)
     {
-        for (uintptr_t i = 0; i < dwLen; i++)
+        const SyxLib::Scanner scanner(bMask, szMask);
+        const size_t offset = scanner.Find(reinterpret_cast<const uint8_t*>(dwAddress), dwLen);
+        return offset == SyxLib::NOT_FOUND ? 0 : dwAddress + offset;
+    }
+
+    /**
+     * Searches for a pattern in an auto memory region. Only the readable regions of the module
+     * are read, so unmapped gaps between its segments are skipped.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The pattern to search for.
+     * @param mask The mask specifying which bytes in the pattern to consider.
+     * @return The address of the found pattern, or NULL if not found.
+     */
+    static uintptr_t FindPatternA(const wchar_t* module, char* pattern, char* mask)
+    {
+        const SyxLib::Scanner scanner(reinterpret_cast<const uint8_t*>(pattern), mask);
+        return SyxLib::FindInRegions(scanner, GetModuleRegions(module));
+    }
+
+    /**
+     * Searches for a parsed signature in a specified memory region.
+     *
+     * @param dwAddress Starting address of the memory region.
+     * @param dwLen Length of the memory region to search.
+     * @param pattern The signature, e.g. SyxLib::Pattern("48 8B ?? E8 ?? ?? ?? ??").
+     * @return The address where the pattern was found, or 0 if not found.
+     */
+    static uintptr_t FindPattern(uintptr_t dwAddress, uintptr_t dwLen, const SyxLib::Pattern& pattern)
+    {
+        const SyxLib::Scanner scanner(pattern);
+        const size_t offset = scanner.Find(reinterpret_cast<const uint8_t*>(dwAddress), dwLen);
+        return offset == SyxLib::NOT_FOUND ? 0 : dwAddress + offset;
+    }
+
+    /**
+     * Searches for a parsed signature in a module.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The signature. Declare it constexpr to have it parsed at compile time.
+     * @return The address of the found pattern, or 0 if not found.
+     */
+    static uintptr_t FindPatternA(const wchar_t* module, const SyxLib::Pattern& pattern)
+    {
+        return SyxLib::FindInRegions(SyxLib::Scanner(pattern), GetModuleRegions(module));
+    }
+
+    /**
+     * Searches for a parsed signature in the parts of a module selected by a filter.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The signature.
+     * @param filter The sections or protections to scan.
+     * @return The address of the found pattern, or 0 if not found.
+     */
+    static uintptr_t FindPatternA(const wchar_t* module, const SyxLib::Pattern& pattern, const SyxLib::RegionFilter& filter)
+    {
+        return SyxLib::FindInRegions(SyxLib::Scanner(pattern), GetModuleRegions(module, filter));
+    }
+
+    /**
+     * Searches for a pattern in the parts of a module selected by a filter, for example only
+     * executable memory or only the ".text" section. Guard and no-access pages are never read.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The pattern to search for.
+     * @param mask The mask specifying which bytes in the pattern to consider.
+     * @param filter The sections or protections to scan, e.g. SyxLib::RegionFilter::Code().
+     * @return The address of the found pattern, or 0 if not found.
+     */
+    static uintptr_t FindPatternA(const wchar_t* module, char* pattern, char* mask, const SyxLib::RegionFilter& filter)
+    {
+        const SyxLib::Scanner scanner(reinterpret_cast<const uint8_t*>(pattern), mask);
+        return SyxLib::FindInRegions(scanner, GetModuleRegions(module, filter));
+    }
+
+    /**
+     * Enumerates the sections of a module with their current protection.
+     *
+     * @param module The name of the module.
+     * @param filter The sections or protections to keep.
+     * @return The matching regions sorted by address, adjacent regions merged.
+     */
+    static std::vector<SyxLib::MemoryRegion> GetModuleRegions(const wchar_t* module, const SyxLib::RegionFilter& filter = {})
+    {
+        SyxLib::ModuleInfo mInfo = GetModuleInfo(module);
+        return SyxLib::FilterRegions(SyxLib::QueryModuleRegions((uintptr_t)mInfo.lpBaseOfDll), filter);
+    }
+
+    /**
+     * Finds where a signature matches a module with the fewest differing bytes, to recover a
+     * signature an update broke. An exact match is always preferred. Only the readable regions
+     * of the module are read, as a best-match search cannot stop early and the image may have
+     * unmapped gaps between its segments.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The signature.
+     * @param maxMismatches Significant bytes allowed to differ.
+     * @param mismatches Optional, receives the number of bytes that differ at the match.
+     * @return The address of the closest match, or 0 if none is within maxMismatches.
+     */
+    static uintptr_t FindPatternFuzzy(const wchar_t* module, const SyxLib::Pattern& pattern, size_t maxMismatches, size_t* mismatches = nullptr)
+    {
+        const SyxLib::Scanner scanner(pattern);
+        uintptr_t best = 0;
+        size_t bestMismatches = 0;
+        for (const SyxLib::MemoryRegion& region : GetModuleRegions(module))
         {
-            if (DataCompare((BYTE*)(dwAddress + i), bMask, szMask))
+            // Later regions only count if they beat the best match so far.
+            const SyxLib::FuzzyMatch match = SyxLib::FindBestMatch(scanner, reinterpret_cast<const uint8_t*>(region.base), region.size,
+                best ? bestMismatches - 1 : maxMismatches);
+            if (match.offset != SyxLib::NOT_FOUND)
             {
-                return (uintptr_t)(dwAddress + i);
+                best = region.base + match.offset;
+                bestMismatches = match.mismatches;
+                if (!bestMismatches)
+                {
+                    break;
+                }
             }
         }
-        return 0;
+        if (best && mismatches)
+        {
+            *mismatches = bestMismatches;
+        }
+        return best;
     }
 
     /**
-     * Searches for a pattern in an auto memory region.
+     * Builds the shortest signature for an address that matches nowhere else in the module's
+     * readable regions, with relocatable operands as wildcards.
+     *
+     * @param module The name of the module the address lies in.
+     * @param address Start of the signature, usually the start of an instruction.
+     * @param options Length limit and margin; the image range defaults to the module.
+     * @return An IDA-style signature, empty if none is unique within options.maxLength bytes.
+     */
+    static std::string MakeSignature(const wchar_t* module, uintptr_t address, const SyxLib::SignatureOptions& options = {})
+    {
+        SyxLib::ModuleInfo mInfo = GetModuleInfo(module);
+        if (!mInfo.lpBaseOfDll)
+        {
+            return std::string();
+        }
+        const std::vector<SyxLib::ByteSpan> spans = GetModuleSpans(module);
+        SyxLib::SignatureOptions moduleOptions = options;
+        if (!moduleOptions.imageBase && !moduleOptions.imageSize)
+        {
+            moduleOptions.imageBase = (uintptr_t)mInfo.lpBaseOfDll;
+            moduleOptions.imageSize = mInfo.SizeOfImage;
+        }
+        return SyxLib::GenerateSignature(spans, reinterpret_cast<const uint8_t*>(address), moduleOptions);
+    }
+
+    /**
+     * Searches for a pattern in a module using several threads, one readable region after the
+     * other. Returns the same address as FindPatternA.
      *
      * @param module The name of the module to search in.
      * @param pattern The pattern to search for.
      * @param mask The mask specifying which bytes in the pattern to consider.
-     * @return The address of the found pattern, or NULL if not found.
+     * @param options Thread count and chunk size.
+     * @return The address of the found pattern, or 0 if not found.
      */
-    static uintptr_t FindPatternA(const wchar_t* module, char* pattern, char* mask)
+    static uintptr_t FindPatternParallel(const wchar_t* module, char* pattern, char* mask, const SyxLib::ParallelScanOptions& options = {})
     {
-        MODULEINFO mInfo = GetModuleInfo(module);
-        uintptr_t base = (uintptr_t)mInfo.lpBaseOfDll;//10000000
-        uintptr_t size = (uintptr_t)mInfo.SizeOfImage;//6000000
-
-        uintptr_t patternLength = (uintptr_t)strlen(mask);
+        const SyxLib::Scanner scanner(reinterpret_cast<const uint8_t*>(pattern), mask);
+        for (const SyxLib::MemoryRegion& region : GetModuleRegions(module))
+        {
+            const size_t offset = SyxLib::ParallelFind(scanner, reinterpret_cast<const uint8_t*>(region.base), region.size, options);
+            if (offset != SyxLib::NOT_FOUND)
+            {
+                return region.base + offset;
+            }
+        }
+        return 0;
+    }
 
-        for (uintptr_t i = 0; i < size - patternLength; i++)
+    /**
+     * Resolves a whole set of signatures with a single pass over the readable regions of a module.
+     *
+     * @param module The name of the module to search in.
+     * @param set The compiled signature set.
+     * @return The address of each signature, indexed like PatternSet::Add, 0 for signatures that were not found.
+     */
+    static std::vector<uintptr_t> FindPatterns(const wchar_t* module, const SyxLib::PatternSet& set)
+    {
+        std::vector<uintptr_t> addresses(set.Size(), 0);
+        size_t missing = set.Size();
+        for (const SyxLib::MemoryRegion& region : GetModuleRegions(module))
         {
-            bool found = true;
-            for (uintptr_t j = 0; j < patternLength; j++)
+            // Regions come in address order: a signature keeps the first region it matches in.
+            const std::vector<size_t> offsets = set.Scan(reinterpret_cast<const uint8_t*>(region.base), region.size);
+            for (size_t i = 0; i < offsets.size(); i++)
             {
-                found &= mask[j] == '?' || pattern[j] == *(char*)(base + i + j);
+                if (offsets[i] != SyxLib::NOT_FOUND && !addresses[i])
+                {
+                    addresses[i] = region.base + offsets[i];
+                    missing--;
+                }
             }
-            if (found)
+            if (!missing)
             {
-                return base + i;
+                break;
             }
         }
+        return addresses;
+    }
+
+    /**
+     * Enumerates every match of a signature in a memory region, in address order.
+     *
+     * @param dwAddress Starting address of the memory region.
+     * @param dwLen Length of the memory region to search.
+     * @param pattern The signature.
+     * @param limit Maximum number of matches to report.
+     * @return A lazy range of match addresses.
+     *
+     * @example
+     * for (uintptr_t hit : Syx::Matches(base, size, SyxLib::Pattern("E8 ?? ?? ?? ??")))
+     *     printf("call at %p\n", (void*)hit);
+     */
+    static SyxLib::MatchRange Matches(uintptr_t dwAddress, uintptr_t dwLen, const SyxLib::Pattern& pattern, size_t limit = SIZE_MAX)
+    {
+        return SyxLib::MatchRange(SyxLib::Scanner(pattern), reinterpret_cast<const uint8_t*>(dwAddress), dwLen, limit, dwAddress);
+    }
+
+    /**
+     * Enumerates every match of a signature in a module, in address order.
+     * Matches(module, pattern, 2).Count() == 1 checks that a signature is unique.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The signature.
+     * @param limit Maximum number of matches to report.
+     * @return A lazy range of match addresses, empty if the module is not loaded.
+     */
+    static SyxLib::MatchRange Matches(const wchar_t* module, const SyxLib::Pattern& pattern, size_t limit = SIZE_MAX)
+    {
+        return Matches(module, SyxLib::Scanner(pattern), limit);
+    }
+
+    /**
+     * Enumerates every match of a pattern in a module, in address order.
+     *
+     * @param module The name of the module to search in.
+     * @param pattern The pattern to search for.
+     * @param mask The mask specifying which bytes in the pattern to consider.
+     * @param limit Maximum number of matches to report.
+     * @return A lazy range of match addresses, empty if the module is not loaded.
+     */
+    static SyxLib::MatchRange Matches(const wchar_t* module, char* pattern, char* mask, size_t limit = SIZE_MAX)
+    {
+        return Matches(module, SyxLib::Scanner(reinterpret_cast<const uint8_t*>(pattern), mask), limit);
+    }
+
+    /**
+     * Searches for a parsed signature in a module, reusing the offset found by a previous run when
+     * the module build is unchanged. A cached offset is verified with one compare before use.
+     *
+     * @param cache The persistent cache, e.g. SyxLib::SignatureCache("game.sigcache").
+     * @param module The name of the module to search in.
+     * @param pattern The signature.
+     * @return The address of the found pattern, or 0 if not found.
+     */
+    static uintptr_t FindPatternCached(SyxLib::SignatureCache& cache, const wchar_t* module, const SyxLib::Pattern& pattern)
+    {
+        return FindPatternCached(cache, module, SyxLib::Scanner(pattern));
+    }
+
+    /**
+     * Compares a module with the snapshot taken by the previous run and replaces the snapshot with
+     * the current build. Without a readable snapshot the diff only carries the current key, and
+     * cached lookups through it fall back to full scans.
+     *
+     * @param module The name of the module.
+     * @param path Snapshot file, e.g. "game.snap".
+     * @param diff Receives the changed pages and both module keys.
+     * @return False if the module is not loaded or the new snapshot cannot be written.
+     */
+    static bool UpdateModuleSnapshot(const wchar_t* module, const std::string& path, SyxLib::SnapshotDiff& diff)
+    {
+        SyxLib::ModuleInfo mInfo = GetModuleInfo(module);
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(mInfo.lpBaseOfDll);
+        const size_t size = mInfo.SizeOfImage;
+        diff = SyxLib::SnapshotDiff();
+        if (!base)
+        {
+            return false;
+        }
+
+        SyxLib::ModuleSnapshot snapshot;
+        if (!snapshot.Open(path) || !SyxLib::DiffSnapshot(snapshot, base, size, diff))
+        {
+            diff.currentKey = SyxLib::ComputeModuleKey(base, size);
+        }
+        return snapshot.Capture(path, base, size);
+    }
 
-        return NULL;
+    /**
+     * FindPatternCached after a module update: an offset cached for the previous build is reused
+     * when no page the diff marks as changed could move the first match, so only signatures near
+     * changed code are rescanned, and only around the changes.
+     *
+     * @param cache The persistent cache.
+     * @param module The name of the module to search in.
+     * @param pattern The signature.
+     * @param diff Result of UpdateModuleSnapshot for this module.
+     * @return The address of the found pattern, or 0 if not found.
+     */
+    static uintptr_t FindPatternCached(SyxLib::SignatureCache& cache, const wchar_t* module, const SyxLib::Pattern& pattern, const SyxLib::SnapshotDiff& diff)
+    {
+        SyxLib::ModuleInfo mInfo = GetModuleInfo(module);
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(mInfo.lpBaseOfDll);
+        if (!base)
+        {
+            return 0;
+        }
+
+        const size_t offset = SyxLib::FindRevalidated(cache, SyxLib::Scanner(pattern), base, GetModuleSpans(module), diff);
+        return offset == SyxLib::NOT_FOUND ? 0 : reinterpret_cast<uintptr_t>(base) + offset;
+    }
+
+    /**
+     * Searches for a pattern in a module, reusing the offset found by a previous run when
+     * the module build is unchanged. A cached offset is verified with one compare before use.
+     *
+     * @param cache The persistent cache.
+     * @param module The name of the module to search in.
+     * @param pattern The pattern to search for.
+     * @param mask The mask specifying which bytes in the pattern to consider.
+     * @return The address of the found pattern, or 0 if not found.
+     */
+    static uintptr_t FindPatternCached(SyxLib::SignatureCache& cache, const wchar_t* module, char* pattern, char* mask)
+    {
+        return FindPatternCached(cache, module, SyxLib::Scanner(reinterpret_cast<const uint8_t*>(pattern), mask));
     }
 
     /**
@@ -139,6 +453,119 @@ public:
         }
     }
 
+    /**
+     * Reads a value from a memory location specified by a nested pointer, following the same
+     * rules as WritePTR. Does not throw; compile a SyxLib::PointerChain for chains read every frame.
+     *
+     * @param baseAddress The base address to start the nested pointer dereferencing.
+     * @param offsets A vector of offsets that define the path to the desired memory location.
+     * @param valueHere Receives the value.
+     * @return False if a null pointer is encountered on the path.
+     */
+    template <typename T>
+    static bool ReadPTR(uintptr_t baseAddress, const std::vector<uintptr_t>& offsets, T& valueHere)
+    {
+        uintptr_t address;
+        return SyxLib::ResolvePointerChain(SyxLib::LocalMemory::Instance(), baseAddress, offsets, address) &&
+            SyxLib::LocalMemory::Instance().Read(address, valueHere);
+    }
+
+    /**
+     * Reads a value through a nested pointer, validating every address against a cached region map
+     * instead of risking a fault. Never throws and never prints; suitable for hot loops.
+     *
+     * @param baseAddress The base address to start the nested pointer dereferencing.
+     * @param offsets A vector of offsets that define the path to the desired memory location.
+     * @return The value, or the SyxLib::MemoryError that stopped the read.
+     */
+    template <typename T>
+    static SyxLib::Result<T> SafeReadPTR(uintptr_t baseAddress, const std::vector<uintptr_t>& offsets)
+    {
+        SyxLib::SafeMemory& memory = SyxLib::SafeMemory::Instance();
+        const SyxLib::Result<uintptr_t> address = memory.TryResolve(baseAddress, offsets);
+        if (!address)
+        {
+            return address.Error();
+        }
+        return memory.TryRead<T>(*address);
+    }
+
+    /**
+     * Writes a value through a nested pointer, validating every address against a cached region map
+     * instead of risking a fault. Never throws and never prints; suitable for hot loops.
+     *
+     * @param baseAddress The base address to start the nested pointer dereferencing.
+     * @param offsets A vector of offsets that define the path to the desired memory location.
+     * @param valueHere The value to be written to the memory location.
+     * @return Success, or the SyxLib::MemoryError that stopped the write.
+     */
+    template <typename T>
+    static SyxLib::Result<void> SafeWritePTR(uintptr_t baseAddress, const std::vector<uintptr_t>& offsets, const T& valueHere)
+    {
+        SyxLib::SafeMemory& memory = SyxLib::SafeMemory::Instance();
+        const SyxLib::Result<uintptr_t> address = memory.TryResolve(baseAddress, offsets);
+        if (!address)
+        {
+            return address.Error();
+        }
+        return memory.TryWrite(*address, valueHere);
+    }
+
+    /**
+     * Writes a value through a nested pointer in any address space, for example another process
+     * opened with SyxLib::ProcessMemory. Pointers are read with the target's pointer size.
+     *
+     * @param memory The address space to write to.
+     * @param baseAddress The base address to start the nested pointer dereferencing.
+     * @param offsets A vector of offsets that define the path to the desired memory location.
+     * @param valueHere The value to be written to the memory location.
+     * @throw std::runtime_error if a pointer on the path cannot be read or the value cannot be written.
+     */
+    template <typename T>
+    static void WritePTR(const SyxLib::MemoryAccessor& memory, uintptr_t baseAddress, const std::vector<uintptr_t>& offsets, T valueHere)
+    {
+        uintptr_t address;
+        if (!SyxLib::ResolvePointerChain(memory, baseAddress, offsets, address))
+        {
+            throw std::runtime_error("Invalid pointer encountered.");
+        }
+        if (!memory.Write(address, valueHere))
+        {
+            throw std::runtime_error("Failed to write the value.");
+        }
+    }
+
+    /**
+     * Finds pointer paths from a module's static data to an address, ready to pass to WritePTR or
+     * ReadPTR. The process is read with ReadProcessMemory, so memory other threads free during the
+     * scan is skipped instead of faulting.
+     *
+     * @param module The name of the module whose writable sections hold the static bases.
+     * @param target The address the paths must reach, e.g. a value found with SyxLib::ValueScan.
+     * @param options Maximum depth, offset and number of paths.
+     * @return The paths found, shortest first.
+     */
+    static std::vector<SyxLib::PointerPath> FindPointerPaths(const wchar_t* module, uintptr_t target, const SyxLib::PointerScanOptions& options = {})
+    {
+        const SyxLib::ProcessMemory self(SyxLib::CurrentProcessId());
+        return SyxLib::FindPointerPaths(self, target, GetModuleRegions(module, SyxLib::RegionFilter::Writable()), options);
+    }
+
+    /**
+     * Searches for a parsed signature in a memory range of any address space. Only committed,
+     * readable regions are read; remote memory is copied in large batched blocks.
+     *
+     * @param memory The address space to search, e.g. SyxLib::ProcessMemory(pid).
+     * @param dwAddress Starting address of the memory range.
+     * @param dwLen Length of the memory range to search.
+     * @param pattern The signature.
+     * @return The address where the pattern was found, or 0 if not found.
+     */
+    static uintptr_t FindPattern(const SyxLib::MemoryAccessor& memory, uintptr_t dwAddress, uintptr_t dwLen, const SyxLib::Pattern& pattern)
+    {
+        return SyxLib::FindPattern(memory, SyxLib::Scanner(pattern), dwAddress, dwLen);
+    }
+
     /**
      * Retrieves the base address of a module loaded in the current process.
      *
@@ -147,113 +574,93 @@ public:
      */
     static uintptr_t GetModuleHandleEx(const char* moduleName)
     {
-        return reinterpret_cast<uintptr_t>(GetModuleHandleA(moduleName));
+        return reinterpret_cast<uintptr_t>(SyxLib::FindModule(moduleName).lpBaseOfDll);
     }
 
     /**
      * Detours a function by replacing its code with a jump to a detour function.
      *
+     * The hook is created and enabled in SyxLib::HookManager::Instance(), which keeps the
+     * trampolines of all hooks in shared pages next to their targets. The overwritten
+     * instructions are found with the built-in length decoder and moved to the trampoline with
+     * their branches and RIP-relative operands relocated, so any prologue works.
+     *
      * @param src Pointer to the function to detour.
      * @param dest Pointer to the detour function.
-     * @param jumplength Length of the jump instruction.
-     * @return A pointer to the original code of the function.
+     * @param jumplength Minimum number of bytes to move, 0 for just the 5-byte jump. Rounded up to whole instructions.
+     * @return A pointer to the original code of the function, or nullptr if the function cannot be hooked.
      */
-    static const void* DetourFunc64(BYTE* const src, const BYTE* dest, const unsigned int jumplength)
+    static const void* DetourFunc64(uint8_t* const src, const uint8_t* dest, const unsigned int jumplength = 0)
     {
-        // Allocate a memory page that is going to contain executable code.
-        MEMORY_BASIC_INFORMATION mbi;
-        const SIZE_T pageSize = 0x1000;
-        for (SIZE_T addr = reinterpret_cast<SIZE_T>(src); addr > reinterpret_cast<SIZE_T>(src) - 0x80000000; addr = reinterpret_cast<SIZE_T>(mbi.BaseAddress) - 1)
+        SyxLib::HookManager& hooks = SyxLib::HookManager::Instance();
+        const void* original = nullptr;
+        if (hooks.Create(src, dest, &original, jumplength) != SyxLib::HookStatus::Ok)
         {
-            if (!VirtualQuery(reinterpret_cast<LPCVOID>(addr), &mbi, sizeof(mbi)))
-            {
-                break;
-            }
-
-            if (mbi.State == MEM_FREE)
-            {
-                if (presenthook64 = reinterpret_cast<HookContext*>(VirtualAlloc(mbi.BaseAddress, pageSize, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE)))
-                {
-                    break;
-                }
-            }
+            return nullptr;
         }
-
-        // If allocating a memory page failed, the function failed.
-        if (!presenthook64)
+        if (hooks.Enable(src) != SyxLib::HookStatus::Ok)
         {
+            hooks.Remove(src);
             return nullptr;
         }
-
-        // Save original code and apply detour. The detour code is:
-        // push rax
-        // movabs rax, 0xCCCCCCCCCCCCCCCC
-        // xchg rax, [rsp]
-        // ret
-        BYTE detour[] = { 0x50, 0x48, 0xB8, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x48, 0x87, 0x04, 0x24, 0xC3 };
-        const unsigned int length = jumplength;
-        memcpy(presenthook64->original_code, src, length);
-        memcpy(&presenthook64->original_code[length], detour, sizeof(detour));
-        *(SIZE_T*)&presenthook64->original_code[length + 3] = (SIZE_T)src + length;
-
-        // Build a far jump to the destination function.
-        *(WORD*)&presenthook64->far_jmp = 0x25FF;
-        *(DWORD*)(presenthook64->far_jmp + 2) = (DWORD)((SIZE_T)presenthook64 - (SIZE_T)src + FIELD_OFFSET(HookContext, dst_ptr) - 6);
-        presenthook64->dst_ptr = (SIZE_T)dest;
-
-        // Write the hook to the original function.
-        DWORD flOld = 0;
-        VirtualProtect(src, 6, PAGE_EXECUTE_READWRITE, &flOld);
-        memcpy(src, presenthook64->far_jmp, sizeof(presenthook64->far_jmp));
-        VirtualProtect(src, 6, flOld, &flOld);
-
-        // Return a pointer to the original code.
-        return presenthook64->original_code;
+        return original;
     }
 
     /**
      * Detours a function in a 32-bit environment.
      *
+     * Same as DetourFunc64; the hook manager patches with a 5-byte jmp rel32 in either mode.
+     *
      * @param src Pointer to the source function to be detoured.
      * @param dest Pointer to the destination function where the execution should be redirected.
-     * @param length Length of the overwritten instructions.
-     * @return Pointer to the original code of the detoured function.
+     * @param length Minimum number of bytes to overwrite, 0 for just the 5-byte jump. Rounded up to whole instructions.
+     * @return Pointer to the original code of the detoured function, or nullptr if the function cannot be hooked.
      */
-    static const void* DetourFunc32(BYTE* const src, const BYTE* dest, const unsigned int length)
+    static const void* DetourFunc32(uint8_t* const src, const uint8_t* dest, const unsigned int length = 0)
     {
-        const auto detourLength = length < 5 ? 5 : length;
+        return DetourFunc64(src, dest, length);
+    }
 
-        BYTE* jmp = new BYTE[detourLength];
-        DWORD dwOldProtect, dwBkup, dwRelAddr;
-        VirtualProtect(src, detourLength, PAGE_EXECUTE_READWRITE, &dwOldProtect);
-        dwRelAddr = (DWORD)(dest - src) - 5;
-        *src = 0xE9;
-        *(DWORD*)(src + 1) = dwRelAddr;
-        for (unsigned int i = 5; i < detourLength; i++)
+    /**
+     * Restores a function detoured with DetourFunc64 or DetourFunc32. Safe while the function
+     * runs; the trampoline stays callable until SyxLib::HookManager::Reclaim.
+     *
+     * @param src Pointer to the detoured function.
+     * @return True if the function was detoured and has been restored.
+     */
+    static bool RemoveDetour(uint8_t* const src)
+    {
+        return SyxLib::HookManager::Instance().Remove(src) == SyxLib::HookStatus::Ok;
+    }
+
+private:
+    /** The readable regions of a module as spans, without the unmapped gaps between its segments. */
+    static std::vector<SyxLib::ByteSpan> GetModuleSpans(const wchar_t* module)
+    {
+        std::vector<SyxLib::ByteSpan> spans;
+        for (const SyxLib::MemoryRegion& region : GetModuleRegions(module))
         {
-            *(src + i) = 0x90;
+            spans.push_back({ reinterpret_cast<const uint8_t*>(region.base), region.size });
         }
-        VirtualProtect(src, detourLength, dwOldProtect, &dwBkup);
-
-        memcpy(jmp, src, detourLength);
-        jmp += detourLength;
-        *(jmp - 5) = 0xE9;
-        *(DWORD*)(jmp - 4) = (DWORD)((src - jmp) - 5);
+        return spans;
+    }
 
-        return (jmp - detourLength);
+    static SyxLib::MatchRange Matches(const wchar_t* module, SyxLib::Scanner scanner, size_t limit)
+    {
+        return SyxLib::MatchRange(static_cast<SyxLib::Scanner&&>(scanner), GetModuleSpans(module), limit);
     }
 
-private:
-    struct HookContext
+    static uintptr_t FindPatternCached(SyxLib::SignatureCache& cache, const wchar_t* module, const SyxLib::Scanner& scanner)
     {
-        BYTE original_code[64];
-        SIZE_T dst_ptr;
-        BYTE far_jmp[6];
-    };
+        SyxLib::ModuleInfo mInfo = GetModuleInfo(module);
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(mInfo.lpBaseOfDll);
+        const size_t size = mInfo.SizeOfImage;
+        if (!base)
+        {
+            return 0;
+        }
 
-    static HookContext* presenthook64;
+        const size_t offset = cache.Find(cache.ModuleKey(base, size), scanner, base, GetModuleSpans(module));
+        return offset == SyxLib::NOT_FOUND ? 0 : reinterpret_cast<uintptr_t>(base) + offset;
+    }
 };
-
-
-//Don't touch, let it be here.
-Syx::HookContext* Syx::presenthook64;
@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SyxLib
+{
+    /**
+     * A fixed set of background threads that run one fork/join task at a time.
+     *
+     * Run() hands the same task to every participating worker (the calling thread is worker 0) and
+     * returns when all of them are done. Work distribution inside the task is up to the caller.
+     * A task must not call Run() on the pool that is executing it.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * Starts the pool.
+         *
+         * @param threads Number of background threads. The calling thread of Run() adds one more worker.
+         */
+        explicit ThreadPool(unsigned threads)
+        {
+            for (unsigned i = 0; i < threads; i++)
+            {
+                m_threads.emplace_back([this, i] { WorkerLoop(i + 1); });
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (std::thread& thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * @return Maximum number of workers a Run() call can use, including the calling thread.
+         */
+        unsigned Concurrency() const
+        {
+            return static_cast<unsigned>(m_threads.size()) + 1;
+        }
+
+        /**
+         * Runs task(0) .. task(workers - 1) in parallel and waits for all of them.
+         *
+         * @param workers Number of workers, clamped to [1, Concurrency()].
+         * @param task Function receiving the worker index.
+         */
+        void Run(unsigned workers, const std::function<void(unsigned)>& task)
+        {
+            workers = (std::max)(1u, (std::min)(workers, Concurrency()));
+            std::lock_guard<std::mutex> runLock(m_runMutex);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_task = &task;
+                m_workers = workers;
+                m_pending = workers - 1;
+                m_generation++;
+            }
+            m_wake.notify_all();
+
+            task(0);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_pending == 0; });
+            m_task = nullptr;
+        }
+
+        /**
+         * @return Process-wide pool sized to the number of hardware threads.
+         */
+        static ThreadPool& Default()
+        {
+            static ThreadPool pool((std::max)(1u, std::thread::hardware_concurrency()) - 1);
+            return pool;
+        }
+
+    private:
+        void WorkerLoop(unsigned index)
+        {
+            uint64_t seen = 0;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (;;)
+            {
+                m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+                if (m_stop)
+                {
+                    return;
+                }
+                seen = m_generation;
+                if (index >= m_workers)
+                {
+                    continue;
+                }
+
+                const std::function<void(unsigned)>* task = m_task;
+                lock.unlock();
+                (*task)(index);
+                lock.lock();
+                if (--m_pending == 0)
+                {
+                    m_done.notify_all();
+                }
+            }
+        }
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_runMutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const std::function<void(unsigned)>* m_task = nullptr;
+        unsigned m_workers = 0;
+        unsigned m_pending = 0;
+        uint64_t m_generation = 0;
+        bool m_stop = false;
+    };
+}
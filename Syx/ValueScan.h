@@ -0,0 +1,848 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "Memory.h"
+#include "MemoryScan.h"
+#include "Regions.h"
+#include "SafeMemory.h"
+#include "Scanner.h"
+
+namespace SyxLib
+{
+    /**
+     * How a value scan selects candidates.
+     */
+    enum class ValueCompare
+    {
+        /** Every aligned address; records the current values for later comparisons. */
+        Unknown,
+        /** The value equals the given value. */
+        Exact,
+        /** The value lies in [value, upper], bounds included. */
+        Range,
+        /** The bytes of the value differ from the last scan. Next scans only. */
+        Changed,
+        /** The bytes of the value are the same as at the last scan. Next scans only. */
+        Unchanged,
+        /** The value is greater than at the last scan. Next scans only. */
+        Increased,
+        /** The value is smaller than at the last scan. Next scans only. */
+        Decreased
+    };
+
+    namespace Detail
+    {
+        template <typename T>
+        struct IsScanValue
+        {
+            static constexpr bool value = std::is_same<T, float>::value || std::is_same<T, double>::value ||
+                (std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+                    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8));
+        };
+
+        /**
+         * lo <= value <= hi. Integers use one unsigned comparison: value - lo <= hi - lo, which
+         * holds exactly for values inside the range whatever the signedness.
+         */
+        template <typename T>
+        inline bool InValueRange(T value, T lo, T hi)
+        {
+            if constexpr (std::is_floating_point<T>::value)
+            {
+                return value >= lo && value <= hi;
+            }
+            else
+            {
+                using U = typename std::make_unsigned<T>::type;
+                return static_cast<U>(static_cast<U>(value) - static_cast<U>(lo)) <= static_cast<U>(static_cast<U>(hi) - static_cast<U>(lo));
+            }
+        }
+
+        template <typename Callback, typename T>
+        inline bool InvokeValueCallback(Callback& callback, uintptr_t address, const T& value)
+        {
+            if constexpr (std::is_same<decltype(callback(address, value)), bool>::value)
+            {
+                return callback(address, value);
+            }
+            else
+            {
+                callback(address, value);
+                return true;
+            }
+        }
+
+        template <typename T>
+        inline T LoadValue(const uint8_t* data)
+        {
+            T value;
+            memcpy(&value, data, sizeof(T));
+            return value;
+        }
+
+        /**
+         * Range test of every element of 64-byte chunks. masks[c] bit i is set if the i-th T of
+         * chunk c lies in [lo, hi]; a chunk holds 64 / sizeof(T) elements.
+         */
+        template <typename T>
+        inline void MatchValuesScalar(const uint8_t* data, size_t chunks, T lo, T hi, uint64_t* masks)
+        {
+            constexpr size_t PER_CHUNK = 64 / sizeof(T);
+            for (size_t c = 0; c < chunks; c++)
+            {
+                uint64_t bits = 0;
+                for (size_t i = 0; i < PER_CHUNK; i++)
+                {
+                    bits |= static_cast<uint64_t>(InValueRange(LoadValue<T>(data + c * 64 + i * sizeof(T)), lo, hi)) << i;
+                }
+                masks[c] = bits;
+            }
+        }
+
+#ifdef SYX_X86
+        template <typename T>
+        SYX_TARGET("avx2")
+        inline uint32_t MatchValuesAVX2Half(__m256i v, T lo, T hi)
+        {
+            if constexpr (std::is_same<T, float>::value)
+            {
+                const __m256 x = _mm256_castsi256_ps(v);
+                return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(
+                    _mm256_cmp_ps(x, _mm256_set1_ps(lo), _CMP_GE_OQ), _mm256_cmp_ps(x, _mm256_set1_ps(hi), _CMP_LE_OQ))));
+            }
+            else if constexpr (std::is_same<T, double>::value)
+            {
+                const __m256d x = _mm256_castsi256_pd(v);
+                return static_cast<uint32_t>(_mm256_movemask_pd(_mm256_and_pd(
+                    _mm256_cmp_pd(x, _mm256_set1_pd(lo), _CMP_GE_OQ), _mm256_cmp_pd(x, _mm256_set1_pd(hi), _CMP_LE_OQ))));
+            }
+            else
+            {
+                // Unsigned value - lo <= hi - lo, see InValueRange. AVX2 has no unsigned compare:
+                // max(x, span) == span for 8 to 32 bits, a signed compare with flipped sign bits for 64.
+                using U = typename std::make_unsigned<T>::type;
+                const U span = static_cast<U>(static_cast<U>(hi) - static_cast<U>(lo));
+                if constexpr (sizeof(T) == 1)
+                {
+                    const __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(static_cast<char>(lo)));
+                    const __m256i s = _mm256_set1_epi8(static_cast<char>(span));
+                    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x, s), s)));
+                }
+                else if constexpr (sizeof(T) == 2)
+                {
+                    const __m256i x = _mm256_sub_epi16(v, _mm256_set1_epi16(static_cast<short>(lo)));
+                    const __m256i s = _mm256_set1_epi16(static_cast<short>(span));
+                    // One bit per 16-bit lane: keep the odd bits of the byte mask.
+                    const uint32_t bytes = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_max_epu16(x, s), s)));
+                    uint32_t bits = 0;
+                    for (unsigned i = 0; i < 16; i++)
+                    {
+                        bits |= ((bytes >> (2 * i + 1)) & 1u) << i;
+                    }
+                    return bits;
+                }
+                else if constexpr (sizeof(T) == 4)
+                {
+                    const __m256i x = _mm256_sub_epi32(v, _mm256_set1_epi32(static_cast<int>(lo)));
+                    const __m256i s = _mm256_set1_epi32(static_cast<int>(span));
+                    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_max_epu32(x, s), s))));
+                }
+                else
+                {
+                    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+                    const __m256i x = _mm256_xor_si256(_mm256_sub_epi64(v, _mm256_set1_epi64x(static_cast<long long>(lo))), sign);
+                    const __m256i s = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(span)), sign);
+                    return ~static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, s)))) & 0xFu;
+                }
+            }
+        }
+
+        template <typename T>
+        SYX_TARGET("avx2")
+        inline void MatchValuesAVX2(const uint8_t* data, size_t chunks, T lo, T hi, uint64_t* masks)
+        {
+            constexpr unsigned HALF = 32 / sizeof(T);
+            for (size_t c = 0; c < chunks; c++)
+            {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + c * 64));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + c * 64 + 32));
+                masks[c] = static_cast<uint64_t>(MatchValuesAVX2Half<T>(a, lo, hi)) |
+                    (static_cast<uint64_t>(MatchValuesAVX2Half<T>(b, lo, hi)) << HALF);
+            }
+        }
+
+        template <typename T>
+        SYX_TARGET("avx512f,avx512bw")
+        inline void MatchValuesAVX512(const uint8_t* data, size_t chunks, T lo, T hi, uint64_t* masks)
+        {
+            using U = typename std::conditional<std::is_floating_point<T>::value, T, typename std::make_unsigned<
+                typename std::conditional<std::is_floating_point<T>::value, int, T>::type>::type>::type;
+            const U span = static_cast<U>(static_cast<U>(hi) - static_cast<U>(lo));
+            for (size_t c = 0; c < chunks; c++)
+            {
+                const __m512i v = _mm512_loadu_si512(data + c * 64);
+                if constexpr (std::is_same<T, float>::value)
+                {
+                    const __m512 x = _mm512_castsi512_ps(v);
+                    masks[c] = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(x, _mm512_set1_ps(lo), _CMP_GE_OQ), x, _mm512_set1_ps(hi), _CMP_LE_OQ);
+                }
+                else if constexpr (std::is_same<T, double>::value)
+                {
+                    const __m512d x = _mm512_castsi512_pd(v);
+                    masks[c] = _mm512_mask_cmp_pd_mask(_mm512_cmp_pd_mask(x, _mm512_set1_pd(lo), _CMP_GE_OQ), x, _mm512_set1_pd(hi), _CMP_LE_OQ);
+                }
+                else if constexpr (sizeof(T) == 1)
+                {
+                    masks[c] = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8(static_cast<char>(lo))), _mm512_set1_epi8(static_cast<char>(span)));
+                }
+                else if constexpr (sizeof(T) == 2)
+                {
+                    masks[c] = _mm512_cmple_epu16_mask(_mm512_sub_epi16(v, _mm512_set1_epi16(static_cast<short>(lo))), _mm512_set1_epi16(static_cast<short>(span)));
+                }
+                else if constexpr (sizeof(T) == 4)
+                {
+                    masks[c] = _mm512_cmple_epu32_mask(_mm512_sub_epi32(v, _mm512_set1_epi32(static_cast<int>(lo))), _mm512_set1_epi32(static_cast<int>(span)));
+                }
+                else
+                {
+                    masks[c] = _mm512_cmple_epu64_mask(_mm512_sub_epi64(v, _mm512_set1_epi64(static_cast<long long>(lo))), _mm512_set1_epi64(static_cast<long long>(span)));
+                }
+            }
+        }
+#endif
+
+        template <typename T>
+        inline void MatchValues(const uint8_t* data, size_t chunks, T lo, T hi, uint64_t* masks, ScanLevel level)
+        {
+            switch (level)
+            {
+#ifdef SYX_X86
+            case ScanLevel::AVX512:
+                MatchValuesAVX512<T>(data, chunks, lo, hi, masks);
+                return;
+            case ScanLevel::AVX2:
+                MatchValuesAVX2<T>(data, chunks, lo, hi, masks);
+                return;
+#endif
+            default:
+                MatchValuesScalar<T>(data, chunks, lo, hi, masks);
+                return;
+            }
+        }
+    }
+
+    template <typename T>
+    class ValueScan;
+
+    /**
+     * The candidates of a value scan: addresses in ascending order, each with the value it had
+     * when last scanned.
+     *
+     * Addresses are grouped in 64 KB windows. Each window stores its candidates either as a bitmap
+     * with one bit per aligned slot or as 16-bit gaps between consecutive slots, whichever is
+     * smaller, so dense results cost a bit per slot and sparse ones two bytes per address instead
+     * of the eight of a plain address list.
+     */
+    template <typename T>
+    class ValueScanResults
+    {
+    public:
+        static constexpr size_t WINDOW_BYTES = 64 * 1024;
+
+        /**
+         * @return Number of candidates.
+         */
+        size_t Count() const
+        {
+            return m_values.size();
+        }
+
+        bool Empty() const
+        {
+            return m_values.empty();
+        }
+
+        /**
+         * @return Distance between candidate slots, in bytes.
+         */
+        size_t Alignment() const
+        {
+            return m_alignment;
+        }
+
+        /**
+         * @return Bytes used by the encoded addresses and the stored values.
+         */
+        size_t MemoryUsage() const
+        {
+            return m_windows.size() * sizeof(Window) + m_bitmaps.size() * sizeof(uint64_t) +
+                m_gaps.size() * sizeof(uint16_t) + m_values.size() * sizeof(T);
+        }
+
+        /**
+         * Calls a function for every candidate in address order.
+         *
+         * @param callback Called with (address, value at the last scan). If it returns bool, returning false stops.
+         * @return Number of candidates visited.
+         */
+        template <typename Callback>
+        size_t ForEach(Callback&& callback) const
+        {
+            size_t visited = 0;
+            for (const Window& window : m_windows)
+            {
+                size_t index = window.firstValue;
+                const bool more = ForEachSlot(window, [&](size_t slot)
+                {
+                    visited++;
+                    return Detail::InvokeValueCallback(callback, window.base + slot * m_alignment, m_values[index++]);
+                });
+                if (!more)
+                {
+                    break;
+                }
+            }
+            return visited;
+        }
+
+        /**
+         * @param limit Maximum number of addresses to return.
+         * @return The candidate addresses in ascending order.
+         */
+        std::vector<uintptr_t> Addresses(size_t limit = SIZE_MAX) const
+        {
+            std::vector<uintptr_t> addresses;
+            addresses.reserve((std::min)(limit, Count()));
+            if (limit)
+            {
+                ForEach([&](uintptr_t address, const T&)
+                {
+                    addresses.push_back(address);
+                    return addresses.size() < limit;
+                });
+            }
+            return addresses;
+        }
+
+        void Clear()
+        {
+            m_windows.clear();
+            m_bitmaps.clear();
+            m_gaps.clear();
+            m_values.clear();
+        }
+
+    private:
+        friend class ValueScan<T>;
+
+        struct Window
+        {
+            /** Address of the window, a multiple of WINDOW_BYTES. */
+            uintptr_t base;
+            /** Index of the first bitmap word or gap. */
+            size_t code;
+            /** Index of the first value. */
+            size_t firstValue;
+            uint32_t count;
+            /** Bitmap: index of the first stored word within the window. */
+            uint16_t firstWord;
+            /** Bitmap: number of stored words; 0 for gap encoding. */
+            uint16_t words;
+        };
+
+        explicit ValueScanResults(size_t alignment = sizeof(T))
+            : m_alignment(alignment)
+        {
+        }
+
+        /** Calls visit(slot) for every slot of a window in ascending order; false stops. */
+        template <typename Visit>
+        bool ForEachSlot(const Window& window, Visit&& visit) const
+        {
+            if (window.words)
+            {
+                for (size_t w = 0; w < window.words; w++)
+                {
+                    uint64_t bits = m_bitmaps[window.code + w];
+                    while (bits)
+                    {
+                        if (!visit((window.firstWord + w) * 64 + Detail::CountTrailingZeros(bits)))
+                        {
+                            return false;
+                        }
+                        bits &= bits - 1;
+                    }
+                }
+                return true;
+            }
+            size_t slot = 0;
+            for (size_t i = 0; i < window.count; i++)
+            {
+                slot += m_gaps[window.code + i];
+                if (!visit(slot))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /** Appends a candidate. Addresses must be added in ascending order and be multiples of the alignment. */
+        void Add(uintptr_t address, const T& value)
+        {
+            const uintptr_t base = address & ~static_cast<uintptr_t>(WINDOW_BYTES - 1);
+            if (base != m_building || m_scratch.empty())
+            {
+                Seal();
+                m_building = base;
+                m_scratch.assign(WINDOW_BYTES / m_alignment / 64, 0);
+                m_firstDirty = m_scratch.size();
+                m_lastDirty = 0;
+                m_buildFirst = m_values.size();
+            }
+            const size_t slot = (address - base) / m_alignment;
+            const size_t word = slot / 64;
+            m_scratch[word] |= uint64_t(1) << (slot % 64);
+            m_firstDirty = (std::min)(m_firstDirty, word);
+            m_lastDirty = (std::max)(m_lastDirty, word);
+            m_values.push_back(value);
+        }
+
+        /** Encodes the window being built. */
+        void Seal()
+        {
+            const size_t count = m_values.size() - m_buildFirst;
+            if (m_scratch.empty() || count == 0)
+            {
+                return;
+            }
+            Window window = { m_building, 0, m_buildFirst, static_cast<uint32_t>(count), 0, 0 };
+            const size_t words = m_lastDirty - m_firstDirty + 1;
+            if (words * sizeof(uint64_t) < count * sizeof(uint16_t))
+            {
+                window.code = m_bitmaps.size();
+                window.firstWord = static_cast<uint16_t>(m_firstDirty);
+                window.words = static_cast<uint16_t>(words);
+                m_bitmaps.insert(m_bitmaps.end(), m_scratch.begin() + m_firstDirty, m_scratch.begin() + m_lastDirty + 1);
+            }
+            else
+            {
+                window.code = m_gaps.size();
+                size_t previous = 0;
+                for (size_t w = m_firstDirty; w <= m_lastDirty; w++)
+                {
+                    uint64_t bits = m_scratch[w];
+                    while (bits)
+                    {
+                        const size_t slot = w * 64 + Detail::CountTrailingZeros(bits);
+                        m_gaps.push_back(static_cast<uint16_t>(slot - previous));
+                        previous = slot;
+                        bits &= bits - 1;
+                    }
+                }
+            }
+            m_windows.push_back(window);
+            m_buildFirst = m_values.size();
+        }
+
+        /** Seals the last window and releases the build state. */
+        void Finish()
+        {
+            Seal();
+            m_scratch.clear();
+            m_scratch.shrink_to_fit();
+            m_windows.shrink_to_fit();
+            m_bitmaps.shrink_to_fit();
+            m_gaps.shrink_to_fit();
+            m_values.shrink_to_fit();
+        }
+
+        size_t m_alignment;
+        std::vector<Window> m_windows;
+        std::vector<uint64_t> m_bitmaps;
+        std::vector<uint16_t> m_gaps;
+        std::vector<T> m_values;
+
+        std::vector<uint64_t> m_scratch;
+        uintptr_t m_building = 0;
+        size_t m_buildFirst = 0;
+        size_t m_firstDirty = 0;
+        size_t m_lastDirty = 0;
+    };
+
+    /**
+     * Finds the addresses holding a typed value and narrows them over successive scans, the way
+     * a cheat table is built: a first scan for an exact value, a range or an unknown value, then
+     * next scans keeping only the candidates whose value is exact, in range, changed, unchanged,
+     * increased or decreased relative to the previous scan.
+     *
+     * The first scan reads every region with the SIMD range kernels (AVX-512, AVX2, scalar). Next
+     * scans only read the surviving candidates: in place for the current process, through
+     * scattered reads for another one. T is an 8 to 64-bit integer, float or double.
+     *
+     * @example
+     * SyxLib::ValueScan<int32_t> scan(memory);
+     * scan.FirstScan(SyxLib::ValueCompare::Exact, 100);
+     * // ... the value drops to 95 ...
+     * scan.NextScan(SyxLib::ValueCompare::Exact, 95);
+     * for (uintptr_t address : scan.Results().Addresses(10)) ...
+     */
+    template <typename T>
+    class ValueScan
+    {
+        static_assert(Detail::IsScanValue<T>::value, "ValueScan needs an 8 to 64-bit integer, float or double.");
+
+    public:
+        /**
+         * @param memory The address space to scan. Must outlive the scan.
+         * @param alignment Distance between candidate addresses: a power of two from 1 to 64.
+         *                  The default, sizeof(T), finds naturally aligned values.
+         * @throw std::invalid_argument if the alignment is not supported.
+         */
+        explicit ValueScan(const MemoryAccessor& memory = LocalMemory::Instance(), size_t alignment = sizeof(T))
+            : m_memory(memory), m_alignment(alignment), m_results(alignment), m_level(DetectScanLevel())
+        {
+            if (alignment == 0 || alignment > 64 || (alignment & (alignment - 1)))
+            {
+                throw std::invalid_argument("ValueScan alignment must be a power of two from 1 to 64.");
+            }
+        }
+
+        /**
+         * Scans a list of regions, replacing any previous results.
+         *
+         * @param regions Regions sorted by base address, typically from FilterRegions.
+         * @param compare Unknown, Exact or Range.
+         * @param value The value for Exact, the lower bound for Range.
+         * @param upper The upper bound for Range.
+         * @return Number of candidates.
+         * @throw std::invalid_argument for a comparison that needs a previous scan, or upper < value.
+         */
+        size_t FirstScan(const std::vector<MemoryRegion>& regions, ValueCompare compare, T value = T(), T upper = T())
+        {
+            T lo, hi;
+            SelectBounds(compare, value, upper, lo, hi, true);
+
+            ValueScanResults<T> results(m_alignment);
+            Detail::ForEachBlock(m_memory, regions, sizeof(T) - 1, DEFAULT_BLOCK_SIZE,
+                [&](uintptr_t address, const uint8_t* data, size_t size)
+                {
+                    if (compare == ValueCompare::Unknown)
+                    {
+                        AddAll(results, address, data, size);
+                    }
+                    else
+                    {
+                        AddMatches(results, address, data, size, lo, hi);
+                    }
+                    return true;
+                });
+            results.Finish();
+            m_results = static_cast<ValueScanResults<T>&&>(results);
+            return m_results.Count();
+        }
+
+        /**
+         * Scans the committed regions of the address space a filter accepts, writable memory by default.
+         */
+        size_t FirstScan(ValueCompare compare, T value = T(), T upper = T(), const RegionFilter& filter = RegionFilter::Writable())
+        {
+            return FirstScan(FilterRegions(m_memory.QueryRegions(), filter), compare, value, upper);
+        }
+
+        /**
+         * Rereads the current candidates and keeps those that pass the comparison. Candidates that
+         * can no longer be read are dropped. The kept candidates remember their new values.
+         *
+         * @param compare Any comparison; Unknown keeps every readable candidate.
+         * @param value The value for Exact, the lower bound for Range.
+         * @param upper The upper bound for Range.
+         * @return Number of candidates left.
+         * @throw std::invalid_argument if upper < value for Range.
+         */
+        size_t NextScan(ValueCompare compare, T value = T(), T upper = T())
+        {
+            T lo, hi;
+            SelectBounds(compare, value, upper, lo, hi, false);
+
+            using Window = typename ValueScanResults<T>::Window;
+            const ValueScanResults<T>& old = m_results;
+            ValueScanResults<T> results(m_alignment);
+
+            // Remote candidates are batched: a dense window is read as one span, a sparse window
+            // as one request per candidate, and all requests of a batch go out in one ReadScatter.
+            struct Pending
+            {
+                const Window* window;
+                size_t request;
+                uintptr_t span;
+            };
+            static constexpr size_t BATCH_BYTES = 1024 * 1024;
+            std::vector<Pending> pending;
+            std::vector<ReadRequest> requests;
+            std::vector<uint8_t> buffer;
+            size_t used = 0;
+            // Direct pointers are not checked, and a candidate may have been unmapped since the
+            // last scan: they are only read where a fresh region query still finds memory.
+            RegionMap regions(m_memory);
+
+            auto keep = [&](uintptr_t address, const uint8_t* bytes, const T& previous)
+            {
+                const T current = Detail::LoadValue<T>(bytes);
+                if (Passes(compare, current, previous, lo, hi))
+                {
+                    results.Add(address, current);
+                }
+            };
+
+            auto flush = [&]()
+            {
+                if (pending.empty())
+                {
+                    return;
+                }
+                for (ReadRequest& request : requests)
+                {
+                    request.buffer = buffer.data() + reinterpret_cast<size_t>(request.buffer);
+                }
+                m_memory.ReadScatter(requests.data(), requests.size());
+                for (const Pending& item : pending)
+                {
+                    const Window& window = *item.window;
+                    size_t index = window.firstValue;
+                    size_t request = item.request;
+                    old.ForEachSlot(window, [&](size_t slot)
+                    {
+                        const uintptr_t address = window.base + slot * m_alignment;
+                        const ReadRequest* source = &requests[item.span ? item.request : request++];
+                        const size_t offset = item.span ? address - item.span : 0;
+                        if (offset + sizeof(T) <= source->transferred)
+                        {
+                            keep(address, static_cast<const uint8_t*>(source->buffer) + offset, old.m_values[index]);
+                        }
+                        index++;
+                        return true;
+                    });
+                }
+                pending.clear();
+                requests.clear();
+                used = 0;
+            };
+
+            for (const Window& window : old.m_windows)
+            {
+                uintptr_t first = 0, last = 0;
+                old.ForEachSlot(window, [&](size_t slot)
+                {
+                    last = window.base + slot * m_alignment;
+                    first = first ? first : last;
+                    return true;
+                });
+                const size_t spanSize = last - first + sizeof(T);
+
+                if (const uint8_t* direct = m_memory.Direct(first, spanSize))
+                {
+                    flush();
+                    const bool readable = regions.Accessible(first, spanSize, PROTECT_READ) == spanSize;
+                    size_t index = window.firstValue;
+                    old.ForEachSlot(window, [&](size_t slot)
+                    {
+                        const uintptr_t address = window.base + slot * m_alignment;
+                        if (readable || regions.Accessible(address, sizeof(T), PROTECT_READ) == sizeof(T))
+                        {
+                            keep(address, direct + (address - first), old.m_values[index]);
+                        }
+                        index++;
+                        return true;
+                    });
+                    continue;
+                }
+
+                const bool dense = window.words != 0;
+                const size_t bytes = dense ? spanSize : window.count * sizeof(T);
+                if (used + bytes > (std::max)(BATCH_BYTES, buffer.size()) && !pending.empty())
+                {
+                    flush();
+                }
+                if (used + bytes > buffer.size())
+                {
+                    buffer.resize((std::max)(used + bytes, BATCH_BYTES));
+                }
+                // Buffers are stored as offsets until the batch is sent; the buffer may still grow.
+                pending.push_back({ &window, requests.size(), dense ? first : 0 });
+                if (dense)
+                {
+                    requests.push_back({ first, reinterpret_cast<void*>(used), spanSize, 0 });
+                    used += spanSize;
+                }
+                else
+                {
+                    old.ForEachSlot(window, [&](size_t slot)
+                    {
+                        requests.push_back({ window.base + slot * m_alignment, reinterpret_cast<void*>(used), sizeof(T), 0 });
+                        used += sizeof(T);
+                        return true;
+                    });
+                }
+            }
+            flush();
+
+            results.Finish();
+            m_results = static_cast<ValueScanResults<T>&&>(results);
+            return m_results.Count();
+        }
+
+        /**
+         * @return The current candidates.
+         */
+        const ValueScanResults<T>& Results() const
+        {
+            return m_results;
+        }
+
+        /**
+         * @return Number of current candidates.
+         */
+        size_t Count() const
+        {
+            return m_results.Count();
+        }
+
+        /** Drops every candidate. */
+        void Reset()
+        {
+            m_results.Clear();
+        }
+
+        /**
+         * Selects the instruction set of the first-scan kernels. Levels the CPU does not support are
+         * lowered to the best supported one.
+         */
+        void SetScanLevel(ScanLevel level)
+        {
+            m_level = (std::min)(level, DetectScanLevel());
+        }
+
+    private:
+        static void SelectBounds(ValueCompare compare, T value, T upper, T& lo, T& hi, bool first)
+        {
+            lo = value;
+            hi = compare == ValueCompare::Range ? upper : value;
+            if (compare == ValueCompare::Range && upper < value)
+            {
+                throw std::invalid_argument("ValueScan range upper bound is below the lower bound.");
+            }
+            if (first && compare != ValueCompare::Unknown && compare != ValueCompare::Exact && compare != ValueCompare::Range)
+            {
+                throw std::invalid_argument("ValueScan comparison needs a previous scan.");
+            }
+        }
+
+        static bool Passes(ValueCompare compare, const T& current, const T& previous, T lo, T hi)
+        {
+            switch (compare)
+            {
+            case ValueCompare::Exact:
+            case ValueCompare::Range:
+                return Detail::InValueRange(current, lo, hi);
+            case ValueCompare::Changed:
+                return memcmp(&current, &previous, sizeof(T)) != 0;
+            case ValueCompare::Unchanged:
+                return memcmp(&current, &previous, sizeof(T)) == 0;
+            case ValueCompare::Increased:
+                return current > previous;
+            case ValueCompare::Decreased:
+                return current < previous;
+            default:
+                return true;
+            }
+        }
+
+        /** Offset of the first aligned slot of a block. */
+        size_t FirstSlot(uintptr_t address) const
+        {
+            return static_cast<size_t>(((address + m_alignment - 1) & ~static_cast<uintptr_t>(m_alignment - 1)) - address);
+        }
+
+        void AddAll(ValueScanResults<T>& results, uintptr_t address, const uint8_t* data, size_t size) const
+        {
+            for (size_t offset = FirstSlot(address); offset + sizeof(T) <= size; offset += m_alignment)
+            {
+                results.Add(address + offset, Detail::LoadValue<T>(data + offset));
+            }
+        }
+
+        void AddMatches(ValueScanResults<T>& results, uintptr_t address, const uint8_t* data, size_t size, T lo, T hi) const
+        {
+            // The kernels test every sizeof(T)-th byte of 64-byte chunks. An alignment below
+            // sizeof(T) takes one pass per phase, an alignment above it drops the elements in
+            // between; the chunk's hits are merged into a byte mask to keep address order.
+            constexpr size_t PER_CHUNK = 64 / sizeof(T);
+            constexpr size_t BATCH = 64;
+            const size_t phases = m_alignment < sizeof(T) ? sizeof(T) / m_alignment : 1;
+            uint64_t selector = 0;
+            for (size_t i = 0; i < PER_CHUNK; i++)
+            {
+                selector |= (i * sizeof(T)) % m_alignment == 0 ? uint64_t(1) << i : 0;
+            }
+
+            size_t offset = FirstSlot(address);
+            const size_t reach = 64 + (phases - 1) * m_alignment;
+            uint64_t masks[8][BATCH];
+            while (offset + reach <= size)
+            {
+                const size_t chunks = (std::min)(BATCH, (size - offset - reach) / 64 + 1);
+                for (size_t phase = 0; phase < phases; phase++)
+                {
+                    Detail::MatchValues<T>(data + offset + phase * m_alignment, chunks, lo, hi, masks[phase], m_level);
+                }
+                for (size_t c = 0; c < chunks; c++)
+                {
+                    const size_t chunk = offset + c * 64;
+                    if (phases == 1)
+                    {
+                        for (uint64_t bits = masks[0][c] & selector; bits; bits &= bits - 1)
+                        {
+                            const size_t at = chunk + Detail::CountTrailingZeros(bits) * sizeof(T);
+                            results.Add(address + at, Detail::LoadValue<T>(data + at));
+                        }
+                        continue;
+                    }
+                    uint64_t hits = 0;
+                    for (size_t phase = 0; phase < phases; phase++)
+                    {
+                        for (uint64_t bits = masks[phase][c]; bits; bits &= bits - 1)
+                        {
+                            const size_t at = phase * m_alignment + Detail::CountTrailingZeros(bits) * sizeof(T);
+                            hits |= at < 64 ? uint64_t(1) << at : 0;
+                        }
+                    }
+                    for (; hits; hits &= hits - 1)
+                    {
+                        const size_t at = chunk + Detail::CountTrailingZeros(hits);
+                        results.Add(address + at, Detail::LoadValue<T>(data + at));
+                    }
+                }
+                offset += chunks * 64;
+            }
+            for (; offset + sizeof(T) <= size; offset += m_alignment)
+            {
+                const T current = Detail::LoadValue<T>(data + offset);
+                if (Detail::InValueRange(current, lo, hi))
+                {
+                    results.Add(address + offset, current);
+                }
+            }
+        }
+
+        const MemoryAccessor& m_memory;
+        size_t m_alignment;
+        ValueScanResults<T> m_results;
+        ScanLevel m_level;
+    };
+}
@@ -0,0 +1,664 @@
+// SyxLib microbenchmarks
+// Measures scan throughput, first-hit latency, pointer-chain walks, freeze servicing, fuzzy matching, signature
+// generation and detour overhead, and prints
+// the results as a table, CSV or JSON so runs from different releases can be compared.
+//
+// Usage: syx_bench [--format=table|csv|json] [--filter=text] [--size=MB] [--module=name] [--quick]
+
+#include "../Syx/Syx.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+namespace
+{
+    struct Options
+    {
+        std::string format = "table";
+        std::string filter;
+        size_t sizeMB = 64;
+#ifdef _WIN32
+        std::string module = "ntdll.dll";
+#else
+        std::string module = "libc.so.6";
+#endif
+        double minTime = 0.2;
+    };
+
+    struct Result
+    {
+        std::string suite;
+        std::string name;
+        /** key=value pairs describing the configuration. */
+        std::vector<std::pair<std::string, std::string>> params;
+        double value;
+        std::string unit;
+    };
+
+    Options g_options;
+    std::vector<Result> g_results;
+    volatile uint64_t g_sink;
+
+    const char* LevelName(SyxLib::ScanLevel level)
+    {
+        switch (level)
+        {
+        case SyxLib::ScanLevel::Scalar:
+            return "scalar";
+        case SyxLib::ScanLevel::SSE2:
+            return "sse2";
+        case SyxLib::ScanLevel::AVX2:
+            return "avx2";
+        case SyxLib::ScanLevel::AVX512:
+            return "avx512";
+        }
+        return "unknown";
+    }
+
+    bool Selected(const std::string& suite, const std::string& name)
+    {
+        return g_options.filter.empty() || (suite + "/" + name).find(g_options.filter) != std::string::npos;
+    }
+
+    void Report(const std::string& suite, const std::string& name, std::vector<std::pair<std::string, std::string>> params,
+        double value, const std::string& unit)
+    {
+        g_results.push_back({ suite, name, std::move(params), value, unit });
+        if (g_options.format == "table")
+        {
+            std::string config;
+            for (const auto& param : g_results.back().params)
+            {
+                config += (config.empty() ? "" : " ") + param.first + "=" + param.second;
+            }
+            printf("%-8s %-22s %-66s %12.3f %s\n", suite.c_str(), name.c_str(), config.c_str(), value, unit.c_str());
+            fflush(stdout);
+        }
+    }
+
+    /**
+     * Seconds per call of fn: the calls are batched until a batch takes a fifth of the minimum
+     * time, and the best of five batches is kept.
+     */
+    template <typename F>
+    double Measure(F&& fn)
+    {
+        using Clock = std::chrono::steady_clock;
+        size_t iterations = 1;
+        double batch = 0;
+        for (;;)
+        {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++)
+            {
+                fn();
+            }
+            batch = std::chrono::duration<double>(Clock::now() - start).count();
+            if (batch >= g_options.minTime / 5 || iterations >= (size_t(1) << 30))
+            {
+                break;
+            }
+            iterations = batch > 0 ? (std::max)(iterations * 2, static_cast<size_t>(iterations * (g_options.minTime / 5) / batch * 1.2)) : iterations * 16;
+        }
+        double best = batch / iterations;
+        for (int round = 0; round < 4; round++)
+        {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++)
+            {
+                fn();
+            }
+            best = (std::min)(best, std::chrono::duration<double>(Clock::now() - start).count() / iterations);
+        }
+        return best;
+    }
+
+    // ============================================
+    // Buffers and patterns
+    // ============================================
+
+    std::vector<uint8_t> SyntheticBuffer(size_t size)
+    {
+        std::vector<uint8_t> buffer(size);
+        std::mt19937_64 rng(1234);
+        for (size_t i = 0; i + 8 <= size; i += 8)
+        {
+            const uint64_t value = rng();
+            memcpy(&buffer[i], &value, 8);
+        }
+        return buffer;
+    }
+
+    /** The code sections of a loaded module, tiled up to size so every buffer streams from memory. */
+    std::vector<uint8_t> ModuleBuffer(const std::string& module, size_t size)
+    {
+        const SyxLib::ModuleInfo info = SyxLib::FindModule(module.c_str());
+        std::vector<uint8_t> code;
+        if (!info.lpBaseOfDll)
+        {
+            return code;
+        }
+        const auto regions = SyxLib::FilterRegions(SyxLib::QueryModuleRegions(reinterpret_cast<uintptr_t>(info.lpBaseOfDll)),
+            SyxLib::RegionFilter::Code());
+        for (const SyxLib::MemoryRegion& region : regions)
+        {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(region.base);
+            code.insert(code.end(), bytes, bytes + region.size);
+        }
+        if (code.empty())
+        {
+            return code;
+        }
+        std::vector<uint8_t> buffer(size);
+        for (size_t at = 0; at < size; at += code.size())
+        {
+            memcpy(&buffer[at], code.data(), (std::min)(code.size(), size - at));
+        }
+        return buffer;
+    }
+
+    struct TestPattern
+    {
+        std::vector<uint8_t> bytes;
+        std::string mask;
+    };
+
+    /**
+     * A pattern drawn from the 16 rarest or most common byte values of a buffer, with a share of
+     * wildcards. The first and last bytes stay significant, as in real signatures.
+     */
+    TestPattern MakePattern(const std::vector<uint8_t>& buffer, size_t length, int wildcardPercent, bool rare, unsigned seed)
+    {
+        std::vector<size_t> histogram(256, 0);
+        for (size_t i = 0; i < buffer.size(); i += 61)
+        {
+            histogram[buffer[i]]++;
+        }
+        std::vector<int> order(256);
+        for (int i = 0; i < 256; i++)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return histogram[a] < histogram[b]; });
+        if (!rare)
+        {
+            std::reverse(order.begin(), order.end());
+        }
+
+        std::mt19937 rng(seed);
+        TestPattern pattern;
+        pattern.mask.assign(length, 'x');
+        for (size_t i = 0; i < length; i++)
+        {
+            pattern.bytes.push_back(static_cast<uint8_t>(order[rng() % 16]));
+        }
+        const size_t wildcards = (std::min)(length * wildcardPercent / 100, length - 2);
+        std::vector<size_t> inner;
+        for (size_t i = 1; i + 1 < length; i++)
+        {
+            inner.push_back(i);
+        }
+        std::shuffle(inner.begin(), inner.end(), rng);
+        for (size_t i = 0; i < wildcards; i++)
+        {
+            pattern.mask[inner[i]] = '?';
+            pattern.bytes[inner[i]] = 0;
+        }
+        return pattern;
+    }
+
+    size_t CountAt(const SyxLib::Scanner& scanner, const std::vector<uint8_t>& buffer, SyxLib::ScanLevel level)
+    {
+        size_t count = 0;
+        for (size_t from = 0, found; (found = scanner.Find(buffer.data(), buffer.size(), from, level)) != SyxLib::NOT_FOUND; from = found + 1)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    // ============================================
+    // Suites
+    // ============================================
+
+    void ScanThroughput(const std::string& bufferName, const std::vector<uint8_t>& buffer)
+    {
+        const SyxLib::ScanLevel level = SyxLib::DetectScanLevel();
+        const double gigabytes = buffer.size() / 1e9;
+        for (size_t length : { 4, 8, 16, 32 })
+        {
+            for (int wildcards : { 0, 25, 50 })
+            {
+                for (bool rare : { true, false })
+                {
+                    const std::string name = "find_all";
+                    if (!Selected("scan", name))
+                    {
+                        continue;
+                    }
+                    const TestPattern pattern = MakePattern(buffer, length, wildcards, rare, static_cast<unsigned>(length * 100 + wildcards));
+                    const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str(), length);
+                    size_t matches = 0;
+                    const double seconds = Measure([&] { matches = CountAt(scanner, buffer, level); g_sink = matches; });
+                    Report("scan", name, { { "buffer", bufferName }, { "length", std::to_string(length) },
+                        { "wildcards", std::to_string(wildcards) + "%" }, { "anchors", rare ? "rare" : "common" },
+                        { "level", LevelName(level) }, { "matches", std::to_string(matches) } }, gigabytes / seconds, "GB/s");
+                }
+            }
+        }
+    }
+
+    void ScanLevels(const std::vector<uint8_t>& buffer)
+    {
+        const TestPattern pattern = MakePattern(buffer, 16, 25, true, 7);
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str(), 16);
+        const double gigabytes = buffer.size() / 1e9;
+        for (int value = 0; value <= static_cast<int>(SyxLib::DetectScanLevel()); value++)
+        {
+            const SyxLib::ScanLevel level = static_cast<SyxLib::ScanLevel>(value);
+            if (!Selected("scan", std::string("level_") + LevelName(level)))
+            {
+                continue;
+            }
+            const double seconds = Measure([&] { g_sink = CountAt(scanner, buffer, level); });
+            Report("scan", std::string("level_") + LevelName(level), { { "buffer", "synthetic" }, { "length", "16" },
+                { "wildcards", "25%" }, { "anchors", "rare" } }, gigabytes / seconds, "GB/s");
+        }
+
+        // The byte-by-byte loop FindPattern used before the vectorized engine, as a fixed reference.
+        if (Selected("scan", "datacompare_loop"))
+        {
+            const uint8_t* data = buffer.data();
+            const size_t count = buffer.size() - 16;
+            const double seconds = Measure([&]
+            {
+                size_t found = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    found += Syx::DataCompare(data + i, pattern.bytes.data(), pattern.mask.c_str());
+                }
+                g_sink = found;
+            });
+            Report("scan", "datacompare_loop", { { "buffer", "synthetic" }, { "length", "16" }, { "wildcards", "25%" },
+                { "anchors", "rare" } }, gigabytes / seconds, "GB/s");
+        }
+    }
+
+    void FirstHitLatency(std::vector<uint8_t> buffer)
+    {
+        const TestPattern pattern = MakePattern(buffer, 16, 0, true, 99);
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str(), 16);
+        const size_t offsets[] = { 0, 4096, 1 << 20, buffer.size() / 2, SIZE_MAX };
+        for (size_t offset : offsets)
+        {
+            const bool miss = offset == SIZE_MAX;
+            const std::string name = miss ? "no_match" : "first_hit";
+            if (!Selected("latency", name))
+            {
+                continue;
+            }
+            std::vector<uint8_t> saved;
+            if (!miss)
+            {
+                saved.assign(buffer.begin() + offset, buffer.begin() + offset + 16);
+                memcpy(&buffer[offset], pattern.bytes.data(), 16);
+            }
+            size_t found = 0;
+            const double seconds = Measure([&] { found = scanner.Find(buffer.data(), buffer.size()); g_sink = found; });
+            if (!miss)
+            {
+                memcpy(&buffer[offset], saved.data(), 16);
+            }
+            Report("latency", name, { { "offset", miss ? "none" : std::to_string(offset) },
+                { "found", found == SyxLib::NOT_FOUND ? "none" : std::to_string(found) } }, seconds * 1e6, "us");
+        }
+    }
+
+    void SnapshotRevalidation(const std::vector<uint8_t>& buffer)
+    {
+        const std::string path = "syx_bench.snap";
+        SyxLib::ModuleSnapshot snapshot;
+        const double gigabytes = buffer.size() / 1e9;
+        if (Selected("snapshot", "capture"))
+        {
+            const double seconds = Measure([&] { g_sink = snapshot.Capture(path, buffer.data(), buffer.size(), false); });
+            Report("snapshot", "capture", { { "buffer", "synthetic" } }, gigabytes / seconds, "GB/s");
+        }
+        if (!snapshot.Capture(path, buffer.data(), buffer.size(), false))
+        {
+            fprintf(stderr, "snapshot: cannot write %s, skipped\n", path.c_str());
+            return;
+        }
+
+        // One changed page in the middle, as after a small patch.
+        std::vector<uint8_t> updated = buffer;
+        updated[updated.size() / 2] ^= 0xFF;
+        SyxLib::SnapshotDiff diff;
+        if (Selected("snapshot", "diff"))
+        {
+            const double seconds = Measure([&] { SyxLib::DiffSnapshot(snapshot, updated.data(), updated.size(), diff); });
+            Report("snapshot", "diff", { { "buffer", "synthetic" }, { "changed_pages", "1" } }, gigabytes / seconds, "GB/s");
+        }
+        SyxLib::DiffSnapshot(snapshot, updated.data(), updated.size(), diff);
+
+        const TestPattern pattern = MakePattern(buffer, 16, 25, true, 11);
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str(), 16);
+        const size_t previous = scanner.Find(buffer.data(), buffer.size());
+        if (Selected("snapshot", "revalidate"))
+        {
+            Report("snapshot", "revalidate", { { "changed_pages", "1" } },
+                Measure([&] { g_sink = SyxLib::RevalidateMatch(scanner, updated.data(), updated.size(), previous, diff); }) * 1e6, "us");
+            Report("snapshot", "full_rescan", { { "changed_pages", "1" } },
+                Measure([&] { g_sink = scanner.Find(updated.data(), updated.size()); }) * 1e6, "us");
+        }
+        snapshot = SyxLib::ModuleSnapshot();
+        remove(path.c_str());
+    }
+
+    void PointerWalks()
+    {
+        for (size_t depth : { 1, 2, 4, 8 })
+        {
+            // base -> node0; node[i] + 0x10 -> node[i + 1]; the value lives at node[depth - 1] + 0x10.
+            std::vector<std::vector<uintptr_t>> nodes(depth, std::vector<uintptr_t>(8, 0));
+            for (size_t i = 0; i + 1 < depth; i++)
+            {
+                nodes[i][2] = reinterpret_cast<uintptr_t>(nodes[i + 1].data());
+            }
+            uintptr_t root = reinterpret_cast<uintptr_t>(nodes[0].data());
+            const uintptr_t base = reinterpret_cast<uintptr_t>(&root);
+            const std::vector<uintptr_t> offsets(depth, 0x10);
+            const std::vector<std::pair<std::string, std::string>> params = { { "depth", std::to_string(depth) } };
+
+            int value = 0;
+            if (Selected("pointer", "write_ptr"))
+            {
+                Report("pointer", "write_ptr", params, Measure([&] { Syx::WritePTR<int>(base, offsets, ++value); }) * 1e9, "ns");
+            }
+            if (Selected("pointer", "read_ptr"))
+            {
+                Report("pointer", "read_ptr", params, Measure([&] { Syx::ReadPTR(base, offsets, value); g_sink = value; }) * 1e9, "ns");
+            }
+            if (Selected("pointer", "safe_read_ptr"))
+            {
+                Report("pointer", "safe_read_ptr", params, Measure([&] { g_sink = Syx::SafeReadPTR<int>(base, offsets).ValueOr(0); }) * 1e9, "ns");
+            }
+            if (Selected("pointer", "chain_read_cached"))
+            {
+                SyxLib::PointerChain chain(base, offsets);
+                Report("pointer", "chain_read_cached", params, Measure([&] { chain.Read(value, 1); g_sink = value; }) * 1e9, "ns");
+            }
+        }
+    }
+
+    void WatchService()
+    {
+        if (!Selected("watch", "freeze"))
+        {
+            return;
+        }
+        // 10000 frozen values behind a two-level chain each, serviced on every Tick(): a 1 us tick is
+        // shorter than one service, so every entry is due at every call.
+        const size_t count = 10000;
+        std::vector<uintptr_t> nodes(count * 4, 0);
+        std::vector<uintptr_t> roots(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            roots[i] = reinterpret_cast<uintptr_t>(&nodes[i * 4]);
+            nodes[i * 4 + 1] = reinterpret_cast<uintptr_t>(&nodes[i * 4 + 2]);
+        }
+        SyxLib::WatchOptions options;
+        options.resolution = std::chrono::microseconds(1);
+        for (bool chained : { false, true })
+        {
+            SyxLib::MemoryWatch watch(SyxLib::LocalMemory::Instance(), options);
+            for (size_t i = 0; i < count; i++)
+            {
+                if (chained)
+                {
+                    watch.Freeze(SyxLib::PointerChain(reinterpret_cast<uintptr_t>(&roots[i]), { sizeof(uintptr_t), 0 }), 100, std::chrono::microseconds(1));
+                }
+                else
+                {
+                    watch.Freeze(reinterpret_cast<uintptr_t>(&nodes[i * 4 + 3]), 100, std::chrono::microseconds(1));
+                }
+            }
+            const double perValue = Measure([&] { watch.Tick(); }) / count;
+            const std::vector<std::pair<std::string, std::string>> params = { { "target", chained ? "chain_depth_2" : "address" }, { "values", std::to_string(count) } };
+            Report("watch", "freeze", params, perValue * 1e9, "ns/value");
+            // Share of one core spent keeping the values frozen at a 10 ms period.
+            Report("watch", "freeze_core_10ms", params, perValue * count / 0.01 * 100, "%");
+        }
+
+        int value = 0;
+        const std::vector<uintptr_t> offsets = { sizeof(uintptr_t), 0 };
+        const double loop = Measure([&] { Syx::WritePTR<int>(reinterpret_cast<uintptr_t>(&roots[value++ % count]), offsets, 100); });
+        Report("watch", "freeze", { { "target", "write_ptr_loop" }, { "values", "1" } }, loop * 1e9, "ns/value");
+    }
+
+    using BenchFunction = int (*)(int);
+    BenchFunction g_original;
+
+    BENCH_NOINLINE int BenchTarget(int x)
+    {
+        // Large enough for the 5-byte jump to cover whole instructions.
+        volatile int value = x;
+        return value * 3 + 1;
+    }
+
+    BENCH_NOINLINE int BenchDetour(int x)
+    {
+        return g_original(x);
+    }
+
+    void FuzzySignatures(const std::vector<uint8_t>& buffer)
+    {
+        // No location is within the bound, so every candidate of the buffer is counted.
+        const TestPattern pattern = MakePattern(buffer, 24, 25, true, 31);
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str(), 24);
+        const double gigabytes = buffer.size() / 1e9;
+        for (int value = 0; value <= static_cast<int>(SyxLib::DetectScanLevel()); value++)
+        {
+            const SyxLib::ScanLevel level = static_cast<SyxLib::ScanLevel>(value);
+            if (!Selected("fuzzy", std::string("best_match_") + LevelName(level)))
+            {
+                continue;
+            }
+            const double seconds = Measure([&] { g_sink = SyxLib::FindBestMatch(scanner, buffer.data(), buffer.size(), 3, level).offset; });
+            Report("fuzzy", std::string("best_match_") + LevelName(level), { { "buffer", "synthetic" }, { "length", "24" },
+                { "wildcards", "25%" }, { "mismatches", "3" } }, gigabytes / seconds, "GB/s");
+        }
+
+        // Signatures for addresses spread over the code of the module, unique in all of it.
+        const SyxLib::ModuleInfo info = SyxLib::FindModule(g_options.module.c_str());
+        if (!info.lpBaseOfDll || !Selected("fuzzy", "generate"))
+        {
+            return;
+        }
+        std::vector<SyxLib::ByteSpan> spans;
+        for (const SyxLib::MemoryRegion& region : SyxLib::FilterRegions(SyxLib::QueryModuleRegions(reinterpret_cast<uintptr_t>(info.lpBaseOfDll)),
+            SyxLib::RegionFilter::Code()))
+        {
+            spans.push_back({ reinterpret_cast<const uint8_t*>(region.base), region.size });
+        }
+        if (spans.empty())
+        {
+            return;
+        }
+        std::vector<const uint8_t*> targets;
+        for (size_t i = 1; i <= 32; i++)
+        {
+            targets.push_back(spans.front().data + spans.front().size * i / 34);
+        }
+        size_t length = 0, unique = 0;
+        const double seconds = Measure([&]
+        {
+            length = unique = 0;
+            for (const uint8_t* target : targets)
+            {
+                const std::string signature = SyxLib::GenerateSignature(spans, target);
+                length += (signature.size() + 1) / 3;
+                unique += !signature.empty();
+            }
+        });
+        Report("fuzzy", "generate", { { "module", g_options.module }, { "targets", std::to_string(targets.size()) },
+            { "unique", std::to_string(unique) }, { "avg_length", std::to_string(unique ? length / unique : 0) } },
+            seconds / targets.size() * 1e3, "ms/sig");
+    }
+
+    void DetourOverhead()
+    {
+        if (!Selected("hook", "call"))
+        {
+            return;
+        }
+        BenchFunction volatile call = BenchTarget;
+        const double direct = Measure([&] { g_sink = call(static_cast<int>(g_sink)); });
+
+        SyxLib::HookManager hooks;
+        const void* original = nullptr;
+        const SyxLib::HookStatus status = hooks.Create(reinterpret_cast<void*>(&BenchTarget), reinterpret_cast<const void*>(&BenchDetour), &original);
+        if (status != SyxLib::HookStatus::Ok || hooks.Enable(reinterpret_cast<void*>(&BenchTarget)) != SyxLib::HookStatus::Ok)
+        {
+            fprintf(stderr, "hook: skipped (%s)\n", SyxLib::ToString(status));
+            return;
+        }
+        g_original = reinterpret_cast<BenchFunction>(const_cast<void*>(original));
+        const double hooked = Measure([&] { g_sink = call(static_cast<int>(g_sink)); });
+        const bool instrumented = hooks.Instrument(reinterpret_cast<void*>(&BenchTarget)) == SyxLib::HookStatus::Ok;
+        const double counted = instrumented ? Measure([&] { g_sink = call(static_cast<int>(g_sink)); }) : 0;
+        hooks.Remove(reinterpret_cast<void*>(&BenchTarget));
+
+        Report("hook", "call", { { "path", "direct" } }, direct * 1e9, "ns");
+        Report("hook", "call", { { "path", "detour+trampoline" } }, hooked * 1e9, "ns");
+        Report("hook", "call", { { "path", "overhead" } }, (hooked - direct) * 1e9, "ns");
+        if (instrumented)
+        {
+            Report("hook", "call", { { "path", "instrumented" } }, counted * 1e9, "ns");
+        }
+    }
+
+    // ============================================
+    // Output
+    // ============================================
+
+    std::string JsonString(const std::string& text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    void PrintResults()
+    {
+        if (g_options.format == "csv")
+        {
+            printf("suite,name,config,value,unit\n");
+            for (const Result& result : g_results)
+            {
+                std::string config;
+                for (const auto& param : result.params)
+                {
+                    config += (config.empty() ? "" : ";") + param.first + "=" + param.second;
+                }
+                printf("%s,%s,%s,%.6g,%s\n", result.suite.c_str(), result.name.c_str(), config.c_str(), result.value, result.unit.c_str());
+            }
+        }
+        else if (g_options.format == "json")
+        {
+            printf("{\n  \"library\": \"SyxLib\",\n  \"version\": \"1.3\",\n  \"scan_level\": \"%s\",\n  \"buffer_mb\": %zu,\n  \"results\": [\n",
+                LevelName(SyxLib::DetectScanLevel()), g_options.sizeMB);
+            for (size_t i = 0; i < g_results.size(); i++)
+            {
+                const Result& result = g_results[i];
+                printf("    { \"suite\": %s, \"name\": %s", JsonString(result.suite).c_str(), JsonString(result.name).c_str());
+                for (const auto& param : result.params)
+                {
+                    printf(", %s: %s", JsonString(param.first).c_str(), JsonString(param.second).c_str());
+                }
+                printf(", \"value\": %.6g, \"unit\": %s }%s\n", result.value, JsonString(result.unit).c_str(), i + 1 < g_results.size() ? "," : "");
+            }
+            printf("  ]\n}\n");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        auto value = [&](const char* prefix) { return arg.compare(0, strlen(prefix), prefix) == 0 ? arg.substr(strlen(prefix)) : std::string(); };
+        if (!value("--format=").empty())
+        {
+            g_options.format = value("--format=");
+        }
+        else if (!value("--filter=").empty())
+        {
+            g_options.filter = value("--filter=");
+        }
+        else if (!value("--size=").empty())
+        {
+            g_options.sizeMB = (std::max)(static_cast<size_t>(strtoul(value("--size=").c_str(), nullptr, 10)), static_cast<size_t>(2));
+        }
+        else if (!value("--module=").empty())
+        {
+            g_options.module = value("--module=");
+        }
+        else if (arg == "--quick")
+        {
+            g_options.minTime = 0.03;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--format=table|csv|json] [--filter=text] [--size=MB] [--module=name] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (g_options.format != "table" && g_options.format != "csv" && g_options.format != "json")
+    {
+        fprintf(stderr, "unknown format: %s\n", g_options.format.c_str());
+        return 1;
+    }
+
+    const size_t size = g_options.sizeMB << 20;
+    const std::vector<uint8_t> synthetic = SyntheticBuffer(size);
+    ScanThroughput("synthetic", synthetic);
+    const std::vector<uint8_t> module = ModuleBuffer(g_options.module, size);
+    if (module.empty())
+    {
+        fprintf(stderr, "module %s: not loaded, real-binary scans skipped\n", g_options.module.c_str());
+    }
+    else
+    {
+        ScanThroughput(g_options.module, module);
+    }
+    ScanLevels(synthetic);
+    FirstHitLatency(synthetic);
+    SnapshotRevalidation(synthetic);
+    PointerWalks();
+    WatchService();
+    FuzzySignatures(synthetic);
+    DetourOverhead();
+
+    PrintResults();
+    return 0;
+}
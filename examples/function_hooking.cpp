@@ -52,13 +52,11 @@ void InstallHook64()
         std::cout << "Target function at: 0x" << std::hex << targetAddress << std::endl;
         
         // Install the hook
-        // The length (14 in this case) depends on the instruction length
-        // You need to disassemble to ensure you're not breaking instructions
+        // The overwritten instructions are measured and relocated automatically
         originalFunction = reinterpret_cast<TargetFunction>(
             Syx::DetourFunc64(
                 reinterpret_cast<BYTE*>(targetAddress),
-                reinterpret_cast<BYTE*>(HookedFunction),
-                14  // Length of instructions to overwrite
+                reinterpret_cast<BYTE*>(HookedFunction)
             )
         );
         
@@ -133,17 +131,19 @@ int main()
     std::cout << "=== SyxLib Function Hooking Example ===" << std::endl;
     
     // Detect architecture
-    #ifdef _WIN64
+    #if defined(_WIN64)
         std::cout << "Running in 64-bit mode" << std::endl;
         InstallHook64();
-    #else
+    #elif defined(_WIN32)
         std::cout << "Running in 32-bit mode" << std::endl;
         InstallHook32();
+    #else
+        std::cout << "The example targets are Windows addresses; see SyxLib::HookManager for hooks on Linux" << std::endl;
     #endif
     
     std::cout << "\n=== Important Notes ===" << std::endl;
-    std::cout << "1. Always verify instruction boundaries before hooking" << std::endl;
-    std::cout << "2. Use a disassembler to determine the correct length" << std::endl;
+    std::cout << "1. Check for nullptr: prologues that cannot be relocated are refused" << std::endl;
+    std::cout << "2. Functions shorter than the 5-byte jump cannot be hooked" << std::endl;
     std::cout << "3. Save the original function pointer to call it later" << std::endl;
     std::cout << "4. Test thoroughly - incorrect hooks can crash the process" << std::endl;
     std::cout << "5. Be aware of anti-cheat systems in games" << std::endl;
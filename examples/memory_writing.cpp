@@ -2,89 +2,127 @@
 // This example demonstrates how to write values through pointer chains
 
 #include "../Syx/Syx.h"
+#include <cstddef>
 #include <iostream>
 #include <vector>
 
+// Real-world scenario: Game data is often stored like this:
+// StaticPointer -> [Offset1] -> [Offset2] -> [Offset3] -> ActualValue
+// The structures below build such a chain inside this process, so the example can run anywhere.
+struct Stats
+{
+    int level;
+    int health;
+    float speed;
+    double score;
+};
+
+struct Player
+{
+    char name[32];
+    Stats* stats;
+};
+
+struct World
+{
+    uint32_t tick;
+    uint32_t flags;
+    Player* player;
+};
+
+static Stats g_stats = { 1, 100, 1.0f, 0.0 };
+static Player g_player = { "player", &g_stats };
+static World g_world = { 0, 0, &g_player };
+// The static pointer a chain starts from, usually found in the module's data section.
+static World* g_worldPointer = &g_world;
+
 int main()
 {
     std::cout << "=== SyxLib Memory Writing Example ===" << std::endl;
-    
-    // Example: Writing to a nested pointer structure
-    // Real-world scenario: Game data is often stored like this:
-    // BaseAddress -> [Offset1] -> [Offset2] -> [Offset3] -> ActualValue
-    
+
     // Get the module base address (use your target module name)
     const char* moduleName = nullptr;  // nullptr = current executable
-    uintptr_t baseAddress = Syx::GetModuleHandleEx(moduleName);
-    
-    if (!baseAddress) {
+    uintptr_t moduleBase = Syx::GetModuleHandleEx(moduleName);
+
+    if (!moduleBase) {
         std::cerr << "Failed to get module base address!" << std::endl;
         return 1;
     }
-    
-    std::cout << "Base address: 0x" << std::hex << baseAddress << std::endl;
-    
-    // Define the pointer chain offsets
-    // These would be determined through reverse engineering
-    std::vector<uintptr_t> offsets = { 0x10, 0x20, 0x30 };
-    
+
+    // In a real target the static pointer is moduleBase + a fixed offset found by reverse
+    // engineering (or Syx::FindPointerPaths); here it is simply our own global.
+    uintptr_t baseAddress = reinterpret_cast<uintptr_t>(&g_worldPointer);
+    std::cout << "Module base:    0x" << std::hex << moduleBase << std::endl;
+    std::cout << "Static pointer: 0x" << std::hex << baseAddress
+              << " (module + 0x" << (baseAddress - moduleBase) << ")" << std::endl;
+
+    // Define the pointer chain offsets: World::player -> Player::stats -> Stats::health
+    std::vector<uintptr_t> offsets = { offsetof(World, player), offsetof(Player, stats), offsetof(Stats, health) };
+
     std::cout << "\nPointer chain: " << std::endl;
     std::cout << "  Base: 0x" << std::hex << baseAddress << std::endl;
     for (size_t i = 0; i < offsets.size(); i++) {
-        std::cout << "  [+" << std::dec << i << "] Offset: 0x" 
+        std::cout << "  [+" << std::dec << i << "] Offset: 0x"
                   << std::hex << offsets[i] << std::endl;
     }
-    
+
     // Example 1: Writing an integer value
     std::cout << "\n[Example 1] Writing integer value" << std::endl;
     int valueToWrite = 12345;
-    
+
     try {
         Syx::WritePTR(baseAddress, offsets, valueToWrite);
-        std::cout << "Successfully wrote value: " << std::dec << valueToWrite << std::endl;
+        std::cout << "Successfully wrote value: " << std::dec << valueToWrite
+                  << " (health is now " << g_stats.health << ")" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error writing to memory: " << e.what() << std::endl;
     }
-    
+
     // Example 2: Writing a float value
     std::cout << "\n[Example 2] Writing float value" << std::endl;
     float floatValue = 99.99f;
-    
+    offsets.back() = offsetof(Stats, speed);
+
     try {
         Syx::WritePTR(baseAddress, offsets, floatValue);
-        std::cout << "Successfully wrote float value: " << floatValue << std::endl;
+        std::cout << "Successfully wrote float value: " << floatValue
+                  << " (speed is now " << g_stats.speed << ")" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error writing to memory: " << e.what() << std::endl;
     }
-    
+
     // Example 3: Writing a double value
     std::cout << "\n[Example 3] Writing double value" << std::endl;
     double doubleValue = 123.456;
-    
+    offsets.back() = offsetof(Stats, score);
+
     try {
         Syx::WritePTR(baseAddress, offsets, doubleValue);
-        std::cout << "Successfully wrote double value: " << doubleValue << std::endl;
+        std::cout << "Successfully wrote double value: " << doubleValue
+                  << " (score is now " << g_stats.score << ")" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error writing to memory: " << e.what() << std::endl;
     }
-    
+
     // Example 4: Handling errors gracefully
+    // WritePTR trusts the chain and faults on a wild pointer; SafeWritePTR checks every
+    // address against the region map first and reports why the write was refused.
     std::cout << "\n[Example 4] Error handling" << std::endl;
-    std::vector<uintptr_t> invalidOffsets = { 0xDEADBEEF };  // Invalid offset
-    
-    try {
-        Syx::WritePTR(baseAddress, invalidOffsets, 42);
+    std::vector<uintptr_t> invalidOffsets = { offsetof(World, player), 0xDEADBEEF, 0 };  // Invalid offset
+
+    SyxLib::Result<void> result = Syx::SafeWritePTR(baseAddress, invalidOffsets, 42);
+    if (result) {
         std::cout << "Value written (this shouldn't print)" << std::endl;
-    } catch (const std::exception& e) {
-        std::cout << "Caught expected error: " << e.what() << std::endl;
+    } else {
+        std::cout << "Caught expected error: " << SyxLib::ToString(result.Error()) << std::endl;
         std::cout << "Error handling works correctly!" << std::endl;
     }
-    
+
     std::cout << "\n=== Example Complete ===" << std::endl;
     std::cout << "\nNote: In a real application, you would:" << std::endl;
     std::cout << "  1. Use valid offsets from reverse engineering" << std::endl;
-    std::cout << "  2. Validate addresses before writing" << std::endl;
+    std::cout << "  2. Validate addresses before writing (SafeWritePTR)" << std::endl;
     std::cout << "  3. Handle errors appropriately" << std::endl;
-    
+
     return 0;
 }
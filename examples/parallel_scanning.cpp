@@ -0,0 +1,74 @@
+// Example 4: Parallel Pattern Scanning
+// This example measures how ParallelFind scales with the number of threads on a synthetic buffer
+
+#include "../Syx/ParallelScan.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    std::cout << "=== SyxLib Parallel Scanning Example ===" << std::endl;
+
+    // Build a 256 MB buffer of random bytes and plant the pattern near the end,
+    // so every configuration has to walk almost the whole buffer.
+    const size_t bufferSize = 256u << 20;
+    std::vector<uint8_t> buffer(bufferSize);
+    std::mt19937_64 rng(1234);
+    for (size_t i = 0; i + 8 <= bufferSize; i += 8)
+    {
+        const uint64_t value = rng();
+        memcpy(&buffer[i], &value, 8);
+    }
+
+    const uint8_t pattern[] = { 0x48, 0x8B, 0x05, 0x00, 0x00, 0x00, 0x00, 0xE8, 0x12, 0x34 };
+    const char mask[] = "xxx????xxx";
+    const size_t planted = bufferSize - 4096;
+    memcpy(&buffer[planted], pattern, sizeof(pattern));
+
+    const SyxLib::Scanner scanner(pattern, mask);
+    // Optional first argument overrides the highest thread count to try.
+    const unsigned maxThreads = argc > 1 ? static_cast<unsigned>(std::max(1, atoi(argv[1])))
+        : std::max(1u, std::thread::hardware_concurrency());
+    SyxLib::ThreadPool pool(maxThreads - 1);
+
+    std::cout << "Buffer: " << (bufferSize >> 20) << " MB, max threads: " << maxThreads << std::endl;
+    std::cout << "threads  chunk KB  time ms  GB/s   result" << std::endl;
+
+    double baseline = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        SyxLib::ParallelScanOptions options;
+        options.threadCount = threads;
+        options.chunkSize = 256 * 1024;
+        options.pool = &pool;
+
+        // Best of three runs to hide page faults and frequency ramp-up.
+        double best = 1e30;
+        size_t result = SyxLib::NOT_FOUND;
+        for (int run = 0; run < 3; run++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            result = SyxLib::ParallelFind(scanner, buffer.data(), buffer.size(), options);
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        if (threads == 1)
+        {
+            baseline = best;
+        }
+
+        printf("%7u  %8zu  %7.2f  %5.2f  %s (x%.2f)\n", threads, options.chunkSize / 1024, best,
+            bufferSize / (best * 1e6), result == planted ? "ok" : "WRONG", baseline / best);
+    }
+
+    std::cout << "\n=== Example Complete ===" << std::endl;
+
+    return 0;
+}
@@ -2,6 +2,7 @@
 // This example demonstrates how to find a specific byte pattern in memory
 
 #include "../Syx/Syx.h"
+#include <algorithm>
 #include <iostream>
 
 int main()
@@ -12,7 +13,7 @@ int main()
     std::cout << "\n[Example 1] Manual Length Pattern Scanning" << std::endl;
     
     // Define the pattern we're looking for (three NOP instructions)
-    BYTE pattern[] = { 0x90, 0x90, 0x90 };
+    uint8_t pattern[] = { 0x90, 0x90, 0x90 };
     char mask[] = "xxx";  // 'x' means byte must match exactly
     
     // Get the base address of the current module
@@ -21,8 +22,9 @@ int main()
     if (moduleBase) {
         std::cout << "Module base address: 0x" << std::hex << moduleBase << std::endl;
         
-        // Search for the pattern in the first 0x100000 bytes
-        uintptr_t foundAddress = Syx::FindPattern(moduleBase, 0x100000, pattern, mask);
+        // Search for the pattern in the first 0x100000 bytes, or the whole module if it is smaller
+        const uintptr_t moduleSize = static_cast<uintptr_t>(Syx::GetModuleInfo(nullptr).SizeOfImage);
+        uintptr_t foundAddress = Syx::FindPattern(moduleBase, (std::min)(moduleSize, static_cast<uintptr_t>(0x100000)), pattern, mask);
         
         if (foundAddress) {
             std::cout << "Pattern found at: 0x" << std::hex << foundAddress << std::endl;
@@ -41,7 +43,7 @@ int main()
     char wildcardMask[] = "x????xx";  // '?' means ignore this byte
     
     const wchar_t* targetModule = nullptr;  // Current process
-    MODULEINFO modInfo = Syx::GetModuleInfo(targetModule);
+    SyxLib::ModuleInfo modInfo = Syx::GetModuleInfo(targetModule);  // MODULEINFO on Windows
     
     if (modInfo.lpBaseOfDll) {
         std::cout << "Module size: 0x" << std::hex << modInfo.SizeOfImage << " bytes" << std::endl;
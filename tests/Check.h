@@ -0,0 +1,178 @@
+// Shared helpers for the tests: failure counting, a deterministic random source and page
+// allocation, so each test compares an engine against a plain reference loop.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static int g_failures;
+
+#define CHECK(condition)                                                             \
+    do                                                                               \
+    {                                                                                \
+        if (!(condition))                                                            \
+        {                                                                            \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+            g_failures++;                                                            \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                   \
+    do                                                                               \
+    {                                                                                \
+        const auto checkActual = (actual);                                           \
+        const auto checkExpected = (expected);                                       \
+        if (!(checkActual == checkExpected))                                         \
+        {                                                                            \
+            printf("%s:%d: %s == %s failed: %llu vs %llu\n", __FILE__, __LINE__,     \
+                #actual, #expected, static_cast<unsigned long long>(checkActual),    \
+                static_cast<unsigned long long>(checkExpected));                     \
+            g_failures++;                                                            \
+        }                                                                            \
+    } while (0)
+
+/** Prints the summary line and returns the process exit code. */
+inline int Finish(const char* name)
+{
+    printf("%s: %s (%d failures)\n", name, g_failures ? "FAILED" : "passed", g_failures);
+    return g_failures ? 1 : 0;
+}
+
+/** xorshift64*: the same sequence on every platform and standard library. */
+class TestRandom
+{
+public:
+    explicit TestRandom(uint64_t seed = 0x9E3779B97F4A7C15ull)
+        : m_state(seed ? seed : 1)
+    {
+    }
+
+    uint64_t Next()
+    {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1Dull;
+    }
+
+    /** @return A value in [0, bound). */
+    size_t Below(size_t bound)
+    {
+        return static_cast<size_t>(Next() % bound);
+    }
+
+    void Fill(uint8_t* data, size_t size, unsigned alphabet = 256)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            data[i] = static_cast<uint8_t>(Below(alphabet));
+        }
+    }
+
+private:
+    uint64_t m_state;
+};
+
+/** A byte pattern with a code-style mask ('x' = the byte must match), the form every engine accepts. */
+struct TestPattern
+{
+    std::vector<uint8_t> bytes;
+    std::string mask;
+
+    /** @return The pattern as an IDA-style signature for SyxLib::Pattern. */
+    std::string Signature() const
+    {
+        static const char digits[] = "0123456789ABCDEF";
+        std::string text;
+        for (size_t i = 0; i < bytes.size(); i++)
+        {
+            text += i ? " " : "";
+            text += mask[i] == 'x' ? std::string{ digits[bytes[i] >> 4], digits[bytes[i] & 15] } : std::string("??");
+        }
+        return text;
+    }
+};
+
+/** @return Significant bytes of the pattern that differ from the data at a location. */
+inline size_t ReferenceMismatches(const uint8_t* data, const TestPattern& pattern)
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pattern.bytes.size(); i++)
+    {
+        mismatches += pattern.mask[i] == 'x' && data[i] != pattern.bytes[i];
+    }
+    return mismatches;
+}
+
+/** @return True if every significant byte of the pattern equals the data at a location. */
+inline bool ReferenceMatchesAt(const uint8_t* data, const TestPattern& pattern)
+{
+    for (size_t i = 0; i < pattern.bytes.size(); i++)
+    {
+        if (pattern.mask[i] == 'x' && data[i] != pattern.bytes[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** @return Every offset at or after from where the pattern matches completely inside the buffer. */
+inline std::vector<size_t> ReferenceFindAll(const uint8_t* data, size_t size, const TestPattern& pattern, size_t from = 0)
+{
+    std::vector<size_t> offsets;
+    for (size_t offset = from; offset + pattern.bytes.size() <= size; offset++)
+    {
+        if (ReferenceMatchesAt(data + offset, pattern))
+        {
+            offsets.push_back(offset);
+        }
+    }
+    return offsets;
+}
+
+/** @return The first offset at or after from where the pattern matches, or SIZE_MAX. */
+inline size_t ReferenceFind(const uint8_t* data, size_t size, const TestPattern& pattern, size_t from = 0)
+{
+    for (size_t offset = from; offset + pattern.bytes.size() <= size; offset++)
+    {
+        if (ReferenceMatchesAt(data + offset, pattern))
+        {
+            return offset;
+        }
+    }
+    return SIZE_MAX;
+}
+
+/** @return size bytes of fresh read/write pages, or nullptr. */
+inline uint8_t* AllocatePages(size_t size)
+{
+#ifdef _WIN32
+    return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+    void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return pages == MAP_FAILED ? nullptr : static_cast<uint8_t*>(pages);
+#endif
+}
+
+/** Returns part of an allocation to the OS, leaving a hole that faults on access. */
+inline void FreePages(uint8_t* pages, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(pages, size, MEM_DECOMMIT);
+#else
+    munmap(pages, size);
+#endif
+}
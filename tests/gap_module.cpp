@@ -0,0 +1,27 @@
+// Shared object for the module_scan test. It is linked with 2 MB segment alignment and separate
+// code, so its headers, code, read-only data and writable data are mapped 2 MB apart with
+// PROT_NONE gaps in between, all inside the range FindModule reports.
+
+extern "C"
+{
+    // Reached only through the accessors below: the test program must not get copies of them.
+    static const unsigned char g_rodataMarker[] = { 0x5A, 0x17, 0xC3, 0x9E, 0x42, 0xD0, 0x6B, 0x81,
+        0xEE, 0x3F, 0xE4, 0x77, 0x0C, 0x95, 0xB2, 0x68 };
+    static unsigned char g_dataMarker[] = { 0xA9, 0x61, 0x2D, 0xF0, 0x88, 0x13, 0x5E, 0xC7,
+        0x31, 0x9B, 0x04, 0xD6, 0x7A, 0xE2, 0x4C, 0xB5 };
+
+    __attribute__((visibility("default"))) const unsigned char* SyxGapRodata()
+    {
+        return g_rodataMarker;
+    }
+
+    __attribute__((visibility("default"))) unsigned char* SyxGapData()
+    {
+        return g_dataMarker;
+    }
+
+    __attribute__((visibility("default"))) int SyxGapCode(int x)
+    {
+        return x * 7 + g_dataMarker[x & 15];
+    }
+}
@@ -0,0 +1,205 @@
+// Hook stress test
+// Worker threads call hooked functions while the main thread creates, enables, disables and
+// removes the hooks in every PatchMode. Every call must return either the original or the
+// detoured result; a torn patch or a thread left inside half-written bytes crashes or shows up
+// as a wrong result.
+
+#include "../Syx/Hooks.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#define STRESS_NOINLINE __declspec(noinline)
+#else
+#define STRESS_NOINLINE __attribute__((noinline))
+#endif
+
+typedef int (*TargetFn)(int);
+
+static volatile int g_sideEffect;
+
+STRESS_NOINLINE int Helper(int x)
+{
+    g_sideEffect = x;
+    return x + 7;
+}
+
+// Called through a pointer so the compiler cannot tailor the callers' register use to it, which
+// keeps their prologues (push, sub rsp) in place.
+static TargetFn volatile g_helper = Helper;
+
+// Three prologue shapes: a long first instruction (atomic jmp rel32), a short one that needs the
+// padding before the function or suspended threads, and a call-heavy body.
+STRESS_NOINLINE int TargetStore(int x)
+{
+    g_sideEffect = x;
+    return x * 3 + 1;
+}
+
+STRESS_NOINLINE int TargetCall(int x)
+{
+    return g_helper(x) * 2 + 1;
+}
+
+STRESS_NOINLINE int TargetSaved(int x)
+{
+    const int y = g_helper(x);
+    return g_helper(y) + x;
+}
+
+static const int DETOUR_BIAS = 1000;
+static std::atomic<TargetFn> g_originals[3];
+
+STRESS_NOINLINE int DetourStore(int x)
+{
+    return g_originals[0].load()(x) + DETOUR_BIAS;
+}
+
+STRESS_NOINLINE int DetourCall(int x)
+{
+    return g_originals[1].load()(x) + DETOUR_BIAS;
+}
+
+STRESS_NOINLINE int DetourSaved(int x)
+{
+    return g_originals[2].load()(x) + DETOUR_BIAS;
+}
+
+static TargetFn volatile g_targets[3] = { TargetStore, TargetCall, TargetSaved };
+static const TargetFn g_detours[3] = { DetourStore, DetourCall, DetourSaved };
+
+static int Expected(size_t index, int x)
+{
+    switch (index)
+    {
+    case 0:
+        return x * 3 + 1;
+    case 1:
+        return (x + 7) * 2 + 1;
+    default:
+        return (x + 14) + x;
+    }
+}
+
+static void* Target(size_t index)
+{
+    return reinterpret_cast<void*>(g_targets[index]);
+}
+
+static const char* ModeName(SyxLib::PatchMode mode)
+{
+    return mode == SyxLib::PatchMode::Atomic ? "Atomic" : "SuspendThreads";
+}
+
+int main()
+{
+#if !defined(__x86_64__) && !defined(__i386__) && !defined(_M_X64) && !defined(_M_IX86)
+    printf("hook_stress: inline hooks are x86 only, skipped\n");
+    return 0;
+#else
+    const unsigned workerCount = (std::min)(8u, (std::max)(4u, std::thread::hardware_concurrency()));
+    std::atomic<bool> stop(false);
+    std::atomic<long long> calls(0), hooked(0), wrong(0);
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < workerCount; w++)
+    {
+        workers.emplace_back([&, w]
+        {
+            long long localCalls = 0, localHooked = 0;
+            for (int x = static_cast<int>(w); !stop.load(std::memory_order_relaxed); x = (x + 1) & 0xFFFF)
+            {
+                const size_t index = static_cast<size_t>(x) % 3;
+                const int result = g_targets[index](x);
+                const int expected = Expected(index, x);
+                if (result == expected + DETOUR_BIAS)
+                {
+                    localHooked++;
+                }
+                else if (result != expected)
+                {
+                    wrong.fetch_add(1);
+                }
+                localCalls++;
+            }
+            calls.fetch_add(localCalls);
+            hooked.fetch_add(localHooked);
+        });
+    }
+
+    int failures = 0;
+    SyxLib::HookManager hooks;
+    const SyxLib::PatchMode modes[] = { SyxLib::PatchMode::Atomic, SyxLib::PatchMode::SuspendThreads };
+    for (SyxLib::PatchMode mode : modes)
+    {
+        hooks.SetPatchMode(mode);
+        for (int cycle = 0; cycle < 25 && !failures; cycle++)
+        {
+            std::vector<void*> targets;
+            for (size_t i = 0; i < 3; i++)
+            {
+                const void* original = nullptr;
+                const SyxLib::HookStatus status = hooks.Create(Target(i), reinterpret_cast<const void*>(g_detours[i]), &original);
+                if (status != SyxLib::HookStatus::Ok)
+                {
+                    printf("%s cycle %d: Create(%zu) failed: %s\n", ModeName(mode), cycle, i, SyxLib::ToString(status));
+                    failures++;
+                    continue;
+                }
+                g_originals[i].store(reinterpret_cast<TargetFn>(const_cast<void*>(original)));
+                targets.push_back(Target(i));
+            }
+
+            // One by one, as a batch, all at once, then removed while the workers keep calling.
+            SyxLib::HookStatus statuses[] = {
+                hooks.Enable(targets.front()),
+                hooks.Enable(targets),
+                hooks.Disable(targets.front()),
+                hooks.EnableAll(),
+                hooks.Disable(targets),
+                hooks.EnableAll(),
+            };
+            for (SyxLib::HookStatus status : statuses)
+            {
+                if (status != SyxLib::HookStatus::Ok)
+                {
+                    printf("%s cycle %d: toggling failed: %s\n", ModeName(mode), cycle, SyxLib::ToString(status));
+                    failures++;
+                }
+            }
+            std::this_thread::yield();
+            for (void* target : targets)
+            {
+                const SyxLib::HookStatus status = hooks.Remove(target);
+                if (status != SyxLib::HookStatus::Ok)
+                {
+                    printf("%s cycle %d: Remove failed: %s\n", ModeName(mode), cycle, SyxLib::ToString(status));
+                    failures++;
+                }
+            }
+        }
+    }
+
+    stop.store(true);
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    // No thread can be inside a removed detour or trampoline any more.
+    hooks.Reclaim();
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (g_targets[i](5) != Expected(i, 5))
+        {
+            printf("target %zu still hooked after Remove\n", i);
+            failures++;
+        }
+    }
+    printf("hook_stress: %u workers, %lld calls, %lld hooked, %lld wrong, %d failures\n", workerCount, calls.load(),
+        hooked.load(), wrong.load(), failures);
+    return failures || wrong.load() || !hooked.load() ? 1 : 0;
+#endif
+}
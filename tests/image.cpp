@@ -0,0 +1,238 @@
+// Image test
+// FileImage reads the gapped shared object of module_scan from disk; its sections, RVA mapping,
+// scans and module key are compared with the copy the loader mapped into this process.
+// ModuleSnapshot captures a buffer, the buffer is edited, and DiffSnapshot, DiffSnapshots and
+// RevalidateMatch are compared with a page-by-page memcmp and a full rescan.
+
+#include "../Syx/Syx.h"
+#include "Check.h"
+#include <cstring>
+#include <dlfcn.h>
+
+extern "C" const unsigned char* SyxGapRodata();
+extern "C" int SyxGapCode(int x);
+
+static const char* const SNAPSHOT = "image.snap";
+static const char* const SNAPSHOT_NEXT = "image.next.snap";
+
+/** The first match in the file-backed parts of a file image, by RVA. */
+static size_t ReferenceFileFind(const SyxLib::FileImage& image, const TestPattern& pattern)
+{
+    for (const SyxLib::ImageSection& section : image.Sections())
+    {
+        const uint64_t backed = (std::min)({ section.fileSize, section.virtualSize, uint64_t(image.Size()) - section.fileOffset });
+        const size_t found = ReferenceFind(image.Data() + section.fileOffset, static_cast<size_t>(backed), pattern);
+        if (found != SIZE_MAX)
+        {
+            return static_cast<size_t>(section.virtualAddress) + found;
+        }
+    }
+    return SIZE_MAX;
+}
+
+static void TestFileImage()
+{
+    Dl_info library;
+    CHECK(dladdr(reinterpret_cast<void*>(&SyxGapCode), &library) && library.dli_fname && library.dli_fbase);
+    if (!library.dli_fbase)
+    {
+        return;
+    }
+    const uint8_t* base = static_cast<const uint8_t*>(library.dli_fbase);
+    SyxLib::FileImage image(library.dli_fname);
+    CHECK(image.IsOpen());
+    if (!image.IsOpen())
+    {
+        return;
+    }
+
+    // Every file-backed byte of a read-only section is where the loader put it.
+    bool sawCode = false;
+    for (const SyxLib::ImageSection& section : image.Sections())
+    {
+        const uint64_t backed = (std::min)(section.fileSize, section.virtualSize);
+        sawCode |= (section.protection & SyxLib::PROTECT_EXECUTE) != 0;
+        for (uint64_t i = 0; i < backed; i += 97)
+        {
+            uint64_t offset = 0, rva = 0;
+            CHECK(image.RvaToOffset(section.virtualAddress + i, offset) && offset == section.fileOffset + i);
+            CHECK(image.OffsetToRva(offset, rva) && rva == section.virtualAddress + i);
+            if (!(section.protection & SyxLib::PROTECT_WRITE) && image.Data()[offset] != base[section.virtualAddress + i])
+            {
+                printf("byte at RVA %llx differs from the loaded module\n", static_cast<unsigned long long>(section.virtualAddress + i));
+                g_failures++;
+                break;
+            }
+        }
+    }
+    CHECK(sawCode);
+
+    const uint8_t* rodata = SyxGapRodata();
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(&SyxGapCode);
+    const TestPattern patterns[] = {
+        { std::vector<uint8_t>(rodata, rodata + 16), "xxxxxxxxxxxxxxxx" },
+        { std::vector<uint8_t>(rodata + 1, rodata + 9), "x?xx??xx" },
+        { std::vector<uint8_t>(code, code + 8), "xxxxxxxx" },
+        { { 0xDE, 0xAD, 0xBE, 0xEF, 0x13, 0x37, 0xC0, 0xDE }, "xxxxxxxx" },
+    };
+    SyxLib::PatternSet set;
+    for (const TestPattern& pattern : patterns)
+    {
+        set.Add("", pattern.bytes.data(), pattern.mask.c_str());
+    }
+    set.Compile();
+    const std::vector<size_t> found = image.Find(set);
+    const std::vector<std::vector<size_t>> files = SyxLib::FindInFiles({ library.dli_fname, "missing.so" }, set);
+    CHECK(files.size() == 2 && files[0] == found && files[1].empty());
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++)
+    {
+        const size_t expected = ReferenceFileFind(image, patterns[i]);
+        CHECK_EQ(image.Find(SyxLib::Scanner(patterns[i].bytes.data(), patterns[i].mask.c_str())), expected);
+        CHECK_EQ(found[i], expected);
+    }
+    CHECK_EQ(found[0], static_cast<size_t>(rodata - base));
+    CHECK_EQ(found[2], static_cast<size_t>(code - base));
+    CHECK_EQ(image.Find(SyxLib::Scanner(patterns[2].bytes.data(), patterns[2].mask.c_str()), SyxLib::RegionFilter::Code()), found[2]);
+
+    // The key of the file is the key of the module it loads as.
+    CHECK_EQ(image.ModuleKey(), SyxLib::ComputeModuleKey(base, image.ImageSize()));
+
+    SyxLib::FileImage copy;
+    std::vector<uint8_t> bytes(image.Data(), image.Data() + image.Size());
+    CHECK(copy.Open(bytes.data(), bytes.size()) && copy.Find(set) == found);
+    bytes[0] ^= 0xFF;
+    CHECK(!copy.Open(bytes.data(), bytes.size()) && !copy.IsOpen());
+}
+
+/** Changed pages of a buffer against a snapshot's page copies, merged like SnapshotDiff. */
+static std::vector<SyxLib::ChangedRange> ReferenceDiff(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& current)
+{
+    const size_t page = SyxLib::ModuleSnapshot::PAGE_BYTES;
+    std::vector<SyxLib::ChangedRange> changed;
+    for (size_t offset = 0; offset < (std::max)(previous.size(), current.size()); offset += page)
+    {
+        const size_t a = offset < previous.size() ? (std::min)(page, previous.size() - offset) : 0;
+        const size_t b = offset < current.size() ? (std::min)(page, current.size() - offset) : 0;
+        if (a == b && memcmp(previous.data() + offset, current.data() + offset, a) == 0)
+        {
+            continue;
+        }
+        if (!changed.empty() && changed.back().offset + changed.back().size == offset)
+        {
+            changed.back().size += page;
+        }
+        else
+        {
+            changed.push_back({ offset, page });
+        }
+    }
+    return changed;
+}
+
+static bool SameRanges(const std::vector<SyxLib::ChangedRange>& a, const std::vector<SyxLib::ChangedRange>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].offset != b[i].offset || a[i].size != b[i].size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestSnapshots(TestRandom& random)
+{
+    for (int round = 0; round < 20; round++)
+    {
+        // Not an image: the whole buffer is captured, in file layout.
+        std::vector<uint8_t> previous(16 * 4096 + random.Below(3 * 4096));
+        random.Fill(previous.data(), previous.size(), 8);
+        previous[0] = 0;
+        SyxLib::ModuleSnapshot snapshot;
+        CHECK(snapshot.Capture(SNAPSHOT, previous.data(), previous.size(), false));
+        CHECK(snapshot.Open(SNAPSHOT) && !snapshot.IsMapped());
+        CHECK_EQ(snapshot.PageCount(), (previous.size() + 4095) / 4096);
+        for (size_t i = 0; i < snapshot.PageCount(); i++)
+        {
+            const size_t length = (std::min)(size_t(4096), previous.size() - i * 4096);
+            CHECK(snapshot.PageOffset(i) == i * 4096 && memcmp(snapshot.PageData(i), previous.data() + i * 4096, length) == 0);
+        }
+
+        // Edit a few pages, sometimes none, and sometimes grow or shrink the buffer.
+        std::vector<uint8_t> current = previous;
+        for (size_t i = random.Below(3) ? random.Below(6) : 0; i > 0; i--)
+        {
+            current[random.Below(current.size())] ^= static_cast<uint8_t>(1 + random.Below(255));
+        }
+        if (random.Below(4) == 0)
+        {
+            current.resize(current.size() + random.Below(2 * 4096) - 4096);
+        }
+        const std::vector<SyxLib::ChangedRange> expected = ReferenceDiff(previous, current);
+
+        SyxLib::SnapshotDiff diff;
+        CHECK(SyxLib::DiffSnapshot(snapshot, current.data(), current.size(), diff));
+        CHECK(SameRanges(diff.changed, expected));
+        CHECK_EQ(diff.previousKey == diff.currentKey, expected.empty());
+
+        SyxLib::ModuleSnapshot next;
+        CHECK(next.Capture(SNAPSHOT_NEXT, current.data(), current.size(), false));
+        SyxLib::SnapshotDiff between;
+        CHECK(SyxLib::DiffSnapshots(snapshot, next, between) && SameRanges(between.changed, expected));
+
+        // A match revalidated around the changed pages is the match a full scan finds.
+        for (int i = 0; i < 30; i++)
+        {
+            TestPattern pattern;
+            const size_t start = random.Below(current.size() - 8);
+            for (size_t j = 0; j < 5; j++)
+            {
+                pattern.bytes.push_back(current[start + j]);
+                pattern.mask += random.Below(4) ? 'x' : '?';
+            }
+            const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str());
+            const size_t before = ReferenceFind(previous.data(), previous.size(), pattern);
+            CHECK_EQ(SyxLib::RevalidateMatch(scanner, current.data(), current.size(), before, diff),
+                ReferenceFind(current.data(), current.size(), pattern));
+        }
+    }
+}
+
+static void TestModuleSnapshot()
+{
+    // A loaded module with unmapped gaps is captured without touching them.
+    const SyxLib::ModuleInfo info = Syx::GetModuleInfo(L"libsyxgap.so");
+    const uint8_t* base = static_cast<const uint8_t*>(info.lpBaseOfDll);
+    CHECK(base != nullptr);
+    if (!base)
+    {
+        return;
+    }
+    SyxLib::ModuleSnapshot snapshot;
+    CHECK(snapshot.Capture(SNAPSHOT, base, info.SizeOfImage) && snapshot.IsMapped());
+    CHECK(snapshot.PageCount() > 0);
+    for (size_t i = 0; i < snapshot.PageCount(); i++)
+    {
+        const size_t length = static_cast<size_t>((std::min)(uint64_t(4096), info.SizeOfImage - snapshot.PageOffset(i)));
+        CHECK(memcmp(snapshot.PageData(i), base + snapshot.PageOffset(i), length) == 0);
+    }
+    SyxLib::SnapshotDiff diff;
+    CHECK(SyxLib::DiffSnapshot(snapshot, base, info.SizeOfImage, diff) && diff.Empty());
+    CHECK_EQ(diff.pages, snapshot.PageCount());
+}
+
+int main()
+{
+    TestFileImage();
+    TestRandom random;
+    TestSnapshots(random);
+    TestModuleSnapshot();
+    remove(SNAPSHOT);
+    remove(SNAPSHOT_NEXT);
+    return Finish("image");
+}
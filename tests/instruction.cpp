@@ -0,0 +1,329 @@
+// Instruction test
+// DecodeInstruction is checked against a table of encodings whose lengths were taken from an
+// assembler. RelocateInstructions copies random streams of branches and RIP-relative operands;
+// the copy is decoded again and every branch, followed through any jump it was widened into,
+// must reach the original target, or the copy of it when the target was itself copied.
+
+#include "../Syx/Instruction.h"
+#include "Check.h"
+#include <cstring>
+
+using SyxLib::InstructionKind;
+
+struct DecodeCase
+{
+    std::vector<uint8_t> bytes;
+    bool x64;
+    uint8_t length;
+    InstructionKind kind;
+    uint8_t relativeOffset;
+    uint8_t relativeSize;
+    bool ripRelative;
+    uint8_t absoluteSize;
+    uint8_t immediateSize;
+};
+
+static void TestDecode()
+{
+    const InstructionKind O = InstructionKind::Other;
+    const DecodeCase cases[] = {
+        { { 0x90 }, true, 1, O, 0, 0, false, 0, 0 },
+        { { 0xC3 }, true, 1, InstructionKind::Exit, 0, 0, false, 0, 0 },
+        { { 0x48, 0x89, 0xE5 }, true, 3, O, 0, 0, false, 0, 0 },
+        { { 0x48, 0x83, 0xEC, 0x20 }, true, 4, O, 0, 0, false, 0, 1 },
+        { { 0x48, 0x8B, 0x05, 0x10, 0, 0, 0 }, true, 7, O, 3, 4, true, 0, 0 },
+        { { 0xE8, 0, 1, 0, 0 }, true, 5, InstructionKind::Call, 1, 4, false, 0, 0 },
+        { { 0xE9, 0, 1, 0, 0 }, true, 5, InstructionKind::Jump, 1, 4, false, 0, 0 },
+        { { 0xEB, 0x10 }, true, 2, InstructionKind::Jump, 1, 1, false, 0, 0 },
+        { { 0x74, 0x05 }, true, 2, InstructionKind::ConditionalJump, 1, 1, false, 0, 0 },
+        { { 0x0F, 0x85, 1, 0, 0, 0 }, true, 6, InstructionKind::ConditionalJump, 2, 4, false, 0, 0 },
+        { { 0xE2, 0xFE }, true, 2, InstructionKind::Loop, 1, 1, false, 0, 0 },
+        { { 0x67, 0xE3, 0x05 }, true, 3, InstructionKind::Loop, 2, 1, false, 0, 0 },
+        { { 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, true, 10, O, 0, 0, false, 0, 8 },
+        { { 0x66, 0xB8, 0x34, 0x12 }, true, 4, O, 0, 0, false, 0, 2 },
+        { { 0xC7, 0x44, 0x24, 0x08, 1, 0, 0, 0 }, true, 8, O, 0, 0, false, 0, 4 },
+        { { 0xC5, 0xFD, 0x6F, 0x05, 1, 0, 0, 0 }, true, 8, O, 4, 4, true, 0, 0 },
+        { { 0x62, 0xF1, 0x7C, 0x48, 0x10, 0x00 }, true, 6, O, 0, 0, false, 0, 0 },
+        { { 0x62, 0xF1, 0x7C, 0x48, 0x10, 0x05, 1, 0, 0, 0 }, true, 10, O, 6, 4, true, 0, 0 },
+        { { 0xFF, 0x15, 1, 0, 0, 0 }, true, 6, O, 2, 4, true, 0, 0 },
+        { { 0xC8, 0x10, 0x00, 0x01 }, true, 4, O, 0, 0, false, 0, 3 },
+        { { 0x48, 0xA1, 1, 2, 3, 4, 5, 6, 7, 8 }, true, 10, O, 0, 0, false, 8, 0 },
+        { { 0x66, 0x0F, 0x3A, 0x0F, 0xC1, 0x08 }, true, 6, O, 0, 0, false, 0, 1 },
+        { { 0xF0, 0x48, 0x0F, 0xB1, 0x0D, 1, 0, 0, 0 }, true, 9, O, 5, 4, true, 0, 0 },
+        { { 0x8F, 0xE8, 0x78, 0xC0, 0xC1, 0x05 }, true, 6, O, 0, 0, false, 0, 1 },
+        { { 0xDD, 0x44, 0x24, 0x08 }, true, 4, O, 0, 0, false, 0, 0 },
+        { { 0x66, 0x0F, 0x38, 0x00, 0xC1 }, true, 5, O, 0, 0, false, 0, 0 },
+        { { 0xF6, 0x05, 1, 0, 0, 0, 0x7F }, true, 7, O, 2, 4, true, 0, 1 },
+        { { 0x48, 0xF7, 0x05, 1, 0, 0, 0, 1, 0, 0, 0 }, true, 11, O, 3, 4, true, 0, 4 },
+        { { 0xA1, 1, 2, 3, 4 }, false, 5, O, 0, 0, false, 4, 0 },
+        { { 0x8B, 0x05, 1, 2, 3, 4 }, false, 6, O, 0, 0, false, 4, 0 },
+        { { 0x06 }, false, 1, O, 0, 0, false, 0, 0 },
+        { { 0x66, 0xE9, 1, 0 }, false, 4, InstructionKind::Jump, 2, 2, false, 0, 0 },
+        { { 0xC5, 0x06 }, false, 2, O, 0, 0, false, 0, 0 },
+        { { 0x40 }, false, 1, O, 0, 0, false, 0, 0 },
+        { { 0xE3, 0x05 }, false, 2, InstructionKind::Loop, 1, 1, false, 0, 0 },
+        { { 0x0F, 0x84, 1, 0, 0, 0 }, false, 6, InstructionKind::ConditionalJump, 2, 4, false, 0, 0 },
+    };
+    for (const DecodeCase& c : cases)
+    {
+        const size_t failuresBefore = g_failures;
+        SyxLib::Instruction instruction;
+        CHECK(SyxLib::DecodeInstruction(c.bytes.data(), c.bytes.size(), c.x64, instruction));
+        CHECK_EQ(instruction.length, c.length);
+        CHECK(instruction.kind == c.kind);
+        CHECK_EQ(instruction.relativeOffset, c.relativeOffset);
+        CHECK_EQ(instruction.relativeSize, c.relativeSize);
+        CHECK_EQ(instruction.ripRelative, c.ripRelative);
+        CHECK_EQ(instruction.absoluteSize, c.absoluteSize);
+        CHECK_EQ(instruction.immediateSize, c.immediateSize);
+        // One byte short is never a valid instruction.
+        CHECK(!SyxLib::DecodeInstruction(c.bytes.data(), c.bytes.size() - 1, c.x64, instruction));
+        if (g_failures != static_cast<int>(failuresBefore))
+        {
+            printf("  in the %s case starting %02X, %zu bytes\n", c.x64 ? "x64" : "x86", c.bytes[0], c.bytes.size());
+        }
+    }
+
+    // Opcodes that 64-bit mode removed.
+    const uint8_t removed[] = { 0x06, 0x27, 0x60, 0xD4 };
+    for (uint8_t opcode : removed)
+    {
+        const uint8_t bytes[] = { opcode, 0x0A, 0, 0 };
+        SyxLib::Instruction instruction;
+        CHECK(!SyxLib::DecodeInstruction(bytes, sizeof(bytes), true, instruction));
+    }
+}
+
+static void TestPatchLength()
+{
+    // push rbp; mov rbp, rsp; sub rsp, 0x20; mov rax, [rip + 0x10]
+    const uint8_t prologue[] = { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0x48, 0x8B, 0x05, 0x10, 0, 0, 0 };
+    const size_t ends[] = { 1, 4, 8, 15 };
+    for (size_t minLength = 1; minLength <= sizeof(prologue); minLength++)
+    {
+        size_t expected = 0;
+        for (size_t end : ends)
+        {
+            if (end >= minLength)
+            {
+                expected = end;
+                break;
+            }
+        }
+        CHECK_EQ(SyxLib::FindPatchLength(prologue, sizeof(prologue), minLength, true), expected);
+    }
+    CHECK_EQ(SyxLib::FindPatchLength(prologue, 10, 14, true), 0u);
+
+    // A function that returns early may be overwritten only over int3/nop padding.
+    const uint8_t padded[] = { 0x31, 0xC0, 0xC3, 0xCC, 0x90, 0xCC, 0x55 };
+    CHECK_EQ(SyxLib::FindPatchLength(padded, sizeof(padded), 6, true), 6u);
+    CHECK_EQ(SyxLib::FindPatchLength(padded, sizeof(padded), 7, true), 0u);
+}
+
+/** An instruction template; rel marks where the displacement goes. */
+struct Template
+{
+    std::vector<uint8_t> bytes;
+    uint8_t relativeOffset;
+    uint8_t relativeSize;
+};
+
+/**
+ * Where control goes when the branch copied at offset is taken, following the long jumps that
+ * rel8 and far branches are rewritten into. Returns 0 if the copy is not a branch it understands.
+ */
+static uintptr_t FollowBranch(const std::vector<uint8_t>& out, uintptr_t destination, size_t offset, size_t end)
+{
+    const uint8_t* code = out.data() + offset;
+    static const uint8_t farCall[] = { 0xFF, 0x15, 0x02, 0, 0, 0, 0xEB, 0x08 };
+    static const uint8_t farJump[] = { 0xFF, 0x25, 0, 0, 0, 0 };
+    uint64_t absolute;
+    if (offset + 16 <= out.size() && memcmp(code, farCall, sizeof(farCall)) == 0)
+    {
+        memcpy(&absolute, code + 8, sizeof(absolute));
+        return static_cast<uintptr_t>(absolute);
+    }
+    if (offset + 14 <= out.size() && memcmp(code, farJump, sizeof(farJump)) == 0)
+    {
+        memcpy(&absolute, code + 6, sizeof(absolute));
+        return static_cast<uintptr_t>(absolute);
+    }
+    SyxLib::Instruction instruction;
+    if (!SyxLib::DecodeInstruction(code, out.size() - offset, true, instruction) || instruction.relativeSize == 0)
+    {
+        return 0;
+    }
+    const uintptr_t target = instruction.Target(code, destination + offset);
+    if (instruction.relativeSize == 1 && target - destination <= out.size())
+    {
+        // A short branch inside the copy: an inverted jcc skipping to the end over a far jump,
+        // or a loop taking the long jump after the short jmp.
+        if (instruction.kind == InstructionKind::ConditionalJump)
+        {
+            return target == destination + end ? FollowBranch(out, destination, offset + instruction.length, end) : 0;
+        }
+        return FollowBranch(out, destination, static_cast<size_t>(target - destination), end);
+    }
+    return target;
+}
+
+static void TestRelocateStream(TestRandom& random, uintptr_t source, uintptr_t destination, bool withRipRelative)
+{
+    const Template plain[] = {
+        { { 0x55 }, 0, 0 }, { { 0x48, 0x89, 0xE5 }, 0, 0 }, { { 0x48, 0x83, 0xEC, 0x20 }, 0, 0 },
+        { { 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, 0, 0 }, { { 0x0F, 0x1F, 0x44, 0x00, 0x00 }, 0, 0 },
+        { { 0xC5, 0xF8, 0x77 }, 0, 0 }, { { 0x62, 0xF1, 0x7C, 0x48, 0x10, 0x00 }, 0, 0 },
+    };
+    const Template branches[] = {
+        { { 0xE8, 0, 0, 0, 0 }, 1, 4 }, { { 0xE9, 0, 0, 0, 0 }, 1, 4 }, { { 0xEB, 0 }, 1, 1 },
+        { { 0x75, 0 }, 1, 1 }, { { 0x7C, 0 }, 1, 1 }, { { 0x0F, 0x84, 0, 0, 0, 0 }, 2, 4 },
+        { { 0xE2, 0 }, 1, 1 }, { { 0x67, 0xE3, 0 }, 2, 1 },
+    };
+    const Template ripRelative[] = {
+        { { 0x48, 0x8B, 0x05, 0, 0, 0, 0 }, 3, 4 }, { { 0xC5, 0xFD, 0x6F, 0x05, 0, 0, 0, 0 }, 4, 4 },
+        { { 0x48, 0xF7, 0x05, 0, 0, 0, 0, 1, 0, 0, 0 }, 3, 4 },
+    };
+
+    for (int round = 0; round < 300; round++)
+    {
+        // Lay the stream out first, so branches can aim at the start of any of its instructions.
+        std::vector<const Template*> stream;
+        const size_t count = 1 + random.Below(12);
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t pick = random.Below(10);
+            stream.push_back(pick < 4 ? &plain[random.Below(7)] :
+                pick < 8 || !withRipRelative ? &branches[random.Below(8)] : &ripRelative[random.Below(3)]);
+        }
+        std::vector<uint8_t> code;
+        std::vector<size_t> starts;
+        for (const Template* t : stream)
+        {
+            starts.push_back(code.size());
+            code.insert(code.end(), t->bytes.begin(), t->bytes.end());
+        }
+
+        std::vector<uintptr_t> targets(count, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            const Template& t = *stream[i];
+            if (!t.relativeSize)
+            {
+                continue;
+            }
+            const bool isRipRelative = &t >= ripRelative && &t < ripRelative + 3;
+            const intptr_t next = static_cast<intptr_t>(starts[i] + t.bytes.size());
+            intptr_t displacement;
+            const bool inside = !isRipRelative && random.Below(2);
+            if (inside)
+            {
+                displacement = static_cast<intptr_t>(starts[random.Below(count)]) - next;
+            }
+            else if (t.relativeSize == 1)
+            {
+                // Before the stream, or after it when the stream is short enough.
+                displacement = -next - 1 - static_cast<intptr_t>(random.Below(20));
+                if (displacement < -128)
+                {
+                    displacement = static_cast<intptr_t>(code.size()) - next + static_cast<intptr_t>(random.Below(20));
+                }
+            }
+            else
+            {
+                displacement = static_cast<intptr_t>(random.Below(1 << 20)) - (1 << 19);
+                displacement += displacement < 0 ? -next : static_cast<intptr_t>(code.size());
+            }
+            if (t.relativeSize == 1 && (displacement < -128 || displacement > 127))
+            {
+                displacement = 0;
+            }
+            const int32_t value = static_cast<int32_t>(displacement);
+            memcpy(code.data() + starts[i] + t.relativeOffset, &value, t.relativeSize);
+            targets[i] = source + next + displacement;
+        }
+
+        std::vector<uint8_t> out;
+        std::vector<std::pair<size_t, size_t>> boundaries;
+        const bool relocated = SyxLib::RelocateInstructions(code.data(), code.size(), source, destination, true, out, &boundaries);
+        CHECK(relocated);
+        CHECK_EQ(boundaries.size(), count);
+        if (!relocated || boundaries.size() != count)
+        {
+            continue;
+        }
+
+        const size_t failuresBefore = g_failures;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Template& t = *stream[i];
+            const size_t at = boundaries[i].second;
+            const size_t end = i + 1 < count ? boundaries[i + 1].second : out.size();
+            CHECK_EQ(boundaries[i].first, starts[i]);
+            if (!t.relativeSize)
+            {
+                CHECK(end - at == t.bytes.size() && memcmp(out.data() + at, code.data() + starts[i], t.bytes.size()) == 0);
+                continue;
+            }
+            uintptr_t expected = targets[i];
+            for (size_t j = 0; j < count; j++)
+            {
+                if (source + starts[j] == targets[i])
+                {
+                    expected = destination + boundaries[j].second;
+                }
+            }
+            if (&t >= ripRelative && &t < ripRelative + 3)
+            {
+                SyxLib::Instruction instruction;
+                CHECK(SyxLib::DecodeInstruction(out.data() + at, end - at, true, instruction) && instruction.length == end - at);
+                CHECK_EQ(instruction.Target(out.data() + at, destination + at), expected);
+                continue;
+            }
+            CHECK_EQ(FollowBranch(out, destination, at, end), expected);
+            // A copied jcc and loop keep their condition.
+            SyxLib::Instruction original, copy;
+            SyxLib::DecodeInstruction(code.data() + starts[i], t.bytes.size(), true, original);
+            SyxLib::DecodeInstruction(out.data() + at, end - at, true, copy);
+            if (original.kind == InstructionKind::Loop)
+            {
+                CHECK(copy.kind == InstructionKind::Loop && copy.condition == original.condition);
+            }
+            else if (original.kind == InstructionKind::ConditionalJump)
+            {
+                CHECK(copy.kind == InstructionKind::ConditionalJump && (copy.condition == original.condition ||
+                    (copy.condition == (original.condition ^ 1) && copy.relativeSize == 1)));
+            }
+        }
+        if (g_failures != static_cast<int>(failuresBefore))
+        {
+            printf("  in a stream of %zu instructions copied %s\n", count, destination - source > 0x80000000u ? "far" : "near");
+        }
+    }
+}
+
+static void TestRelocateFailures()
+{
+    // A rel16 branch, a branch into the middle of a copied instruction, an unreachable RIP operand.
+    const uint8_t rel16[] = { 0x66, 0xE9, 0x10, 0x00 };
+    const uint8_t intoMiddle[] = { 0xEB, 0x01, 0x48, 0x89, 0xE5 };
+    const uint8_t rip[] = { 0x48, 0x8B, 0x05, 0x10, 0, 0, 0 };
+    std::vector<uint8_t> out;
+    CHECK(!SyxLib::RelocateInstructions(rel16, sizeof(rel16), 0x401000, 0x402000, false, out));
+    CHECK(!SyxLib::RelocateInstructions(intoMiddle, sizeof(intoMiddle), 0x401000, 0x402000, true, out));
+    CHECK(!SyxLib::RelocateInstructions(rip, sizeof(rip), 0x140001000ull, 0x340001000ull, true, out));
+    CHECK(SyxLib::RelocateInstructions(rip, sizeof(rip), 0x140001000ull, 0x150001000ull, true, out));
+}
+
+int main()
+{
+    TestDecode();
+    TestPatchLength();
+    TestRandom random;
+    if (sizeof(uintptr_t) == 8)
+    {
+        TestRelocateStream(random, 0x140001000ull, 0x140201000ull, true);
+        TestRelocateStream(random, 0x140001000ull, 0x7FF600001000ull, false);
+    }
+    TestRelocateFailures();
+    return Finish("instruction");
+}
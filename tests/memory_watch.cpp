@@ -0,0 +1,314 @@
+// MemoryWatch test
+// Watched values of every size are changed between ticks and the reported changes are compared
+// with a reference model of the last value each entry saw. Frozen values must be restored after
+// being overwritten, follow SetValue and stop after Remove, both when driven with Tick() and on
+// the scheduler thread. Chains follow a moved object after Refresh(), a full queue counts what it
+// drops, and on Linux entries whose memory was unmapped are skipped through ProcessMemory.
+
+#include "../Syx/MemoryWatch.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static const std::chrono::microseconds RESOLUTION(100);
+static const std::chrono::microseconds PERIOD(100);
+
+/** Sleeps past the period of every entry, then services them on this thread. */
+static void Advance(SyxLib::MemoryWatch& watch)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    watch.Tick();
+}
+
+static std::vector<SyxLib::WatchEvent> Drain(SyxLib::MemoryWatch& watch)
+{
+    std::vector<SyxLib::WatchEvent> events;
+    SyxLib::WatchEvent event;
+    while (watch.Poll(event))
+    {
+        events.push_back(event);
+    }
+    std::sort(events.begin(), events.end(), [](const SyxLib::WatchEvent& a, const SyxLib::WatchEvent& b) { return a.id < b.id; });
+    return events;
+}
+
+struct WatchedValue
+{
+    uint32_t id;
+    uint8_t* data;
+    uint32_t size;
+    /** What the entry saw at its last service. */
+    std::vector<uint8_t> seen;
+    bool removed;
+};
+
+template <typename T>
+static uint32_t WatchAs(SyxLib::MemoryWatch& watch, uint8_t* data)
+{
+    return watch.Watch<T>(reinterpret_cast<uintptr_t>(data), PERIOD);
+}
+
+static void TestWatch(uint8_t* buffer, TestRandom& random)
+{
+    SyxLib::WatchOptions options;
+    options.resolution = RESOLUTION;
+    SyxLib::MemoryWatch watch(SyxLib::LocalMemory::Instance(), options);
+
+    struct Value16
+    {
+        uint8_t bytes[16];
+    };
+    std::vector<WatchedValue> values;
+    for (size_t i = 0; i < 60; i++)
+    {
+        // Distinct 16-byte slots in random order, so batches need sorting.
+        uint8_t* data = buffer + (i * 37 % 60) * 16;
+        const uint32_t size = 1u << random.Below(5);
+        const uint32_t id = size == 1 ? WatchAs<uint8_t>(watch, data) : size == 2 ? WatchAs<uint16_t>(watch, data) :
+            size == 4 ? WatchAs<uint32_t>(watch, data) : size == 8 ? WatchAs<uint64_t>(watch, data) : WatchAs<Value16>(watch, data);
+        values.push_back({ id, data, size, std::vector<uint8_t>(data, data + size), false });
+    }
+    CHECK_EQ(watch.Count(), values.size());
+
+    // The first service only records the baseline.
+    Advance(watch);
+    CHECK(Drain(watch).empty());
+
+    for (int round = 0; round < 30; round++)
+    {
+        for (size_t i = random.Below(12); i > 0; i--)
+        {
+            WatchedValue& value = values[random.Below(values.size())];
+            value.data[random.Below(value.size)] = static_cast<uint8_t>(random.Below(4));
+        }
+        Advance(watch);
+
+        std::vector<const WatchedValue*> changed;
+        for (WatchedValue& value : values)
+        {
+            if (!value.removed && memcmp(value.seen.data(), value.data, value.size) != 0)
+            {
+                changed.push_back(&value);
+            }
+        }
+        const std::vector<SyxLib::WatchEvent> events = Drain(watch);
+        CHECK_EQ(events.size(), changed.size());
+        for (size_t i = 0; i < events.size() && i < changed.size(); i++)
+        {
+            const WatchedValue& value = *changed[i];
+            CHECK(events[i].id == value.id && events[i].address == reinterpret_cast<uintptr_t>(value.data) && events[i].size == value.size);
+            CHECK(memcmp(events[i].previous, value.seen.data(), value.size) == 0 && memcmp(events[i].current, value.data, value.size) == 0);
+        }
+        for (WatchedValue& value : values)
+        {
+            value.seen.assign(value.data, value.data + value.size);
+        }
+
+        // Removed entries report nothing more.
+        if (round == 20)
+        {
+            for (size_t i = 0; i < values.size(); i += 2)
+            {
+                CHECK(watch.Remove(values[i].id));
+                CHECK(!watch.Remove(values[i].id));
+                values[i].removed = true;
+            }
+        }
+    }
+    CHECK_EQ(watch.Count(), values.size() / 2);
+    CHECK_EQ(watch.Dropped(), 0u);
+}
+
+static void TestFreeze(uint8_t* buffer, TestRandom& random, bool threaded)
+{
+    SyxLib::WatchOptions options;
+    options.resolution = RESOLUTION;
+    SyxLib::MemoryWatch watch(SyxLib::LocalMemory::Instance(), options);
+    std::map<uint32_t, std::pair<uint32_t*, uint32_t>> frozen;
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        uint32_t* slot = reinterpret_cast<uint32_t*>(buffer) + i;
+        const uint32_t value = static_cast<uint32_t>(random.Next());
+        frozen[watch.Freeze(reinterpret_cast<uintptr_t>(slot), value, PERIOD)] = { slot, value };
+    }
+    if (threaded)
+    {
+        CHECK(watch.Start() && !watch.Start() && watch.IsRunning());
+    }
+
+    // Waits until every frozen value holds, on the scheduler or by ticking.
+    auto settled = [&]()
+    {
+        for (int attempt = 0; attempt < 1000; attempt++)
+        {
+            if (threaded)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            else
+            {
+                Advance(watch);
+            }
+            bool held = true;
+            for (const auto& entry : frozen)
+            {
+                held = held && *entry.second.first == entry.second.second;
+            }
+            if (held)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (int round = 0; round < 5; round++)
+    {
+        for (auto& entry : frozen)
+        {
+            *entry.second.first = ~entry.second.second;
+            if (random.Below(4) == 0)
+            {
+                entry.second.second = static_cast<uint32_t>(random.Next());
+                CHECK(watch.SetValue(entry.first, entry.second.second));
+                CHECK(!watch.SetValue(entry.first, uint64_t(0)));
+            }
+        }
+        CHECK(settled());
+    }
+
+    // Removed entries are no longer written.
+    std::vector<uint32_t*> released;
+    for (auto it = frozen.begin(); it != frozen.end();)
+    {
+        if (random.Below(2))
+        {
+            CHECK(watch.Remove(it->first));
+            released.push_back(it->second.first);
+            it = frozen.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    CHECK(settled());
+    for (uint32_t* slot : released)
+    {
+        *slot = 0x12345678;
+    }
+    for (auto& entry : frozen)
+    {
+        *entry.second.first = ~entry.second.second;
+    }
+    CHECK(settled());
+    for (uint32_t* slot : released)
+    {
+        CHECK_EQ(*slot, 0x12345678u);
+    }
+    watch.Stop();
+    CHECK(!watch.IsRunning());
+}
+
+static void TestChains(uint8_t* buffer)
+{
+    SyxLib::WatchOptions options;
+    options.resolution = RESOLUTION;
+    SyxLib::MemoryWatch watch(SyxLib::LocalMemory::Instance(), options);
+
+    // pointer -> object; the watched field is at +8 in the object.
+    uintptr_t* pointer = reinterpret_cast<uintptr_t*>(buffer);
+    uint8_t* first = buffer + 256;
+    uint8_t* second = buffer + 512;
+    *pointer = reinterpret_cast<uintptr_t>(first);
+    const uint32_t one = 111, two = 222;
+    memcpy(first + 8, &one, sizeof(one));
+    memcpy(second + 8, &two, sizeof(two));
+    const uint32_t id = watch.Watch<uint32_t>(SyxLib::PointerChain(reinterpret_cast<uintptr_t>(pointer), { 8 }), PERIOD);
+    const uint32_t frozenId = watch.Freeze(SyxLib::PointerChain(reinterpret_cast<uintptr_t>(pointer), { 16 }), uint32_t(333), PERIOD);
+    Advance(watch);
+    CHECK(Drain(watch).empty());
+
+    // The object moves; after Refresh the chains follow it.
+    *pointer = reinterpret_cast<uintptr_t>(second);
+    watch.Refresh();
+    Advance(watch);
+    const std::vector<SyxLib::WatchEvent> events = Drain(watch);
+    CHECK(events.size() == 1 && events[0].id == id && events[0].address == reinterpret_cast<uintptr_t>(second + 8) &&
+        events[0].Previous<uint32_t>() == one && events[0].Current<uint32_t>() == two);
+    uint32_t written;
+    memcpy(&written, second + 16, sizeof(written));
+    CHECK_EQ(written, 333u);
+    CHECK(watch.Remove(frozenId));
+}
+
+/**
+ * A full queue counts the changes it drops. Through an accessor that checks its accesses, entries
+ * whose memory is gone are skipped; LocalMemory dereferences directly, so it gets none.
+ */
+static void TestDropped(const SyxLib::MemoryAccessor& memory, bool unmapped, TestRandom& random)
+{
+    const size_t size = 64 * 1024;
+    uint8_t* pages = AllocatePages(size);
+    CHECK(pages != nullptr);
+    if (!pages)
+    {
+        return;
+    }
+    memset(pages, 0, 64);
+    SyxLib::WatchOptions options;
+    options.resolution = RESOLUTION;
+    options.queueCapacity = 4;
+    SyxLib::MemoryWatch watch(memory, options);
+    for (size_t i = 0; i < 10; i++)
+    {
+        watch.Watch<uint32_t>(reinterpret_cast<uintptr_t>(pages + i * 4), PERIOD);
+    }
+    if (unmapped)
+    {
+        watch.Watch<uint32_t>(reinterpret_cast<uintptr_t>(pages + size / 2), PERIOD);
+        watch.Freeze(reinterpret_cast<uintptr_t>(pages + size / 2 + 64), uint32_t(5), PERIOD);
+    }
+    Advance(watch);
+    FreePages(pages + size / 2, size / 2);
+    random.Fill(pages, 40, 256);
+    for (size_t i = 0; i < 40; i += 4)
+    {
+        pages[i] |= 0x80;
+    }
+    Advance(watch);
+    Advance(watch);
+    CHECK_EQ(Drain(watch).size(), 4u);
+    CHECK_EQ(watch.Dropped(), 6u);
+    FreePages(pages, size / 2);
+}
+
+int main()
+{
+    uint8_t* buffer = AllocatePages(4096);
+    CHECK(buffer != nullptr);
+    if (buffer)
+    {
+        TestRandom random;
+        memset(buffer, 0, 4096);
+        TestWatch(buffer, random);
+        TestFreeze(buffer + 2048, random, false);
+        TestFreeze(buffer + 2048, random, true);
+        TestChains(buffer + 1024);
+        TestDropped(SyxLib::LocalMemory::Instance(), false, random);
+#ifdef __linux__
+        SyxLib::ProcessMemory self(static_cast<uint32_t>(getpid()));
+        if (self.IsOpen())
+        {
+            TestDropped(self, true, random);
+        }
+#endif
+        FreePages(buffer, 4096);
+    }
+    return Finish("memory_watch");
+}
@@ -0,0 +1,126 @@
+// Module scan test
+// Every module-wide entry point of Syx is run against a shared object whose image range holds
+// unmapped gaps between its segments, and compared with a byte-by-byte search of the module's
+// readable regions. Scanning the image range as one buffer faults on the first gap.
+
+#include "../Syx/Syx.h"
+#include "Check.h"
+#include <cstdio>
+#include <string>
+
+extern "C" const unsigned char* SyxGapRodata();
+extern "C" unsigned char* SyxGapData();
+extern "C" int SyxGapCode(int x);
+
+static const wchar_t* const MODULE = L"libsyxgap.so";
+
+struct NamedPattern
+{
+    const char* name;
+    TestPattern pattern;
+};
+
+static std::vector<uintptr_t> ReferenceMatches(const std::vector<SyxLib::MemoryRegion>& regions, const TestPattern& pattern)
+{
+    std::vector<uintptr_t> matches;
+    for (const SyxLib::MemoryRegion& region : regions)
+    {
+        for (size_t offset : ReferenceFindAll(reinterpret_cast<const uint8_t*>(region.base), region.size, pattern))
+        {
+            matches.push_back(region.base + offset);
+        }
+    }
+    return matches;
+}
+
+int main()
+{
+    const SyxLib::ModuleInfo info = Syx::GetModuleInfo(MODULE);
+    const uintptr_t base = reinterpret_cast<uintptr_t>(info.lpBaseOfDll);
+    CHECK(base != 0);
+    if (!base)
+    {
+        return Finish("module_scan");
+    }
+    const std::vector<SyxLib::MemoryRegion> readable =
+        SyxLib::FilterRegions(SyxLib::QueryRegions(base, base + info.SizeOfImage), SyxLib::RegionFilter::Readable());
+    size_t readableBytes = 0;
+    for (const SyxLib::MemoryRegion& region : readable)
+    {
+        readableBytes += region.size;
+    }
+    // The point of the test: the image range is not readable as a whole.
+    CHECK(readableBytes < info.SizeOfImage);
+
+    const uint8_t* rodata = SyxGapRodata();
+    const uint8_t* data = SyxGapData();
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(&SyxGapCode);
+    std::vector<NamedPattern> patterns = {
+        { "rodata", { std::vector<uint8_t>(rodata, rodata + 16), "xxxxxxxxxxxxxxxx" } },
+        { "rodata wildcards", { std::vector<uint8_t>(rodata + 2, rodata + 14), "xx??xxx?xxxx" } },
+        { "data", { std::vector<uint8_t>(data, data + 16), "xxxxxxxxxxxxxxxx" } },
+        { "code", { std::vector<uint8_t>(code, code + 8), "xxxxxxxx" } },
+        { "absent", { { 0xDE, 0xAD, 0xBE, 0xEF, 0x13, 0x37, 0xC0, 0xDE, 0xFA, 0xCE }, "xxxxxxxxxx" } },
+    };
+
+    SyxLib::PatternSet set;
+    for (const NamedPattern& named : patterns)
+    {
+        set.Add(named.name, named.pattern.bytes.data(), named.pattern.mask.c_str());
+    }
+    set.Compile();
+    const std::vector<uintptr_t> found = Syx::FindPatterns(MODULE, set);
+
+    remove("module_scan.sigcache");
+    remove("module_scan.snap");
+    SyxLib::SignatureCache cache("module_scan.sigcache");
+    SyxLib::SnapshotDiff diff;
+    CHECK(Syx::UpdateModuleSnapshot(MODULE, "module_scan.snap", diff));
+
+    for (size_t index = 0; index < patterns.size(); index++)
+    {
+        TestPattern& pattern = patterns[index].pattern;
+        const std::vector<uintptr_t> expected = ReferenceMatches(readable, pattern);
+        const uintptr_t first = expected.empty() ? 0 : expected.front();
+        const SyxLib::Pattern parsed(pattern.Signature().c_str());
+        char* bytes = reinterpret_cast<char*>(pattern.bytes.data());
+        char* mask = &pattern.mask[0];
+        printf("%s: %zu matches\n", patterns[index].name, expected.size());
+
+        CHECK_EQ(Syx::FindPatternA(MODULE, bytes, mask), first);
+        CHECK_EQ(Syx::FindPatternA(MODULE, parsed), first);
+        CHECK_EQ(Syx::FindPatternA(MODULE, parsed, SyxLib::RegionFilter()), first);
+        SyxLib::ParallelScanOptions options;
+        options.chunkSize = 4096;
+        CHECK_EQ(Syx::FindPatternParallel(MODULE, bytes, mask, options), first);
+        CHECK_EQ(found[index], first);
+        CHECK(Syx::Matches(MODULE, parsed).ToVector() == expected);
+        CHECK_EQ(Syx::Matches(MODULE, bytes, mask, 2).Count(), (std::min)(expected.size(), size_t(2)));
+        // The second call is answered from the cache and verified in place.
+        CHECK_EQ(Syx::FindPatternCached(cache, MODULE, parsed), first);
+        CHECK_EQ(Syx::FindPatternCached(cache, MODULE, bytes, mask), first);
+        CHECK_EQ(Syx::FindPatternCached(cache, MODULE, parsed, diff), first);
+        size_t mismatches = SIZE_MAX;
+        CHECK_EQ(Syx::FindPatternFuzzy(MODULE, parsed, 2, &mismatches), first);
+        CHECK_EQ(mismatches, first ? 0u : SIZE_MAX);
+    }
+
+    // Found only in the last read-only segment, past two gaps, with one differing byte.
+    TestPattern fuzzy = patterns[0].pattern;
+    fuzzy.bytes[5] ^= 0xFF;
+    size_t mismatches = 0;
+    CHECK_EQ(Syx::FindPatternFuzzy(MODULE, SyxLib::Pattern(fuzzy.Signature().c_str()), 1, &mismatches), reinterpret_cast<uintptr_t>(rodata));
+    CHECK_EQ(mismatches, 1u);
+
+    const std::string signature = Syx::MakeSignature(MODULE, reinterpret_cast<uintptr_t>(rodata));
+    CHECK(!signature.empty());
+    if (!signature.empty())
+    {
+        const std::vector<uintptr_t> hits = Syx::Matches(MODULE, SyxLib::Pattern(signature.c_str())).ToVector();
+        CHECK(hits.size() == 1 && hits.front() == reinterpret_cast<uintptr_t>(rodata));
+    }
+
+    remove("module_scan.sigcache");
+    remove("module_scan.snap");
+    return Finish("module_scan");
+}
@@ -0,0 +1,268 @@
+// Patch test
+// Random sets of PatchSet patches over writable and read-only pages are applied and reverted, and
+// the memory is compared with a shadow copy patched by hand. A set that fails a check must leave
+// every byte untouched. PointerHooks redirects virtual calls, a function pointer table and, on
+// Linux, an imported function, and restores them.
+
+#include "../Syx/PointerHooks.h"
+#include "Check.h"
+#include <cstring>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static const size_t PAGE_BYTES = 4096;
+static const size_t PAGES = 6;
+
+static void SetReadOnly(uint8_t* pages, size_t size, bool readOnly)
+{
+#ifdef _WIN32
+    DWORD old;
+    VirtualProtect(pages, size, readOnly ? PAGE_READONLY : PAGE_READWRITE, &old);
+#else
+    mprotect(pages, size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE);
+#endif
+}
+
+static uint32_t ProtectionAt(const uint8_t* address)
+{
+    const uintptr_t at = reinterpret_cast<uintptr_t>(address);
+    const std::vector<SyxLib::MemoryRegion> regions = SyxLib::QueryRegions(at, at + 1);
+    return regions.empty() ? 0 : regions.front().protection;
+}
+
+static void TestPatchSets(uint8_t* pages, TestRandom& random)
+{
+    const size_t size = PAGES * PAGE_BYTES;
+    for (int round = 0; round < 40; round++)
+    {
+        // Pages 1 and 4 are read-only: their protection must come back after every write.
+        SetReadOnly(pages, size, false);
+        random.Fill(pages, size);
+        std::vector<uint8_t> original(pages, pages + size);
+        SetReadOnly(pages + PAGE_BYTES, PAGE_BYTES, true);
+        SetReadOnly(pages + 4 * PAGE_BYTES, PAGE_BYTES, true);
+
+        SyxLib::PatchSet set(random.Below(2) ? SyxLib::PatchMode::Atomic : SyxLib::PatchMode::SuspendThreads);
+        std::vector<uint8_t> patched = original;
+        std::vector<bool> used(size, false);
+        std::vector<std::pair<size_t, size_t>> patches;
+        const size_t count = 1 + random.Below(40);
+        for (size_t i = 0; i < count * 4 && patches.size() < count; i++)
+        {
+            // Short patches inside one word and longer ones across page boundaries.
+            const size_t length = random.Below(3) ? 1 + random.Below(8) : 1 + random.Below(40);
+            const size_t offset = random.Below(size - length);
+            bool vacant = true;
+            for (size_t j = offset; j < offset + length; j++)
+            {
+                vacant = vacant && !used[j];
+            }
+            if (!vacant)
+            {
+                continue;
+            }
+            std::vector<uint8_t> bytes(length);
+            random.Fill(bytes.data(), length);
+            const uintptr_t address = reinterpret_cast<uintptr_t>(pages + offset);
+            const uint8_t* expected = random.Below(2) ? original.data() + offset : nullptr;
+            const bool nop = random.Below(4) == 0;
+            const size_t index = nop ? set.AddNop(address, length, expected) : set.Add(address, bytes.data(), length, expected);
+            CHECK_EQ(index, patches.size());
+            for (size_t j = 0; j < length; j++)
+            {
+                used[offset + j] = true;
+                patched[offset + j] = nop ? 0x90 : bytes[j];
+            }
+            patches.push_back({ offset, length });
+        }
+
+        CHECK(set.Validate() == SyxLib::PatchStatus::Ok);
+        CHECK(memcmp(pages, original.data(), size) == 0);
+        CHECK(set.Apply() == SyxLib::PatchStatus::Ok && set.IsApplied());
+        CHECK(memcmp(pages, patched.data(), size) == 0);
+        for (size_t i = 0; i < patches.size(); i++)
+        {
+            CHECK(memcmp(set.Original(i), original.data() + patches[i].first, patches[i].second) == 0);
+        }
+        CHECK(ProtectionAt(pages + PAGE_BYTES) == SyxLib::PROTECT_READ && ProtectionAt(pages + 4 * PAGE_BYTES) == SyxLib::PROTECT_READ);
+        CHECK(set.Apply() == SyxLib::PatchStatus::InvalidArgument);
+        CHECK_EQ(set.Add(reinterpret_cast<uintptr_t>(pages), { 0xCC }), SyxLib::NOT_FOUND);
+
+        // A patch overwritten since Apply blocks the whole revert.
+        if (random.Below(3) == 0)
+        {
+            const size_t victim = random.Below(patches.size());
+            uint8_t* at = pages + patches[victim].first;
+            SetReadOnly(pages, size, false);
+            at[0] ^= 0xFF;
+            std::vector<uint8_t> before(pages, pages + size);
+            CHECK(set.Revert() == SyxLib::PatchStatus::Mismatch && set.FailedPatch() == victim);
+            CHECK(memcmp(pages, before.data(), size) == 0);
+            at[0] ^= 0xFF;
+            SetReadOnly(pages + PAGE_BYTES, PAGE_BYTES, true);
+            SetReadOnly(pages + 4 * PAGE_BYTES, PAGE_BYTES, true);
+        }
+        CHECK(set.Revert() == SyxLib::PatchStatus::Ok && !set.IsApplied());
+        CHECK(memcmp(pages, original.data(), size) == 0);
+        CHECK(ProtectionAt(pages + PAGE_BYTES) == SyxLib::PROTECT_READ);
+    }
+    SetReadOnly(pages, size, false);
+}
+
+static void TestPatchFailures(uint8_t* pages, TestRandom& random)
+{
+    random.Fill(pages, PAGES * PAGE_BYTES);
+    const std::vector<uint8_t> original(pages, pages + PAGES * PAGE_BYTES);
+    const uintptr_t base = reinterpret_cast<uintptr_t>(pages);
+
+    // Overlapping patches, a wrong expected byte: nothing is written.
+    SyxLib::PatchSet overlap;
+    overlap.Add(base + 100, { 1, 2, 3, 4 });
+    overlap.Add(base + 5000, { 5 });
+    overlap.Add(base + 102, { 6, 7 });
+    CHECK(overlap.Apply() == SyxLib::PatchStatus::Overlap && overlap.FailedPatch() == 2);
+
+    SyxLib::PatchSet mismatch;
+    mismatch.Add(base + 10, { 1 }, { original[10] });
+    mismatch.Add(base + 9000, { 2, 3 }, { original[9000], static_cast<uint8_t>(original[9001] ^ 1) });
+    CHECK(mismatch.Apply() == SyxLib::PatchStatus::Mismatch && mismatch.FailedPatch() == 1);
+    CHECK(memcmp(pages, original.data(), original.size()) == 0);
+
+    SyxLib::PatchSet empty;
+    CHECK(empty.Apply() == SyxLib::PatchStatus::InvalidArgument);
+    CHECK_EQ(empty.Add(base, nullptr, 4), SyxLib::NOT_FOUND);
+    CHECK_EQ(empty.AddNop(base, 2, { 0x90 }), SyxLib::NOT_FOUND);
+
+    // A patch reaching into unmapped memory.
+    FreePages(pages + (PAGES - 1) * PAGE_BYTES, PAGE_BYTES);
+    SyxLib::PatchSet unmapped;
+    unmapped.Add(base + 20, { 1 });
+    unmapped.AddNop(base + (PAGES - 1) * PAGE_BYTES - 2, 4);
+    CHECK(unmapped.Apply() == SyxLib::PatchStatus::Unreadable && unmapped.FailedPatch() == 1);
+    CHECK(memcmp(pages, original.data(), (PAGES - 1) * PAGE_BYTES) == 0);
+}
+
+class Shape
+{
+public:
+    virtual ~Shape() = default;
+    virtual int Area() const
+    {
+        return 6;
+    }
+    virtual int Sides() const
+    {
+        return 4;
+    }
+};
+
+static int g_hookCalls;
+static const void* g_originalArea;
+
+static int HookedArea(const Shape* shape)
+{
+    g_hookCalls++;
+    // The original is reached through the pointer the slot held.
+    return 100 + reinterpret_cast<int (*)(const Shape*)>(const_cast<void*>(g_originalArea))(shape);
+}
+
+static int HookedSides(const Shape*)
+{
+    return 8;
+}
+
+/** Keeps the compiler from devirtualizing the calls. */
+static Shape* volatile g_shape;
+
+static int Twice(int x)
+{
+    return x * 2;
+}
+
+static int Thrice(int x)
+{
+    return x * 3;
+}
+
+static int (*g_table[5])(int) = { Twice, Twice, Twice, Twice, Twice };
+
+#ifdef __linux__
+static pid_t FakePid()
+{
+    return 4242;
+}
+#endif
+
+static void TestPointerHooks()
+{
+    Shape shape;
+    g_shape = &shape;
+    // Slots 0 and 1 of the Itanium vtable are the destructors.
+    const size_t area = 2, sides = 3;
+    {
+        SyxLib::PointerHooks hooks;
+        CHECK(hooks.CreateVirtual(g_shape, area, reinterpret_cast<const void*>(&HookedArea), &g_originalArea) == SyxLib::HookStatus::Ok);
+        CHECK(hooks.CreateVirtual(g_shape, sides, reinterpret_cast<const void*>(&HookedSides)) == SyxLib::HookStatus::Ok);
+        CHECK(hooks.CreateVirtual(g_shape, area, reinterpret_cast<const void*>(&HookedSides)) == SyxLib::HookStatus::AlreadyHooked);
+        CHECK(g_shape->Area() == 6 && g_shape->Sides() == 4);
+        CHECK(hooks.EnableAll() == SyxLib::HookStatus::Ok);
+        CHECK(g_shape->Area() == 106 && g_shape->Sides() == 8 && g_hookCalls == 1);
+        void** table = *reinterpret_cast<void***>(g_shape);
+        CHECK(hooks.Disable(table + sides) == SyxLib::HookStatus::Ok && hooks.IsEnabled(table + area));
+        CHECK(g_shape->Area() == 106 && g_shape->Sides() == 4);
+        // Destroying the registry unhooks what is still enabled.
+    }
+    CHECK(g_shape->Area() == 6 && g_shape->Sides() == 4);
+
+    SyxLib::PointerHooks hooks;
+    void** slots[4];
+    for (size_t i = 0; i < 4; i++)
+    {
+        slots[i] = reinterpret_cast<void**>(&g_table[i]);
+        CHECK(hooks.Create(slots[i], reinterpret_cast<const void*>(&Thrice)) == SyxLib::HookStatus::Ok);
+    }
+    CHECK(hooks.Enable({ slots[0], slots[1] }) == SyxLib::HookStatus::Ok);
+    CHECK(g_table[0](5) == 15 && g_table[1](5) == 15 && g_table[2](5) == 10);
+
+    // Someone else rewrote slot 3: a batch containing it writes nothing.
+    g_table[3] = Thrice;
+    CHECK(hooks.Enable({ slots[2], slots[3] }) == SyxLib::HookStatus::SlotChanged);
+    CHECK(!hooks.IsEnabled(slots[2]) && g_table[2](5) == 10);
+    g_table[3] = Twice;
+    // A slot without a hook is reported; the hooked ones are still enabled.
+    CHECK(hooks.Enable({ slots[2], slots[3], reinterpret_cast<void**>(&g_table[4]) }) == SyxLib::HookStatus::UnknownHook);
+    CHECK(g_table[2](5) == 15 && g_table[3](5) == 15 && hooks.IsEnabled(slots[3]));
+    CHECK(hooks.Remove(slots[0]) == SyxLib::HookStatus::Ok && hooks.Count() == 3 && g_table[0](5) == 10);
+    CHECK(hooks.DisableAll() == SyxLib::HookStatus::Ok);
+    CHECK(g_table[1](5) == 10 && g_table[2](5) == 10 && g_table[3](5) == 10);
+
+#ifdef __linux__
+    const pid_t pid = getpid();
+    const void* original = nullptr;
+    const SyxLib::HookStatus status = hooks.CreateImport(nullptr, "getpid", reinterpret_cast<const void*>(&FakePid), &original);
+    CHECK(status == SyxLib::HookStatus::Ok);
+    if (status == SyxLib::HookStatus::Ok)
+    {
+        CHECK(hooks.EnableAll() == SyxLib::HookStatus::Ok && getpid() == 4242);
+        CHECK(reinterpret_cast<pid_t (*)()>(const_cast<void*>(original))() == pid);
+        CHECK(hooks.DisableAll() == SyxLib::HookStatus::Ok && getpid() == pid);
+    }
+    CHECK(hooks.CreateImport(nullptr, "no_such_import", reinterpret_cast<const void*>(&FakePid)) == SyxLib::HookStatus::NotFound);
+#endif
+}
+
+int main()
+{
+    uint8_t* pages = AllocatePages(PAGES * PAGE_BYTES);
+    CHECK(pages != nullptr);
+    if (pages)
+    {
+        TestRandom random;
+        TestPatchSets(pages, random);
+        TestPatchFailures(pages, random);
+        FreePages(pages, (PAGES - 1) * PAGE_BYTES);
+    }
+    TestPointerHooks();
+    return Finish("patches");
+}
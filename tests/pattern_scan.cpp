@@ -0,0 +1,277 @@
+// Pattern scan test
+// Scanner at every instruction set, Pattern, PatternSet, ParallelFind, MatchRange, FindInSpans,
+// FindBestMatch and GenerateSignature are compared with reference loops over random buffers. Small
+// byte alphabets give many partial matches, so every verification and tail path gets exercised.
+
+#include "../Syx/FuzzyScan.h"
+#include "../Syx/Matches.h"
+#include "../Syx/ParallelScan.h"
+#include "../Syx/PatternSet.h"
+#include "../Syx/SignatureGen.h"
+#include "Check.h"
+#include <stdexcept>
+
+static const size_t BUFFER_BYTES = 48 * 1024;
+
+static std::vector<SyxLib::ScanLevel> SupportedLevels()
+{
+    std::vector<SyxLib::ScanLevel> levels;
+    const SyxLib::ScanLevel all[] = { SyxLib::ScanLevel::Scalar, SyxLib::ScanLevel::SSE2, SyxLib::ScanLevel::AVX2, SyxLib::ScanLevel::AVX512 };
+    for (SyxLib::ScanLevel level : all)
+    {
+        if (level <= SyxLib::DetectScanLevel())
+        {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+/** A pattern cut from the buffer (or random bytes) with some bytes turned into wildcards. */
+static TestPattern RandomPattern(const uint8_t* data, size_t size, TestRandom& random, size_t maxLength)
+{
+    TestPattern pattern;
+    const size_t length = 1 + random.Below(random.Below(4) ? (std::min)(size_t(24), maxLength) : maxLength);
+    const size_t start = random.Below(size - length + 1);
+    const bool present = random.Below(4) != 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        pattern.bytes.push_back(present ? data[start + i] : static_cast<uint8_t>(random.Next()));
+        pattern.mask += random.Below(4) ? 'x' : '?';
+    }
+    return pattern;
+}
+
+static void TestPatternParsing()
+{
+    const SyxLib::Pattern pattern("48 8B ?? E8 ? ?? ?? ?? c3");
+    CHECK_EQ(pattern.Length(), 9u);
+    const uint8_t bytes[] = { 0x48, 0x8B, 0, 0xE8, 0, 0, 0, 0, 0xC3 };
+    const uint8_t mask[] = { 0xFF, 0xFF, 0, 0xFF, 0, 0, 0, 0, 0xFF };
+    for (size_t i = 0; i < pattern.Length(); i++)
+    {
+        CHECK_EQ(pattern.Mask()[i], mask[i]);
+        CHECK_EQ(pattern.Mask()[i] ? pattern.Bytes()[i] : 0, bytes[i]);
+    }
+
+    const char* const malformed[] = { "", "   ", "4", "48 8", "48 GG", "488B", "48 ?x" };
+    for (const char* signature : malformed)
+    {
+        bool threw = false;
+        try
+        {
+            SyxLib::Pattern parsed(signature);
+            (void)parsed;
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
+
+static void TestFind(const uint8_t* data, TestRandom& random, const std::vector<SyxLib::ScanLevel>& levels)
+{
+    for (int round = 0; round < 150; round++)
+    {
+        // Random sizes move matches onto the last candidate and into every tail length.
+        const size_t size = 1 + random.Below(BUFFER_BYTES);
+        const TestPattern pattern = RandomPattern(data, size, random, SyxLib::Pattern::MAX_LENGTH);
+        const size_t from = random.Below(2) ? 0 : random.Below(size + 2);
+        const size_t expected = ReferenceFind(data, size, pattern, from);
+
+        const SyxLib::Scanner masked(pattern.bytes.data(), pattern.mask.c_str());
+        const SyxLib::Scanner parsed(SyxLib::Pattern(pattern.Signature().c_str()));
+        for (SyxLib::ScanLevel level : levels)
+        {
+            CHECK_EQ(masked.Find(data, size, from, level), expected);
+            CHECK_EQ(parsed.Find(data, size, from, level), expected);
+        }
+        if (expected != SIZE_MAX)
+        {
+            CHECK(masked.MatchesAt(data + expected));
+        }
+
+        SyxLib::ParallelScanOptions options;
+        options.threadCount = 1 + static_cast<unsigned>(random.Below(4));
+        options.chunkSize = 1 + random.Below(4096);
+        CHECK_EQ(SyxLib::ParallelFind(masked, data, size, options), ReferenceFind(data, size, pattern));
+
+        const std::vector<size_t> all = ReferenceFindAll(data, size, pattern);
+        const size_t limit = random.Below(2) ? SIZE_MAX : random.Below(5);
+        const std::vector<uintptr_t> matches = SyxLib::MatchRange(masked, data, size, limit, 100).ToVector();
+        CHECK_EQ(matches.size(), (std::min)(all.size(), limit));
+        for (size_t i = 0; i < matches.size() && i < all.size(); i++)
+        {
+            CHECK_EQ(matches[i], all[i] + 100);
+        }
+        CHECK_EQ(SyxLib::CountMatches(masked, data, size, limit), (std::min)(all.size(), limit));
+    }
+}
+
+static void TestPatternSet(const uint8_t* data, TestRandom& random)
+{
+    for (int round = 0; round < 4; round++)
+    {
+        SyxLib::PatternSet set;
+        std::vector<TestPattern> patterns;
+        for (int i = 0; i < 60; i++)
+        {
+            patterns.push_back(RandomPattern(data, BUFFER_BYTES, random, 40));
+            if (i % 3)
+            {
+                set.Add("masked", patterns.back().bytes.data(), patterns.back().mask.c_str());
+            }
+            else
+            {
+                set.Add("parsed", SyxLib::Pattern(patterns.back().Signature().c_str()));
+            }
+        }
+        set.Compile();
+        const size_t size = BUFFER_BYTES - random.Below(64);
+        const std::vector<size_t> offsets = set.Scan(data, size);
+        CHECK_EQ(offsets.size(), patterns.size());
+        for (size_t i = 0; i < patterns.size() && i < offsets.size(); i++)
+        {
+            CHECK_EQ(offsets[i], ReferenceFind(data, size, patterns[i]));
+        }
+    }
+}
+
+static void TestSpans(const uint8_t* data, TestRandom& random)
+{
+    for (int round = 0; round < 60; round++)
+    {
+        // Spans with holes between them; a match may not bridge a hole.
+        std::vector<SyxLib::ByteSpan> spans;
+        for (size_t offset = random.Below(64); offset < BUFFER_BYTES;)
+        {
+            const size_t size = (std::min)(1 + random.Below(4096), BUFFER_BYTES - offset);
+            spans.push_back({ data + offset, size });
+            offset += size + random.Below(3) * random.Below(128);
+        }
+        const TestPattern pattern = RandomPattern(data, BUFFER_BYTES, random, 32);
+        const size_t from = random.Below(BUFFER_BYTES), to = from + random.Below(BUFFER_BYTES);
+
+        std::vector<size_t> all;
+        size_t expected = SIZE_MAX;
+        for (const SyxLib::ByteSpan& span : spans)
+        {
+            const size_t begin = static_cast<size_t>(span.data - data);
+            for (size_t offset : ReferenceFindAll(span.data, span.size, pattern))
+            {
+                all.push_back(begin + offset);
+                if (expected == SIZE_MAX && begin + offset >= from && begin + offset + pattern.bytes.size() <= to)
+                {
+                    expected = begin + offset;
+                }
+            }
+        }
+
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str());
+        CHECK_EQ(SyxLib::FindInSpans(scanner, data, spans, from, to), expected);
+        const std::vector<uintptr_t> matches = SyxLib::MatchRange(scanner, spans).ToVector();
+        CHECK_EQ(matches.size(), all.size());
+        for (size_t i = 0; i < matches.size() && i < all.size(); i++)
+        {
+            CHECK_EQ(matches[i], reinterpret_cast<uintptr_t>(data) + all[i]);
+            CHECK(SyxLib::MatchesInSpans(scanner, data, spans, all[i]));
+        }
+    }
+}
+
+static void TestBestMatch(const uint8_t* data, TestRandom& random, const std::vector<SyxLib::ScanLevel>& levels)
+{
+    for (int round = 0; round < 80; round++)
+    {
+        const size_t size = 1 + random.Below(16 * 1024);
+        TestPattern pattern = RandomPattern(data, size, random, 48);
+        // Damage a few bytes so the best match is usually inexact.
+        for (size_t i = random.Below(4); i > 0; i--)
+        {
+            pattern.bytes[random.Below(pattern.bytes.size())] ^= 0x5A;
+        }
+        const size_t maxMismatches = random.Below(6);
+
+        size_t bestOffset = SIZE_MAX, best = SIZE_MAX;
+        for (size_t offset = 0; offset + pattern.bytes.size() <= size; offset++)
+        {
+            const size_t mismatches = ReferenceMismatches(data + offset, pattern);
+            if (mismatches <= maxMismatches && mismatches < best)
+            {
+                best = mismatches;
+                bestOffset = offset;
+            }
+        }
+
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str());
+        for (SyxLib::ScanLevel level : levels)
+        {
+            const SyxLib::FuzzyMatch match = SyxLib::FindBestMatch(scanner, data, size, maxMismatches, level);
+            CHECK_EQ(match.offset, bestOffset);
+            if (bestOffset != SIZE_MAX)
+            {
+                CHECK_EQ(match.mismatches, best);
+            }
+        }
+    }
+}
+
+static void TestSignatures(const uint8_t* data, TestRandom& random)
+{
+    size_t generated = 0;
+    for (int round = 0; round < 40; round++)
+    {
+        SyxLib::SignatureOptions options;
+        options.margin = random.Below(3);
+        const size_t target = random.Below(BUFFER_BYTES - 256);
+        const std::string signature = SyxLib::GenerateSignature(data, BUFFER_BYTES, target, options);
+        if (signature.empty())
+        {
+            continue;
+        }
+        generated++;
+
+        // The signature matches at the target and every other location differs in more than margin bytes.
+        const SyxLib::Pattern parsed(signature.c_str());
+        TestPattern pattern;
+        for (size_t i = 0; i < parsed.Length(); i++)
+        {
+            pattern.bytes.push_back(parsed.Bytes()[i]);
+            pattern.mask += parsed.Mask()[i] ? 'x' : '?';
+        }
+        CHECK(ReferenceMatchesAt(data + target, pattern));
+        for (size_t offset = 0; offset + pattern.bytes.size() <= BUFFER_BYTES; offset++)
+        {
+            if (offset != target && ReferenceMismatches(data + offset, pattern) <= options.margin)
+            {
+                printf("signature %s for offset %zu also matches at %zu\n", signature.c_str(), target, offset);
+                g_failures++;
+                break;
+            }
+        }
+    }
+    // Random bytes are almost always unique within a few instructions.
+    CHECK(generated >= 30);
+}
+
+int main()
+{
+    const std::vector<SyxLib::ScanLevel> levels = SupportedLevels();
+    TestRandom random;
+    std::vector<uint8_t> buffer(BUFFER_BYTES);
+
+    TestPatternParsing();
+    const unsigned alphabets[] = { 2, 4, 256 };
+    for (unsigned alphabet : alphabets)
+    {
+        random.Fill(buffer.data(), buffer.size(), alphabet);
+        TestFind(buffer.data(), random, levels);
+        TestPatternSet(buffer.data(), random);
+        TestSpans(buffer.data(), random);
+        TestBestMatch(buffer.data(), random, levels);
+    }
+    TestSignatures(buffer.data(), random);
+    return Finish("pattern_scan");
+}
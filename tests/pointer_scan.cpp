@@ -0,0 +1,200 @@
+// PointerScan test
+// A synthetic pointer graph in a "static" and a "heap" allocation is searched with PointerMap and
+// FindPointerPaths and compared with a forward search that tries every offset at every step.
+// FilterPointerPaths is checked against following each path by hand after the graph changes.
+
+#include "../Syx/PointerScan.h"
+#include "Check.h"
+#include <cstring>
+#include <map>
+
+static const size_t STATIC_BYTES = 16 * 1024;
+static const size_t HEAP_BYTES = 64 * 1024;
+
+struct Graph
+{
+    std::vector<SyxLib::MemoryRegion> regions;
+    std::vector<SyxLib::MemoryRegion> statics;
+    /** Every location holding a value that points into the regions, with that value. */
+    std::map<uintptr_t, uintptr_t> pointers;
+};
+
+static bool InRegions(const std::vector<SyxLib::MemoryRegion>& regions, uintptr_t address)
+{
+    for (const SyxLib::MemoryRegion& region : regions)
+    {
+        if (address - region.base < region.size)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static Graph Index(const std::vector<SyxLib::MemoryRegion>& regions, const std::vector<SyxLib::MemoryRegion>& statics, size_t step)
+{
+    Graph graph = { regions, statics, {} };
+    for (const SyxLib::MemoryRegion& region : regions)
+    {
+        for (size_t offset = 0; offset + sizeof(uintptr_t) <= region.size; offset += step)
+        {
+            uintptr_t value;
+            memcpy(&value, reinterpret_cast<const uint8_t*>(region.base + offset), sizeof(value));
+            if (InRegions(regions, value))
+            {
+                graph.pointers[region.base + offset] = value;
+            }
+        }
+    }
+    return graph;
+}
+
+/** Follows every offset from every static pointer, depth-first, and sorts like FindPointerPaths. */
+static std::vector<SyxLib::PointerPath> ReferencePaths(const Graph& graph, uintptr_t target, const SyxLib::PointerScanOptions& options)
+{
+    std::vector<SyxLib::PointerPath> paths;
+    std::vector<uintptr_t> offsets;
+    auto follow = [&](auto& self, uintptr_t base, uintptr_t value, size_t depth) -> void
+    {
+        for (size_t offset = 0; offset <= options.maxOffset; offset++)
+        {
+            offsets.push_back(offset);
+            if (offsets.size() == depth)
+            {
+                if (value + offset == target)
+                {
+                    paths.push_back({ base, offsets });
+                }
+            }
+            else
+            {
+                auto next = graph.pointers.find(value + offset);
+                if (next != graph.pointers.end())
+                {
+                    self(self, base, next->second, depth);
+                }
+            }
+            offsets.pop_back();
+        }
+    };
+    for (size_t depth = 1; depth <= options.maxDepth; depth++)
+    {
+        for (const auto& pointer : graph.pointers)
+        {
+            if (InRegions(graph.statics, pointer.first))
+            {
+                follow(follow, pointer.first, pointer.second, depth);
+            }
+        }
+    }
+    return paths;
+}
+
+static bool ReferenceResolve(const std::vector<SyxLib::MemoryRegion>& regions, const SyxLib::PointerPath& path, uintptr_t& address)
+{
+    address = path.base;
+    for (uintptr_t offset : path.offsets)
+    {
+        if (!InRegions(regions, address) || !InRegions(regions, address + sizeof(uintptr_t) - 1))
+        {
+            return false;
+        }
+        uintptr_t value;
+        memcpy(&value, reinterpret_cast<const void*>(address), sizeof(value));
+        address = value + offset;
+    }
+    return true;
+}
+
+static void TestGraph(uint8_t* statics, uint8_t* heap, bool aligned, TestRandom& random)
+{
+    memset(statics, 0, STATIC_BYTES);
+    memset(heap, 0, HEAP_BYTES);
+    std::vector<SyxLib::MemoryRegion> regions = {
+        { reinterpret_cast<uintptr_t>(statics), STATIC_BYTES, SyxLib::PROTECT_READ | SyxLib::PROTECT_WRITE, "" },
+        { reinterpret_cast<uintptr_t>(heap), HEAP_BYTES, SyxLib::PROTECT_READ | SyxLib::PROTECT_WRITE, "" },
+    };
+    const std::vector<SyxLib::MemoryRegion> staticRegions = { regions[0] };
+    std::sort(regions.begin(), regions.end(), [](const SyxLib::MemoryRegion& a, const SyxLib::MemoryRegion& b) { return a.base < b.base; });
+
+    // Half of the pointers lead into a hot 2 KB object around the target, so paths branch and
+    // merge; the rest point anywhere. Unaligned runs also store pointers at odd locations.
+    const uintptr_t hot = reinterpret_cast<uintptr_t>(heap) + 8192;
+    const uintptr_t target = hot + 1000;
+    for (int i = 0; i < 800; i++)
+    {
+        const bool inStatic = random.Below(4) == 0;
+        uint8_t* region = inStatic ? statics : heap;
+        const size_t size = inStatic ? STATIC_BYTES : HEAP_BYTES;
+        size_t offset = random.Below(size - sizeof(uintptr_t) + 1);
+        offset = aligned || random.Below(2) ? offset & ~(sizeof(uintptr_t) - 1) : offset;
+        uintptr_t value;
+        if (random.Below(2))
+        {
+            value = hot + random.Below(2048);
+        }
+        else
+        {
+            value = random.Below(4) ? reinterpret_cast<uintptr_t>(heap) + random.Below(HEAP_BYTES) : reinterpret_cast<uintptr_t>(statics) + random.Below(STATIC_BYTES);
+        }
+        memcpy(region + offset, &value, sizeof(value));
+    }
+
+    SyxLib::PointerScanOptions options;
+    options.maxDepth = 4;
+    options.maxOffset = 256;
+    options.aligned = aligned;
+    options.threadCount = 1 + static_cast<unsigned>(random.Below(4));
+    const Graph graph = Index(regions, staticRegions, aligned ? sizeof(uintptr_t) : 1);
+    const SyxLib::PointerMap map(SyxLib::LocalMemory::Instance(), regions, options);
+    CHECK_EQ(map.Size(), graph.pointers.size());
+
+    const std::vector<SyxLib::PointerPath> expected = ReferencePaths(graph, target, options);
+    const std::vector<SyxLib::PointerPath> paths = SyxLib::FindPointerPaths(map, target, staticRegions, options);
+    printf("%s: %zu pointers, %zu paths\n", aligned ? "aligned" : "unaligned", graph.pointers.size(), expected.size());
+    CHECK(expected.size() > 10);
+    CHECK(paths == expected);
+
+    // A result limit keeps the shortest paths first.
+    options.maxResults = expected.size() / 3;
+    const std::vector<SyxLib::PointerPath> limited = SyxLib::FindPointerPaths(map, target, staticRegions, options);
+    CHECK(limited == std::vector<SyxLib::PointerPath>(expected.begin(), expected.begin() + options.maxResults));
+
+    // Redirect a few heap pointers: only the paths that still reach the target by hand survive.
+    for (int i = 0; i < 8; i++)
+    {
+        auto it = graph.pointers.lower_bound(reinterpret_cast<uintptr_t>(heap) + random.Below(HEAP_BYTES));
+        if (it != graph.pointers.end())
+        {
+            const uintptr_t value = reinterpret_cast<uintptr_t>(heap) + random.Below(HEAP_BYTES - 64);
+            memcpy(reinterpret_cast<void*>(it->first), &value, sizeof(value));
+        }
+    }
+    std::vector<SyxLib::PointerPath> surviving;
+    for (const SyxLib::PointerPath& path : expected)
+    {
+        uintptr_t address;
+        if (ReferenceResolve(regions, path, address) && address == target)
+        {
+            surviving.push_back(path);
+        }
+    }
+    CHECK(SyxLib::FilterPointerPaths(SyxLib::LocalMemory::Instance(), expected, target) == surviving);
+    CHECK(SyxLib::IntersectPointerPaths(expected, surviving) == surviving);
+}
+
+int main()
+{
+    uint8_t* statics = AllocatePages(STATIC_BYTES);
+    uint8_t* heap = AllocatePages(HEAP_BYTES);
+    CHECK(statics && heap);
+    if (statics && heap)
+    {
+        TestRandom random;
+        TestGraph(statics, heap, true, random);
+        TestGraph(statics, heap, false, random);
+        FreePages(statics, STATIC_BYTES);
+        FreePages(heap, HEAP_BYTES);
+    }
+    return Finish("pointer_scan");
+}
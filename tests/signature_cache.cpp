@@ -0,0 +1,193 @@
+// SignatureCache test
+// Stores and lookups are compared with a std::map through growth, reopening, a second handle on
+// the same file, Clear and a corrupt file. On Linux, several processes fill one cache at once and
+// every entry of every process must be readable afterwards.
+
+#include "../Syx/SignatureCache.h"
+#include "Check.h"
+#include <algorithm>
+#include <map>
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static const char* const PATH = "signature_cache.sigcache";
+
+typedef std::map<std::pair<uint64_t, uint64_t>, size_t> ReferenceCache;
+
+static void CompareAll(const SyxLib::SignatureCache& cache, const ReferenceCache& expected)
+{
+    CHECK_EQ(cache.Count(), expected.size());
+    for (const auto& entry : expected)
+    {
+        size_t offset = 0;
+        if (!cache.Lookup(entry.first.first, entry.first.second, offset) || offset != entry.second)
+        {
+            printf("entry %llx:%llx missing or wrong\n", static_cast<unsigned long long>(entry.first.first),
+                static_cast<unsigned long long>(entry.first.second));
+            g_failures++;
+            return;
+        }
+    }
+}
+
+static void TestStoreLookup(TestRandom& random)
+{
+    remove(PATH);
+    SyxLib::SignatureCache cache(PATH);
+    CHECK(cache.IsOpen());
+    CHECK_EQ(cache.Count(), 0u);
+
+    // Few module keys and small pattern keys collide on slots, overwrites replace in place.
+    ReferenceCache expected;
+    for (int i = 0; i < 5000; i++)
+    {
+        const uint64_t moduleKey = random.Below(3), patternKey = random.Below(4000);
+        const size_t offset = random.Below(8) ? random.Below(1 << 24) : SyxLib::NOT_FOUND;
+        CHECK(cache.Store(moduleKey, patternKey, offset));
+        expected[{ moduleKey, patternKey }] = offset;
+    }
+    CompareAll(cache, expected);
+    size_t offset;
+    CHECK(!cache.Lookup(7, 1, offset));
+
+    // A second handle maps the grown file once it takes the lock.
+    SyxLib::SignatureCache other(PATH);
+    CompareAll(other, expected);
+    CHECK(other.Store(9, 9, 99));
+    expected[{ 9, 9 }] = 99;
+    CompareAll(cache, expected);
+
+    CHECK(cache.Flush());
+    SyxLib::SignatureCache reopened(PATH);
+    CompareAll(reopened, expected);
+
+    CHECK(reopened.Clear());
+    CHECK_EQ(reopened.Count(), 0u);
+    CHECK(!reopened.Lookup(9, 9, offset));
+    CHECK(reopened.Store(1, 2, 3));
+    CHECK(reopened.Lookup(1, 2, offset) && offset == 3);
+}
+
+static void TestCorruptFile()
+{
+    // A file that is not a cache is reinitialized empty, never trusted.
+    FILE* file = fopen(PATH, "wb");
+    CHECK(file != nullptr);
+    if (file)
+    {
+        TestRandom random(7);
+        for (int i = 0; i < 10000; i++)
+        {
+            fputc(static_cast<int>(random.Below(256)), file);
+        }
+        fclose(file);
+    }
+    SyxLib::SignatureCache cache(PATH);
+    CHECK(cache.IsOpen());
+    CHECK_EQ(cache.Count(), 0u);
+    size_t offset;
+    CHECK(cache.Store(5, 6, 7));
+    CHECK(cache.Lookup(5, 6, offset) && offset == 7);
+}
+
+static void TestFind(TestRandom& random)
+{
+    remove(PATH);
+    SyxLib::SignatureCache cache(PATH);
+    std::vector<uint8_t> image(64 * 1024);
+    random.Fill(image.data(), image.size(), 16);
+    const std::vector<SyxLib::ByteSpan> spans = { { image.data(), 20000 }, { image.data() + 30000, 34000 } };
+
+    for (int round = 0; round < 40; round++)
+    {
+        TestPattern pattern;
+        const size_t start = random.Below(image.size() - 8);
+        for (size_t i = 0; i < 6; i++)
+        {
+            pattern.bytes.push_back(random.Below(6) ? image[start + i] : static_cast<uint8_t>(random.Below(16)));
+            pattern.mask += random.Below(5) ? 'x' : '?';
+        }
+        const SyxLib::Scanner scanner(pattern.bytes.data(), pattern.mask.c_str());
+        size_t expected = SIZE_MAX;
+        for (const SyxLib::ByteSpan& span : spans)
+        {
+            const size_t found = ReferenceFind(span.data, span.size, pattern);
+            if (found != SIZE_MAX)
+            {
+                expected = static_cast<size_t>(span.data - image.data()) + found;
+                break;
+            }
+        }
+
+        // Scanned, then answered from the cache, then rescanned once the cached match is gone.
+        CHECK_EQ(cache.Find(1, scanner, image.data(), spans), expected);
+        CHECK_EQ(cache.Find(1, scanner, image.data(), spans), expected);
+        if (expected != SIZE_MAX)
+        {
+            std::vector<uint8_t> saved(image.begin() + expected, image.begin() + expected + 6);
+            for (size_t i = 0; i < 6; i++)
+            {
+                image[expected + i] = static_cast<uint8_t>(0xF0 | i);
+            }
+            const size_t moved = SyxLib::FindInSpans(scanner, image.data(), spans);
+            CHECK_EQ(cache.Find(1, scanner, image.data(), spans), moved);
+            std::copy(saved.begin(), saved.end(), image.begin() + expected);
+        }
+    }
+}
+
+#ifdef __linux__
+static void TestProcesses()
+{
+    remove(PATH);
+    const int processes = 4, entries = 3000;
+    std::vector<pid_t> children;
+    for (int process = 0; process < processes; process++)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            // Every process grows the table several times while the others insert.
+            SyxLib::SignatureCache cache(PATH);
+            bool ok = cache.IsOpen();
+            for (int i = 0; i < entries && ok; i++)
+            {
+                ok = cache.Store(process, i, size_t(i) * 16);
+            }
+            _exit(ok ? 0 : 1);
+        }
+        CHECK(pid > 0);
+        children.push_back(pid);
+    }
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    ReferenceCache expected;
+    for (int process = 0; process < processes; process++)
+    {
+        for (int i = 0; i < entries; i++)
+        {
+            expected[{ uint64_t(process), uint64_t(i) }] = size_t(i) * 16;
+        }
+    }
+    CompareAll(SyxLib::SignatureCache(PATH), expected);
+}
+#endif
+
+int main()
+{
+    TestRandom random;
+    TestStoreLookup(random);
+    TestCorruptFile();
+    TestFind(random);
+#ifdef __linux__
+    TestProcesses();
+#endif
+    remove(PATH);
+    return Finish("signature_cache");
+}
@@ -0,0 +1,193 @@
+// ValueScan test
+// First and next scans of every value type and several alignments are compared with a reference
+// loop over the same buffer, through the current process and, on Linux, through ProcessMemory.
+// A candidate unmapped between two scans must be dropped, not read.
+
+#include "../Syx/ValueScan.h"
+#include "Check.h"
+#include <cstring>
+#include <map>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static const size_t BUFFER_BYTES = 256 * 1024;
+
+template <typename T>
+static T Load(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static bool ReferencePasses(SyxLib::ValueCompare compare, T current, T previous, T lo, T hi)
+{
+    switch (compare)
+    {
+    case SyxLib::ValueCompare::Unknown:
+        return true;
+    case SyxLib::ValueCompare::Exact:
+    case SyxLib::ValueCompare::Range:
+        return current >= lo && current <= hi;
+    case SyxLib::ValueCompare::Changed:
+        return memcmp(&current, &previous, sizeof(T)) != 0;
+    case SyxLib::ValueCompare::Unchanged:
+        return memcmp(&current, &previous, sizeof(T)) == 0;
+    case SyxLib::ValueCompare::Increased:
+        return current > previous;
+    default:
+        return current < previous;
+    }
+}
+
+/** Compares the scan's candidates with the reference map of address to value. */
+template <typename T>
+static void Compare(const SyxLib::ValueScan<T>& scan, const std::map<uintptr_t, T>& expected, const char* step)
+{
+    const size_t failuresBefore = g_failures;
+    CHECK_EQ(scan.Count(), expected.size());
+    auto it = expected.begin();
+    scan.Results().ForEach([&](uintptr_t address, const T& value)
+    {
+        if (it == expected.end() || it->first != address || memcmp(&it->second, &value, sizeof(T)) != 0)
+        {
+            g_failures++;
+            return false;
+        }
+        ++it;
+        return true;
+    });
+    if (g_failures != static_cast<int>(failuresBefore))
+    {
+        printf("  in %s, sizeof(T) %zu, alignment %zu\n", step, sizeof(T), scan.Results().Alignment());
+    }
+}
+
+template <typename T>
+static void TestType(const SyxLib::MemoryAccessor& memory, uint8_t* buffer, size_t alignment, TestRandom& random)
+{
+    // A small alphabet gives dense hits in some windows; one sparse stretch exercises the gap encoding.
+    random.Fill(buffer, BUFFER_BYTES, 4);
+    memset(buffer + BUFFER_BYTES / 2, 0xFF, BUFFER_BYTES / 4);
+    for (size_t i = 0; i < 40; i++)
+    {
+        buffer[BUFFER_BYTES / 2 + random.Below(BUFFER_BYTES / 4)] = 1;
+    }
+
+    const uintptr_t base = reinterpret_cast<uintptr_t>(buffer);
+    const std::vector<SyxLib::MemoryRegion> regions = { { base, BUFFER_BYTES, SyxLib::PROTECT_READ | SyxLib::PROTECT_WRITE, "" } };
+    auto reference = [&](SyxLib::ValueCompare compare, const std::map<uintptr_t, T>* previous, T lo, T hi)
+    {
+        std::map<uintptr_t, T> result;
+        for (size_t offset = 0; offset + sizeof(T) <= BUFFER_BYTES; offset += alignment)
+        {
+            const uintptr_t address = base + offset;
+            typename std::map<uintptr_t, T>::const_iterator old;
+            if (previous && (old = previous->find(address)) == previous->end())
+            {
+                continue;
+            }
+            const T current = Load<T>(buffer + offset);
+            if (ReferencePasses(compare, current, previous ? old->second : T(), lo, hi))
+            {
+                result[address] = current;
+            }
+        }
+        return result;
+    };
+
+    SyxLib::ValueScan<T> scan(memory, alignment);
+    const T one = Load<T>(buffer + alignment);
+    scan.FirstScan(regions, SyxLib::ValueCompare::Exact, one);
+    Compare(scan, reference(SyxLib::ValueCompare::Exact, nullptr, one, one), "FirstScan Exact");
+
+    const T lo = Load<T>(buffer), hi = (std::max)(lo, Load<T>(buffer + 64));
+    scan.FirstScan(regions, SyxLib::ValueCompare::Range, (std::min)(lo, hi), hi);
+    Compare(scan, reference(SyxLib::ValueCompare::Range, nullptr, (std::min)(lo, hi), hi), "FirstScan Range");
+
+    scan.FirstScan(regions, SyxLib::ValueCompare::Unknown);
+    std::map<uintptr_t, T> expected = reference(SyxLib::ValueCompare::Unknown, nullptr, T(), T());
+    Compare(scan, expected, "FirstScan Unknown");
+
+    const SyxLib::ValueCompare nexts[] = { SyxLib::ValueCompare::Changed, SyxLib::ValueCompare::Increased,
+        SyxLib::ValueCompare::Unchanged, SyxLib::ValueCompare::Decreased, SyxLib::ValueCompare::Exact };
+    for (SyxLib::ValueCompare compare : nexts)
+    {
+        for (size_t i = 0; i < BUFFER_BYTES / 64; i++)
+        {
+            buffer[random.Below(BUFFER_BYTES)] = static_cast<uint8_t>(random.Below(4));
+        }
+        const T value = expected.empty() ? T() : expected.begin()->second;
+        scan.NextScan(compare, value);
+        expected = reference(compare, &expected, value, value);
+        Compare(scan, expected, "NextScan");
+    }
+}
+
+template <typename T>
+static void TestAlignments(const SyxLib::MemoryAccessor& memory, uint8_t* buffer, TestRandom& random)
+{
+    TestType<T>(memory, buffer, 1, random);
+    TestType<T>(memory, buffer, sizeof(T), random);
+    TestType<T>(memory, buffer, 16, random);
+}
+
+static void TestAccessor(const SyxLib::MemoryAccessor& memory, uint8_t* buffer)
+{
+    TestRandom random;
+    TestAlignments<uint8_t>(memory, buffer, random);
+    TestAlignments<int16_t>(memory, buffer, random);
+    TestAlignments<int32_t>(memory, buffer, random);
+    TestAlignments<uint64_t>(memory, buffer, random);
+    TestAlignments<float>(memory, buffer, random);
+    TestAlignments<double>(memory, buffer, random);
+}
+
+static void TestUnmappedCandidates()
+{
+    // Every candidate of the first half survives, the unmapped half is dropped without a fault.
+    const size_t size = 1024 * 1024;
+    uint8_t* pages = AllocatePages(size);
+    CHECK(pages != nullptr);
+    if (!pages)
+    {
+        return;
+    }
+    for (size_t offset = 0; offset < size; offset += sizeof(int32_t))
+    {
+        const int32_t value = 0x5A5A1234;
+        memcpy(pages + offset, &value, sizeof(value));
+    }
+    const uintptr_t base = reinterpret_cast<uintptr_t>(pages);
+    SyxLib::ValueScan<int32_t> scan;
+    scan.FirstScan(SyxLib::FilterRegions(SyxLib::QueryRegions(base, base + size), SyxLib::RegionFilter::Readable()),
+        SyxLib::ValueCompare::Exact, 0x5A5A1234);
+    CHECK_EQ(scan.Count(), size / sizeof(int32_t));
+
+    FreePages(pages + size / 2, size / 2);
+    CHECK_EQ(scan.NextScan(SyxLib::ValueCompare::Unchanged), size / 2 / sizeof(int32_t));
+    FreePages(pages, size / 2);
+    CHECK_EQ(scan.NextScan(SyxLib::ValueCompare::Unchanged), 0u);
+}
+
+int main()
+{
+    uint8_t* buffer = AllocatePages(BUFFER_BYTES);
+    CHECK(buffer != nullptr);
+    if (buffer)
+    {
+        TestAccessor(SyxLib::LocalMemory::Instance(), buffer);
+#ifdef __linux__
+        SyxLib::ProcessMemory self(static_cast<uint32_t>(getpid()));
+        if (self.IsOpen())
+        {
+            TestAccessor(self, buffer);
+        }
+#endif
+        FreePages(buffer, BUFFER_BYTES);
+    }
+    TestUnmappedCandidates();
+    return Finish("value_scan");
+}